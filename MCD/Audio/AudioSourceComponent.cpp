@@ -6,25 +6,17 @@
 
 namespace MCD {
 
-static AudioManagerComponent* gAudioManager = nullptr;
+static ComponentRegistry gAudioRegistry;
 
-void AudioComponent::gather()
-{
-	MCD_ASSUME(gAudioManager);
-	gAudioManager->mComponents.push_back(this);
-}
-
-void AudioManagerComponent::begin()
-{
-	mComponents.clear();
-	gAudioManager = this;
+ComponentRegistry* AudioComponent::registry() const {
+	return &gAudioRegistry;
 }
 
 void AudioManagerComponent::end(float dt)
 {
-	MCD_FOREACH(const AudioComponentPtr c, mComponents)
-		if(c) c->update(dt);
-	gAudioManager = nullptr;
+	// NOTE: The update may destroy the Component or even its Entity, which the iterator can handle
+	for(ComponentRegistry::Iterator itr(gAudioRegistry, Entity::currentRoot()); !itr.ended(); itr.next())
+		static_cast<AudioComponent*>(itr.current())->update(dt);
 }
 
 AudioSourceComponent::AudioSourceComponent()
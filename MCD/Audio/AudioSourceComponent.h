@@ -4,7 +4,6 @@
 #include "ShareLib.h"
 #include "AudioSource.h"
 #include "../Core/Entity/Component.h"
-#include <vector>
 
 namespace MCD {
 
@@ -17,21 +16,15 @@ public:
 
 	virtual void update(float dt) = 0;
 
-protected:
-	sal_override void gather();
+	sal_override sal_maybenull ComponentRegistry* registry() const;
 };	// AudioComponent
 
 typedef IntrusiveWeakPtr<AudioComponent> AudioComponentPtr;
 
 class MCD_AUDIO_API AudioManagerComponent : public ComponentUpdater
 {
-	friend class AudioComponent;
-
 protected:
-	sal_override void begin();
 	sal_override void end(float dt);
-
-	std::vector<AudioComponentPtr> mComponents;
 };	// AudioManagerComponent
 
 typedef IntrusiveWeakPtr<AudioManagerComponent> AudioManagerComponentPtr;
@@ -4,6 +4,7 @@
 #include "../Core/System/Deque.h"
 #include "../Core/System/Mutex.h"
 #include "../Core/System/PlatformInclude.h"
+#include "../Core/System/ReadSpan.h"
 #include "../Core/System/ResourceManager.h"
 #include "../Core/System/StrUtility.h"
 #include "../../3Party/OpenAL/al.h"
@@ -104,6 +105,50 @@ long ov_tell_func(void* userData)
 	return static_cast<long>(is->tellg());
 }
 
+//! A read cursor on the file content in memory, see getReadSpan()
+struct SpanCursor
+{
+	ReadSpanPtr span;
+	size_t pos;
+};	// SpanCursor
+
+// Read directly from the memory, without going through std::istream
+size_t ov_span_read_func(void* ptr, size_t eleSize, size_t count, void* userData)
+{
+	SpanCursor* c = reinterpret_cast<SpanCursor*>(userData);
+	const size_t remain = c->pos < c->span->size() ? c->span->size() - c->pos : 0;
+	const size_t size = eleSize * count < remain ? eleSize * count : remain;
+	::memcpy(ptr, c->span->data() + c->pos, size);
+	c->pos += size;
+	return size;
+}
+
+int ov_span_seek_func(void* userData, ogg_int64_t offset, int whence)
+{
+	SpanCursor* c = reinterpret_cast<SpanCursor*>(userData);
+	ogg_int64_t pos;
+	if(whence == SEEK_SET)
+		pos = offset;
+	else if(whence == SEEK_CUR)
+		pos = ogg_int64_t(c->pos) + offset;
+	else if(whence == SEEK_END)
+		pos = ogg_int64_t(c->span->size()) + offset;
+	else
+		return -1;
+
+	if(pos < 0 || pos > ogg_int64_t(c->span->size()))
+		return 1;
+
+	c->pos = size_t(pos);
+	return 0;
+}
+
+long ov_span_tell_func(void* userData)
+{
+	SpanCursor* c = reinterpret_cast<SpanCursor*>(userData);
+	return static_cast<long>(c->pos);
+}
+
 void swap(short& s1, short& s2)
 {
 	short sTemp = s1;
@@ -247,6 +292,7 @@ public:
 		, mCurrentPcmOffset(0)
 	{
 		::memset(&mInfo, 0, sizeof(mInfo));
+		mSpanCursor.pos = 0;
 	}
 
 	~Impl()
@@ -263,13 +309,26 @@ public:
 			return true;
 
 		mIStream = is;
-		mOggFileCallbacks.read_func = ov_read_func;
-		mOggFileCallbacks.seek_func = ov_seek_func;
+		void* dataSource = is;
 		mOggFileCallbacks.close_func = ov_close_func;
-		mOggFileCallbacks.tell_func = ov_tell_func;
+
+		// Fast path: decode directly from the file content in memory
+		if(ReadSpan* span = getReadSpan(is)) {
+			mSpanCursor.span = span;
+			mSpanCursor.pos = size_t(is->tellg());
+			dataSource = &mSpanCursor;
+			mOggFileCallbacks.read_func = ov_span_read_func;
+			mOggFileCallbacks.seek_func = ov_span_seek_func;
+			mOggFileCallbacks.tell_func = ov_span_tell_func;
+		}
+		else {
+			mOggFileCallbacks.read_func = ov_read_func;
+			mOggFileCallbacks.seek_func = ov_seek_func;
+			mOggFileCallbacks.tell_func = ov_tell_func;
+		}
 
 		{	ScopeUnlock unlock(mMutex);
-			if(gFnOvOpenCallbacks(is, &mOggFile, nullptr, 0, mOggFileCallbacks) != 0)
+			if(gFnOvOpenCallbacks(dataSource, &mOggFile, nullptr, 0, mOggFileCallbacks) != 0)
 				return false;
 
 			// Get some information about the file (Channels, Format, and Frequency)
@@ -381,6 +440,7 @@ public:
 	ov_callbacks mOggFileCallbacks;
 	vorbis_info* mVorbisInfo;
 	std::istream* mIStream;
+	SpanCursor mSpanCursor;
 	IAudioStreamLoader::Info mInfo;
 	uint64_t mCurrentPcmOffset;	//!< The PCM
 
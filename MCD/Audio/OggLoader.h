@@ -25,6 +25,9 @@ public:
 
 	sal_override void commit(Resource& resource);
 
+	//!	The ogg file is decoded directly from memory, it avoids the stream overhead for every seek.
+	sal_override bool preferReadSpan() const { return true; }
+
 	/*!	Invoked by AudioSource when new buffer data need to be load.
 		Each request will be queued up and executed inside the commit() function after the load is finished.
 		Since AudioBuffer has several internal buffers, a bufferIndex need to be supplied inorder to
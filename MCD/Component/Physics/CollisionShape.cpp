@@ -1,11 +1,16 @@
 #include "Pch.h"
 #include "CollisionShape.h"
 #include "MathConvertor.inl"
+#include "../../Core/System/CacheFile.h"
+#include "../../Core/System/ContentHash.h"
 #include "../../Core/System/Log.h"
+#include "../../Core/System/MemoryMappedFile.h"
+#include "../../Core/System/RawFileSystem.h"
 #include "../../Render/Mesh.h"
 #include "../../Render/MeshBuilder.h"
 
 #include "../../../3Party/bullet/btBulletCollisionCommon.h"
+#include <vector>
 
 using namespace MCD;
 
@@ -28,33 +33,81 @@ SphereShape::SphereShape(float radius)
 	: CollisionShape(new btSphereShape(radius))
 {}
 
+BoxShape::BoxShape(const Vec3f& halfExtents)
+	: CollisionShape(new btBoxShape(toBullet(halfExtents)))
+{}
+
 StaticPlaneShape::StaticPlaneShape(const Vec3f& planeNormal, float planeConstant)
 	: CollisionShape(new btStaticPlaneShape(toBullet(planeNormal), planeConstant))
 {}
 
+namespace {
+
+/*!	Header of a BVH cache file, followed by the buffer of btQuantizedBvh::serialize().
+	The size is a multiple of 16, keeping the BVH aligned in the mapped memory.
+ */
+struct BvhCacheHeader
+{
+	CacheFileHeader common;	//!< The key is the hash of the mesh
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	uint32_t bvhSize;
+	uint32_t reserved;
+};	// BvhCacheHeader
+
+const uint32_t cBvhCacheMagic = 0x4856424D;	// "MBVH"
+
+// Bump it when the layout of the serialized BVH changes
+const uint32_t cBvhCacheVersion = 1;
+
+//! The BVH layout depends on the pointer size and the bullet version, they go into the hash as well.
+uint64_t bvhCacheKey(const Vec3fArray& vertex, const IndexArray& index)
+{
+	uint64_t seed = uint64_t(cBvhCacheVersion) << 32 | sizeof(void*) << 16 | BT_BULLET_VERSION;
+
+	if(vertex.stride == sizeof(Vec3f))
+		seed = hashContent64(vertex.data, vertex.sizeInByte(), seed);
+	else {
+		std::vector<Vec3f> positions(vertex.size);
+		for(size_t i=0; i<vertex.size; ++i)
+			positions[i] = vertex[i];
+		seed = hashContent64(&positions[0], positions.size() * sizeof(Vec3f), seed);
+	}
+
+	MCD_ASSERT(index.stride == sizeof(uint16_t));
+	return hashContent64(index.data, index.sizeInByte(), seed);
+}
+
+Path bvhCacheFileName(uint64_t key) {
+	return cacheFileName(key, "bvh");
+}
+
+}	// namespace
+
 class StaticTriMeshShape::Impl
 {
 public:
-	Impl(const MeshPtr& mesh, void*& shapeImpl) : mVertexBuffer(nullptr), mIndexBuffer(nullptr)
+	Impl(const MeshPtr& mesh, const Path& bvhCacheDirectory, void*& shapeImpl)
+		: mVertexBuffer(nullptr), mIndexBuffer(nullptr), mCachedBvh(nullptr)
 	{
 		Mesh::MappedBuffers mapped;
 		StrideArray<Vec3f> vertex = mesh->mapAttribute<Vec3f>(Mesh::cPositionAttrIdx, mapped, Mesh::Read);
 		StrideArray<uint16_t> index = mesh->mapAttribute<uint16_t>(Mesh::cIndexAttrIdx, mapped, Mesh::Read);
 
-		init(vertex, index, true, shapeImpl);
+		init(vertex, index, true, bvhCacheDirectory, shapeImpl);
 
 		// Unlock the buffers
 		mesh->unmapBuffers(mapped);
 	}
 
-	Impl(MeshBuilder& meshBuilder, int positionId, bool keepOwnBuffer, void*& shapeImpl)
-		: mVertexBuffer(nullptr), mIndexBuffer(nullptr)
+	Impl(MeshBuilder& meshBuilder, int positionId, bool keepOwnBuffer, const Path& bvhCacheDirectory, void*& shapeImpl)
+		: mVertexBuffer(nullptr), mIndexBuffer(nullptr), mCachedBvh(nullptr)
 	{
 		const IndexArray idxPtr = meshBuilder.getAttributeAs<uint16_t>(0);
 		const Vec3fArray posPtr = meshBuilder.getAttributeAs<Vec3f>(positionId);
 
 		if(idxPtr.data && posPtr.data)
-			init(posPtr, idxPtr, keepOwnBuffer, shapeImpl);
+			init(posPtr, idxPtr, keepOwnBuffer, bvhCacheDirectory, shapeImpl);
 		else {
 			Log::write(Log::Error, "An empty mesh is passed into StaticTriMeshShape constructor");
 			shapeImpl = nullptr;
@@ -63,7 +116,7 @@ public:
 
 	void init(
 		Vec3fArray vertexBuffer, IndexArray indexBuffer,
-		bool keepOwnBuffer, void*& shapeImpl)
+		bool keepOwnBuffer, const Path& bvhCacheDirectory, void*& shapeImpl)
 	{
 		MCD_ASSERT(indexBuffer.size % 3 == 0);
 
@@ -82,9 +135,10 @@ public:
 
 		btIndexedMesh bulletMesh;
 
+		// NOTE: The vertex buffer of a MeshBuilder may be interleaved with other attributes
 		bulletMesh.m_numVertices = vertexBuffer.size;
 		bulletMesh.m_vertexBase = (const unsigned char *)vertexBuffer.data;
-		bulletMesh.m_vertexStride = sizeof(float) * 3;
+		bulletMesh.m_vertexStride = int(vertexBuffer.stride);
 
 		bulletMesh.m_numTriangles = indexBuffer.size / 3;
 		bulletMesh.m_triangleIndexBase = (const unsigned char *)indexBuffer.data;
@@ -92,11 +146,76 @@ public:
 
 		// Assign to bullet
 		mBulletVertexIdxArray.addIndexedMesh(bulletMesh, PHY_SHORT);
-		shapeImpl = new btBvhTriangleMeshShape(&mBulletVertexIdxArray, true, true);	// bool useQuantizedAabbCompression, bool buildBvh
+
+		if(bvhCacheDirectory.getString().empty()) {
+			shapeImpl = new btBvhTriangleMeshShape(&mBulletVertexIdxArray, true, true);	// bool useQuantizedAabbCompression, bool buildBvh
+			return;
+		}
+
+		RawFileSystem fs(bvhCacheDirectory);
+		const uint64_t key = bvhCacheKey(vertexBuffer, indexBuffer);
+		const Path fileName = bvhCacheFileName(key);
+		mCacheFileName = fs.toAbsolutePath(fileName);
+
+		mCachedBvh = loadBvh(fs, fileName, key, vertexBuffer.size, indexBuffer.size / 3);
+		btBvhTriangleMeshShape* shape = new btBvhTriangleMeshShape(&mBulletVertexIdxArray, true, !mCachedBvh);
+		shapeImpl = shape;
+
+		if(mCachedBvh)
+			shape->setOptimizedBvh(mCachedBvh);
+		else
+			saveBvh(fs, fileName, key, vertexBuffer.size, indexBuffer.size / 3, *shape->getOptimizedBvh());
+	}
+
+	//! Returns null if the file is missing or not matching the mesh.
+	btOptimizedBvh* loadBvh(const RawFileSystem& fs, const Path& fileName, uint64_t key, size_t vertexCount, size_t triangleCount)
+	{
+		if(!fs.isExists(fileName))
+			return nullptr;
+
+		// The BVH is initialized in place, which writes to the header
+		MemoryMappedFilePtr file = new MemoryMappedFile;
+		if(!file->open(fs.toAbsolutePath(fileName), true) || file->size() < sizeof(BvhCacheHeader))
+			return nullptr;
+
+		const BvhCacheHeader& header = *reinterpret_cast<const BvhCacheHeader*>(file->data());
+		if(!header.common.isValid(cBvhCacheMagic, cBvhCacheVersion, key) ||
+			header.vertexCount != vertexCount || header.triangleCount != triangleCount ||
+			file->size() < sizeof(BvhCacheHeader) + header.bvhSize)
+		{
+			Log::format(Log::Warn, "The BVH cache \"%s\" is outdated or corrupted, rebuilding", fileName.c_str());
+			return nullptr;
+		}
+
+		btOptimizedBvh* bvh = btOptimizedBvh::deSerializeInPlace(file->writableData() + sizeof(BvhCacheHeader), header.bvhSize, false);
+		if(bvh)
+			mCacheFile = file;
+		return bvh;
+	}
+
+	void saveBvh(const RawFileSystem& fs, const Path& fileName, uint64_t key, size_t vertexCount, size_t triangleCount, btOptimizedBvh& bvh)
+	{
+		BvhCacheHeader header;
+		header.common.set(cBvhCacheMagic, cBvhCacheVersion, key);
+		header.vertexCount = uint32_t(vertexCount);
+		header.triangleCount = uint32_t(triangleCount);
+		header.bvhSize = bvh.calculateSerializeBufferSize();
+		header.reserved = 0;
+
+		void* buffer = btAlignedAlloc(header.bvhSize, 16);
+		if(bvh.serialize(buffer, header.bvhSize, false))
+			writeCacheFile(fs, fileName, &header, sizeof(header), buffer, header.bvhSize);
+		else
+			Log::format(Log::Warn, "Fail to serialize the BVH cache \"%s\"", fileName.c_str());
+		btAlignedFree(buffer);
 	}
 
 	~Impl()
 	{
+		if(mCachedBvh)
+			mCachedBvh->~btOptimizedBvh();
+		mCacheFile = nullptr;
+
 		delete[] mVertexBuffer;
 		delete[] mIndexBuffer;
 	}
@@ -104,19 +223,36 @@ public:
 	btTriangleIndexVertexArray mBulletVertexIdxArray;
 	Vec3f* mVertexBuffer;
 	uint16_t* mIndexBuffer;
+
+	btOptimizedBvh* mCachedBvh;			//!< Lives in mCacheFile, not owned by the shape
+	MemoryMappedFilePtr mCacheFile;
+	Path mCacheFileName;
 };	// Impl
 
-StaticTriMeshShape::StaticTriMeshShape(const MeshPtr& mesh)
-	: mImpl(*new Impl(mesh, shapeImpl))
+StaticTriMeshShape::StaticTriMeshShape(const MeshPtr& mesh, const Path& bvhCacheDirectory)
+	: mImpl(*new Impl(mesh, bvhCacheDirectory, shapeImpl))
 {
 }
 
-StaticTriMeshShape::StaticTriMeshShape(const MeshBuilder& meshBuilder,int positionId, bool keepOwnBuffer)
-	: mImpl(*new Impl(const_cast<MeshBuilder&>(meshBuilder), positionId, keepOwnBuffer, shapeImpl))
+StaticTriMeshShape::StaticTriMeshShape(const MeshBuilder& meshBuilder,int positionId, bool keepOwnBuffer, const Path& bvhCacheDirectory)
+	: mImpl(*new Impl(const_cast<MeshBuilder&>(meshBuilder), positionId, keepOwnBuffer, bvhCacheDirectory, shapeImpl))
 {
 }
 
 StaticTriMeshShape::~StaticTriMeshShape()
 {
+	// The shape refers to the buffers and the BVH cache kept in mImpl
+	delete reinterpret_cast<btCollisionShape*>(shapeImpl);
+	shapeImpl = nullptr;
 	delete &mImpl;
 }
+
+bool StaticTriMeshShape::isBvhCached() const
+{
+	return mImpl.mCachedBvh != nullptr;
+}
+
+const Path& StaticTriMeshShape::bvhCacheFile() const
+{
+	return mImpl.mCacheFileName;
+}
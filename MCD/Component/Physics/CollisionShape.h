@@ -3,6 +3,7 @@
 
 #include "../ShareLib.h"
 #include "../../Core/System/NonCopyable.h"
+#include "../../Core/System/Path.h"
 #include "../../Core/System/ScriptOwnershipHandle.h"
 #include "../../Core/System/SharedPtr.h"
 
@@ -56,6 +57,19 @@ protected:
 
 typedef IntrusivePtr<SphereShape> SphereShapePtr;
 
+class MCD_COMPONENT_API BoxShape : public CollisionShape
+{
+public:
+	BoxShape(const Vec3f& halfExtents);
+
+	sal_override bool isStatic() const { return false; }
+
+protected:
+	sal_override ~BoxShape() {}
+};	// BoxShape
+
+typedef IntrusivePtr<BoxShape> BoxShapePtr;
+
 class MCD_COMPONENT_API StaticPlaneShape : public CollisionShape
 {
 public:
@@ -69,19 +83,37 @@ protected:
 
 typedef IntrusivePtr<StaticPlaneShape> StaticPlaneShapePtr;
 
+/*!	A triangle mesh collision shape, accelerated by a quantized BVH.
+
+	Building the BVH of a big mesh takes a while. If a cache directory is given, the BVH
+	is saved into it, named after the hash of the vertices and indices; later the same
+	mesh memory maps the file instead of building the BVH again. The mapping is copy on
+	write, so only the page of the BVH header becomes private to the process, and the
+	nodes are shared with the OS file cache.
+ */
 class MCD_COMPONENT_API StaticTriMeshShape : public CollisionShape
 {
 public:
-	StaticTriMeshShape(const MeshPtr& mesh);
+	/*!	Create StaticTriMeshShape from a Mesh, the vertex and index are copied since
+		the Mesh keeps them in the GPU.
+		\param bvhCacheDirectory An existing directory for the BVH cache, empty for no caching.
+	 */
+	StaticTriMeshShape(const MeshPtr& mesh, const Path& bvhCacheDirectory=Path());
 
 	/*!	Create StaticTriMeshShape from a MeshBuilder.
 		\note If you knows the mesh builder will not be destroyed before the StaticTriMeshShape,
 			you can pass keepOwnBuffer = false, use with care!
 	 */
-	StaticTriMeshShape(const MeshBuilder& meshBuilder, int positionId, bool keepOwnBuffer=true);
+	StaticTriMeshShape(const MeshBuilder& meshBuilder, int positionId, bool keepOwnBuffer=true, const Path& bvhCacheDirectory=Path());
 
 	sal_override bool isStatic() const { return true; }
 
+	//! Whether the BVH is loaded from the cache directory, instead of being built.
+	bool isBvhCached() const;
+
+	//! The BVH cache file of this mesh, empty if there is no cache directory.
+	const Path& bvhCacheFile() const;
+
 protected:
 	sal_override ~StaticTriMeshShape();
 
@@ -4,9 +4,15 @@
 #include "RigidBodyComponent.h"
 #include "RigidBodyComponent.inl"	// We need to access some implementation of RigidBodyComponent
 #include "MathConvertor.inl"
+#include "ParallelDynamics.h"
+#include "UniformGridBroadphase.h"
+#include "../../Core/Entity/Entity.h"
+#include "../../Core/System/Atomic.h"
 #include "../../Core/System/MemoryProfiler.h"
+#include "../../Core/System/TaskPool.h"
 #include "../../Core/System/ThreadedCpuProfiler.h"
 #include "../../../3Party/bullet/btBulletDynamicsCommon.h"
+#include <algorithm>	// For std::find
 
 using namespace MCD;
 
@@ -22,21 +28,435 @@ using namespace MCD;
 #	endif
 #endif
 
-DynamicsWorld::Impl::Impl()
+namespace {
+
+btBroadphaseInterface* createSweepAndPrune(const btVector3& aabbMin, const btVector3& aabbMax, size_t maxProxies)
+{
+	// The 16 bits version can handle at most 32766 proxies
+	if(maxProxies < 32767)
+		return new btAxisSweep3(aabbMin, aabbMax, static_cast<unsigned short>(maxProxies));
+	return new bt32BitAxisSweep3(aabbMin, aabbMax, static_cast<unsigned int>(maxProxies));
+}
+
+void getAabb(const btCollisionObject& o, btVector3& aabbMin, btVector3& aabbMax)
+{
+	o.getCollisionShape()->getAabb(o.getWorldTransform(), aabbMin, aabbMax);
+}
+
+Entity* entityOf(const btCollisionObject* o)
+{
+	// NOTE: All bodies are created by RigidBodyComponent
+	const btRigidBody* body = btRigidBody::upcast(o);
+	if(!body || !body->getMotionState())
+		return nullptr;
+	return static_cast<const MotionState*>(body->getMotionState())->mEntity;
+}
+
+void setNoHit(DynamicsWorld::QueryHit& hit)
+{
+	hit.entity = nullptr;
+	hit.position = hit.normal = Vec3f::cZero;
+	hit.fraction = 1;
+}
+
+bool raycast(const btCollisionWorld& world, const Vec3f& from, const Vec3f& to, DynamicsWorld::QueryHit& hit, int filterMask)
+{
+	const btVector3 rayFrom = toBullet(from), rayTo = toBullet(to);
+	btCollisionWorld::ClosestRayResultCallback callback(rayFrom, rayTo);
+	callback.m_collisionFilterMask = short(filterMask);
+	world.rayTest(rayFrom, rayTo, callback);
+
+	if(!callback.hasHit()) {
+		setNoHit(hit);
+		return false;
+	}
+
+	hit.entity = entityOf(callback.m_collisionObject);
+	hit.position = toMCD(callback.m_hitPointWorld);
+	hit.normal = toMCD(callback.m_hitNormalWorld.normalized());	// Triangle normals are not normalized
+	hit.fraction = callback.m_closestHitFraction;
+	return true;
+}
+
+bool sweep(const btCollisionWorld& world, const btConvexShape& shape, const Vec3f& from, const Vec3f& to, DynamicsWorld::QueryHit& hit, int filterMask)
+{
+	btTransform txFrom, txTo;
+	txFrom.setIdentity();
+	txTo.setIdentity();
+	txFrom.setOrigin(toBullet(from));
+	txTo.setOrigin(toBullet(to));
+
+	btCollisionWorld::ClosestConvexResultCallback callback(txFrom.getOrigin(), txTo.getOrigin());
+	callback.m_collisionFilterMask = short(filterMask);
+	world.convexSweepTest(&shape, txFrom, txTo, callback);
+
+	if(!callback.hasHit()) {
+		setNoHit(hit);
+		return false;
+	}
+
+	hit.entity = entityOf(callback.m_hitCollisionObject);
+	hit.position = toMCD(callback.m_hitPointWorld);
+	hit.normal = toMCD(callback.m_hitNormalWorld.normalized());
+	hit.fraction = callback.m_closestHitFraction;
+	return true;
+}
+
+/*!	The rays of a batched raycast, split into chunks which are claimed one by one by the calling
+	thread and the RaycastTask in the pool. The calling thread only waits for the chunks already
+	claimed by others; a task picked up after that finds nothing left and touches no ray.
+	It's reference counted, since such a task may run after the query has returned.
+ */
+class RaycastBatch
+{
+public:
+	RaycastBatch(size_t chunkCount) : chunkHits(chunkCount, 0), refCount(1) {}
+
+	//! Process the chunks not yet claimed.
+	void process()
+	{
+		for(int chunk; (chunk = nextChunk++) < int(chunkHits.size()); ) {
+			const size_t begin = count * chunk / chunkHits.size();
+			const size_t end = count * (chunk + 1) / chunkHits.size();
+			for(size_t i=begin; i<end; ++i)
+				chunkHits[chunk] += ::raycast(*world, from[i], to[i], hits[i], filterMask) ? 1 : 0;
+			++finishedChunks;
+		}
+	}
+
+	bool finished() const {
+		return finishedChunks == int(chunkHits.size());
+	}
+
+	void addReference() { ++refCount; }
+
+	void releaseReference() {
+		if(--refCount == 0)
+			delete this;
+	}
+
+	const btCollisionWorld* world;
+	const Vec3f* from;
+	const Vec3f* to;
+	DynamicsWorld::QueryHit* hits;
+	size_t count;
+	int filterMask;
+	std::vector<size_t> chunkHits;
+	AtomicInteger nextChunk;
+	AtomicInteger finishedChunks;
+	AtomicInteger refCount;
+};	// RaycastBatch
+
+class RaycastTask : public TaskPool::Task
+{
+public:
+	RaycastTask(RaycastBatch& batch) : TaskPool::Task(0), mBatch(batch) {
+		mBatch.addReference();
+	}
+
+	sal_override ~RaycastTask() {
+		mBatch.releaseReference();
+	}
+
+	sal_override void run(Thread&)
+	{
+		mBatch.process();
+		delete this;
+	}
+
+	RaycastBatch& mBatch;
+};	// RaycastTask
+
+//! Keeps the contact points of the exact overlap test out of the persistent manifold.
+class OverlapResult : public btManifoldResult
+{
+public:
+	OverlapResult(btCollisionObject* body0, btCollisionObject* body1)
+		: btManifoldResult(body0, body1), overlapped(false)
+	{}
+
+	sal_override void addContactPoint(const btVector3&, const btVector3&, btScalar depth)
+	{
+		if(depth <= 0)
+			overlapped = true;
+	}
+
+	bool overlapped;
+};	// OverlapResult
+
+/*!	Collects the bodies overlapping a query object, the candidates come from either
+	the AABB trees of btDbvtBroadphase, or a linear scan for the other broadphases.
+ */
+class OverlapTest : public btDbvt::ICollide
+{
+public:
+	OverlapTest(btCollisionWorld& world, sal_maybenull btDbvtBroadphase* dbvt, btCollisionShape& shape, const Vec3f& center, int filterMask, std::vector<Entity*>& result)
+		: mWorld(world), mDbvt(dbvt), mFilterMask(filterMask), mResult(result)
+	{
+		btTransform tx;
+		tx.setIdentity();
+		tx.setOrigin(toBullet(center));
+		mQuery.setCollisionShape(&shape);
+		mQuery.setWorldTransform(tx);
+	}
+
+	size_t run()
+	{
+		const size_t count = mResult.size();
+
+		btVector3 aabbMin, aabbMax;
+		getAabb(mQuery, aabbMin, aabbMax);
+
+		if(mDbvt) {
+			const btDbvtVolume volume = btDbvtVolume::FromMM(aabbMin, aabbMax);
+			for(int i=0; i<2; ++i)
+				mDbvt->m_sets[i].collideTV(mDbvt->m_sets[i].m_root, volume, *this);
+		}
+		else {
+			btCollisionObjectArray& objects = mWorld.getCollisionObjectArray();
+			for(int i=0; i<objects.size(); ++i) {
+				btVector3 min, max;
+				getAabb(*objects[i], min, max);
+				if(TestAabbAgainstAabb2(aabbMin, aabbMax, min, max))
+					test(objects[i]);
+			}
+		}
+
+		return mResult.size() - count;
+	}
+
+	sal_override void Process(const btDbvtNode* leaf)
+	{
+		const btBroadphaseProxy* proxy = static_cast<const btBroadphaseProxy*>(leaf->data);
+		test(static_cast<btCollisionObject*>(proxy->m_clientObject));
+	}
+
+protected:
+	void test(btCollisionObject* o)
+	{
+		const btBroadphaseProxy* proxy = o->getBroadphaseHandle();
+		if(!proxy || !(proxy->m_collisionFilterGroup & mFilterMask))
+			return;
+
+		Entity* e = entityOf(o);
+		if(!e)
+			return;
+
+		btDispatcher& dispatcher = *mWorld.getDispatcher();
+		btCollisionAlgorithm* algorithm = dispatcher.findAlgorithm(&mQuery, o);
+		if(!algorithm)
+			return;
+
+		OverlapResult result(&mQuery, o);
+		algorithm->processCollision(&mQuery, o, mWorld.getDispatchInfo(), &result);
+		algorithm->~btCollisionAlgorithm();
+		dispatcher.freeCollisionAlgorithm(algorithm);
+
+		if(result.overlapped)
+			mResult.push_back(e);
+	}
+
+	btCollisionWorld& mWorld;
+	btDbvtBroadphase* mDbvt;
+	btCollisionObject mQuery;
+	int mFilterMask;
+	std::vector<Entity*>& mResult;
+};	// OverlapTest
+
+}	// namespace
+
+DiscreteDynamicsWorld::~DiscreteDynamicsWorld()
+{
+	delete mIslandSolver;
+}
+
+void DiscreteDynamicsWorld::stepFixed(size_t steps, btScalar fixedTimeStep)
+{
+	// Mirrors btDiscreteDynamicsWorld::stepSimulation(), forces applied in this frame act on all the steps
+	saveKinematicState(fixedTimeStep);
+	applyGravity();
+
+	mMoved.clear();
+	mFirstStep = mStepCount + 1;
+	for(size_t i=0; i<steps; ++i)
+		internalSingleStepSimulation(fixedTimeStep);
+
+	// Motion states get the exact simulated transform, without bullet's own extrapolation
+	m_localTime = 0;
+	synchronizeMotionStates();
+	clearForces();
+}
+
+void DiscreteDynamicsWorld::internalSingleStepSimulation(btScalar timeStep)
+{
+	btDiscreteDynamicsWorld::internalSingleStepSimulation(timeStep);
+	++mStepCount;
+
+	for(int i=0; i<m_collisionObjects.size(); ++i) {
+		btRigidBody* body = btRigidBody::upcast(m_collisionObjects[i]);
+		if(!body || body->isStaticOrKinematicObject())
+			continue;
+
+		// NOTE: All bodies are created by RigidBodyComponent
+		MotionState* state = static_cast<MotionState*>(body->getMotionState());
+
+		// Also record the body which moved in the previous step but fell asleep in this one,
+		// such that its previous and current transforms become the same
+		if(!body->isActive() && (state->mStep + 1 != mStepCount || state->mPrevious == state->mCurrent))
+			continue;
+
+		if(state->mStep < mFirstStep)	// The first record in this stepFixed()
+			mMoved.push_back(state);
+		state->record(body->getWorldTransform(), mStepCount);
+	}
+}
+
+void DiscreteDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
+{
+	if(mIslandSolver)
+		mIslandSolver->solve(*m_islandManager, *this, m_constraints, solverInfo);
+	else
+		btDiscreteDynamicsWorld::solveConstraints(solverInfo);
+}
+
+DynamicsWorld::Config::Config()
+	: broadphase(DynamicAabbTree), collision(DefaultCollision)
+	, worldAabbMin(-1000), worldAabbMax(1000), maxProxies(1500)
+	, gridCellSize(4), solverIterations(10), collisionPoolSize(0)
+	, fixedTimeStep(1.0f / 60), maxSubSteps(5), interpolation(Interpolate), batchSync(false)
+	, taskPool(nullptr)
+{
+}
+
+DynamicsWorld::Impl::Impl(const Config& config)
+	: mConfig(config), mTimeStep(config.fixedTimeStep, config.maxSubSteps), mVariableStep(false)
 {
-	btVector3 worldAabbMin(-1000,-1000,-1000);
-	btVector3 worldAabbMax( 1000, 1000, 1000);
+	mSweepAndPrune.aabbMin = toBullet(config.worldAabbMin);
+	mSweepAndPrune.aabbMax = toBullet(config.worldAabbMax);
+	mSweepAndPrune.maxProxies = config.maxProxies;
+
+	switch(config.broadphase) {
+	case Config::SweepAndPrune:
+		mBroadphase = createSweepAndPrune(toBullet(config.worldAabbMin), toBullet(config.worldAabbMax), config.maxProxies);
+		break;
+	case Config::UniformGrid:
+		mBroadphase = new UniformGridBroadphase(config.gridCellSize);
+		break;
+	default:
+		mBroadphase = new btDbvtBroadphase();
+		break;
+	}
+
+	btDefaultCollisionConstructionInfo collisionInfo;
+	if(config.collisionPoolSize > 0) {
+		collisionInfo.m_defaultMaxPersistentManifoldPoolSize = int(config.collisionPoolSize);
+		collisionInfo.m_defaultMaxCollisionAlgorithmPoolSize = int(config.collisionPoolSize);
+	}
+	if(config.taskPool) {
+		ParallelCollisionConfiguration* collisionConfiguration = new ParallelCollisionConfiguration(collisionInfo);
+		mCollisionConfiguration = collisionConfiguration;
+		mDispatcher = new ParallelCollisionDispatcher(*collisionConfiguration, *config.taskPool);
+	}
+	else {
+		mCollisionConfiguration = new btDefaultCollisionConfiguration(collisionInfo);
+		mDispatcher = new btCollisionDispatcher(mCollisionConfiguration);
+	}
 
-	const unsigned short maxProxies = 1500;
+	if(config.collision == Config::MultipointCollision)
+		mCollisionConfiguration->setConvexConvexMultipointIterations();
 
-	// Create the btDiscreteDynamicsWorld
-	// The world configuation is temporary hardcoded
-	mBroadphase = new btAxisSweep3(worldAabbMin, worldAabbMax, maxProxies);
-	mCollisionConfiguration = new btDefaultCollisionConfiguration();
-	mDispatcher = new btCollisionDispatcher(mCollisionConfiguration);
 	mSolver = new btSequentialImpulseConstraintSolver();
 
-	mDynamicsWorld = new btDiscreteDynamicsWorld(mDispatcher, mBroadphase, mSolver, mCollisionConfiguration);
+	mDynamicsWorld = new DiscreteDynamicsWorld(mDispatcher, mBroadphase, mSolver, mCollisionConfiguration);
+	mDynamicsWorld->getSolverInfo().m_numIterations = config.solverIterations;
+	if(config.taskPool)
+		mDynamicsWorld->mIslandSolver = new ParallelIslandSolver(*config.taskPool);
+}
+
+void DynamicsWorld::Impl::growSweepAndPrune(size_t requiredProxies, const btCollisionObject* added)
+{
+	if(mConfig.broadphase != Config::SweepAndPrune)
+		return;
+
+	// Only this thread writes mSweepAndPrune, reading it needs no lock
+	const btVector3 worldMin = mSweepAndPrune.aabbMin;
+	const btVector3 worldMax = mSweepAndPrune.aabbMax;
+	btVector3 aabbMin = worldMin, aabbMax = worldMax;
+
+	// Only the newly added body is checked, bodies moving out of the bounds later are clamped.
+	// Static objects are ignored, since a plane for instance is infinitely large; the
+	// sweep and prune simply clamps them to the bounds.
+	if(added && !added->isStaticObject()) {
+		btVector3 min, max;
+		getAabb(*added, min, max);
+		aabbMin.setMin(min);
+		aabbMax.setMax(max);
+	}
+
+	// Double the capacity, so adding n bodies re-creates the broadphase only log(n) times
+	size_t maxProxies = mSweepAndPrune.maxProxies > 0 ? mSweepAndPrune.maxProxies : 1;
+	while(maxProxies < requiredProxies)
+		maxProxies *= 2;
+
+	const bool outOfBounds = aabbMin != worldMin || aabbMax != worldMax;
+	if(!outOfBounds && maxProxies == mSweepAndPrune.maxProxies)
+		return;
+
+	// Leave some room so that it need not grow again soon
+	if(outOfBounds) {
+		const btVector3 margin = (aabbMax - aabbMin) * btScalar(0.5);
+		aabbMin -= margin;
+		aabbMax += margin;
+	}
+
+	btCollisionObjectArray& objects = mDynamicsWorld->getCollisionObjectArray();
+	btBroadphaseInterface* old = mBroadphase;
+	mBroadphase = createSweepAndPrune(aabbMin, aabbMax, maxProxies);
+
+	// Move all the proxies to the new broadphase
+	for(int i=0; i<objects.size(); ++i) {
+		btCollisionObject* o = objects[i];
+		btBroadphaseProxy* proxy = o->getBroadphaseHandle();
+		if(!proxy)
+			continue;
+
+		const short group = proxy->m_collisionFilterGroup;
+		const short mask = proxy->m_collisionFilterMask;
+		old->getOverlappingPairCache()->cleanProxyFromPairs(proxy, mDispatcher);
+		old->destroyProxy(proxy, mDispatcher);
+
+		btVector3 min, max;
+		getAabb(*o, min, max);
+		o->setBroadphaseHandle(mBroadphase->createProxy(min, max, o->getCollisionShape()->getShapeType(), o, group, mask, mDispatcher, nullptr));
+	}
+
+	mDynamicsWorld->setBroadphase(mBroadphase);
+	delete old;
+
+	ScopeLock lock(mSweepAndPruneMutex);
+	mSweepAndPrune.aabbMin = aabbMin;
+	mSweepAndPrune.aabbMax = aabbMax;
+	mSweepAndPrune.maxProxies = maxProxies;
+}
+
+btScalar DynamicsWorld::Impl::interpolationParam(size_t bodyStep) const
+{
+	// A body not moved in the latest step is at rest
+	if(bodyStep != mDynamicsWorld->mStepCount || mVariableStep)
+		return 1;
+
+	if(mConfig.interpolation == Config::Interpolate)
+		return mTimeStep.alpha();
+	if(mConfig.interpolation == Config::Extrapolate)
+		return 1 + mTimeStep.alpha();
+	return 1;
+}
+
+btDbvtBroadphase* DynamicsWorld::Impl::dbvtBroadphase() const
+{
+	if(mConfig.broadphase != Config::DynamicAabbTree)
+		return nullptr;
+	return static_cast<btDbvtBroadphase*>(mBroadphase);
 }
 
 DynamicsWorld::Impl::~Impl()
@@ -51,7 +471,12 @@ DynamicsWorld::Impl::~Impl()
 
 DynamicsWorld::DynamicsWorld()
 {
-	mImpl = new Impl();
+	mImpl = new Impl(Config());
+}
+
+DynamicsWorld::DynamicsWorld(const Config& config)
+{
+	mImpl = new Impl(config);
 }
 
 DynamicsWorld::~DynamicsWorld()
@@ -71,13 +496,98 @@ Vec3f DynamicsWorld::gravity() const
 	return toMCD(mImpl->mDynamicsWorld->getGravity());
 }
 
-void DynamicsWorld::stepSimulation(float timeStep, int maxSubStep)
+const DynamicsWorld::Config& DynamicsWorld::config() const
+{
+	MCD_ASSUME(mImpl);
+	return mImpl->mConfig;
+}
+
+void DynamicsWorld::sweepAndPruneSize(Vec3f& aabbMin, Vec3f& aabbMax, size_t& maxProxies) const
+{
+	MCD_ASSUME(mImpl);
+	ScopeLock lock(mImpl->mSweepAndPruneMutex);
+	aabbMin = toMCD(mImpl->mSweepAndPrune.aabbMin);
+	aabbMax = toMCD(mImpl->mSweepAndPrune.aabbMax);
+	maxProxies = mImpl->mSweepAndPrune.maxProxies;
+}
+
+int DynamicsWorld::solverIterations() const
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	return mImpl->mDynamicsWorld->getSolverInfo().m_numIterations;
+}
+
+void DynamicsWorld::setSolverIterations(int iterations)
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	mImpl->mDynamicsWorld->getSolverInfo().m_numIterations = iterations;
+	mImpl->mConfig.solverIterations = iterations;
+}
+
+size_t DynamicsWorld::rigidBodyCount() const
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	return size_t(mImpl->mDynamicsWorld->getNumCollisionObjects());
+}
+
+float DynamicsWorld::interpolationAlpha() const
+{
+	MCD_ASSUME(mImpl);
+	return mImpl->mTimeStep.alpha();
+}
+
+size_t DynamicsWorld::stepCount() const
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	return mImpl->mDynamicsWorld->mStepCount;
+}
+
+size_t DynamicsWorld::stepSimulation(float timeStep, int maxSubStep)
 {
 	MemoryProfiler::Scope profiler("DynamicsWorld::stepSimulation");
 	ThreadedCpuProfiler::Scope scope("DynamicsWorld::stepSimulation");
 
 	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
-	mImpl->mDynamicsWorld->stepSimulation(timeStep, maxSubStep);
+
+	// The same as bullet, a single step of the frame time
+	if(maxSubStep <= 0) {
+		if(timeStep <= 0)
+			return 0;
+		mImpl->mVariableStep = true;
+		mImpl->mDynamicsWorld->stepFixed(1, timeStep);
+		return 1;
+	}
+
+	FixedTimeStep& timer = mImpl->mTimeStep;
+	const size_t steps = timer.advance(timeStep, size_t(maxSubStep));
+	if(steps == 0)
+		return 0;
+
+	mImpl->mVariableStep = false;
+	mImpl->mDynamicsWorld->stepFixed(steps, timer.stepSize);
+	return steps;
+}
+
+size_t DynamicsWorld::stepSimulation(float timeStep)
+{
+	MCD_ASSUME(mImpl);
+	return stepSimulation(timeStep, int(mImpl->mConfig.maxSubSteps));
+}
+
+size_t DynamicsWorld::syncTransforms()
+{
+	ThreadedCpuProfiler::Scope scope("DynamicsWorld::syncTransforms");
+
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	const std::vector<MotionState*>& moved = mImpl->mDynamicsWorld->mMoved;
+
+	for(size_t i=0; i<moved.size(); ++i) {
+		const MotionState& state = *moved[i];
+		if(state.mEntity)
+			interpolate(state.mPrevious, state.mCurrent, mImpl->interpolationParam(state.mStep), state.mEntity->localTransform);
+	}
+
+	return moved.size();
 }
 
 void DynamicsWorld::addRigidBody(RigidBodyComponent& rbc)
@@ -85,18 +595,23 @@ void DynamicsWorld::addRigidBody(RigidBodyComponent& rbc)
 	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
 	// NOTE: rbc.mImpl may be null, when using with ThreadedDynamicsWorld
 	if(rbc.mImpl)
-		mImpl->mDynamicsWorld->addRigidBody(rbc.mImpl->mRigidBody);
+		addRigidBody(rbc.mImpl->mRigidBody);
+}
+
+void DynamicsWorld::addRigidBody(void* rbc)
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	btRigidBody* p = reinterpret_cast<btRigidBody*>(rbc);
+	mImpl->growSweepAndPrune(rigidBodyCount() + 1, p);	// Make room before adding
+	mImpl->mDynamicsWorld->addRigidBody(p);
 }
 
 void DynamicsWorld::removeRigidBody(RigidBodyComponent& rbc)
 {
 	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
 	// NOTE: rbc.mImpl may be null, when using with ThreadedDynamicsWorld
-	if(rbc.mImpl) {
-		// NOTE: If you saw memory error on the next line, most likely you haven't
-		// make sure all RigidBodyComponent are destroyed before the DynamicsWorld destroy.
-		mImpl->mDynamicsWorld->removeRigidBody(rbc.mImpl->mRigidBody);
-	}
+	if(rbc.mImpl)
+		removeRigidBody(rbc.mImpl->mRigidBody);
 }
 
 void DynamicsWorld::removeRigidBody(void* rbc)
@@ -106,4 +621,113 @@ void DynamicsWorld::removeRigidBody(void* rbc)
 	// NOTE: If you saw memory error on the next line, most likely you haven't
 	// make sure all RigidBodyComponent are destroyed before the DynamicsWorld destroy.
 	mImpl->mDynamicsWorld->removeRigidBody(p);
+
+	// The motion state is going to be deleted with the body
+	std::vector<MotionState*>& moved = mImpl->mDynamicsWorld->mMoved;
+	std::vector<MotionState*>::iterator i = std::find(moved.begin(), moved.end(), p->getMotionState());
+	if(i != moved.end()) {
+		*i = moved.back();
+		moved.pop_back();
+	}
+}
+
+bool DynamicsWorld::getTransform(RigidBodyComponent& rbc, Mat44f& transform)
+{
+	MCD_ASSUME(mImpl && rbc.mImpl && rbc.mImpl->mMotionState);
+	const MotionState& state = *rbc.mImpl->mMotionState;
+	interpolate(state.mPrevious, state.mCurrent, mImpl->interpolationParam(state.mStep), transform);
+	return true;
+}
+
+void DynamicsWorld::setTransform(RigidBodyComponent& rbc, const Mat44f& transform)
+{
+	MCD_ASSUME(rbc.mImpl);
+	rbc.mImpl->setTransform(transform);
+}
+
+void DynamicsWorld::applyForce(RigidBodyComponent& rbc, const Vec3f& force, const Vec3f& relPos)
+{
+	MCD_ASSUME(rbc.mImpl && rbc.mImpl->mRigidBody);
+	rbc.mImpl->mRigidBody->applyForce(toBullet(force), toBullet(relPos));
+}
+
+void DynamicsWorld::setDamping(RigidBodyComponent& rbc, float linear, float angular)
+{
+	MCD_ASSUME(rbc.mImpl && rbc.mImpl->mRigidBody);
+	rbc.mImpl->mRigidBody->setDamping(linear, angular);
+}
+
+bool DynamicsWorld::raycast(const Vec3f& from, const Vec3f& to, QueryHit& hit, int filterMask) const
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	return ::raycast(*mImpl->mDynamicsWorld, from, to, hit, filterMask);
+}
+
+size_t DynamicsWorld::raycast(const Vec3f* from, const Vec3f* to, QueryHit* hits, size_t count, int filterMask, TaskPool* taskPool) const
+{
+	ThreadedCpuProfiler::Scope scope("DynamicsWorld::raycast");
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+
+	// Enough rays per task to hide the overhead of the task pool
+	static const size_t cMaxChunks = 64;
+	static const size_t cMinRaysPerTask = 256;
+
+	size_t chunkCount = taskPool ? (count + cMinRaysPerTask - 1) / cMinRaysPerTask : 1;
+	chunkCount = chunkCount > cMaxChunks ? cMaxChunks : (chunkCount < 1 ? 1 : chunkCount);
+
+	RaycastBatch* batch = new RaycastBatch(chunkCount);
+	batch->world = mImpl->mDynamicsWorld;
+	batch->from = from;
+	batch->to = to;
+	batch->hits = hits;
+	batch->count = count;
+	batch->filterMask = filterMask;
+
+	// The calling thread takes part, so one task less than the chunks
+	const size_t taskCount = taskPool ? std::min(chunkCount - 1, taskPool->getThreadCount()) : 0;
+	for(size_t i=0; i<taskCount; ++i) {
+		RaycastTask* task = new RaycastTask(*batch);
+		if(!taskPool->enqueue(*task))
+			delete task;
+	}
+
+	// Never run the other tasks of the pool here, they may take much longer than the rays
+	batch->process();
+	while(!batch->finished())
+		mSleep(0);
+
+	size_t hitCount = 0;
+	for(size_t i=0; i<chunkCount; ++i)
+		hitCount += batch->chunkHits[i];
+	batch->releaseReference();
+
+	return hitCount;
+}
+
+bool DynamicsWorld::sweepSphere(float radius, const Vec3f& from, const Vec3f& to, QueryHit& hit, int filterMask) const
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	btSphereShape shape(radius);
+	return sweep(*mImpl->mDynamicsWorld, shape, from, to, hit, filterMask);
+}
+
+bool DynamicsWorld::sweepBox(const Vec3f& halfExtents, const Vec3f& from, const Vec3f& to, QueryHit& hit, int filterMask) const
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	btBoxShape shape(toBullet(halfExtents));
+	return sweep(*mImpl->mDynamicsWorld, shape, from, to, hit, filterMask);
+}
+
+size_t DynamicsWorld::overlapSphere(const Vec3f& center, float radius, std::vector<Entity*>& result, int filterMask) const
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	btSphereShape shape(radius);
+	return OverlapTest(*mImpl->mDynamicsWorld, mImpl->dbvtBroadphase(), shape, center, filterMask, result).run();
+}
+
+size_t DynamicsWorld::overlapBox(const Vec3f& center, const Vec3f& halfExtents, std::vector<Entity*>& result, int filterMask) const
+{
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	btBoxShape shape(toBullet(halfExtents));
+	return OverlapTest(*mImpl->mDynamicsWorld, mImpl->dbvtBroadphase(), shape, center, filterMask, result).run();
 }
@@ -2,35 +2,228 @@
 #define __MCD_COMPONENT_DYNAMICSWORLD__
 
 #include "../ShareLib.h"
+#include "../../Core/Math/Vec3.h"
 #include "../../Core/System/NonCopyable.h"
+#include <vector>
 
 namespace MCD {
 
-template<typename T> class Vec3;
-typedef Vec3<float> Vec3f;
+template<typename T> class Mat44;
+typedef Mat44<float> Mat44f;
+
+class Entity;
+class TaskPool;
 
 class MCD_COMPONENT_API DynamicsWorld : Noncopyable
 {
 	friend class RigidBodyComponent;
 
 public:
+	/*!	Describes how the underlying physics world is built, supply it to the constructor.
+		The default is an AABB tree broadphase, which has neither world bounds nor
+		proxy count limit.
+
+		Example:
+		\code
+		DynamicsWorld::Config config;
+		config.broadphase = DynamicsWorld::Config::UniformGrid;
+		config.gridCellSize = 2;
+		config.solverIterations = 5;
+		DynamicsWorld world(config);
+		\endcode
+	 */
+	struct MCD_COMPONENT_API Config
+	{
+		Config();
+
+		enum Broadphase
+		{
+			DynamicAabbTree,	//!< btDbvtBroadphase, incremental AABB trees; good for general use
+			SweepAndPrune,		//!< btAxisSweep3, with the bounds and proxy limit grown automatically
+			UniformGrid			//!< Hashed uniform grid, good for a large amount of similar sized bodies
+		};
+
+		enum Collision
+		{
+			DefaultCollision,	//!< btDefaultCollisionConfiguration
+			MultipointCollision	//!< Generates a full contact manifold for convex pairs in one step, more stable stacking but slower
+		};
+
+		Broadphase broadphase;
+		Collision collision;
+
+		/*!	Initial world bounds of SweepAndPrune, it grows when a body is added out of the bounds.
+			A body moving out of the bounds afterward is clamped to them, which costs more overlapping pairs.
+		 */
+		Vec3f worldAabbMin, worldAabbMax;
+
+		//! Initial proxy capacity of SweepAndPrune, it's doubled when the limit is reached.
+		size_t maxProxies;
+
+		//! Cell size of UniformGrid, best around the size of a typical body.
+		float gridCellSize;
+
+		//! Number of iterations of the constraint solver.
+		int solverIterations;
+
+		//! Number of pre-allocated contact manifolds and collision algorithms, zero for bullet's default.
+		size_t collisionPoolSize;
+
+		enum Interpolation
+		{
+			NoInterpolation,	//!< Render the latest physics state
+			Interpolate,		//!< Blend the last two physics states, smooth but one step behind
+			Extrapolate			//!< Predict from the last two physics states, no latency but may overshoot
+		};
+
+		/*!	Duration of a physics step. The simulation always advances in this fixed
+			step, so it behaves the same regardless of the frame rate; a step of 1/30
+			or even 1/20 second is enough for many games, given the interpolation.
+		 */
+		float fixedTimeStep;
+
+		//! Maximum number of steps per stepSimulation(), the time beyond it is dropped.
+		size_t maxSubSteps;
+
+		//! How the render transform of a RigidBodyComponent is derived from the physics states.
+		Interpolation interpolation;
+
+		/*!	If true, the transforms of the dynamic bodies are written to their Entity by
+			syncTransforms(), and RigidBodyComponent::update() only moves the static bodies.
+		 */
+		bool batchSync;
+
+		/*!	If not null, the narrowphase and the constraint solving of independent simulation
+			islands run on the threads of this TaskPool, together with the stepping thread.
+			The result is deterministic regardless of the number of threads, but may differ
+			from the single threaded stepping with a null TaskPool.
+			The TaskPool must outlive the DynamicsWorld.
+		 */
+		TaskPool* taskPool;
+	};	// Config
+
+	//! Result of a raycast or sweep query.
+	struct QueryHit
+	{
+		QueryHit() : entity(nullptr), fraction(1) {}
+
+		Entity* entity;		//!< The Entity of the body hit, may be null if the body has no Entity
+		Vec3f position;		//!< The hit position in world space, or the contact point of a sweep
+		Vec3f normal;		//!< Surface normal of the body hit, in world space
+		float fraction;		//!< Fraction along the query, 1 if nothing is hit
+
+		bool hasHit() const { return fraction < 1; }
+	};	// QueryHit
+
+	//! The filter mask of the queries, compared against the collision group of the bodies.
+	enum QueryFilter
+	{
+		DynamicBodies	= 1,	//!< btBroadphaseProxy::DefaultFilter
+		StaticBodies	= 2,	//!< btBroadphaseProxy::StaticFilter
+		AllBodies		= -1
+	};
+
 	DynamicsWorld();
 
+	explicit DynamicsWorld(const Config& config);
+
 	virtual ~DynamicsWorld();
 
 // Operations
-	void stepSimulation(float timeStep, int maxSubStep);
+	/*!	Advance the simulation by the frame time, in zero or more steps of Config::fixedTimeStep.
+		Returns the number of steps taken, which is never larger than \em maxSubStep.
+		A \em maxSubStep of zero means a variable time step like in bullet: a single step
+		of \em timeStep is taken, and the render transforms are not interpolated.
+	 */
+	size_t stepSimulation(float timeStep, int maxSubStep);
+
+	//! Use Config::maxSubSteps as the step limit.
+	size_t stepSimulation(float timeStep);
+
+	/*!	Write the render transform of the bodies moved in the latest stepSimulation() to the
+		Entity::localTransform, in a single pass over a contiguous list. Sleeping and static
+		bodies are not visited at all. Call it once per frame when Config::batchSync is true.
+		Returns the number of bodies visited.
+	 */
+	virtual size_t syncTransforms();
+
+// Queries
+	// All queries go through the broadphase tree, then do the exact test on the bodies found.
+	// Raycasts and sweeps only read the world, so they can be run from multiple threads, but none of the
+	// queries should overlap with stepSimulation(); so ThreadedDynamicsWorld is not supported.
+
+	//! Find the closest body hit by the ray, returns false if nothing is hit.
+	bool raycast(const Vec3f& from, const Vec3f& to, QueryHit& hit, int filterMask=AllBodies) const;
+
+	/*!	Cast \em count rays, writing the closest hit of each ray into \em hits.
+		If \em taskPool is given, the rays are split into chunks processed by the pool's
+		threads together with the calling thread; the function returns when all are done.
+		The calling thread never runs the other tasks of the pool, and the pool's threads
+		busy with other tasks do not delay the query.
+		Returns the number of rays hit something.
+	 */
+	size_t raycast(
+		sal_in_ecount(count) const Vec3f* from, sal_in_ecount(count) const Vec3f* to, sal_out_ecount(count) QueryHit* hits, size_t count,
+		int filterMask=AllBodies, sal_maybenull TaskPool* taskPool=nullptr) const;
+
+	//! Sweep a sphere from \em from to \em to, returns false if nothing is hit.
+	bool sweepSphere(float radius, const Vec3f& from, const Vec3f& to, QueryHit& hit, int filterMask=AllBodies) const;
+
+	//! Sweep an axis aligned box from \em from to \em to, returns false if nothing is hit.
+	bool sweepBox(const Vec3f& halfExtents, const Vec3f& from, const Vec3f& to, QueryHit& hit, int filterMask=AllBodies) const;
+
+	/*!	Append the Entity of the bodies overlapping the sphere to \em result.
+		Bodies without an Entity are ignored. Returns the number of Entity appended.
+	 */
+	size_t overlapSphere(const Vec3f& center, float radius, std::vector<Entity*>& result, int filterMask=AllBodies) const;
+
+	//! Same as overlapSphere() but with an axis aligned box.
+	size_t overlapBox(const Vec3f& center, const Vec3f& halfExtents, std::vector<Entity*>& result, int filterMask=AllBodies) const;
 
 // Attributes
 	void setGravity(const Vec3f& g);
 	Vec3f gravity() const;
 
+	//! The config used for construction, see sweepAndPruneSize() for the grown SweepAndPrune bounds and capacity.
+	const Config& config() const;
+
+	/*!	The current bounds and proxy capacity of SweepAndPrune, grown from those in config().
+		It can be called while another thread is adding bodies, eg. the physics thread of ThreadedDynamicsWorld.
+	 */
+	void sweepAndPruneSize(Vec3f& aabbMin, Vec3f& aabbMax, size_t& maxProxies) const;
+
+	int solverIterations() const;
+	void setSolverIterations(int iterations);
+
+	size_t rigidBodyCount() const;
+
+	//! The fraction of a step not yet simulated, in the range of [0, 1).
+	float interpolationAlpha() const;
+
+	//! Total number of fixed steps taken.
+	size_t stepCount() const;
+
 protected:
 	//! DynamicsWorld will not take over the ownership of RigidBodyComponent
 	virtual void addRigidBody(RigidBodyComponent& rbc);
 
 	virtual void removeRigidBody(RigidBodyComponent& rbc);
 
+	/*!	Get the simulated rotation and translation of a dynamic body, interpolated
+		according to Config::interpolation. Returns false if it's not available yet.
+	 */
+	virtual bool getTransform(RigidBodyComponent& rbc, Mat44f& transform);
+
+	//! Move a static body, where the scaling goes to the collision shape.
+	virtual void setTransform(RigidBodyComponent& rbc, const Mat44f& transform);
+
+	virtual void applyForce(RigidBodyComponent& rbc, const Vec3f& force, const Vec3f& relPos);
+
+	virtual void setDamping(RigidBodyComponent& rbc, float linear, float angular);
+
+	//! Expecting void* to be btRigidBody*
+	void addRigidBody(sal_notnull void* rbc);
+
 	//! Expecting void* to be btRigidBody*
 	void removeRigidBody(sal_notnull void* rbc);
 
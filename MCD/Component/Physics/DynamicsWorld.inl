@@ -1,19 +1,79 @@
+#include "../../Core/System/FixedTimeStep.h"
+#include "../../Core/System/Mutex.h"
 #include "../../../3Party/bullet/btBulletDynamicsCommon.h"
 #include <vector>
 
 namespace MCD {
 
+class MotionState;
+class ParallelIslandSolver;
+
+/*!	Steps in exactly the fixed step given by DynamicsWorld, instead of the
+	accumulator of bullet, and records the transforms of the moving bodies
+	after each step for the interpolation.
+ */
+class DiscreteDynamicsWorld : public btDiscreteDynamicsWorld
+{
+public:
+	DiscreteDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* broadphase, btConstraintSolver* solver, btCollisionConfiguration* config)
+		: btDiscreteDynamicsWorld(dispatcher, broadphase, solver, config), mStepCount(0), mFirstStep(1), mIslandSolver(nullptr)
+	{}
+
+	sal_override ~DiscreteDynamicsWorld();
+
+	void stepFixed(size_t steps, btScalar fixedTimeStep);
+
+	size_t mStepCount;
+
+	//! The bodies recorded in the latest stepFixed(), including those just fell asleep.
+	std::vector<MotionState*> mMoved;
+	size_t mFirstStep;	//!< The first step of the latest stepFixed()
+
+	//! Solves the islands on a TaskPool if not null, owned.
+	ParallelIslandSolver* mIslandSolver;
+
+protected:
+	sal_override void internalSingleStepSimulation(btScalar timeStep);
+
+	sal_override void solveConstraints(btContactSolverInfo& solverInfo);
+};	// DiscreteDynamicsWorld
+
 class DynamicsWorld::Impl
 {
 public:
-	Impl();
+	explicit Impl(const Config& config);
 	~Impl();
 
-	btAxisSweep3* mBroadphase;
+	/*!	Re-create the SweepAndPrune broadphase if the body to be \em added is out of its bounds,
+		or the proxy limit cannot fit \em requiredProxies, where the limit is doubled.
+	 */
+	void growSweepAndPrune(size_t requiredProxies, sal_maybenull const btCollisionObject* added=nullptr);
+
+	//! The blending parameter for interpolate(), of a body last recorded at \em bodyStep.
+	btScalar interpolationParam(size_t bodyStep) const;
+
+	//! The broadphase with its AABB trees exposed for the overlap queries, null for other kinds.
+	sal_maybenull btDbvtBroadphase* dbvtBroadphase() const;
+
+	Config mConfig;	//!< Not changed after construction, except the solverIterations
+
+	//! The grown bounds and capacity of SweepAndPrune, only written by growSweepAndPrune()
+	struct SweepAndPruneSize
+	{
+		btVector3 aabbMin, aabbMax;
+		size_t maxProxies;
+	};	// SweepAndPruneSize
+
+	SweepAndPruneSize mSweepAndPrune;	//!< Written with mSweepAndPruneMutex locked, in the thread adding the bodies
+	mutable Mutex mSweepAndPruneMutex;	//!< For reading mSweepAndPrune in the other threads
+
+	FixedTimeStep mTimeStep;
+	bool mVariableStep;	//!< The latest step took the whole frame time, there is nothing to interpolate
+	btBroadphaseInterface* mBroadphase;
 	btDefaultCollisionConfiguration* mCollisionConfiguration;
 	btCollisionDispatcher* mDispatcher;
 	btSequentialImpulseConstraintSolver* mSolver;
-	btDynamicsWorld* mDynamicsWorld;
+	DiscreteDynamicsWorld* mDynamicsWorld;
 };	// Impl
 
 }	// namespace MCD
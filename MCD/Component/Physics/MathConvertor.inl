@@ -3,8 +3,13 @@
 	bullet physics engine directly.
  */
 
-#include "../../Core/Math/Vec3.h"
-#include "../../../3Party/bullet/LinearMath/btVector3.h"
+#include "../../Core/Math/Mat44.h"
+#include "../../../3Party/bullet/LinearMath/btTransform.h"
+
+#if (!defined(MCD_GCC) || defined(__SSE__)) && !defined(BT_USE_DOUBLE_PRECISION)
+#	define MCD_BULLET_SSE 1
+#	include <xmmintrin.h>
+#endif
 
 namespace MCD {
 
@@ -19,4 +24,55 @@ inline const Vec3f& toMCD(const btVector3& v) {
 	return reinterpret_cast<const Vec3f&>(v);
 }
 
+/*!	The rotation and translation of \em m are set, together with its last row as (0, 0, 0, 1).
+	It's used for every moving body in every frame, so it's written in SSE where available.
+ */
+inline void toMCD(const btTransform& tx, Mat44f& m)
+{
+	const btMatrix3x3& rot = tx.getBasis();
+
+#if MCD_BULLET_SSE
+	// The rows of btMatrix3x3 are copied to the memory columns of Mat44f, each btVector3 is padded
+	// to 4 floats; shuffle (x, y, z, w) with (z, fill, w, fill) into (x, y, z, fill).
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set_ps(1, 1, 1, 1);
+	__m128 r0 = _mm_loadu_ps(rot[0]);
+	__m128 r1 = _mm_loadu_ps(rot[1]);
+	__m128 r2 = _mm_loadu_ps(rot[2]);
+	__m128 o = _mm_loadu_ps(tx.getOrigin());
+
+	_mm_storeu_ps(m.c0, _mm_shuffle_ps(r0, _mm_unpackhi_ps(r0, zero), _MM_SHUFFLE(1, 0, 1, 0)));
+	_mm_storeu_ps(m.c1, _mm_shuffle_ps(r1, _mm_unpackhi_ps(r1, zero), _MM_SHUFFLE(1, 0, 1, 0)));
+	_mm_storeu_ps(m.c2, _mm_shuffle_ps(r2, _mm_unpackhi_ps(r2, zero), _MM_SHUFFLE(1, 0, 1, 0)));
+	_mm_storeu_ps(m.c3, _mm_shuffle_ps(o, _mm_unpackhi_ps(o, one), _MM_SHUFFLE(1, 0, 1, 0)));
+#else
+	for(int x = 0; x < 3; ++x) {
+		for(int y = 0; y < 3; ++y)
+			m[x][y] = rot[x][y];
+		m[x][3] = 0;
+	}
+
+	m.setTranslation(toMCD(tx.getOrigin()));
+	m.m33 = 1;
+#endif
+}
+
+/*!	Blend two rigid transforms, where \em t of 0 gives \em previous and 1 gives \em current.
+	A \em t larger than 1 extrapolates. Only the rotation and translation of \em m are touched.
+ */
+inline void interpolate(const btTransform& previous, const btTransform& current, btScalar t, Mat44f& m)
+{
+	if(t == btScalar(1)) {
+		toMCD(current, m);
+		return;
+	}
+
+	btQuaternion q0 = previous.getRotation();
+	btQuaternion q1 = current.getRotation();
+	if(q0.dot(q1) < 0)	// Take the shortest path
+		q1 = -q1;
+
+	toMCD(btTransform(q0.slerp(q1, t), previous.getOrigin().lerp(current.getOrigin(), t)), m);
+}
+
 }	// MCD
@@ -0,0 +1,400 @@
+#include "Pch.h"
+#include "ParallelDynamics.h"
+#include "../../Core/System/ThreadedCpuProfiler.h"
+#include "../../../3Party/bullet/BulletCollision/CollisionDispatch/btCompoundCollisionAlgorithm.h"
+#include "../../../3Party/bullet/BulletCollision/CollisionDispatch/btConvexConcaveCollisionAlgorithm.h"
+#include "../../../3Party/bullet/BulletCollision/CollisionDispatch/btConvexConvexAlgorithm.h"
+#include "../../../3Party/bullet/BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h"
+#include "../../../3Party/bullet/LinearMath/btPoolAllocator.h"
+#include <algorithm>	// For std::stable_sort and std::equal_range
+
+using namespace MCD;
+
+namespace {
+
+//! btConvexConvexAlgorithm with its own simplex solver.
+class ConvexConvexAlgorithm : public btConvexConvexAlgorithm
+{
+public:
+	ConvexConvexAlgorithm(const btCollisionAlgorithmConstructionInfo& ci, btCollisionObject* body0, btCollisionObject* body1, const btConvexConvexAlgorithm::CreateFunc& createFunc)
+		// NOTE: The base class only keeps the pointer of the not yet constructed mSimplexSolver
+		: btConvexConvexAlgorithm(ci.m_manifold, ci, body0, body1, &mSimplexSolver, createFunc.m_pdSolver,
+			createFunc.m_numPerturbationIterations, createFunc.m_minimumPointsPerturbationThreshold)
+	{}
+
+protected:
+	btVoronoiSimplexSolver mSimplexSolver;
+};	// ConvexConvexAlgorithm
+
+btDefaultCollisionConstructionInfo withAlgorithmPool(btDefaultCollisionConstructionInfo info)
+{
+	if(info.m_collisionAlgorithmPool)
+		return info;
+
+	int size = sizeof(ConvexConvexAlgorithm);
+	size = btMax(size, int(sizeof(btConvexConcaveCollisionAlgorithm)));
+	size = btMax(size, int(sizeof(btCompoundCollisionAlgorithm)));
+
+	// Allocated in the same way as btDefaultCollisionConfiguration, which deletes it
+	void* mem = btAlignedAlloc(sizeof(btPoolAllocator), 16);
+	info.m_collisionAlgorithmPool = new(mem) btPoolAllocator(size, info.m_defaultMaxCollisionAlgorithmPoolSize);
+	return info;
+}
+
+//! Whether the collision algorithm temporary swaps the shape of the body.
+bool swapsShape(const btCollisionObject& body)
+{
+	const btCollisionShape* shape = body.getCollisionShape();
+	return shape->isCompound() || (shape->isConcave() && shape->getShapeType() != STATIC_PLANE_PROXYTYPE);
+}
+
+int broadphaseId(const void* body)
+{
+	const btBroadphaseProxy* proxy = static_cast<const btCollisionObject*>(body)->getBroadphaseHandle();
+	return proxy ? proxy->m_uniqueId : -1;
+}
+
+struct ManifoldLess
+{
+	bool operator()(const btPersistentManifold* lhs, const btPersistentManifold* rhs) const
+	{
+		const int l0 = broadphaseId(lhs->getBody0()), r0 = broadphaseId(rhs->getBody0());
+		if(l0 != r0)
+			return l0 < r0;
+		return broadphaseId(lhs->getBody1()) < broadphaseId(rhs->getBody1());
+	}
+};	// ManifoldLess
+
+//! Same as btGetConstraintIslandId() in btDiscreteDynamicsWorld.cpp
+int islandIdOf(const btTypedConstraint* constraint)
+{
+	const btCollisionObject& body0 = constraint->getRigidBodyA();
+	const btCollisionObject& body1 = constraint->getRigidBodyB();
+	return body0.getIslandTag() >= 0 ? body0.getIslandTag() : body1.getIslandTag();
+}
+
+struct ConstraintIslandLess
+{
+	bool operator()(const btTypedConstraint* lhs, const btTypedConstraint* rhs) const {
+		return islandIdOf(lhs) < islandIdOf(rhs);
+	}
+};	// ConstraintIslandLess
+
+//! A range of the pairs to process, the last thing it does is telling the group it's done.
+class NarrowphaseTask : public TaskPool::Task
+{
+public:
+	NarrowphaseTask() : TaskPool::Task(0) {}
+
+	sal_override void run(Thread&) { process(); }
+
+	void process()
+	{
+		for(size_t i=begin; i<end; ++i) {
+			btBroadphasePair& pair = *pairs[i];
+			btCollisionObject* body0 = static_cast<btCollisionObject*>(pair.m_pProxy0->m_clientObject);
+			btCollisionObject* body1 = static_cast<btCollisionObject*>(pair.m_pProxy1->m_clientObject);
+			btManifoldResult result(body0, body1);
+
+			// Mirrors btCollisionDispatcher::defaultNearCallback()
+			if(info->m_dispatchFunc == btDispatcherInfo::DISPATCH_DISCRETE)
+				pair.m_algorithm->processCollision(body0, body1, *info, &result);
+			else {
+				const btScalar toi = pair.m_algorithm->calculateTimeOfImpact(body0, body1, *info, &result);
+				if(toi < timeOfImpact)
+					timeOfImpact = toi;
+			}
+		}
+		group->done();
+	}
+
+	btBroadphasePair* const* pairs;
+	size_t begin, end;
+	const btDispatcherInfo* info;
+	btScalar timeOfImpact;
+	TaskGroup* group;
+};	// NarrowphaseTask
+
+}	// namespace
+
+struct ParallelCollisionConfiguration::ConvexConvexCreateFunc : public btCollisionAlgorithmCreateFunc
+{
+	explicit ConvexConvexCreateFunc(const btConvexConvexAlgorithm::CreateFunc& defaultCreateFunc)
+		: mDefault(defaultCreateFunc)
+	{}
+
+	sal_override btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci, btCollisionObject* body0, btCollisionObject* body1)
+	{
+		void* mem = ci.m_dispatcher1->allocateCollisionAlgorithm(sizeof(ConvexConvexAlgorithm));
+		return new(mem) ConvexConvexAlgorithm(ci, body0, body1, mDefault);
+	}
+
+	//! Where the multipoint iterations are set to, see btDefaultCollisionConfiguration::setConvexConvexMultipointIterations()
+	const btConvexConvexAlgorithm::CreateFunc& mDefault;
+};	// ConvexConvexCreateFunc
+
+ParallelCollisionConfiguration::ParallelCollisionConfiguration(const btDefaultCollisionConstructionInfo& info)
+	: btDefaultCollisionConfiguration(withAlgorithmPool(info))
+{
+	if(!info.m_collisionAlgorithmPool)
+		m_ownsCollisionAlgorithmPool = true;
+	mConvexConvexCreateFunc = new ConvexConvexCreateFunc(*static_cast<btConvexConvexAlgorithm::CreateFunc*>(m_convexConvexCreateFunc));
+}
+
+ParallelCollisionConfiguration::~ParallelCollisionConfiguration()
+{
+	delete mConvexConvexCreateFunc;
+}
+
+btCollisionAlgorithmCreateFunc* ParallelCollisionConfiguration::getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1)
+{
+	btCollisionAlgorithmCreateFunc* createFunc = btDefaultCollisionConfiguration::getCollisionAlgorithmCreateFunc(proxyType0, proxyType1);
+	if(createFunc == m_convexConvexCreateFunc)
+		return mConvexConvexCreateFunc;
+	return createFunc;
+}
+
+ParallelCollisionDispatcher::ParallelCollisionDispatcher(ParallelCollisionConfiguration& config, TaskPool& taskPool)
+	: btCollisionDispatcher(&config), mTaskPool(taskPool)
+{
+}
+
+btPersistentManifold* ParallelCollisionDispatcher::getNewManifold(void* body0, void* body1)
+{
+	ScopeLock lock(mMutex);
+	return btCollisionDispatcher::getNewManifold(body0, body1);
+}
+
+void ParallelCollisionDispatcher::releaseManifold(btPersistentManifold* manifold)
+{
+	ScopeLock lock(mMutex);
+	btCollisionDispatcher::releaseManifold(manifold);
+}
+
+void* ParallelCollisionDispatcher::allocateCollisionAlgorithm(int size)
+{
+	ScopeLock lock(mMutex);
+	return btCollisionDispatcher::allocateCollisionAlgorithm(size);
+}
+
+void ParallelCollisionDispatcher::freeCollisionAlgorithm(void* ptr)
+{
+	ScopeLock lock(mMutex);
+	btCollisionDispatcher::freeCollisionAlgorithm(ptr);
+}
+
+void ParallelCollisionDispatcher::dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo, btDispatcher*)
+{
+	ThreadedCpuProfiler::Scope scope("ParallelCollisionDispatcher::dispatchAllCollisionPairs");
+
+	const int pairCount = pairCache->getNumOverlappingPairs();
+	if(pairCount == 0)
+		return;
+
+	// Collect the pairs which need processing, and create their algorithms in this thread
+	btBroadphasePair* pairs = pairCache->getOverlappingPairArrayPtr();
+	size_t serialCount = 0;
+	mPairs.clear();
+	for(int i=0; i<pairCount; ++i) {
+		btBroadphasePair& pair = pairs[i];
+		btCollisionObject* body0 = static_cast<btCollisionObject*>(pair.m_pProxy0->m_clientObject);
+		btCollisionObject* body1 = static_cast<btCollisionObject*>(pair.m_pProxy1->m_clientObject);
+		if(!needsCollision(body0, body1))
+			continue;
+
+		if(!pair.m_algorithm)
+			pair.m_algorithm = findAlgorithm(body0, body1);
+		if(!pair.m_algorithm)
+			continue;
+
+		mPairs.push_back(&pair);
+		if(swapsShape(*body0) || swapsShape(*body1))
+			std::swap(mPairs[serialCount++], mPairs.back());
+	}
+
+	if(mPairs.empty())
+		return;
+
+	// Enough pairs per task to hide the overhead of the task pool
+	static const size_t cMaxTasks = 64;
+	static const size_t cMinPairsPerTask = 64;
+
+	size_t taskCount = 0;
+	NarrowphaseTask tasks[cMaxTasks];
+	const size_t boundaries[] = { 0, serialCount, mPairs.size() };
+
+	// The first range is processed by a single task
+	for(size_t range=0; range<2; ++range) {
+		const size_t begin = boundaries[range], count = boundaries[range + 1] - begin;
+		if(count == 0)
+			continue;
+
+		size_t n = range == 0 ? 1 : (count + cMinPairsPerTask - 1) / cMinPairsPerTask;
+		n = n > cMaxTasks - taskCount ? cMaxTasks - taskCount : n;
+		for(size_t i=0; i<n; ++i, ++taskCount) {
+			NarrowphaseTask& t = tasks[taskCount];
+			t.pairs = &mPairs[0];
+			t.begin = begin + count * i / n;
+			t.end = begin + count * (i + 1) / n;
+			t.info = &dispatchInfo;
+			t.timeOfImpact = dispatchInfo.m_timeOfImpact;
+		}
+	}
+
+	TaskGroup group(taskCount);
+	TaskPool::Task* taskPtrs[cMaxTasks];
+	for(size_t i=0; i<taskCount; ++i) {
+		tasks[i].group = &group;
+		taskPtrs[i] = &tasks[i];
+	}
+
+	forkJoin(&mTaskPool, taskPtrs, taskCount, group);
+
+	for(size_t i=0; i<taskCount; ++i) {
+		if(tasks[i].timeOfImpact < dispatchInfo.m_timeOfImpact)
+			dispatchInfo.m_timeOfImpact = tasks[i].timeOfImpact;
+	}
+
+	// The manifolds created by the tasks are appended in any order, sort them for determinism
+	const int manifoldCount = getNumManifolds();
+	if(manifoldCount > 0) {
+		btPersistentManifold** manifolds = getInternalManifoldPointer();
+		std::stable_sort(manifolds, manifolds + manifoldCount, ManifoldLess());
+		for(int i=0; i<manifoldCount; ++i)
+			manifolds[i]->m_index1a = i;
+	}
+}
+
+//! A range of the islands to solve, the last thing it does is telling the group it's done.
+class ParallelIslandSolver::IslandTask : public TaskPool::Task
+{
+public:
+	IslandTask() : TaskPool::Task(0) {}
+
+	sal_override void run(Thread&) { process(); }
+
+	void process()
+	{
+		for(size_t i=begin; i<end; ++i) {
+			const Island& island = owner->mIslands[i];
+			btTypedConstraint** constraints = island.constraintCount > 0 ? &owner->mConstraints[island.constraintBegin] : nullptr;
+			solver->solveGroup(
+				&owner->mBodies[island.bodyBegin], int(island.bodyCount),
+				island.manifolds, int(island.manifoldCount),
+				constraints, int(island.constraintCount),
+				*info, nullptr, nullptr, nullptr
+			);
+		}
+		group->done();
+	}
+
+	ParallelIslandSolver* owner;
+	btConstraintSolver* solver;
+	size_t begin, end;
+	const btContactSolverInfo* info;
+	TaskGroup* group;
+};	// IslandTask
+
+ParallelIslandSolver::ParallelIslandSolver(TaskPool& taskPool)
+	: mTaskPool(taskPool)
+{
+}
+
+ParallelIslandSolver::~ParallelIslandSolver()
+{
+	for(size_t i=0; i<mSolvers.size(); ++i)
+		delete mSolvers[i];
+}
+
+void ParallelIslandSolver::solve(
+	btSimulationIslandManager& islandManager, btCollisionWorld& world,
+	const btAlignedObjectArray<btTypedConstraint*>& constraints, const btContactSolverInfo& info)
+{
+	ThreadedCpuProfiler::Scope scope("ParallelIslandSolver::solve");
+
+	mConstraints.resize(constraints.size());
+	for(int i=0; i<constraints.size(); ++i)
+		mConstraints[i] = constraints[i];
+	std::stable_sort(mConstraints.begin(), mConstraints.end(), ConstraintIslandLess());
+
+	mConstraintIslands.resize(mConstraints.size());
+	for(size_t i=0; i<mConstraints.size(); ++i)
+		mConstraintIslands[i] = islandIdOf(mConstraints[i]);
+
+	// Collect the awake islands
+	mIslands.clear();
+	mBodies.clear();
+	islandManager.buildAndProcessIslands(world.getDispatcher(), &world, this);
+
+	if(mIslands.empty())
+		return;
+
+	// Enough work per task to hide the overhead of the task pool
+	static const size_t cMaxTasks = 64;
+	static const size_t cMinWorkPerTask = 64;
+
+	size_t totalWork = 0;
+	for(size_t i=0; i<mIslands.size(); ++i)
+		totalWork += mIslands[i].bodyCount + mIslands[i].manifoldCount + mIslands[i].constraintCount;
+
+	size_t taskCount = totalWork / cMinWorkPerTask;
+	taskCount = taskCount > cMaxTasks ? cMaxTasks : (taskCount < 1 ? 1 : taskCount);
+	taskCount = taskCount > mIslands.size() ? mIslands.size() : taskCount;
+
+	while(mSolvers.size() < taskCount)
+		mSolvers.push_back(new btSequentialImpulseConstraintSolver);
+
+	// Consecutive islands go to the same task, until its share of the work is reached
+	IslandTask tasks[cMaxTasks];
+	TaskPool::Task* taskPtrs[cMaxTasks];
+	TaskGroup group(taskCount);
+	size_t island = 0, work = 0;
+	for(size_t i=0; i<taskCount; ++i) {
+		IslandTask& t = tasks[i];
+		t.owner = this;
+		t.solver = mSolvers[i];
+		t.info = &info;
+		t.group = &group;
+		t.begin = island;
+
+		const size_t target = totalWork * (i + 1) / taskCount;
+		while(island < mIslands.size() && (work < target || i + 1 == taskCount)) {
+			work += mIslands[island].bodyCount + mIslands[island].manifoldCount + mIslands[island].constraintCount;
+			++island;
+		}
+		t.end = island;
+		taskPtrs[i] = &t;
+	}
+
+	forkJoin(&mTaskPool, taskPtrs, taskCount, group);
+}
+
+void ParallelIslandSolver::ProcessIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, int islandId)
+{
+	Island island;
+	island.manifolds = manifolds;
+	island.manifoldCount = size_t(numManifolds);
+
+	if(islandId < 0) {
+		// Islands are not split, everything goes into one solveGroup()
+		island.constraintBegin = 0;
+		island.constraintCount = mConstraints.size();
+	}
+	else {
+		const std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator> range =
+			std::equal_range(mConstraintIslands.begin(), mConstraintIslands.end(), islandId);
+		island.constraintBegin = size_t(range.first - mConstraintIslands.begin());
+		island.constraintCount = size_t(range.second - range.first);
+	}
+
+	// Only solve if there is some work, as bullet does
+	if(island.manifoldCount + island.constraintCount == 0)
+		return;
+
+	// The body array is reused by btSimulationIslandManager for the next island
+	island.bodyBegin = mBodies.size();
+	island.bodyCount = size_t(numBodies);
+	mBodies.insert(mBodies.end(), bodies, bodies + numBodies);
+
+	mIslands.push_back(island);
+}
@@ -0,0 +1,113 @@
+#ifndef __MCD_COMPONENT_PARALLELDYNAMICS__
+#define __MCD_COMPONENT_PARALLELDYNAMICS__
+
+#include "../../Core/System/Mutex.h"
+#include "../../Core/System/TaskPool.h"
+#include "../../../3Party/bullet/btBulletDynamicsCommon.h"
+#include "../../../3Party/bullet/BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+#include <vector>
+
+namespace MCD {
+
+/*!	The default collision configuration, except that every convex-convex algorithm owns
+	its simplex solver; bullet shares a single one which cannot be used by multiple threads.
+	The collision algorithm pool is enlarged accordingly.
+ */
+class ParallelCollisionConfiguration : public btDefaultCollisionConfiguration
+{
+public:
+	explicit ParallelCollisionConfiguration(const btDefaultCollisionConstructionInfo& info);
+
+	sal_override ~ParallelCollisionConfiguration();
+
+	sal_override btCollisionAlgorithmCreateFunc* getCollisionAlgorithmCreateFunc(int proxyType0, int proxyType1);
+
+protected:
+	struct ConvexConvexCreateFunc;
+	ConvexConvexCreateFunc* mConvexConvexCreateFunc;
+};	// ParallelCollisionConfiguration
+
+/*!	A collision dispatcher which runs the narrowphase of the overlapping pairs on a TaskPool.
+
+	The collision algorithms of new pairs are created up front in the calling thread, then
+	the pairs are processed by the tasks; the memory pools touched during the processing are
+	guarded by a mutex. Pairs with a concave (except plane) or compound body are processed
+	one after another by a single task, since their algorithms temporary swap the shape of
+	that body.
+
+	Afterward the contact manifolds are sorted by the broadphase id of their bodies, so the
+	solver sees the same order of contacts regardless of the number of threads.
+
+	\note Use with ParallelCollisionConfiguration.
+ */
+class ParallelCollisionDispatcher : public btCollisionDispatcher
+{
+public:
+	ParallelCollisionDispatcher(ParallelCollisionConfiguration& config, TaskPool& taskPool);
+
+// Override from btCollisionDispatcher
+	sal_override btPersistentManifold* getNewManifold(void* body0, void* body1);
+
+	sal_override void releaseManifold(btPersistentManifold* manifold);
+
+	sal_override void* allocateCollisionAlgorithm(int size);
+
+	sal_override void freeCollisionAlgorithm(void* ptr);
+
+	sal_override void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& dispatchInfo, btDispatcher* dispatcher);
+
+protected:
+	TaskPool& mTaskPool;
+	Mutex mMutex;
+	std::vector<btBroadphasePair*> mPairs;	//!< Pairs which need processing, the serial ones at the front
+};	// ParallelCollisionDispatcher
+
+/*!	Solves the simulation islands on a TaskPool, with one constraint solver instance per task.
+
+	The islands are collected by btSimulationIslandManager, where the sleeping ones are
+	skipped already, and then distributed among the tasks by their amount of work. Since an
+	island is always solved as a whole by a single btConstraintSolver::solveGroup(), and
+	islands share no dynamic body, the result is the same however the islands are distributed.
+
+	\note Used by DynamicsWorld, see DynamicsWorld::Config::taskPool.
+ */
+class ParallelIslandSolver : protected btSimulationIslandManager::IslandCallback
+{
+public:
+	explicit ParallelIslandSolver(TaskPool& taskPool);
+
+	~ParallelIslandSolver();
+
+	//! Replacement of btDiscreteDynamicsWorld::solveConstraints().
+	void solve(
+		btSimulationIslandManager& islandManager, btCollisionWorld& world,
+		const btAlignedObjectArray<btTypedConstraint*>& constraints, const btContactSolverInfo& info);
+
+	//! Number of islands solved in the last solve().
+	size_t islandCount() const { return mIslands.size(); }
+
+protected:
+	class IslandTask;
+	friend class IslandTask;
+
+	sal_override void ProcessIsland(btCollisionObject** bodies, int numBodies, btPersistentManifold** manifolds, int numManifolds, int islandId);
+
+	struct Island
+	{
+		size_t bodyBegin, bodyCount;
+		btPersistentManifold** manifolds;	//!< Points into the btSimulationIslandManager, valid until its next build
+		size_t manifoldCount;
+		size_t constraintBegin, constraintCount;
+	};	// Island
+
+	TaskPool& mTaskPool;
+	std::vector<btSequentialImpulseConstraintSolver*> mSolvers;
+	std::vector<Island> mIslands;
+	std::vector<btCollisionObject*> mBodies;
+	std::vector<btTypedConstraint*> mConstraints;	//!< Sorted by island
+	std::vector<int> mConstraintIslands;			//!< Island id of mConstraints
+};	// ParallelIslandSolver
+
+}	// namespace MCD
+
+#endif	// __MCD_COMPONENT_PARALLELDYNAMICS__
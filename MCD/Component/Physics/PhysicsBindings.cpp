@@ -0,0 +1,123 @@
+#include "Pch.h"
+#include "PhysicsBindings.h"
+#include "DynamicsWorld.h"
+#include "../../Core/Binding/CoreBindings.h"
+#include "../../Core/Binding/Declarator.h"
+#include "../../Core/Binding/VMCore.h"
+#include "../../Core/Entity/Entity.h"
+
+namespace MCD {
+namespace Binding {
+
+// QueryHit
+
+static Entity* entity_QueryHit(DynamicsWorld::QueryHit& h) {
+	return h.entity;
+}
+
+SCRIPT_CLASS_DECLAR(DynamicsWorld::QueryHit);
+SCRIPT_CLASS_REGISTER(DynamicsWorld::QueryHit)
+	.declareClass<DynamicsWorld::QueryHit>("PhysicsHit")
+	.constructor()
+	.varGet("entity", &entity_QueryHit)
+	.var("position", &DynamicsWorld::QueryHit::position)
+	.var("normal", &DynamicsWorld::QueryHit::normal)
+	.var("fraction", &DynamicsWorld::QueryHit::fraction)
+;}
+
+// DynamicsWorld
+
+static bool raycast_DynamicsWorld(DynamicsWorld& w, const Vec3f& from, const Vec3f& to, DynamicsWorld::QueryHit& hit, int filterMask) {
+	return w.raycast(from, to, hit, filterMask);
+}
+
+static bool sweepSphere_DynamicsWorld(DynamicsWorld& w, float radius, const Vec3f& from, const Vec3f& to, DynamicsWorld::QueryHit& hit, int filterMask) {
+	return w.sweepSphere(radius, from, to, hit, filterMask);
+}
+
+static bool sweepBox_DynamicsWorld(DynamicsWorld& w, const Vec3f& halfExtents, const Vec3f& from, const Vec3f& to, DynamicsWorld::QueryHit& hit, int filterMask) {
+	return w.sweepBox(halfExtents, from, to, hit, filterMask);
+}
+
+// Push the entities as a new script array
+static SQInteger pushEntityArray(HSQUIRRELVM vm, const std::vector<Entity*>& entities)
+{
+	sq_newarray(vm, 0);
+	for(size_t i=0; i<entities.size(); ++i) {
+		push(vm, entities[i], entities[i]);
+		sq_arrayappend(vm, -2);
+	}
+	return 1;
+}
+
+static Vec3f* getVec3(HSQUIRRELVM vm, SQInteger idx)
+{
+	Vec3f* v = nullptr;
+	if(sq_gettype(vm, idx) != OT_INSTANCE || SQ_FAILED(fromInstanceUp(vm, idx, v, v, ClassTraits<Vec3f>::classID())))
+		return nullptr;
+	return v;
+}
+
+// _overlapSphere(center, radius, filterMask), returns an array of Entity
+static SQInteger overlapSphere_DynamicsWorld(HSQUIRRELVM vm)
+{
+	DynamicsWorld* self = get(TypeSelect<DynamicsWorld*>(), vm, 1);
+	const Vec3f* center = getVec3(vm, 2);
+	SQFloat radius = 0;
+	SQInteger filterMask = 0;
+	if(!self || !center || SQ_FAILED(sq_getfloat(vm, 3, &radius)) || SQ_FAILED(sq_getinteger(vm, 4, &filterMask)))
+		return sq_throwerror(vm, "DynamicsWorld.overlapSphere() expecting a Vec3, a float and an optional integer parameter");
+
+	std::vector<Entity*> result;
+	self->overlapSphere(*center, radius, result, int(filterMask));
+	return pushEntityArray(vm, result);
+}
+
+// _overlapBox(center, halfExtents, filterMask), returns an array of Entity
+static SQInteger overlapBox_DynamicsWorld(HSQUIRRELVM vm)
+{
+	DynamicsWorld* self = get(TypeSelect<DynamicsWorld*>(), vm, 1);
+	const Vec3f* center = getVec3(vm, 2);
+	const Vec3f* halfExtents = getVec3(vm, 3);
+	SQInteger filterMask = 0;
+	if(!self || !center || !halfExtents || SQ_FAILED(sq_getinteger(vm, 4, &filterMask)))
+		return sq_throwerror(vm, "DynamicsWorld.overlapBox() expecting two Vec3 and an optional integer parameter");
+
+	std::vector<Entity*> result;
+	self->overlapBox(*center, *halfExtents, result, int(filterMask));
+	return pushEntityArray(vm, result);
+}
+
+SCRIPT_CLASS_DECLAR(DynamicsWorld);
+SCRIPT_CLASS_REGISTER(DynamicsWorld)
+	.declareClass<DynamicsWorld>("DynamicsWorld")
+	.varGet("gravity", &DynamicsWorld::gravity)
+	.method("_raycast", &raycast_DynamicsWorld)
+	.runScript("DynamicsWorld.raycast<-function(from,to,hit,filterMask=-1){return _raycast(from,to,hit,filterMask);}")
+	.method("_sweepSphere", &sweepSphere_DynamicsWorld)
+	.runScript("DynamicsWorld.sweepSphere<-function(radius,from,to,hit,filterMask=-1){return _sweepSphere(radius,from,to,hit,filterMask);}")
+	.method("_sweepBox", &sweepBox_DynamicsWorld)
+	.runScript("DynamicsWorld.sweepBox<-function(halfExtents,from,to,hit,filterMask=-1){return _sweepBox(halfExtents,from,to,hit,filterMask);}")
+	.rawMethod("_overlapSphere", &overlapSphere_DynamicsWorld)
+	.rawMethod("_overlapBox", &overlapBox_DynamicsWorld)
+	.runScript("DynamicsWorld.overlapSphere<-function(center,radius,filterMask=-1){return _overlapSphere(center,radius,filterMask);}")
+	.runScript("DynamicsWorld.overlapBox<-function(center,halfExtents,filterMask=-1){return _overlapBox(center,halfExtents,filterMask);}")
+	.runScript("DynamicsWorld.dynamicBodies<-1;DynamicsWorld.staticBodies<-2;DynamicsWorld.allBodies<- -1;")
+;}
+
+void registerPhysicsBinding(VMCore& vm, DynamicsWorld& world)
+{
+	Binding::ClassTraits<DynamicsWorld::QueryHit>::bind(&vm);
+	Binding::ClassTraits<DynamicsWorld>::bind(&vm);
+
+	// Each VM refers to its own world
+	HSQUIRRELVM v = vm.getVM();
+	sq_pushroottable(v);
+	sq_pushstring(v, "physicsWorld", -1);
+	objNoCare::pushResult(v, &world);
+	MCD_VERIFY(SQ_SUCCEEDED(sq_newslot(v, -3, false)));
+	sq_pop(v, 1);
+}
+
+}	// namespace Binding
+}	// namespace MCD
@@ -0,0 +1,29 @@
+#ifndef __MCD_COMPONENT_PHYSICSBINDING__
+#define __MCD_COMPONENT_PHYSICSBINDING__
+
+#include "../ShareLib.h"
+#include "../../Core/Binding/ClassTraits.h"
+
+namespace MCD {
+
+class DynamicsWorld;
+
+namespace Binding {
+
+/*!	Expose the scene queries of \em world to the script, as the global variable "physicsWorld".
+	Example:
+	\code
+	local hit = PhysicsHit();
+	if(physicsWorld.raycast(Vec3(0, 10, 0), Vec3(0, -10, 0), hit))
+		println(hit.entity.name + " at " + hit.position);
+	foreach(e in physicsWorld.overlapSphere(Vec3(0), 5))
+		e.enabled = false;
+	\endcode
+	\note The VM refers to the world without owning it, the world must outlive the VM.
+ */
+MCD_COMPONENT_API void registerPhysicsBinding(VMCore& vm, DynamicsWorld& world);
+
+}	// namespace Binding
+}	// namespace MCD
+
+#endif	// __MCD_COMPONENT_PHYSICSBINDING__
@@ -8,11 +8,13 @@
 #include "../Render/MeshComponent.h"
 #include "../../Core/Entity/Entity.h"
 #include "../../../3Party/bullet/btBulletDynamicsCommon.h"
+#include <map>
 
 namespace MCD {
 
 RigidBodyComponent::Impl::Impl(DynamicsWorld& dynamicsWorld, float mass, const CollisionShapePtr& shape)
 	: mDynamicsWorld(&dynamicsWorld), mRigidBody(nullptr), mMotionState(nullptr), mShape(shape), mMass(mass)
+	, mSlot(0), mGeneration(0), mReadFrame(0)
 {
 }
 
@@ -23,8 +25,7 @@ RigidBodyComponent::Impl::~Impl()
 	delete mMotionState;
 }
 
-// This function apply transform to a collision shape, with the care of scaling
-static void setShapeTransform(Mat44f transform, btTransform& tx, btCollisionShape* shape)
+void RigidBodyComponent::Impl::setShapeTransform(Mat44f transform, btTransform& tx, btCollisionShape* shape)
 {
 	Vec3f scaling = transform.scale();
 	transform.setScale(Vec3f(1));	// Bullet handles scaling differently from translation and rotation.
@@ -39,7 +40,7 @@ void RigidBodyComponent::Impl::onAdd(Entity* e)
 	btTransform tx;
 	setShapeTransform(e->worldTransform(), tx, reinterpret_cast<btCollisionShape*>(mShape->shapeImpl));
 
-	mMotionState = new btDefaultMotionState(tx);
+	mMotionState = new MotionState(tx, e);
 
 	btRigidBody::btRigidBodyConstructionInfo rbInfo(
 		(btScalar)mMass, mMotionState, reinterpret_cast<btCollisionShape*>(mShape->shapeImpl)
@@ -51,26 +52,12 @@ void RigidBodyComponent::Impl::onAdd(Entity* e)
 	mRigidBody = new btRigidBody(rbInfo);
 }
 
-void RigidBodyComponent::Impl::update(Entity* e)
+void RigidBodyComponent::Impl::setTransform(const Mat44f& transform)
 {
-	if(mShape->isStatic()) {
-		btTransform tx;
-		setShapeTransform(e->worldTransform(), tx, reinterpret_cast<btCollisionShape*>(mShape->shapeImpl));
-		mRigidBody->setWorldTransform(tx);	// NOTE: We need to set transfrom on mRigidBody but not mMotionState
-		return;
-	}
-
-	// Simple translation of btTransform to MCD Matrix
+	MCD_ASSUME(mRigidBody);
 	btTransform tx;
-	mMotionState->getWorldTransform(tx);
-	const btMatrix3x3 rot(tx.getBasis());
-	const btVector3 v(tx.getOrigin());
-
-	for(int x = 0; x < 3; ++x)
-		for(int y = 0; y < 3; ++y)
-			e->localTransform[x][y] = rot[x][y];
-
-	e->localTransform.setTranslation(Vec3f(v[0], v[1], v[2]));
+	setShapeTransform(transform, tx, reinterpret_cast<btCollisionShape*>(mShape->shapeImpl));
+	mRigidBody->setWorldTransform(tx);	// NOTE: We need to set transfrom on mRigidBody but not mMotionState
 }
 
 RigidBodyComponent::RigidBodyComponent(DynamicsWorld& dynamicsWorld, float mass, const CollisionShapePtr& shape)
@@ -94,17 +81,38 @@ Component* RigidBodyComponent::clone() const
 
 void RigidBodyComponent::update(float)
 {
-	MCD_ASSUME(mImpl);
-	if(Entity* e = entity())
-		mImpl->update(e);
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	Entity* e = entity();
+	if(!e)
+		return;
+
+	// Static bodies follow the Entity, while dynamic bodies drive the Entity
+	if(mImpl->mShape->isStatic()) {
+		mImpl->mDynamicsWorld->setTransform(*this, e->worldTransform());
+		return;
+	}
+
+	// DynamicsWorld::syncTransforms() takes care of the dynamic bodies in one go
+	if(mImpl->mDynamicsWorld->config().batchSync)
+		return;
+
+	Mat44f transform;
+	if(!mImpl->mDynamicsWorld->getTransform(*this, transform))
+		return;
+
+	for(int x = 0; x < 3; ++x)
+		for(int y = 0; y < 3; ++y)
+			e->localTransform[x][y] = transform[x][y];
+
+	e->localTransform.setTranslation(transform.translation());
 }
 
-// TODO: If physics component is going to use multi-thread,
-// we should delay the following operations till update() to do.
+// NOTE: The operations go through the DynamicsWorld, so that ThreadedDynamicsWorld
+// can delay them to the physics thread.
 void RigidBodyComponent::applyForce(const Vec3f& force, const Vec3f& rel_pos)
 {
-	MCD_ASSUME(mImpl && mImpl->mRigidBody);
-	mImpl->mRigidBody->applyForce(toBullet(force), toBullet(rel_pos));
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	mImpl->mDynamicsWorld->applyForce(*this, force, rel_pos);
 }
 
 float RigidBodyComponent::getLinearDamping() const
@@ -121,8 +129,8 @@ float RigidBodyComponent::getAngularDamping() const
 
 void RigidBodyComponent::setDamping(float lin_damping, float ang_damping)
 {
-	MCD_ASSUME(mImpl && mImpl->mRigidBody);
-	mImpl->mRigidBody->setDamping(lin_damping, ang_damping);
+	MCD_ASSUME(mImpl && mImpl->mDynamicsWorld);
+	mImpl->mDynamicsWorld->setDamping(*this, lin_damping, ang_damping);
 }
 
 void RigidBodyComponent::onAdd()
@@ -141,8 +149,11 @@ void RigidBodyComponent::onRemove()
 	// NOTE: mImpl may now become null, because of threaded dynamics world's removeRigidBody()
 }
 
-void createStaticRigidBody(DynamicsWorld& dynamicsWorld, Entity& entityTree)
+void createStaticRigidBody(DynamicsWorld& dynamicsWorld, Entity& entityTree, const Path& bvhCacheDirectory)
 {
+	// Entities sharing the same Mesh share the same shape
+	std::map<Mesh*, CollisionShapePtr> shapes;
+
 	for(ComponentPreorderIterator itr(&entityTree); !itr.ended(); itr.next()) {
 		MeshComponent* meshComponent = dynamic_cast<MeshComponent*>(itr.current());
 		if(!meshComponent || !meshComponent->mesh)
@@ -151,8 +162,12 @@ void createStaticRigidBody(DynamicsWorld& dynamicsWorld, Entity& entityTree)
 		Entity* e = meshComponent->entity();
 		MCD_ASSUME(e);
 
+		CollisionShapePtr& shape = shapes[meshComponent->mesh.get()];
+		if(!shape)
+			shape = new StaticTriMeshShape(meshComponent->mesh, bvhCacheDirectory);
+
 		// Create the phyiscs component
-		RigidBodyComponent* rbc = new RigidBodyComponent(dynamicsWorld, 0, new StaticTriMeshShape(meshComponent->mesh));
+		RigidBodyComponent* rbc = new RigidBodyComponent(dynamicsWorld, 0, shape);
 		e->addComponent(rbc);
 	}
 }
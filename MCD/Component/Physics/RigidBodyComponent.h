@@ -3,6 +3,7 @@
 
 #include "../ShareLib.h"
 #include "../../Core/Entity/BehaviourComponent.h"
+#include "../../Core/System/Path.h"
 
 namespace MCD {
 
@@ -50,9 +51,10 @@ private:
 };	// RigidBodyComponent
 
 /*!	Given a tree of Entity, creates RigidBodyComponent with StaticTriMeshShape for
-	each MeshComponent found in the tree.
+	each MeshComponent found in the tree. MeshComponent using the same Mesh share one shape.
+	\param bvhCacheDirectory Where the BVH of the shapes are cached, see StaticTriMeshShape.
  */
-MCD_COMPONENT_API void createStaticRigidBody(DynamicsWorld& dynamicsWorld, Entity& entityTree);
+MCD_COMPONENT_API void createStaticRigidBody(DynamicsWorld& dynamicsWorld, Entity& entityTree, const Path& bvhCacheDirectory=Path());
 
 }	// MCD
 
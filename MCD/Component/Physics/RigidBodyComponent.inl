@@ -1,9 +1,33 @@
+#include "../../Core/Math/Mat44.h"
 #include "../../../3Party/bullet/btBulletDynamicsCommon.h"
 
 namespace MCD {
 
 class DynamicsWorld;
 
+/*!	Besides the transform synchronized by bullet, it keeps the world transforms of the
+	last two physics steps, recorded by DynamicsWorld, for interpolating the render transform.
+ */
+class MotionState : public btDefaultMotionState
+{
+public:
+	MotionState(const btTransform& transform, sal_in Entity* entity)
+		: btDefaultMotionState(transform), mPrevious(transform), mCurrent(transform), mStep(0), mEntity(entity)
+	{}
+
+	void record(const btTransform& transform, size_t step)
+	{
+		mPrevious = mCurrent;
+		mCurrent = transform;
+		mStep = step;
+	}
+
+	btTransform mPrevious;
+	btTransform mCurrent;
+	size_t mStep;	//!< The step when mCurrent was recorded; a body not moved in the latest step is at rest
+	Entity* mEntity;	//!< The Entity driven by this body, for DynamicsWorld::syncTransforms()
+};	// MotionState
+
 class RigidBodyComponent::Impl
 {
 public:
@@ -13,13 +37,22 @@ public:
 
 	void onAdd(sal_in Entity* e);
 
-	void update(sal_in Entity* e);
+	//! Move a static body.
+	void setTransform(const Mat44f& transform);
+
+	//! Bullet handles scaling differently from translation and rotation, the scaling goes to the shape.
+	static void setShapeTransform(Mat44f transform, btTransform& tx, btCollisionShape* shape);
 
 	DynamicsWorld* mDynamicsWorld;
 	btRigidBody* mRigidBody;
-	btMotionState* mMotionState;
+	MotionState* mMotionState;
 	CollisionShapePtr mShape;
 	float mMass;
+
+	// Book keeping for ThreadedDynamicsWorld, only touched by the main thread
+	size_t mSlot;			//!< Index in the transform snapshot
+	uint32_t mGeneration;	//!< Distinguish the bodies which used the same slot
+	size_t mReadFrame;		//!< The snapshot frame last read by this body
 };	// Impl
 
 }	// namespace MCD
@@ -1,58 +1,98 @@
 #include "Pch.h"
 #include "ThreadedDynamicWorld.h"
 #include "DynamicsWorld.inl"
+#include "MathConvertor.inl"
 #include "RigidBodyComponent.h"
 #include "RigidBodyComponent.inl"
-#include "../../Core/Entity/Component.h"
+#include "../../Core/Entity/Entity.h"
+#include "../../Core/System/Atomic.h"
 #include "../../Core/System/Mutex.h"
+#include "../../Core/System/SpscQueue.h"
 #include "../../Core/System/Timer.h"
-#include "../../Core/System/TypeTrait.h"
-#ifdef MCD_VC
-#	pragma warning(push)
-#	pragma warning(disable: 6011)
-#endif
-#include <queue>
-#ifdef MCD_VC
-#	pragma warning(pop)
-#endif
-
-//! A simply enough command class for use in physics component command queue.
-class MCD_ABSTRACT_CLASS ICommand {
-public:
-	virtual ~ICommand() {}
-	virtual void exec() = 0;
-};	// ICommand
+#include <string.h>	// For memcpy
+#include <vector>
+
+using namespace MCD;
+
+namespace {
 
-template<typename T1, typename T2, typename T1_=ParamType<T1>::RET, typename T2_=ParamType<T2>::RET>
-struct StaticCommand2 : public ICommand
+/*!	The last two physics states of a body in the snapshot, valid only if the generation matches
+	with the body. Each state is a position followed by a quaternion, which are cheaper to
+	store and interpolate than a matrix.
+ */
+struct BodyState
 {
-	typedef void (*F)(T1_, T2_);
-	StaticCommand2(F f, T1_ t1, T2_ t2) : f(f), t1(t1), t2(t2) {}
-	sal_override void exec() { (*f)(t1, t2); }
+	float previous[7];
+	float current[7];
+	uint32_t generation;
+};	// BodyState
 
-	F f;
-	T1 t1;	// The storage type can be differ from the argument type.
-	T2 t2;
-};	// StaticCommand2
+struct Snapshot
+{
+	std::vector<BodyState> bodies;	//!< Indexed by slot
+	std::vector<size_t> moved;		//!< Slots of the bodies moved since the previous publish
+	double time;					//!< The time, in Timer::sinceProgramStatup(), represented by the current states
+	size_t sequence;				//!< Increments on each publish
+};	// Snapshot
 
-template<class C, typename T1, typename T1_=ParamType<T1>::RET>
-struct MemCommand1 : public ICommand
+void store(const btTransform& tx, float* p)
 {
-	typedef void (C::*F)(T1_);
-	MemCommand1(F f, C& c, T1_ t1) : f(f), c(c), t1(t1) {}
-	sal_override void exec() { (c.*f)(t1); }
+	const btVector3& o = tx.getOrigin();
+	const btQuaternion q = tx.getRotation();
+	p[0] = o.x(); p[1] = o.y(); p[2] = o.z();
+	p[3] = q.x(); p[4] = q.y(); p[5] = q.z(); p[6] = q.w();
+}
 
-	F f;
-	C& c;
-	T1 t1;	// The storage type can be differ from the argument type.
-};	// MemCommand1
+btTransform load(const float* p)
+{
+	return btTransform(btQuaternion(p[3], p[4], p[5], p[6]), btVector3(p[0], p[1], p[2]));
+}
 
-using namespace MCD;
+}	// namespace
 
 class ThreadedDynamicsWorld::Impl
 {
 public:
-	Impl(ThreadedDynamicsWorld& world) : mThreadedDynamicsWorld(world) {}
+	/*!	A command sent from the main thread to the physics thread.
+		It's a POD, so it can be copied into the ring buffer without any heap allocation.
+	 */
+	struct Command
+	{
+		enum Type
+		{
+			AddRigidBody,
+			RemoveRigidBody,	//!< Also deletes the RigidBodyComponent::Impl
+			SetTransform,		//!< data holds a Mat44f
+			ApplyForce,			//!< data holds the force and the relative position
+			SetDamping,			//!< data holds the linear and angular damping
+			SetGravity			//!< data holds the gravity
+		};
+
+		Type type;
+		RigidBodyComponent::Impl* body;
+		size_t slot;
+		uint32_t generation;
+		float data[16];
+	};	// Command
+
+	struct Body
+	{
+		RigidBodyComponent::Impl* body;
+		size_t slot;
+		uint32_t generation;
+	};	// Body
+
+	Impl(ThreadedDynamicsWorld& world, size_t commandCapacity)
+		: mThreadedDynamicsWorld(world)
+		, mCommands(commandCapacity), mOverflowing(false), mOverflowCount(0)
+		, mFront(0), mMiddle(1), mBack(2), mReadFrame(0), mRenderT(1)
+		, mPublishedStep(0), mPublishCount(0)
+	{
+		for(size_t i=0; i<3; ++i) {
+			mSnapshots[i].time = 0;
+			mSnapshots[i].sequence = 0;
+		}
+	}
 
 	~Impl()
 	{
@@ -61,44 +101,224 @@ public:
 		doQueueJob();
 	}
 
-	void doQueueJob() 
+// Main thread
+	void push(const Command& c)
 	{
-		ScopeLock lock(mCommandQueueLock);
-		while(!mCommandQueue.empty())
-		{
-			ICommand* c = mCommandQueue.front();
-			c->exec();
-			delete c;
-			mCommandQueue.pop();
+		// Once overflowed, keep using the overflow vector until the physics thread
+		// consumed it, in order to preserve the command ordering.
+		if(!mOverflowing && mCommands.push(c))
+			return;
+
+		ScopeLock lock(mOverflowLock);
+		if(!mOverflowing && mCommands.push(c))
+			return;
+
+		mOverflowing = true;
+		mOverflow.push_back(c);
+		++mOverflowCount;
+	}
+
+	size_t allocateSlot()
+	{
+		if(mFreeSlots.empty()) {
+			mGenerations.push_back(0);
+			mSlotBodies.push_back(nullptr);
+			return mGenerations.size() - 1;
+		}
+
+		const size_t slot = mFreeSlots.back();
+		mFreeSlots.pop_back();
+		return slot;
+	}
+
+	bool latchTransforms()
+	{
+		++mReadFrame;
+		bool fresh = false;
+		if(int(mMiddle) & cFreshBit) {
+			mFront = mMiddle.exchange(mFront) & ~cFreshBit;
+			fresh = true;
+		}
+
+		// Map the current time to the interpolation parameter, see DynamicsWorld::getTransform()
+		const DynamicsWorld::Config& config = mThreadedDynamicsWorld.config();
+		float t = float(Timer::sinceProgramStatup().asSecond() - mSnapshots[mFront].time) / config.fixedTimeStep;
+		t = t < 0 ? 0 : (t > 1 ? 1 : t);	// Hold the state if the physics thread falls behind
+
+		if(config.interpolation == DynamicsWorld::Config::Interpolate)
+			mRenderT = t;
+		else if(config.interpolation == DynamicsWorld::Config::Extrapolate)
+			mRenderT = 1 + t;
+		else
+			mRenderT = 1;
+
+		return fresh;
+	}
+
+// Physics thread
+	void doQueueJob()
+	{
+		// Read the flag before draining the ring buffer. Once it's set, the main thread pushes
+		// nothing more into the ring buffer, so after draining, the ring buffer held only
+		// commands older than those in the overflow vector. If the main thread overflows after
+		// this point instead, the overflow vector waits for the next call.
+		const bool overflowing = mOverflowing;
+
+		Command c;
+		while(mCommands.pop(c))
+			exec(c);
+
+		if(!overflowing)
+			return;
+
+		{	ScopeLock lock(mOverflowLock);
+			mExecuting.swap(mOverflow);
+			mOverflowing = false;
+		}
+
+		for(size_t i=0; i<mExecuting.size(); ++i)
+			exec(mExecuting[i]);
+		mExecuting.clear();
+
+		// Those pushed into the ring buffer after clearing the flag are newer than the overflow vector
+		while(mCommands.pop(c))
+			exec(c);
+	}
+
+	void exec(const Command& c)
+	{
+		RigidBodyComponent::Impl* body = c.body;
+
+		switch(c.type) {
+		case Command::AddRigidBody:
+		{	MCD_ASSUME(body && body->mRigidBody);
+			if(c.slot >= mBodyIndex.size())
+				mBodyIndex.resize(c.slot + 1);
+			mBodyIndex[c.slot] = mBodies.size();
+			Body b = { body, c.slot, c.generation };
+			mBodies.push_back(b);
+			mThreadedDynamicsWorld.DynamicsWorld::addRigidBody(body->mRigidBody);
+		}	break;
+		case Command::RemoveRigidBody:
+		{	MCD_ASSUME(body);
+			if(c.generation != 0) {
+				// Swap with the last one for a constant time removal
+				const size_t i = mBodyIndex[c.slot];
+				MCD_ASSERT(mBodies[i].body == body);
+				mBodies[i] = mBodies.back();
+				mBodyIndex[mBodies[i].slot] = i;
+				mBodies.pop_back();
+			}
+			if(body->mRigidBody)
+				mThreadedDynamicsWorld.DynamicsWorld::removeRigidBody(body->mRigidBody);
+			delete body;
+		}	break;
+		case Command::SetTransform:
+		{	MCD_ASSUME(body);
+			Mat44f transform;
+			::memcpy(transform.getPtr(), c.data, sizeof(c.data));
+			body->setTransform(transform);
+		}	break;
+		case Command::ApplyForce:
+			MCD_ASSUME(body && body->mRigidBody);
+			body->mRigidBody->applyForce(btVector3(c.data[0], c.data[1], c.data[2]), btVector3(c.data[3], c.data[4], c.data[5]));
+			break;
+		case Command::SetDamping:
+			MCD_ASSUME(body && body->mRigidBody);
+			body->mRigidBody->setDamping(c.data[0], c.data[1]);
+			break;
+		case Command::SetGravity:
+			mThreadedDynamicsWorld.DynamicsWorld::setGravity(Vec3f(c.data[0], c.data[1], c.data[2]));
+			break;
+		default:
+			MCD_ASSERT(false);
+		}
+	}
+
+	//! Write the states into the back buffer and swap it with the middle one.
+	void publish(double time)
+	{
+		Snapshot& snapshot = mSnapshots[mBack];
+		if(snapshot.bodies.size() < mBodyIndex.size())
+			snapshot.bodies.resize(mBodyIndex.size());
+		snapshot.moved.clear();
+		snapshot.time = time;
+		snapshot.sequence = ++mPublishCount;
+
+		const size_t stepCount = mThreadedDynamicsWorld.stepCount();
+		for(size_t i=0; i<mBodies.size(); ++i) {
+			const Body& b = mBodies[i];
+			if(b.body->mRigidBody->isStaticObject())
+				continue;
+
+			const MotionState& motion = *b.body->mMotionState;
+			if(motion.mStep > mPublishedStep)
+				snapshot.moved.push_back(b.slot);
+
+			BodyState& state = snapshot.bodies[b.slot];
+			store(motion.mCurrent, state.current);
+			// A body not moved in the latest step is at rest
+			store(motion.mStep == stepCount ? motion.mPrevious : motion.mCurrent, state.previous);
+			state.generation = b.generation;
 		}
+
+		mPublishedStep = stepCount;
+		mBack = mMiddle.exchange(mBack | cFreshBit) & ~cFreshBit;
 	}
 
 	void run(Thread& thread)
 	{
+		const float stepSize = mThreadedDynamicsWorld.config().fixedTimeStep;
 		DeltaTimer timer;
 		while(thread.keepRun())
 		{
-			float dt = float(timer.getDelta().asSecond());
-			mThreadedDynamicsWorld.stepSimulation(dt, 10);
-
-			float instanceFps = 1.0f / dt;
+			doQueueJob();
 
-			// Limit the framerate of the physics thread
-			if(instanceFps > cFpsLimit)
-				mSleep(size_t(1000.0f/cFpsLimit - 1000.0f / instanceFps));
+			const float dt = float(timer.getDelta().asSecond());
+			if(mThreadedDynamicsWorld.stepSimulation(dt) > 0) {
+				// The latest state lags behind the wall clock by the time left in the accumulator
+				const double now = Timer::sinceProgramStatup().asSecond();
+				publish(now - mThreadedDynamicsWorld.interpolationAlpha() * stepSize);
+			}
 
-			doQueueJob();
+			// Sleep until the next step is due
+			const float remain = (1 - mThreadedDynamicsWorld.interpolationAlpha()) * stepSize;
+			mSleep(size_t(remain * 1000));
 		}
 
 		doQueueJob();
 	}
 
 	ThreadedDynamicsWorld& mThreadedDynamicsWorld;
-	Mutex mCommandQueueLock;
-	typedef std::queue<ICommand*> CommandQueue;
-	CommandQueue mCommandQueue;
 
-	static const int cFpsLimit = 30;
+	// Command passing
+	SpscQueue<Command> mCommands;
+	AtomicValue<bool> mOverflowing;	//!< Set with release and read with acquire, the ring buffer content is visible once it's seen
+	Mutex mOverflowLock;
+	std::vector<Command> mOverflow;	//!< Protected by mOverflowLock
+	std::vector<Command> mExecuting;	//!< The overflowed commands being executed, physics thread only
+	size_t mOverflowCount;
+
+	// Triple buffered snapshot: the physics thread writes mBack, the main thread reads mFront,
+	// and the two are swapped with mMiddle atomically. cFreshBit in mMiddle marks a new publish.
+	Snapshot mSnapshots[3];
+	int mFront;
+	AtomicInteger mMiddle;
+	int mBack;
+	static const int cFreshBit = 4;
+
+	// Main thread only
+	std::vector<size_t> mFreeSlots;
+	std::vector<uint32_t> mGenerations;	//!< Indexed by slot
+	std::vector<RigidBodyComponent::Impl*> mSlotBodies;	//!< Indexed by slot, for syncTransforms()
+	size_t mReadFrame;
+	float mRenderT;	//!< The interpolation parameter of the current frame
+
+	// Physics thread only
+	std::vector<Body> mBodies;
+	std::vector<size_t> mBodyIndex;	//!< Index into mBodies, indexed by slot
+	size_t mPublishedStep;	//!< The step count at the previous publish
+	size_t mPublishCount;
 };	// Impl
 
 void ThreadedDynamicsWorld::run(Thread& thread)
@@ -109,7 +329,13 @@ void ThreadedDynamicsWorld::run(Thread& thread)
 
 ThreadedDynamicsWorld::ThreadedDynamicsWorld()
 {
-	mImpl = new Impl(*this);
+	mImpl = new Impl(*this, cDefaultCommandCapacity);
+}
+
+ThreadedDynamicsWorld::ThreadedDynamicsWorld(const Config& config, size_t commandCapacity)
+	: DynamicsWorld(config)
+{
+	mImpl = new Impl(*this, commandCapacity);
 }
 
 ThreadedDynamicsWorld::~ThreadedDynamicsWorld()
@@ -117,62 +343,146 @@ ThreadedDynamicsWorld::~ThreadedDynamicsWorld()
 	delete mImpl;
 }
 
-void ThreadedDynamicsWorld::addRigidBody(RigidBodyComponent& rbc)
+bool ThreadedDynamicsWorld::latchTransforms()
 {
-	struct Dummy
-	{
-		// Note that we use ComponentPtr (a weak pointer) as parameter
-		static void addRigidBody(ThreadedDynamicsWorld& world, const ComponentPtr& rbc)
-		{
-			RigidBodyComponent* p = dynamic_cast<RigidBodyComponent*>(rbc.get());
-			if(p)
-				world.addRigidBodyNoQueue(*p);
-		}
-	};	// Dummy
-
 	MCD_ASSUME(mImpl);
-	ScopeLock lock(mImpl->mCommandQueueLock);
-	mImpl->mCommandQueue.push(new StaticCommand2<ThreadedDynamicsWorld&, const ComponentPtr>(&Dummy::addRigidBody, *this, ComponentPtr(&rbc)));
+	return mImpl->latchTransforms();
 }
 
-void ThreadedDynamicsWorld::addRigidBodyNoQueue(RigidBodyComponent& rbc)
+void ThreadedDynamicsWorld::addRigidBody(RigidBodyComponent& rbc)
 {
 	MCD_ASSUME(mImpl);
-	MCD_ASSERT(mImpl->mCommandQueueLock.isLocked());
-	DynamicsWorld::addRigidBody(rbc);
+	RigidBodyComponent::Impl* body = rbc.mImpl;
+	if(!body)
+		return;
+
+	body->mSlot = mImpl->allocateSlot();
+	uint32_t& generation = mImpl->mGenerations[body->mSlot];
+	if(++generation == 0)	// Zero is reserved for the bodies never added
+		++generation;
+	body->mGeneration = generation;
+	body->mReadFrame = mImpl->mReadFrame - 1;	// Such that this body will not trigger latchTransforms()
+	mImpl->mSlotBodies[body->mSlot] = body;
+
+	Impl::Command c;
+	c.type = Impl::Command::AddRigidBody;
+	c.body = body;
+	c.slot = body->mSlot;
+	c.generation = body->mGeneration;
+	mImpl->push(c);
 }
 
 void ThreadedDynamicsWorld::setGravity(const Vec3f& g)
 {
 	MCD_ASSUME(mImpl);
-	ScopeLock lock(mImpl->mCommandQueueLock);
-	mImpl->mCommandQueue.push(new MemCommand1<DynamicsWorld, const Vec3f>(&DynamicsWorld::setGravity, *this, g));
+	Impl::Command c;
+	c.type = Impl::Command::SetGravity;
+	c.body = nullptr;
+	c.data[0] = g.x; c.data[1] = g.y; c.data[2] = g.z;
+	mImpl->push(c);
 }
 
-void ThreadedDynamicsWorld::removeRigidBody(RigidBodyComponent& rbc)
+size_t ThreadedDynamicsWorld::overflowCount() const
 {
-	struct Dummy
-	{
-		// Note that we use ComponentPtr (a weak pointer) as parameter
-		static void removeRigidBody(ThreadedDynamicsWorld& world, RigidBodyComponent::Impl* rbc)
-		{
-			if(rbc->mRigidBody)
-				world.removeRigidBodyNoQueue(rbc->mRigidBody);
-			delete rbc;
-		}
-	};	// Dummy
+	MCD_ASSUME(mImpl);
+	return mImpl->mOverflowCount;
+}
 
+void ThreadedDynamicsWorld::removeRigidBody(RigidBodyComponent& rbc)
+{
 	// Remove the ownership of btRigidBody from RigidBodyComponent to the command.
 	MCD_ASSUME(rbc.mImpl);
-	RigidBodyComponent::Impl* p = rbc.mImpl;
+	RigidBodyComponent::Impl* body = rbc.mImpl;
 	rbc.mImpl = nullptr;
 
 	MCD_ASSUME(mImpl);
-	ScopeLock lock(mImpl->mCommandQueueLock);
-	mImpl->mCommandQueue.push(new StaticCommand2<ThreadedDynamicsWorld&, RigidBodyComponent::Impl*>(&Dummy::removeRigidBody, *this, p));
+
+	// The slot can be reused immediately, the generation tells the snapshot of the old body apart
+	if(body->mGeneration != 0) {
+		mImpl->mFreeSlots.push_back(body->mSlot);
+		mImpl->mSlotBodies[body->mSlot] = nullptr;
+	}
+
+	Impl::Command c;
+	c.type = Impl::Command::RemoveRigidBody;
+	c.body = body;
+	c.slot = body->mSlot;
+	c.generation = body->mGeneration;
+	mImpl->push(c);
+}
+
+bool ThreadedDynamicsWorld::getTransform(RigidBodyComponent& rbc, Mat44f& transform)
+{
+	MCD_ASSUME(mImpl && rbc.mImpl);
+	RigidBodyComponent::Impl& body = *rbc.mImpl;
+
+	// A body reading the same frame twice means a new frame has begun
+	if(body.mReadFrame == mImpl->mReadFrame)
+		mImpl->latchTransforms();
+	body.mReadFrame = mImpl->mReadFrame;
+
+	const std::vector<BodyState>& bodies = mImpl->mSnapshots[mImpl->mFront].bodies;
+	if(body.mSlot >= bodies.size() || bodies[body.mSlot].generation != body.mGeneration)
+		return false;
+
+	const BodyState& state = bodies[body.mSlot];
+	interpolate(load(state.previous), load(state.current), mImpl->mRenderT, transform);
+	return true;
+}
+
+size_t ThreadedDynamicsWorld::syncTransforms()
+{
+	MCD_ASSUME(mImpl);
+	const size_t lastSequence = mImpl->mSnapshots[mImpl->mFront].sequence;
+	const bool fresh = mImpl->latchTransforms();
+	const Snapshot& snapshot = mImpl->mSnapshots[mImpl->mFront];
+
+	// Only the moved list of the latest publish is available, visit all bodies if some publish was skipped
+	const bool skipped = fresh && snapshot.sequence != lastSequence + 1;
+	const size_t count = skipped ? mImpl->mSlotBodies.size() : snapshot.moved.size();
+
+	for(size_t i=0; i<count; ++i) {
+		const size_t slot = skipped ? i : snapshot.moved[i];
+		RigidBodyComponent::Impl* body = slot < mImpl->mSlotBodies.size() ? mImpl->mSlotBodies[slot] : nullptr;
+		if(!body || slot >= snapshot.bodies.size())
+			continue;
+
+		const BodyState& state = snapshot.bodies[slot];
+		Entity* e = body->mMotionState->mEntity;
+		if(state.generation == body->mGeneration && e)
+			interpolate(load(state.previous), load(state.current), mImpl->mRenderT, e->localTransform);
+	}
+
+	return count;
 }
 
-void ThreadedDynamicsWorld::removeRigidBodyNoQueue(void* rbc)
+void ThreadedDynamicsWorld::setTransform(RigidBodyComponent& rbc, const Mat44f& transform)
 {
-	DynamicsWorld::removeRigidBody(rbc);
+	MCD_ASSUME(mImpl);
+	Impl::Command c;
+	c.type = Impl::Command::SetTransform;
+	c.body = rbc.mImpl;
+	::memcpy(c.data, transform.getPtr(), sizeof(c.data));
+	mImpl->push(c);
+}
+
+void ThreadedDynamicsWorld::applyForce(RigidBodyComponent& rbc, const Vec3f& force, const Vec3f& relPos)
+{
+	MCD_ASSUME(mImpl);
+	Impl::Command c;
+	c.type = Impl::Command::ApplyForce;
+	c.body = rbc.mImpl;
+	c.data[0] = force.x; c.data[1] = force.y; c.data[2] = force.z;
+	c.data[3] = relPos.x; c.data[4] = relPos.y; c.data[5] = relPos.z;
+	mImpl->push(c);
+}
+
+void ThreadedDynamicsWorld::setDamping(RigidBodyComponent& rbc, float linear, float angular)
+{
+	MCD_ASSUME(mImpl);
+	Impl::Command c;
+	c.type = Impl::Command::SetDamping;
+	c.body = rbc.mImpl;
+	c.data[0] = linear; c.data[1] = angular;
+	mImpl->push(c);
 }
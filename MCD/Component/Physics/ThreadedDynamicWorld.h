@@ -8,29 +8,64 @@
 
 namespace MCD {
 
+/*!	A DynamicsWorld which steps in it's own thread, by starting a Thread with it as the runnable.
+
+	The main thread never touches bullet directly. Adding and removing bodies, applying
+	forces and moving static bodies are sent to the physics thread as fixed size commands
+	through a lock free ring buffer, so no heap allocation is involved.
+
+	The physics thread steps at Config::fixedTimeStep and sleeps in between. After stepping,
+	it publishes the last two states of all bodies into a triple buffered snapshot.
+	RigidBodyComponent::update() reads the latest snapshot without any lock, and all bodies
+	in a frame see the same physics step, interpolated to the time of the frame.
+ */
 class MCD_COMPONENT_API ThreadedDynamicsWorld : public DynamicsWorld, public Thread::IRunnable
 {
 public:
 	ThreadedDynamicsWorld(void);
 
+	/*!	\param commandCapacity Number of commands the ring buffer can hold before the physics
+			thread consumes them; the overflowed commands fall back to a locked vector.
+	 */
+	explicit ThreadedDynamicsWorld(const Config& config, size_t commandCapacity=cDefaultCommandCapacity);
+
 	sal_override ~ThreadedDynamicsWorld();
 
 	sal_override void run(Thread& thread);
 
 // Operations
+	/*!	Make the latest published transforms visible to RigidBodyComponent::update(),
+		and sample the time for the interpolation.
+		Call it on the main thread once per frame, before updating the components.
+		If it's never called, the first RigidBodyComponent updated in a frame will do it.
+		Returns false if the physics thread has published nothing new.
+	 */
+	bool latchTransforms();
+
+	//! Latch the transforms and write those moved to the Entity, see DynamicsWorld::syncTransforms().
+	sal_override size_t syncTransforms();
 
 // Attributes
 	void setGravity(const Vec3f& g);
 
+	//! Number of commands that didn't fit into the ring buffer so far.
+	size_t overflowCount() const;
+
+	static const size_t cDefaultCommandCapacity = 16384;
+
 protected:
 	//! ThreadedDynamicsWorld will not take over the ownership of RigidBodyComponent
 	sal_override void addRigidBody(RigidBodyComponent& rbc);
-	void addRigidBodyNoQueue(RigidBodyComponent& rbc);
 
 	sal_override void removeRigidBody(RigidBodyComponent& rbc);
 
-	//! Expecting void* to be btRigidBody*
-	void removeRigidBodyNoQueue(sal_notnull void* rbc);
+	sal_override bool getTransform(RigidBodyComponent& rbc, Mat44f& transform);
+
+	sal_override void setTransform(RigidBodyComponent& rbc, const Mat44f& transform);
+
+	sal_override void applyForce(RigidBodyComponent& rbc, const Vec3f& force, const Vec3f& relPos);
+
+	sal_override void setDamping(RigidBodyComponent& rbc, float linear, float angular);
 
 private:
 	class Impl;
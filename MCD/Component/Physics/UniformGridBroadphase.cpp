@@ -0,0 +1,248 @@
+#include "Pch.h"
+#include "UniformGridBroadphase.h"
+#include "../../Core/System/Log.h"
+#include "../../../3Party/bullet/BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include <algorithm>	// For std::sort
+#include <new>
+
+namespace MCD {
+
+struct UniformGridBroadphase::Proxy : public btBroadphaseProxy
+{
+	Proxy(const btVector3& aabbMin, const btVector3& aabbMax, void* userPtr, short int collisionFilterGroup, short int collisionFilterMask)
+		: btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask)
+		, index(0), isLarge(false)
+	{}
+
+	size_t index;	//!< Index in mProxies
+	bool isLarge;	//!< Overlapping too many cells, in mLargeProxies
+};	// Proxy
+
+namespace {
+
+inline bool aabbOverlap(const btBroadphaseProxy& p1, const btBroadphaseProxy& p2)
+{
+	return
+		p1.m_aabbMin[0] <= p2.m_aabbMax[0] && p2.m_aabbMin[0] <= p1.m_aabbMax[0] &&
+		p1.m_aabbMin[1] <= p2.m_aabbMax[1] && p2.m_aabbMin[1] <= p1.m_aabbMax[1] &&
+		p1.m_aabbMin[2] <= p2.m_aabbMax[2] && p2.m_aabbMin[2] <= p1.m_aabbMax[2];
+}
+
+//! Remove the pairs which no longer overlap.
+class RemoveSeparatedPair : public btOverlapCallback
+{
+public:
+	sal_override bool processOverlap(btBroadphasePair& pair) {
+		return !aabbOverlap(*pair.m_pProxy0, *pair.m_pProxy1);
+	}
+};	// RemoveSeparatedPair
+
+// 21 bits for each axis in the cell key
+const int cCellBits = 21;
+const int cCellOffset = 1 << (cCellBits - 1);
+const int cCellLimit = cCellOffset - 1;
+
+inline int toCell(btScalar x, btScalar invCellSize)
+{
+	const btScalar c = btScalar(floor(x * invCellSize));
+	// Clamp to the range of the key, far away proxies just share the border cells
+	if(c < -cCellLimit) return -cCellLimit;
+	if(c > cCellLimit) return cCellLimit;
+	return int(c);
+}
+
+}	// namespace
+
+UniformGridBroadphase::UniformGridBroadphase(btScalar cellSize, size_t maxCellsPerProxy)
+	: mCellSize(cellSize), mInvCellSize(btScalar(1) / cellSize)
+	, mMaxCellsPerProxy(maxCellsPerProxy)
+	, mNextUid(2)	// Same as bullet's broadphase, avoid the trivial values 0 and 1
+{
+	MCD_ASSERT(cellSize > 0);
+	void* mem = btAlignedAlloc(sizeof(btHashedOverlappingPairCache), 16);
+	mPairCache = new(mem) btHashedOverlappingPairCache();
+}
+
+UniformGridBroadphase::~UniformGridBroadphase()
+{
+	for(size_t i=0; i<mProxies.size(); ++i)
+		delete mProxies[i];
+
+	mPairCache->~btOverlappingPairCache();
+	btAlignedFree(mPairCache);
+}
+
+btBroadphaseProxy* UniformGridBroadphase::createProxy(
+	const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr,
+	short int collisionFilterGroup, short int collisionFilterMask, btDispatcher* dispatcher, void* multiSapProxy)
+{
+	(void)shapeType; (void)dispatcher; (void)multiSapProxy;
+
+	Proxy* proxy = new Proxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+	proxy->m_uniqueId = mNextUid++;
+	proxy->index = mProxies.size();
+	mProxies.push_back(proxy);
+
+	return proxy;
+}
+
+void UniformGridBroadphase::destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher)
+{
+	Proxy* p = static_cast<Proxy*>(proxy);
+	MCD_ASSERT(p->index < mProxies.size() && mProxies[p->index] == p);
+
+	mPairCache->removeOverlappingPairsContainingProxy(p, dispatcher);
+
+	// Swap with the last one for a constant time removal
+	mProxies[p->index] = mProxies.back();
+	mProxies[p->index]->index = p->index;
+	mProxies.pop_back();
+
+	delete p;
+}
+
+void UniformGridBroadphase::setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher)
+{
+	(void)dispatcher;
+	proxy->m_aabbMin = aabbMin;
+	proxy->m_aabbMax = aabbMax;
+}
+
+void UniformGridBroadphase::getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin = proxy->m_aabbMin;
+	aabbMax = proxy->m_aabbMax;
+}
+
+void UniformGridBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback,
+	const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	// Same as btSimpleBroadphase, the callback does the actual ray test
+	(void)rayFrom; (void)rayTo; (void)aabbMin; (void)aabbMax;
+	for(size_t i=0; i<mProxies.size(); ++i)
+		rayCallback.process(mProxies[i]);
+}
+
+void UniformGridBroadphase::cellRange(const btVector3& aabbMin, const btVector3& aabbMax, int min[3], int max[3]) const
+{
+	for(int i=0; i<3; ++i) {
+		min[i] = toCell(aabbMin[i], mInvCellSize);
+		max[i] = toCell(aabbMax[i], mInvCellSize);
+	}
+}
+
+uint64_t UniformGridBroadphase::cellKey(int x, int y, int z) const
+{
+	const uint64_t mask = (uint64_t(1) << cCellBits) - 1;
+	return
+		(uint64_t(x + cCellOffset) & mask) << (cCellBits * 2) |
+		(uint64_t(y + cCellOffset) & mask) << cCellBits |
+		(uint64_t(z + cCellOffset) & mask);
+}
+
+void UniformGridBroadphase::testPair(Proxy& p1, Proxy& p2, uint64_t cell)
+{
+	if(!aabbOverlap(p1, p2))
+		return;
+
+	// Only the cell containing the minimum corner of the intersection reports the pair
+	const btVector3 corner(
+		btMax(p1.m_aabbMin[0], p2.m_aabbMin[0]),
+		btMax(p1.m_aabbMin[1], p2.m_aabbMin[1]),
+		btMax(p1.m_aabbMin[2], p2.m_aabbMin[2])
+	);
+	if(cellKey(toCell(corner[0], mInvCellSize), toCell(corner[1], mInvCellSize), toCell(corner[2], mInvCellSize)) != cell)
+		return;
+
+	// NOTE: The pair cache does the collision filtering, and ignores existing pairs
+	mPairCache->addOverlappingPair(&p1, &p2);
+}
+
+void UniformGridBroadphase::calculateOverlappingPairs(btDispatcher* dispatcher)
+{
+	// Remove the separated pairs first, so the new pairs need not be checked again
+	RemoveSeparatedPair removeSeparatedPair;
+	mPairCache->processAllOverlappingPairs(&removeSeparatedPair, dispatcher);
+
+	// Register every proxy into the cells it overlaps
+	mCells.clear();
+	mLargeProxies.clear();
+	for(size_t i=0; i<mProxies.size(); ++i) {
+		Proxy* p = mProxies[i];
+		int min[3], max[3];
+		cellRange(p->m_aabbMin, p->m_aabbMax, min, max);
+
+		const uint64_t cellCount = uint64_t(max[0] - min[0] + 1) * (max[1] - min[1] + 1) * (max[2] - min[2] + 1);
+		p->isLarge = cellCount > mMaxCellsPerProxy;
+		if(p->isLarge) {
+			mLargeProxies.push_back(p);
+			continue;
+		}
+
+		CellEntry e;
+		e.proxy = p;
+		for(int x=min[0]; x<=max[0]; ++x) for(int y=min[1]; y<=max[1]; ++y) for(int z=min[2]; z<=max[2]; ++z) {
+			e.cell = cellKey(x, y, z);
+			mCells.push_back(e);
+		}
+	}
+
+	std::sort(mCells.begin(), mCells.end());
+
+	// Test the proxies sharing the same cell
+	for(size_t begin=0, end=0; begin<mCells.size(); begin=end) {
+		const uint64_t cell = mCells[begin].cell;
+		for(end=begin+1; end<mCells.size() && mCells[end].cell == cell; ++end) {}
+
+		for(size_t i=begin; i<end; ++i) for(size_t j=i+1; j<end; ++j)
+			testPair(*mCells[i].proxy, *mCells[j].proxy, cell);
+	}
+
+	// Large proxies are tested against everything else
+	for(size_t i=0; i<mLargeProxies.size(); ++i) {
+		Proxy* large = mLargeProxies[i];
+		for(size_t j=0; j<mProxies.size(); ++j) {
+			Proxy* p = mProxies[j];
+			if(!p->isLarge && aabbOverlap(*large, *p))
+				mPairCache->addOverlappingPair(large, p);
+		}
+		for(size_t j=i+1; j<mLargeProxies.size(); ++j) {
+			if(aabbOverlap(*large, *mLargeProxies[j]))
+				mPairCache->addOverlappingPair(large, mLargeProxies[j]);
+		}
+	}
+}
+
+btOverlappingPairCache* UniformGridBroadphase::getOverlappingPairCache()
+{
+	return mPairCache;
+}
+
+const btOverlappingPairCache* UniformGridBroadphase::getOverlappingPairCache() const
+{
+	return mPairCache;
+}
+
+void UniformGridBroadphase::getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const
+{
+	aabbMin.setValue(0, 0, 0);
+	aabbMax.setValue(0, 0, 0);
+
+	for(size_t i=0; i<mProxies.size(); ++i) {
+		if(i == 0) {
+			aabbMin = mProxies[i]->m_aabbMin;
+			aabbMax = mProxies[i]->m_aabbMax;
+		}
+		aabbMin.setMin(mProxies[i]->m_aabbMin);
+		aabbMax.setMax(mProxies[i]->m_aabbMax);
+	}
+}
+
+void UniformGridBroadphase::printStats()
+{
+	Log::format(Log::Info, "UniformGridBroadphase: %u proxies, %u large proxies, %u cell entries, %d pairs",
+		unsigned(mProxies.size()), unsigned(mLargeProxies.size()), unsigned(mCells.size()),
+		mPairCache->getNumOverlappingPairs());
+}
+
+}	// namespace MCD
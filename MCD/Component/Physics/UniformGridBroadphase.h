@@ -0,0 +1,99 @@
+#ifndef __MCD_COMPONENT_UNIFORMGRIDBROADPHASE__
+#define __MCD_COMPONENT_UNIFORMGRIDBROADPHASE__
+
+#include "../../Core/System/Platform.h"
+#include "../../../3Party/bullet/BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+#include <vector>
+
+class btOverlappingPairCache;
+
+namespace MCD {
+
+/*!	A broadphase which puts the proxies into the cells of an unbounded uniform grid.
+
+	The grid is rebuilt in every calculateOverlappingPairs(): each proxy is registered
+	to the cells it overlaps, the (cell, proxy) list is sorted by cell, and only the
+	proxies sharing a cell are tested against each other. A pair is reported by the
+	cell containing the minimum corner of the pair's intersection only, so no duplicated
+	test is made for proxies sharing multiple cells.
+
+	It works best when most bodies are of similar size and the cell size is around
+	the size of a typical body. Proxies spanning too many cells (a ground plane for
+	instance) are kept in a separated list and tested against every other proxy.
+
+	\note Used by DynamicsWorld, see DynamicsWorld::Config::UniformGrid.
+ */
+class UniformGridBroadphase : public btBroadphaseInterface
+{
+public:
+	/*!	\param cellSize The edge length of a grid cell.
+		\param maxCellsPerProxy Proxies overlapping more cells than this are treated as large proxy.
+	 */
+	explicit UniformGridBroadphase(btScalar cellSize, size_t maxCellsPerProxy=64);
+
+	sal_override ~UniformGridBroadphase();
+
+// Override from btBroadphaseInterface
+	sal_override btBroadphaseProxy* createProxy(
+		const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr,
+		short int collisionFilterGroup, short int collisionFilterMask, btDispatcher* dispatcher, void* multiSapProxy);
+
+	sal_override void destroyProxy(btBroadphaseProxy* proxy, btDispatcher* dispatcher);
+
+	sal_override void setAabb(btBroadphaseProxy* proxy, const btVector3& aabbMin, const btVector3& aabbMax, btDispatcher* dispatcher);
+
+	sal_override void getAabb(btBroadphaseProxy* proxy, btVector3& aabbMin, btVector3& aabbMax) const;
+
+	sal_override void rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback,
+		const btVector3& aabbMin=btVector3(0,0,0), const btVector3& aabbMax=btVector3(0,0,0));
+
+	sal_override void calculateOverlappingPairs(btDispatcher* dispatcher);
+
+	sal_override btOverlappingPairCache* getOverlappingPairCache();
+
+	sal_override const btOverlappingPairCache* getOverlappingPairCache() const;
+
+	sal_override void getBroadphaseAabb(btVector3& aabbMin, btVector3& aabbMax) const;
+
+	sal_override void printStats();
+
+// Attributes
+	btScalar cellSize() const { return mCellSize; }
+
+	size_t proxyCount() const { return mProxies.size(); }
+
+	//! Number of proxies tested against every other proxy in the last calculateOverlappingPairs().
+	size_t largeProxyCount() const { return mLargeProxies.size(); }
+
+protected:
+	struct Proxy;
+
+	//! A proxy registered into a cell, sorted by the cell key.
+	struct CellEntry
+	{
+		uint64_t cell;
+		Proxy* proxy;
+		bool operator<(const CellEntry& rhs) const { return cell < rhs.cell; }
+	};	// CellEntry
+
+	void cellRange(const btVector3& aabbMin, const btVector3& aabbMax, int min[3], int max[3]) const;
+
+	uint64_t cellKey(int x, int y, int z) const;
+
+	void testPair(Proxy& p1, Proxy& p2, uint64_t cell);
+
+	btScalar mCellSize, mInvCellSize;
+	size_t mMaxCellsPerProxy;
+	btOverlappingPairCache* mPairCache;
+	int mNextUid;
+
+	std::vector<Proxy*> mProxies;
+	// The following are rebuilt in each calculateOverlappingPairs(), they are member
+	// variables just to reuse the memory.
+	std::vector<CellEntry> mCells;
+	std::vector<Proxy*> mLargeProxies;
+};	// UniformGridBroadphase
+
+}	// namespace MCD
+
+#endif	// __MCD_COMPONENT_UNIFORMGRIDBROADPHASE__
@@ -7,7 +7,8 @@
 #include "../../../3Party/squirrel/squirrel.h"
 
 #define CAPI_VERIFY(arg) MCD_VERIFY(SQ_SUCCEEDED((arg)))
-#define CHECK_ARG(arg) if(!match(TypeSelect<P##arg>(), v, index+arg-1)) MCD_ASSERT(false);
+// The type check is for debug only, get() assumes the correct type in release
+#define CHECK_ARG(arg) MCD_ASSERT(match(TypeSelect<P##arg>(), v, index+arg-1));
 
 #ifdef MCD_VC
 #ifdef MCD_WIN32
@@ -764,6 +765,110 @@ public:
 	}
 };
 
+// Batch callers, the array elements are type checked one by one since they are not checked by the parameter check
+template<class Callee, class RT, class P1>
+SQInteger CallForEach(Callee& callee, RT (Callee::*func)(P1), HSQUIRRELVM v, int index) {
+	const SQInteger size = sq_getsize(v, index);
+	for(SQInteger i=0; i<size; ++i) {
+		sq_pushinteger(v, i);
+		CAPI_VERIFY(sq_rawget(v, index));
+		if(!match(TypeSelect<P1>(), v, -1))
+			return sq_throwerror(v, "Array element of incorrect type");
+		(callee.*func)(get(TypeSelect<P1>(), v, -1));
+		sq_poptop(v);
+	}
+	return 0;
+}
+
+template<class Callee, class RT, class P1>
+SQInteger CallForEach(Callee& callee, RT (Callee::*func)(P1) const, HSQUIRRELVM v, int index) {
+	const SQInteger size = sq_getsize(v, index);
+	for(SQInteger i=0; i<size; ++i) {
+		sq_pushinteger(v, i);
+		CAPI_VERIFY(sq_rawget(v, index));
+		if(!match(TypeSelect<P1>(), v, -1))
+			return sq_throwerror(v, "Array element of incorrect type");
+		(callee.*func)(get(TypeSelect<P1>(), v, -1));
+		sq_poptop(v);
+	}
+	return 0;
+}
+
+// Static function with the first parameter as the "this" pointer
+template<class Callee, class RT, class P0, class P1>
+SQInteger CallForEach(Callee& callee, RT (*func)(P0,P1), HSQUIRRELVM v, int index) {
+	const SQInteger size = sq_getsize(v, index);
+	for(SQInteger i=0; i<size; ++i) {
+		sq_pushinteger(v, i);
+		CAPI_VERIFY(sq_rawget(v, index));
+		if(!match(TypeSelect<P1>(), v, -1))
+			return sq_throwerror(v, "Array element of incorrect type");
+		func(callee, get(TypeSelect<P1>(), v, -1));
+		sq_poptop(v);
+	}
+	return 0;
+}
+
+template<class RT, class P1, class P2>
+SQInteger CallForEach(RT (*func)(P1,P2), HSQUIRRELVM v, int index) {
+	const SQInteger size = sq_getsize(v, index);
+	if(sq_getsize(v, index + 1) != size)
+		return sq_throwerror(v, "Expecting arrays of the same size");
+	for(SQInteger i=0; i<size; ++i) {
+		sq_pushinteger(v, i);
+		CAPI_VERIFY(sq_rawget(v, index));
+		sq_pushinteger(v, i);
+		CAPI_VERIFY(sq_rawget(v, index + 1));
+		if(!match(TypeSelect<P1>(), v, -2) || !match(TypeSelect<P2>(), v, -1))
+			return sq_throwerror(v, "Array element of incorrect type");
+		func(get(TypeSelect<P1>(), v, -2), get(TypeSelect<P2>(), v, -1));
+		sq_pop(v, 2);
+	}
+	return 0;
+}
+
+/// Array member function handler, the one parameter member function (or the static function with
+/// the first parameter as the "this" pointer) is called for each element of the array argument,
+/// in a single native call. Return values are discarded.
+template<class Callee, class Func>
+class ArrayCallMemberFunction
+{
+public:
+	static SQInteger Dispatch(HSQUIRRELVM v)
+	{
+		Callee* instance(nullptr);
+		if(SQ_FAILED(fromInstanceUp(v, 1, instance, instance, ClassTraits<Callee>::classID())))
+			return sq_throwerror(v, "Trying to invoke an member function without a correct this pointer");
+		if(!instance)
+			return sq_throwerror(v, "Try to call member funciton on null");
+		if(sq_gettype(v, 2) != OT_ARRAY)
+			return sq_throwerror(v, "Expecting an array");
+
+		Func func = getFunctionPointer<Func>(v, -1);
+		MCD_ASSUME(func);
+		return CallForEach(*instance, func, v, 2);
+	}
+};
+
+/// Array static function handler, the two parameters function is called for each pair of elements
+/// of the two array arguments, in a single native call. Return values are discarded.
+template<class Func>
+class ArrayCallStaticFunction
+{
+public:
+	static SQInteger Dispatch(HSQUIRRELVM v)
+	{
+		if(sq_gettype(v, 2) != OT_ARRAY || sq_gettype(v, 3) != OT_ARRAY)
+			return sq_throwerror(v, "Expecting two arrays");
+
+		void* p = nullptr;
+		CAPI_VERIFY(sq_getuserpointer(v, -1, &p));
+		Func func = Func(p);
+		MCD_ASSUME(func);
+		return CallForEach(func, v, 2);
+	}
+};
+
 }	// namespace Binding
 }	// namespace MCD
 
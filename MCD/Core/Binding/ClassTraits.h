@@ -9,8 +9,11 @@ namespace MCD {
 namespace Binding {
 
 class VMCore;
+class inlineValue;
 typedef void* ClassID;
 
+template<typename T> struct DefaultReturnPolicy;
+
 /// Common class traits
 template<typename T> struct ClassTraits;
 
@@ -53,6 +56,13 @@ inline void push(HSQUIRRELVM v, Class& p, Class*) { push(v, &p, &p); }	\
 template<typename T> void destroy(Class* p, T*) { destroy(p, p); }	\
 template<typename T> void push(HSQUIRRELVM v, T* p, Class**) { push(v, (Class*)p, (Class*)p); }
 
+/// Make a small value type returned by value using the inlineValue policy, instead of objOwn.
+/// Declare the class with ClassDeclarator::inlineStorage() to really have the memory inline.
+#define SCRIPT_CLASS_INLINE_VALUE(Class)		\
+template<> struct DefaultReturnPolicy<Class> {	\
+	typedef ::MCD::Binding::inlineValue policy;	\
+};
+
 #define SCRIPT_CLASS_REGISTER(Class)			\
 void ClassTraits<Class>::bind(VMCore* vm) {		\
 	RootDeclarator root(vm);					\
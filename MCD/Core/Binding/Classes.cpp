@@ -1,6 +1,7 @@
 #include "Pch.h"
 #include "Classes.h"
 #include "VMCore.h"
+#include "../System/Mutex.h"
 #include <map>
 
 #define CAPI_VERIFY(arg) MCD_VERIFY(SQ_SUCCEEDED((arg)))
@@ -19,16 +20,19 @@ struct TypeInfo {
 
 typedef std::map<TypeInfo, ClassID> TypeMap;
 static TypeMap gTypeMap;
+static Mutex gTypeMapMutex;	// Shared by all VMCore, which may run in different threads
 
 }	// namespace
 
 void ClassesManager::setClassIdForRtti(const std::type_info& typeInfo, ClassID classID)
 {
+	ScopeLock lock(gTypeMapMutex);
 	gTypeMap[typeInfo] = classID;
 }
 
 ClassID ClassesManager::getClassIdFromRtti(const std::type_info& typeInfo, ClassID fallback)
 {
+	ScopeLock lock(gTypeMapMutex);
 	const TypeMap::const_iterator i = gTypeMap.find(typeInfo);
 	if(i != gTypeMap.end())
 		return i->second;
@@ -62,6 +66,17 @@ ScriptObject ClassesManager::findClass(HSQUIRRELVM v, ClassID classId)
 	return result;
 }
 
+void ClassesManager::cacheClass(HSQUIRRELVM v, ClassID classId, HSQOBJECT& classObj)
+{
+	VMCore* vm = reinterpret_cast<VMCore*>(sq_getforeignptr(v));
+	std::pair<VMCore::ClassCache::iterator, bool> i = vm->mClassCache.insert(std::make_pair(classId, classObj));
+	if(!i.second) {
+		sq_release(v, &i.first->second);
+		i.first->second = classObj;
+	}
+	sq_addref(v, &i.first->second);
+}
+
 void ClassesManager::createObjectInstanceOnStack(HSQUIRRELVM v, ClassID classId, const void* objPtr)
 {
 	// Simply push null if the object's pointer is null
@@ -70,22 +85,38 @@ void ClassesManager::createObjectInstanceOnStack(HSQUIRRELVM v, ClassID classId,
 		return;
 	}
 
-	const SQInteger oldTop = sq_gettop(v);
-	ScriptObject classObj = findClass(v, classId);
-	sq_pushobject(v, classObj.handle());
+	(void)createInstanceOnStack(v, classId);
+	/// stack: instance
+
+	// Associate the instance object with the C++ pointer
+	CAPI_VERIFY(sq_setinstanceup(v, -1, const_cast<void*>(objPtr)));
+}
+
+SQUserPointer ClassesManager::createInstanceOnStack(HSQUIRRELVM v, ClassID classId)
+{
+	// Look up the class handle cached by createClass(), instead of the class table, since
+	// this is done for every object returned to the script
+	VMCore* vm = reinterpret_cast<VMCore*>(sq_getforeignptr(v));
+	VMCore::ClassCache::const_iterator i = vm->mClassCache.find(classId);
+	if(i != vm->mClassCache.end())
+		sq_pushobject(v, i->second);
+	else {
+		// Not created by createClass(), fall back to the class table and cache it for the next time
+		ScriptObject classObj = findClass(v, classId);
+		cacheClass(v, classId, classObj.handle());
+		sq_pushobject(v, classObj.handle());
+	}
 	/// stack: class
 
 	CAPI_VERIFY(sq_createinstance(v, -1));
 	/// stack: class, instance
 
-	ScriptObject intance(v);
-	MCD_VERIFY(intance.getFromStack(-1));
+	sq_remove(v, -2);
+	/// stack: instance
 
-	// Associate the instance object with the C++ pointer
-	CAPI_VERIFY(sq_setinstanceup(v, -1, const_cast<void*>(objPtr)));
-
-	sq_settop(v, oldTop);
-	sq_pushobject(v, intance.handle());
+	SQUserPointer storage = nullptr;
+	CAPI_VERIFY(sq_getinstanceup(v, -1, &storage, 0));
+	return storage;
 }
 
 ScriptObject ClassesManager::createClass(HSQUIRRELVM v, ScriptObject& ns, ClassID classId, const char* className, ClassID parentClass)
@@ -125,6 +156,8 @@ ScriptObject ClassesManager::createClass(HSQUIRRELVM v, ScriptObject& ns, ClassI
 	CAPI_VERIFY(sq_newslot(v, -3, false));
 	sq_poptop(v);
 
+	cacheClass(v, classId, newClass.handle());
+
 	MCD_ASSERT(oldTop == sq_gettop(v));
 
 	return newClass;
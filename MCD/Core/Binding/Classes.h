@@ -19,6 +19,10 @@ public:
 	/// Creates a Squirrel object instance of type classId, and left it on the top of the stack.
 	static void createObjectInstanceOnStack(HSQUIRRELVM v, ClassID classId, const void* objPtr);
 
+	/// Creates a Squirrel object instance of type classId without any C++ object associated, and left it
+	/// on the top of the stack. Returns the instance's inline storage, null if the class has none.
+	static SQUserPointer createInstanceOnStack(HSQUIRRELVM v, ClassID classId);
+
 	/// Register the type name to return when invoking the Squirrel meta function _typeof().
 	static void registerTypeOf(HSQUIRRELVM v, ScriptObject& classObj, const char* typeName);
 
@@ -41,6 +45,9 @@ public:
 private:
 	/// Returns the class table by a given ClassID.
 	static ScriptObject findClass(HSQUIRRELVM v, ClassID classType);
+
+	/// Cache the class for createInstanceOnStack(), the cache holds a reference released by VMCore when it closes.
+	static void cacheClass(HSQUIRRELVM v, ClassID classType, HSQOBJECT& classObj);
 };	// ClassesManager
 
 // Member functions
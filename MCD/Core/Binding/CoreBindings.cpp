@@ -67,21 +67,21 @@ SCRIPT_CLASS_REGISTER_NAME(Timer)
 static SQInteger create_Mat44(HSQUIRRELVM vm)
 {
 	const SQInteger paramCount = sq_gettop(vm) - 1;
-	Mat44f* m = nullptr;
+	Mat44f m;
 
 	switch(paramCount) {
 	case 0:
-		m = new Mat44f(Mat44f::cIdentity);	// Default construct
+		m = Mat44f(Mat44f::cIdentity);	// Default construct
 		break;
 	case 1:
 		if(sq_gettype(vm, 2) == OT_INSTANCE)
-			m = new Mat44f(get(TypeSelect<Mat44f&>(), vm, 2));	// Copy construct
+			m = Mat44f(get(TypeSelect<Mat44f&>(), vm, 2));	// Copy construct
 		else
-			m = new Mat44f(get(TypeSelect<float>(), vm, 2));	// Scalar construct
+			m = Mat44f(get(TypeSelect<float>(), vm, 2));	// Scalar construct
 		break;
-	case 3:
+	case 16:
 			#define GET(i) (get(TypeSelect<float>(), vm, i))
-			m = new Mat44f(	// Element wise construct
+			m = Mat44f(	// Element wise construct
 				GET( 2), GET( 3), GET( 4), GET( 5),
 				GET( 6), GET( 7), GET( 8), GET( 9),
 				GET(10), GET(11), GET(12), GET(13),
@@ -95,7 +95,7 @@ static SQInteger create_Mat44(HSQUIRRELVM vm)
 
 	// Pops the input params
 	sq_pop(vm, paramCount);
-	construct::pushResult(vm, m);
+	inlineValue::constructAt(vm, 1, m);
 	return 1;
 }
 
@@ -109,6 +109,7 @@ static bool isIdentity_Mat44(const Mat44f& m) { return m == Mat44f::cIdentity; }
 
 SCRIPT_CLASS_REGISTER(Mat44f)
 	.declareClass<Mat44f>("Mat44")
+	.inlineStorage()
 	.rawMethod("constructor", create_Mat44)
 	.var("m00", (float Mat44f::*)&Mat44f::m00)	.var("m01", (float Mat44f::*)&Mat44f::m01)	.var("m02", (float Mat44f::*)&Mat44f::m02)	.var("m03", (float Mat44f::*)&Mat44f::m03)
 	.var("m10", (float Mat44f::*)&Mat44f::m10)	.var("m11", (float Mat44f::*)&Mat44f::m11)	.var("m12", (float Mat44f::*)&Mat44f::m12)	.var("m13", (float Mat44f::*)&Mat44f::m13)
@@ -129,6 +130,8 @@ SCRIPT_CLASS_REGISTER(Mat44f)
 	.method("scaleBy", &Mat44f::scaleBy)
 	.method("setRotation", &Mat44f::setRotation)
 	.method("rotateBy", &Mat44f::rotateBy)
+	.arrayMethod("transformPoints", &Mat44f::transformPoint)	// Transform an array of Vec3 in place
+	.arrayMethod("transformNormals", &Mat44f::transformNormal)
 	.staticMethod("makeAxisRotation", &Mat44f::makeAxisRotation)
 	.method("_add", &add_Mat44)
 	.method("_sub", &sub_Mat44)
@@ -142,21 +145,21 @@ SCRIPT_CLASS_REGISTER(Mat44f)
 static SQInteger create_Vec2(HSQUIRRELVM vm)
 {
 	const SQInteger paramCount = sq_gettop(vm) - 1;
-	Vec2f* v = nullptr;
+	Vec2f v;
 
 	switch(paramCount) {
 	case 0:
-		v = new Vec2f(Vec2f::cZero);	// Default construct
+		v = Vec2f(Vec2f::cZero);	// Default construct
 		break;
 	case 1:
 		if(sq_gettype(vm, 2) == OT_INSTANCE)
-			v = new Vec2f(get(TypeSelect<Vec2f&>(), vm, 2));	// Copy construct
+			v = Vec2f(get(TypeSelect<Vec2f&>(), vm, 2));	// Copy construct
 		else
-			v = new Vec2f(get(TypeSelect<float>(), vm, 2));	// Scalar construct
+			v = Vec2f(get(TypeSelect<float>(), vm, 2));	// Scalar construct
 		break;
 	case 2:
 			#define GET(i) (get(TypeSelect<float>(), vm, i))
-			v = new Vec2f(GET(2), GET(3));	// Element wise construct
+			v = Vec2f(GET(2), GET(3));	// Element wise construct
 			#undef GET
 		break;
 	default:
@@ -165,12 +168,13 @@ static SQInteger create_Vec2(HSQUIRRELVM vm)
 
 	// Pops the input params
 	sq_pop(vm, paramCount);
-	construct::pushResult(vm, v);
+	inlineValue::constructAt(vm, 1, v);
 	return 1;
 }
 
 SCRIPT_CLASS_REGISTER(Vec2f)
 	.declareClass<Vec2f>("Vec2")
+	.inlineStorage()
 	.rawMethod("constructor", create_Vec2)
 	.var("x", (float Vec2f::*)&Vec2f::x)
 	.var("y", (float Vec2f::*)&Vec2f::y)
@@ -180,21 +184,21 @@ SCRIPT_CLASS_REGISTER(Vec2f)
 static SQInteger create_Vec3(HSQUIRRELVM vm)
 {
 	const SQInteger paramCount = sq_gettop(vm) - 1;
-	Vec3f* v = nullptr;
+	Vec3f v;
 
 	switch(paramCount) {
 	case 0:
-		v = new Vec3f(Vec3f::cZero);	// Default construct
+		v = Vec3f(Vec3f::cZero);	// Default construct
 		break;
 	case 1:
 		if(sq_gettype(vm, 2) == OT_INSTANCE)
-			v = new Vec3f(get(TypeSelect<Vec3f&>(), vm, 2));	// Copy construct
+			v = Vec3f(get(TypeSelect<Vec3f&>(), vm, 2));	// Copy construct
 		else
-			v = new Vec3f(get(TypeSelect<float>(), vm, 2));	// Scalar construct
+			v = Vec3f(get(TypeSelect<float>(), vm, 2));	// Scalar construct
 		break;
 	case 3:
 			#define GET(i) (get(TypeSelect<float>(), vm, i))
-			v = new Vec3f(GET(2), GET(3), GET(4));	// Element wise construct
+			v = Vec3f(GET(2), GET(3), GET(4));	// Element wise construct
 			#undef GET
 		break;
 	default:
@@ -203,7 +207,7 @@ static SQInteger create_Vec3(HSQUIRRELVM vm)
 
 	// Pops the input params
 	sq_pop(vm, paramCount);
-	construct::pushResult(vm, v);
+	inlineValue::constructAt(vm, 1, v);
 	return 1;
 }
 
@@ -219,6 +223,7 @@ static void mulEqual_Vec3(Vec3f& lhs, float rhs) { lhs *= rhs; }
 
 SCRIPT_CLASS_REGISTER(Vec3f)
 	.declareClass<Vec3f>("Vec3")
+	.inlineStorage()
 	.rawMethod("constructor", create_Vec3)
 	.var("x", (float Vec3f::*)&Vec3f::x)
 	.var("y", (float Vec3f::*)&Vec3f::y)
@@ -250,6 +255,10 @@ static Component* nextComponent_Entity(Entity& self, Component* c) {
 	return c == self.components.end() ? nullptr : c;
 }
 
+static void setLocalTransform_Entity(Entity& self, const Mat44f& transform) {
+	self.localTransform = transform;
+}
+
 SCRIPT_CLASS_REGISTER_NAME(Entity)
 	.constructor("defaultConstructor")
 	.runScript("Entity.constructor<-function(name=\"\"){defaultConstructor.call(this);this.name=name;}")
@@ -260,6 +269,7 @@ SCRIPT_CLASS_REGISTER_NAME(Entity)
 	.varGet("lastChild", (Entity* (Entity::*)())(&Entity::lastChild))
 	.varGet("nextSibling", (Entity* (Entity::*)())(&Entity::nextSibling))
 	.var("localTransform", &Entity::localTransform)
+	.staticArrayMethod("setLocalTransforms", &setLocalTransform_Entity)	// Entity.setLocalTransforms(entities, transforms)
 	.varGet("worldTransform", &Entity::worldTransform)
 	.varSet("worldTransform", &Entity::setWorldTransform)
 	.method("asChildOf", (void (Entity::*)(Entity*))(&Entity::asChildOf))
@@ -419,7 +429,7 @@ SQInteger sleep_ScriptComponent(HSQUIRRELVM vm)
 		float t = 0;
 		if(SQ_SUCCEEDED(sq_getfloat(vm, 2, &t))) {
 			ScriptComponent* self = get(TypeSelect<ScriptComponent*>(), vm, 1);
-			core->scheduleWakeup(vm, core->currentTime() + t, self);
+			self->mWakeup = core->scheduleWakeup(vm, core->currentTime() + t, self);
 			return sq_suspendvm(vm);
 		}
 	}
@@ -427,6 +437,38 @@ SQInteger sleep_ScriptComponent(HSQUIRRELVM vm)
 	return sq_throwerror(vm, "ScriptComponent.sleep() expecting a float parameter");
 }
 
+// waitFor(event, [timeOut]), suspends until ScriptComponent.signal(event) or the time out
+SQInteger waitFor_ScriptComponent(HSQUIRRELVM vm)
+{
+	VMCore* core = reinterpret_cast<VMCore*>(sq_getforeignptr(vm));
+	MCD_ASSUME(core);
+	const SQInteger paramCount = sq_gettop(vm) - 1;
+	const SQChar* event = nullptr;
+	float t = -1;
+
+	if(paramCount < 1 || SQ_FAILED(sq_getstring(vm, 2, &event)) ||
+		(paramCount >= 2 && SQ_FAILED(sq_getfloat(vm, 3, &t))))
+		return sq_throwerror(vm, "ScriptComponent.waitFor() expecting a string and an optional float parameter");
+
+	ScriptComponent* self = get(TypeSelect<ScriptComponent*>(), vm, 1);
+	self->mWaitEvent = event;
+	self->mWakeup = core->scheduleWakeup(vm, t < 0 ? -1 : core->currentTime() + t, self, self->mWaitEvent.c_str());
+	return sq_suspendvm(vm);
+}
+
+// signal(event), returns the number of scripts waiting for the event
+SQInteger signal_ScriptComponent(HSQUIRRELVM vm)
+{
+	VMCore* core = reinterpret_cast<VMCore*>(sq_getforeignptr(vm));
+	MCD_ASSUME(core);
+	const SQChar* event = nullptr;
+	if(SQ_FAILED(sq_getstring(vm, 2, &event)))
+		return sq_throwerror(vm, "ScriptComponent.signal() expecting a string parameter");
+
+	sq_pushinteger(vm, SQInteger(core->signalWakeup(FixString(event).c_str())));
+	return 1;
+}
+
 SCRIPT_CLASS_DECLAR_EXPORT(ScriptComponent, MCD_CORE_API);	// TODO: Don't why this is needed!
 SCRIPT_CLASS_REGISTER(ScriptComponent)
 	.declareClass<ScriptComponent, Component>("ScriptComponent")
@@ -434,6 +476,8 @@ SCRIPT_CLASS_REGISTER(ScriptComponent)
 	.rawMethod("suspend", &suspend_ScriptComponent)
 	.rawMethod("wakeup", &wakeup_ScriptComponent)
 	.rawMethod("sleep", &sleep_ScriptComponent)
+	.rawMethod("waitFor", &waitFor_ScriptComponent)
+	.rawMethod("signal", &signal_ScriptComponent)
 ;}
 
 // Input
@@ -35,6 +35,9 @@ SCRIPT_CLASS_DECLAR_EXPORT(Timer, MCD_CORE_API);
 SCRIPT_CLASS_DECLAR_EXPORT(Mat44f, MCD_CORE_API);
 SCRIPT_CLASS_DECLAR_EXPORT(Vec2f, MCD_CORE_API);
 SCRIPT_CLASS_DECLAR_EXPORT(Vec3f, MCD_CORE_API);
+SCRIPT_CLASS_INLINE_VALUE(Mat44f);
+SCRIPT_CLASS_INLINE_VALUE(Vec2f);
+SCRIPT_CLASS_INLINE_VALUE(Vec3f);
 
 // Entity
 SCRIPT_CLASS_DECLAR_EXPORT(Entity, MCD_CORE_API);
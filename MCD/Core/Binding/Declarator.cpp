@@ -100,6 +100,13 @@ void ClassDeclaratorBase::runScript(const char* script)
 	MCD_VERIFY(VMCore::runScript(_vm, script));
 }
 
+void ClassDeclaratorBase::setInlineStorage(size_t size)
+{
+	sq_pushobject(_vm, _hostObject.handle());
+	CAPI_VERIFY(sq_setclassudsize(_vm, -1, SQInteger(size)));
+	sq_poptop(_vm);
+}
+
 GlobalDeclarator::GlobalDeclarator(const ScriptObject& hostObject, HSQUIRRELVM vm)
 	: Declarator(hostObject, vm)
 {
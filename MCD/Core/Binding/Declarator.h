@@ -44,6 +44,8 @@ protected:
 
 	void runScript(const char* script);
 
+	void setInlineStorage(size_t size);
+
 protected:
 	// Specialized pushFunction() to minimize code size
 	void pushVarGetSetFunction(const char* name, void* varPtr, size_t sizeofVar, SQFUNCTION dispatchGetFunc, SQFUNCTION dispatchSetFunc);
@@ -140,6 +142,35 @@ public:
 		return staticMethod<typename DefaultReturnPolicy<typename FuncTraits<Func>::RET>::policy>(name, func);
 	}
 
+// Batch call
+	/// The member function of one parameter (or a static function taking the object as the first parameter)
+	/// is called with an array of the parameter from script, once for each element,
+	/// e.g. mat.transformPoints([v1, v2, v3]) with Mat44f::transformPoint.
+	template<typename Func>
+	ClassDeclarator& arrayMethod(const char* name, Func func)
+	{
+		pushFunction(name, &func, sizeof(func), 1, &ArrayCallMemberFunction<Class, Func>::Dispatch);
+		return *this;
+	}
+
+	/// The static function of two parameters is called with two arrays of the same size from script,
+	/// once for each pair of elements, e.g. Entity.setLocalTransforms(entities, transforms).
+	template<typename Func>
+	ClassDeclarator& staticArrayMethod(const char* name, Func func)
+	{
+		pushFunction(name, (void*)func, 0, 2, &ArrayCallStaticFunction<Func>::Dispatch);
+		return *this;
+	}
+
+// Value type
+	/// Reserve memory for a T inside each script instance, used by the inlineValue return policy
+	/// and constructor such that a small value type needs no separated heap allocation.
+	ClassDeclarator& inlineStorage()
+	{
+		setInlineStorage(sizeof(T));
+		return rawMethod("_cloned", &inlineValue::cloned<T>);
+	}
+
 // Script event:
 	template<typename Event>
 	ClassDeclarator& scriptEvent(const char* name, Event event)
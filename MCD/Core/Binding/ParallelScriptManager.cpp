@@ -0,0 +1,235 @@
+#include "Pch.h"
+#include "ParallelScriptManager.h"
+#include "CoreBindings.h"
+#include "ScriptComponent.h"
+#include "VMCore.h"
+
+#define CAPI_VERIFY(arg) MCD_VERIFY(SQ_SUCCEEDED((arg)))
+
+namespace MCD {
+namespace Binding {
+
+/// Runs one VM, the last thing it does is telling the group it's done.
+class ParallelScriptManager::VMTask : public TaskPool::Task
+{
+public:
+	VMTask() : TaskPool::Task(0), owner(nullptr), vmIndex(0), dt(0) {}
+
+	sal_override void run(Thread&) { process(); }
+
+	void process()
+	{
+		owner->process(vmIndex, dt);
+		owner->mGroup.done();
+	}
+
+	ParallelScriptManager* owner;
+	size_t vmIndex;
+	float dt;
+};	// VMTask
+
+struct ParallelScriptManager::VM
+{
+	explicit VM(Entity& root) : manager(&core), partition(&root) {}
+
+	VMCore core;
+	ScriptManagerComponent manager;
+	EntityPtr partition;
+	std::vector<Message> inbox;		///< Merged by the owner, read by the VM's task only
+	std::vector<Message> outbox;	///< Written by the VM's task only, merged by the owner
+	ParallelScriptManager* owner;
+	size_t index;
+	VMTask task;
+};	// VM
+
+// postMessage(toVm, name, value), toVm is -1 for the host
+SQInteger postMessage_ParallelScriptManager(HSQUIRRELVM v)
+{
+	// The free variable is pushed after the arguments
+	SQUserPointer p = nullptr;
+	const SQInteger top = sq_gettop(v);
+	if(top != 5 || SQ_FAILED(sq_getuserpointer(v, top, &p)) || !p)
+		return sq_throwerror(v, "postMessage() expecting a vm index, a string and a value");
+
+	ParallelScriptManager::VM& vm = *reinterpret_cast<ParallelScriptManager::VM*>(p);
+	ParallelScriptManager::Message m;
+	m.from = vm.index;
+	m.integer = 0;
+	m.number = 0;
+
+	SQInteger to;
+	const SQChar* name;
+	if(SQ_FAILED(sq_getinteger(v, 2, &to)) || SQ_FAILED(sq_getstring(v, 3, &name)))
+		return sq_throwerror(v, "postMessage() expecting a vm index, a string and a value");
+	if(to < -1 || to >= SQInteger(vm.owner->vmCount()))
+		return sq_throwerror(v, "postMessage() invalid vm index");
+	m.to = to < 0 ? ParallelScriptManager::cHost : size_t(to);
+	m.name = name;
+
+	// Only primitive values can cross the VMs
+	m.type = sq_gettype(v, 4);
+	switch(m.type) {
+	case OT_NULL:
+		break;
+	case OT_BOOL: {
+		SQBool b;
+		sq_getbool(v, 4, &b);
+		m.integer = b ? 1 : 0;
+	}	break;
+	case OT_INTEGER:
+		sq_getinteger(v, 4, &m.integer);
+		break;
+	case OT_FLOAT:
+		sq_getfloat(v, 4, &m.number);
+		break;
+	case OT_STRING: {
+		const SQChar* s;
+		sq_getstring(v, 4, &s);
+		m.string = s;
+	}	break;
+	default:
+		return sq_throwerror(v, "postMessage() only accepts null, bool, integer, float or string value");
+	}
+
+	vm.outbox.push_back(m);
+	return 0;
+}
+
+ParallelScriptManager::ParallelScriptManager(TaskPool* taskPool)
+	: mTaskPool(taskPool)
+{
+}
+
+ParallelScriptManager::~ParallelScriptManager()
+{
+	for(size_t i=0; i<mVMs.size(); ++i)
+		delete mVMs[i];
+}
+
+size_t ParallelScriptManager::addVM(Entity& partition, void (*registerBinding)(VMCore&))
+{
+	VM* vm = new VM(partition);
+	vm->owner = this;
+	vm->index = mVMs.size();
+	vm->task.owner = this;
+	vm->task.vmIndex = vm->index;
+	mVMs.push_back(vm);
+	mTasks.push_back(&vm->task);
+
+	if(registerBinding)
+		registerBinding(vm->core);
+
+	HSQUIRRELVM v = vm->core.getVM();
+	sq_pushroottable(v);
+
+	sq_pushstring(v, "postMessage", -1);
+	sq_pushuserpointer(v, vm);
+	sq_newclosure(v, &postMessage_ParallelScriptManager, 1);
+	CAPI_VERIFY(sq_newslot(v, -3, false));
+
+	sq_pushstring(v, "vmIndex", -1);
+	sq_pushinteger(v, SQInteger(vm->index));
+	CAPI_VERIFY(sq_newslot(v, -3, false));
+
+	sq_pushstring(v, "partition", -1);
+	push(v, &partition, &partition);
+	CAPI_VERIFY(sq_newslot(v, -3, false));
+
+	sq_pop(v, 1);
+
+	return vm->index;
+}
+
+bool ParallelScriptManager::runScript(size_t vmIndex, const char* script)
+{
+	return vm(vmIndex).runScript(script);
+}
+
+void ParallelScriptManager::update(float dt)
+{
+	const size_t count = mVMs.size();
+	mGroup.reset(count);
+	for(size_t i=0; i<count; ++i)
+		mVMs[i]->task.dt = dt;
+
+	if(count > 0)
+		forkJoin(mTaskPool, &mTasks[0], count, mGroup);
+
+	// Merge the outboxes in the order of the source VM and then the posting order,
+	// such that the result doesn't depend on which VM finished first
+	mHostMessages.clear();
+	for(size_t i=0; i<count; ++i) {
+		std::vector<Message>& outbox = mVMs[i]->outbox;
+		for(size_t j=0; j<outbox.size(); ++j) {
+			const Message& m = outbox[j];
+			if(m.to == cHost)
+				mHostMessages.push_back(m);
+			else
+				mVMs[m.to]->inbox.push_back(m);
+		}
+		outbox.clear();
+	}
+}
+
+VMCore& ParallelScriptManager::vm(size_t vmIndex)
+{
+	MCD_ASSERT(vmIndex < mVMs.size());
+	return mVMs[vmIndex]->core;
+}
+
+ScriptManagerComponent& ParallelScriptManager::manager(size_t vmIndex)
+{
+	MCD_ASSERT(vmIndex < mVMs.size());
+	return mVMs[vmIndex]->manager;
+}
+
+Entity* ParallelScriptManager::partition(size_t vmIndex)
+{
+	MCD_ASSERT(vmIndex < mVMs.size());
+	return mVMs[vmIndex]->partition.get();
+}
+
+void ParallelScriptManager::process(size_t vmIndex, float dt)
+{
+	VM& vm = *mVMs[vmIndex];
+
+	for(size_t i=0; i<vm.inbox.size(); ++i)
+		deliver(vmIndex, vm.inbox[i]);
+	vm.inbox.clear();
+
+	// Nothing to update if the partition is gone
+	if(Entity* partition = vm.partition.get()) {
+		vm.manager.updateScripts(dt, partition);
+		(void)vm.manager.wakeup();
+	}
+}
+
+void ParallelScriptManager::deliver(size_t vmIndex, const Message& m)
+{
+	HSQUIRRELVM v = mVMs[vmIndex]->core.getVM();
+	const SQInteger oldTop = sq_gettop(v);
+
+	sq_pushroottable(v);
+	sq_pushstring(v, "onMessage", -1);
+	if(SQ_SUCCEEDED(sq_get(v, -2))) {
+		sq_pushroottable(v);
+		sq_pushstring(v, m.name.c_str(), SQInteger(m.name.size()));
+		switch(m.type) {
+		case OT_BOOL: sq_pushbool(v, m.integer != 0); break;
+		case OT_INTEGER: sq_pushinteger(v, m.integer); break;
+		case OT_FLOAT: sq_pushfloat(v, m.number); break;
+		case OT_STRING: sq_pushstring(v, m.string.c_str(), SQInteger(m.string.size())); break;
+		default: sq_pushnull(v); break;
+		}
+		sq_pushinteger(v, SQInteger(m.from));
+		/// stack: root, onMessage(), root, name, value, fromVm
+
+		if(SQ_FAILED(sq_call(v, 4, false, true)))
+			VMCore::printError(v);
+	}
+
+	sq_settop(v, oldTop);
+}
+
+}	// namespace Binding
+}	// namespace MCD
@@ -0,0 +1,117 @@
+#ifndef __MCD_CORE_BINDING_PARALLELSCRIPTMANAGER__
+#define __MCD_CORE_BINDING_PARALLELSCRIPTMANAGER__
+
+#include "../Entity/Entity.h"
+#include "../System/NonCopyable.h"
+#include "../System/TaskPool.h"
+#include "../../../3Party/squirrel/squirrel.h"
+#include <string>
+#include <vector>
+
+namespace MCD {
+namespace Binding {
+
+class ScriptManagerComponent;
+class VMCore;
+
+/// Runs several isolated VMCore in parallel, each owning a partition of the scripted Entity.
+///
+/// A partition is an Entity sub-tree, where the VM creates its ScriptComponent and nobody else touches
+/// during update(). Each VM has its own bindings, classes table and ScriptComponent registry, and its
+/// ScriptManagerComponent updates and wakes up the scripts of its partition as a TaskPool::Task.
+///
+/// The VMs don't share any script object, instead they communicate by messages of a primitive value
+/// (null, bool, integer, float or string):
+///	 -	postMessage(toVm, name, value) in script puts the message into the VM's own outbox.
+///	 -	At the end of update(), the outboxes are merged in the order of the source VM index and then the
+///		posting order, so the result is the same no matter how the threads were scheduled.
+///	 -	The merged messages are delivered at the beginning of the next update(), by calling the root
+///		table function onMessage(name, value, fromVm) of the target VM, in its own task.
+///	 -	Messages to cHost are for the writes outside any partition, the host applies them from
+///		hostMessages() after update(), in the same deterministic order.
+///
+/// Example:
+/// \code
+/// TaskPool taskPool;
+/// taskPool.setThreadCount(3);
+/// ParallelScriptManager manager(&taskPool);
+/// for(size_t i=0; i<4; ++i) {
+///		Entity* partition = root.addLastChild(new Entity("partition"));
+///		manager.addVM(*partition, &registerCoreBinding);	// Script can access "partition" and "vmIndex"
+///		manager.runScript(i, script);
+/// }
+///
+/// // Each frame
+/// manager.update(dt);
+/// for(size_t i=0; i<manager.hostMessages().size(); ++i)
+///		apply(manager.hostMessages()[i]);
+/// \endcode
+class MCD_CORE_API ParallelScriptManager : Noncopyable
+{
+public:
+	/// Runs the VMs on the task pool, or one after another in the calling thread if it's null.
+	explicit ParallelScriptManager(sal_maybenull TaskPool* taskPool);
+
+	~ParallelScriptManager();
+
+	/// Target of the messages which should be handled by the host.
+	static const size_t cHost = size_t(-1);
+
+	struct Message
+	{
+		size_t from, to;
+		std::string name;
+		SQObjectType type;		///< OT_NULL, OT_BOOL, OT_INTEGER, OT_FLOAT or OT_STRING
+		SQInteger integer;		///< Also for bool
+		SQFloat number;
+		std::string string;
+	};	// Message
+
+// Operations
+	/// Create a new VM owning the partition, the bindings are registered into it by registerBinding,
+	/// as well as the postMessage() function, and the "partition" and "vmIndex" variables.
+	/// Returns the index of the VM.
+	size_t addVM(Entity& partition, void (*registerBinding)(VMCore&));
+
+	/// Run the script in the VM, it should only create Entity and ScriptComponent under its partition.
+	sal_checkreturn bool runScript(size_t vmIndex, sal_in_z const char* script);
+
+	/// Deliver the messages posted in the last update(), and invoke ScriptManagerComponent::updateScripts()
+	/// and wakeup() of each VM, all VMs in parallel. Returns after all of them finished and the newly
+	/// posted messages are merged.
+	void update(float dt);
+
+// Attributes
+	size_t vmCount() const { return mVMs.size(); }
+
+	VMCore& vm(size_t vmIndex);
+
+	ScriptManagerComponent& manager(size_t vmIndex);
+
+	sal_maybenull Entity* partition(size_t vmIndex);
+
+	/// The messages to cHost, posted during the last update().
+	const std::vector<Message>& hostMessages() const { return mHostMessages; }
+
+protected:
+	friend SQInteger postMessage_ParallelScriptManager(HSQUIRRELVM v);
+
+	class VMTask;
+
+	/// Deliver the messages in inbox, then run the scripts, called in the VM's own task.
+	void process(size_t vmIndex, float dt);
+
+	void deliver(size_t vmIndex, const Message& message);
+
+	struct VM;
+	std::vector<VM*> mVMs;
+	std::vector<TaskPool::Task*> mTasks;	///< The task of each VM
+	std::vector<Message> mHostMessages;
+	TaskPool* mTaskPool;
+	TaskGroup mGroup;
+};	// ParallelScriptManager
+
+}	// namespace Binding
+}	// namespace MCD
+
+#endif	// __MCD_CORE_BINDING_PARALLELSCRIPTMANAGER__
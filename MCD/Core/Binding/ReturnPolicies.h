@@ -5,6 +5,7 @@
 
 #include "Types.h"
 #include "../../../3Party/squirrel/squirrel.h"
+#include <new>
 
 namespace MCD {
 namespace Binding {
@@ -107,6 +108,75 @@ private:
 	}
 };
 
+/// Creates new instance, with the value copied into the instance's own memory instead of a separated heap object.
+/// For the small value types that are returned by value a lot, like Vec3f and Mat44f. The class should
+/// be declared with ClassDeclarator::inlineStorage(), otherwise (or for a script sub-class) it falls
+/// back to a heap object owned by the instance, just like objOwn.
+/// Use SCRIPT_CLASS_INLINE_VALUE to make it the default policy of the type.
+class inlineValue
+{
+public:
+	template<typename RT>
+	static SQInteger pushResult(HSQUIRRELVM v, RT result)
+	{
+		typedef typename pointer<RT>::HostType HostType;
+		SQUserPointer storage = ClassesManager::createInstanceOnStack(v, ClassTraits<HostType>::classID());
+		placeValue<HostType>(v, -1, storage, result);
+		return 1;
+	}
+
+	/// Copy construct the value into the instance at idx, for the instance created by the script constructor.
+	template<typename T>
+	static void constructAt(HSQUIRRELVM v, SQInteger idx, const T& value)
+	{
+		SQUserPointer storage = nullptr;
+		if(sq_getsize(v, idx) >= SQInteger(sizeof(T)))
+			sq_getinstanceup(v, idx, &storage, 0);
+		placeValue(v, idx, storage, value);
+	}
+
+	/// The _cloned() meta method for the class of inline storage, which otherwise has an un-initialized copy.
+	template<typename T>
+	static SQInteger cloned(HSQUIRRELVM v)
+	{
+		/// stack: clone, original
+		SQUserPointer p = nullptr;
+		if(SQ_FAILED(sq_getinstanceup(v, 2, &p, 0)) || !p)
+			return sq_throwerror(v, "Cloning an un-initialized object");
+		constructAt(v, 1, *static_cast<T*>(p));
+		return 0;
+	}
+
+private:
+	template<typename T>
+	static void placeValue(HSQUIRRELVM v, SQInteger idx, SQUserPointer storage, const T& value)
+	{
+		if(storage) {
+			::new(storage) T(value);
+			sq_setreleasehook(v, idx, &destructHook<T>);
+		}
+		else {
+			sq_setinstanceup(v, idx, new T(value));
+			sq_setreleasehook(v, idx, &deleteHook<T>);
+		}
+	}
+
+	template<typename T>
+	static SQInteger destructHook(SQUserPointer p, SQInteger size)
+	{
+		static_cast<T*>(p)->~T();	// The memory is freed together with the instance
+		return 1;
+	}
+
+	template<typename T>
+	static SQInteger deleteHook(SQUserPointer p, SQInteger size)
+	{
+		T* data = (T*)p;
+		destroy(data, data);
+		return 1;
+	}
+};	// inlineValue
+
 /// Default return policies
 template<typename T> struct DefaultReturnPolicy			{ typedef objOwn policy; };
 template<typename T> struct DefaultReturnPolicy<const T>{ typedef typename DefaultReturnPolicy<T>::policy policy; };
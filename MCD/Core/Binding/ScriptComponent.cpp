@@ -2,6 +2,7 @@
 #include "ScriptComponent.h"
 #include "VMCore.h"
 #include "../Entity/Entity.h"
+#include "../System/Timer.h"
 #include "../../../3Party/squirrel/squirrel.h"
 
 #define CAPI_VERIFY(arg) MCD_VERIFY(SQ_SUCCEEDED((arg)))
@@ -10,7 +11,8 @@ namespace MCD {
 namespace Binding {
 
 ScriptComponent::ScriptComponent()
-	: mThreadVM(nullptr)
+	: mWakeup(0)
+	, mThreadVM(nullptr)
 	, mSuspended(false)
 {
 }
@@ -57,30 +59,180 @@ void ScriptComponent::update(float dt)
 	sq_settop(orgVm, orgOldTop);
 }
 
-ScriptManagerComponent::ScriptManagerComponent(VMCore* vmcore) : mVMCore(vmcore) {}
+ComponentRegistry* ScriptComponent::registry() const
+{
+	HSQUIRRELVM v = reinterpret_cast<HSQUIRRELVM>(scriptVm);
+	if(!v) return nullptr;
+
+	VMCore* core = reinterpret_cast<VMCore*>(sq_getforeignptr(v));
+	MCD_ASSUME(core);
+	return &core->scriptComponents();
+}
+
+void ScriptComponent::destroyThis()
+{
+	// Keep alive, in case discarding the thread releases the last reference
+	intrusivePtrAddRef(this);
+
+	// The suspended thread will never be waken up
+	if(mWakeup && scriptVm) {
+		VMCore* core = reinterpret_cast<VMCore*>(sq_getforeignptr(reinterpret_cast<HSQUIRRELVM>(scriptVm)));
+		MCD_ASSUME(core);
+		if(core->cancelWakeup(mWakeup))
+			mSuspended = false;
+		mWakeup = 0;
+		mWaitEvent = "";
+	}
+
+	Component::destroyThis();
+	intrusivePtrRelease(this);
+}
+
+ScriptManagerComponent::ScriptManagerComponent(VMCore* vmcore)
+	: manualWakeup(false), wakeupLimit(0), mVMCore(vmcore), mThread(nullptr)
+{}
+
+ScriptManagerComponent::~ScriptManagerComponent()
+{
+	MCD_ASSUME(mVMCore);
+	HSQUIRRELVM vm = mVMCore->getVM();
+
+	for(UpdateMethods::iterator i=mUpdateMethods.begin(); i!=mUpdateMethods.end(); ++i) {
+		sq_release(vm, &i->second.scriptClass);
+		sq_release(vm, &i->second.closure);
+	}
+
+	if(mThread)
+		mVMCore->releaseThread(mThread);
+}
 
 void ScriptManagerComponent::end(float dt)
+{
+	updateScripts(dt);
+
+	if(!manualWakeup)
+		(void)wakeup();
+}
+
+void ScriptManagerComponent::updateScripts(float dt)
+{
+	updateScripts(dt, Entity::currentRoot());
+}
+
+void ScriptManagerComponent::updateScripts(float dt, const Entity* root)
 {
 	MCD_ASSUME(mVMCore);
+	HSQUIRRELVM vm = mVMCore->getVM();
 
-	while(true)
+	for(ComponentRegistry::Iterator itr(mVMCore->scriptComponents(), root); !itr.ended(); itr.next())
 	{
+		ScriptComponent* c = static_cast<ScriptComponent*>(itr.current());
+		HSQUIRRELVM orgVm = reinterpret_cast<HSQUIRRELVM>(c->scriptVm);
+		if(c->mSuspended || !orgVm)
+			continue;
+		MCD_ASSERT(sq_getforeignptr(orgVm) == mVMCore);
+
+		const HSQOBJECT& self = *reinterpret_cast<HSQOBJECT*>(c->scriptHandle);
+		const HSQOBJECT* closure = findUpdate(self);
+		if(!closure)
+			continue;
+
+		if(!mThread) {
+			const SQInteger oldTop = sq_gettop(vm);
+			mThread = mVMCore->allocateThraed();
+			sq_settop(vm, oldTop);
+		}
+
+		HSQUIRRELVM v = mThread;
+		sq_pushobject(v, *closure);
+		sq_pushobject(v, self);
+		sq_pushfloat(v, dt);
+		/// stack: update(), scriptComponent, dt
+
+		if(SQ_FAILED(sq_call(v, 2, false, true)))
+			VMCore::printError(v);
+
+		// The thread now belongs to the suspended script, until it's waken up
+		if(SQ_VMSTATE_SUSPENDED == sq_getvmstate(v)) {
+			c->mSuspended = true;
+			mThread = nullptr;
+		}
+		else
+			sq_settop(v, 0);
+	}
+}
+
+const HSQOBJECT* ScriptManagerComponent::findUpdate(const HSQOBJECT& instance)
+{
+	HSQUIRRELVM vm = mVMCore->getVM();
+	const SQInteger oldTop = sq_gettop(vm);
+
+	sq_pushobject(vm, instance);
+	if(SQ_FAILED(sq_getclass(vm, -1))) {
+		sq_settop(vm, oldTop);
+		return nullptr;
+	}
+
+	HSQOBJECT scriptClass;
+	CAPI_VERIFY(sq_getstackobj(vm, -1, &scriptClass));
+
+	UpdateMethods::iterator i = mUpdateMethods.find(scriptClass._unVal.pClass);
+	if(i == mUpdateMethods.end()) {
+		UpdateMethod m;
+		m.scriptClass = scriptClass;
+		sq_resetobject(&m.closure);
+
+		sq_pushstring(vm, "update", -1);
+		if(SQ_SUCCEEDED(sq_get(vm, -2)) && (sq_gettype(vm, -1) == OT_CLOSURE || sq_gettype(vm, -1) == OT_NATIVECLOSURE))
+			CAPI_VERIFY(sq_getstackobj(vm, -1, &m.closure));
+
+		sq_addref(vm, &m.scriptClass);
+		sq_addref(vm, &m.closure);
+		i = mUpdateMethods.insert(std::make_pair(scriptClass._unVal.pClass, m)).first;
+	}
+
+	sq_settop(vm, oldTop);
+	return sq_isnull(i->second.closure) ? nullptr : &i->second.closure;
+}
+
+bool ScriptManagerComponent::wakeup(Timer* timer, float timeOut)
+{
+	MCD_ASSUME(mVMCore);
+
+	for(size_t count = 0; ; ++count)
+	{
+		if(timer && float(timer->get().asSecond()) >= timeOut)
+			return true;
+
+		if(wakeupLimit > 0 && count >= wakeupLimit)
+			return true;
+
 		void* userData = nullptr;
 		const float time = mVMCore->currentTime();	// Putting this line in the loop make a better response
 
 		if(HSQUIRRELVM v = mVMCore->popScheduled(time, &userData)) {
 			MCD_ASSUME(userData);
+			ScriptComponent* c = reinterpret_cast<ScriptComponent*>(userData);
+			c->mWakeup = 0;
+			c->mWaitEvent = "";
+
 			if(SQ_FAILED(sq_wakeupvm(v, false, false, true, false)))
 				VMCore::printError(v);
 
 			if(SQ_VMSTATE_SUSPENDED != sq_getvmstate(v)) {
 				mVMCore->releaseThread(v);
-				reinterpret_cast<ScriptComponent*>(userData)->mSuspended = false;
+				c->mSuspended = false;
 			}
 		} else
-			break;
+			return false;
 	}
 }
 
+size_t ScriptManagerComponent::signal(const char* event)
+{
+	MCD_ASSUME(mVMCore);
+	return mVMCore->signalWakeup(FixString(event).c_str());
+}
+
 }	// namespace Binding
 }	// namespace MCD
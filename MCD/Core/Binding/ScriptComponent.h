@@ -2,38 +2,104 @@
 #define __MCD_CORE_BINDING_SCRIPTCOMPONENT__
 
 #include "../Entity/BehaviourComponent.h"
+#include "../System/StringHash.h"
+#include "../System/TimingWheel.h"
 #include "../../../3Party/squirrel/squirrel.h"
+#include <map>
 
 namespace MCD {
+
+class Timer;
+
 namespace Binding {
 
 class VMCore;
 
 /// To be sub-classed in script
+/// The update() of all ScriptComponent is batched by ScriptManagerComponent, instead of BehaviourUpdaterComponent.
 class MCD_CORE_API ScriptComponent : public BehaviourComponent
 {
 public:
 	ScriptComponent();
 
+	/// Calls the script's update() on its own, prefer ScriptManagerComponent::updateScripts().
 	sal_override void update(float dt);
 
+	/// Listed in the registry of the VM which created it, separated from the other BehaviourComponent.
+	/// Returns null if it's not created by script, in such case it has no update() to invoke anyway.
+	sal_override sal_maybenull ComponentRegistry* registry() const;
+
+	/// Also cancels the pending sleep() or waitFor(), the suspended thread is discarded.
+	sal_override void destroyThis();
+
 protected:
 	friend SQInteger wakeup_ScriptComponent(HSQUIRRELVM vm);
+	friend SQInteger sleep_ScriptComponent(HSQUIRRELVM vm);
+	friend SQInteger waitFor_ScriptComponent(HSQUIRRELVM vm);
 	friend class ScriptManagerComponent;
+
+	/// The scheduled wakeup of sleep() or waitFor(), zero if none
+	TimingWheel::Handle mWakeup;
+	/// The event waiting by waitFor(), kept such that its c_str() pointer is unique while waiting
+	FixString mWaitEvent;
 	void* mThreadVM;
 	bool mSuspended;
 };	// ScriptComponent
 
+/// Updates the ScriptComponent in batch, and wakes up the sleeping ones.
+/// The update() closure of each script class is looked up once and cached, and the scripts
+/// run one after another on a single reused thread, until one of them suspends and keeps it.
 class MCD_CORE_API ScriptManagerComponent : public ComponentUpdater
 {
 public:
 	explicit ScriptManagerComponent(VMCore* vmcore);
 
+	sal_override ~ScriptManagerComponent();
+
+	/// Invokes update(dt) of the enabled and not suspended ScriptComponent under Entity::currentRoot().
+	/// Classes without an update() are skipped.
+	void updateScripts(float dt);
+
+	/// Same as updateScripts(dt), but for the ScriptComponent under root instead.
+	/// Only the scripts created by this VM are updated.
+	void updateScripts(float dt, sal_maybenull const Entity* root);
+
+	/// Wakeup the sleeped scripts which are due or signaled, until the timer reaches timeOut or
+	/// wakeupLimit scripts are waken. Returns true if it ran out of time or the limit, where some
+	/// scripts may still be due.
+	bool wakeup(sal_maybenull Timer* timer=nullptr, float timeOut=0);
+
+	/// Make the scripts waiting for the event, by ScriptComponent.waitFor(), ready to wakeup.
+	/// Returns the number of them.
+	size_t signal(sal_in_z const char* event);
+
+	/// When true, end() only updates the scripts and the owner calls wakeup() instead,
+	/// for instance as a FrameScheduler task.
+	bool manualWakeup;
+
+	/// Maximum number of scripts to wakeup in each wakeup(), such that a burst spreads over frames.
+	/// Zero means no limit, default is zero.
+	size_t wakeupLimit;
+
 protected:
-	/// Will wakeup up sleeped script at the right time
+	/// Will update the scripts, and wakeup up sleeped script at the right time
 	sal_override void end(float dt);
 
+	/// Returns the update() closure of the script instance's class, null if there is none.
+	sal_maybenull const HSQOBJECT* findUpdate(const HSQOBJECT& instance);
+
 	VMCore* mVMCore;
+
+	struct UpdateMethod
+	{
+		HSQOBJECT scriptClass;	///< Referenced, so the class pointer used as key is never reused
+		HSQOBJECT closure;		///< Null if the class has no update()
+	};	// UpdateMethod
+
+	typedef std::map<const void*, UpdateMethod> UpdateMethods;
+	UpdateMethods mUpdateMethods;
+
+	HSQUIRRELVM mThread;	///< Reused for running update(), null after a script suspended in it
 };	// ScriptManagerComponent
 
 }	// namespace Binding
@@ -1,12 +1,18 @@
 #include "Pch.h"
 #include "VMCore.h"
+#include "../System/CacheFile.h"
+#include "../System/ContentHash.h"
+#include "../System/Log.h"
+#include "../System/RawFileSystem.h"
 #include "../System/Stream.h"
 #include "../../../3Party/squirrel/sqstdio.h"
 #include "../../../3Party/squirrel/sqstdmath.h"
 #include "../../../3Party/squirrel/sqstdstring.h"
 #include "../../../3Party/squirrel/sqstdsystem.h"
 #include <iostream>
+#include <sstream>
 #include <stdarg.h>	// For va_list
+#include <string.h>	// For strcmp
 
 #define CAPI_VERIFY(arg) MCD_VERIFY(SQ_SUCCEEDED((arg)))
 
@@ -37,6 +43,9 @@ VMCore::VMCore(int initialStackSize)
 	, mState(OPENING)
 
 {
+	ByteCodeCacheStats stats = { 0, 0, 0 };
+	mByteCodeCacheStats = stats;
+
 	// Creating vm
 	mSqvm = sq_open(initialStackSize);
 	sq_setforeignptr(mSqvm, this);
@@ -93,7 +102,10 @@ VMCore::~VMCore()
 	for(ThreadMap::iterator i=mThreadMap.begin(); i!=mThreadMap.end(); ++i)
 		sq_release(mSqvm, &i->second);
 
-	// Releasing types table
+	// Releasing the class cache and types table
+	for(ClassCache::iterator i=mClassCache.begin(); i!=mClassCache.end(); ++i)
+		sq_release(mSqvm, &i->second);
+	mClassCache.clear();
 	sq_release(mSqvm, &mClassesTable);
 	sq_resetobject(&mClassesTable);
 
@@ -108,24 +120,76 @@ HSQUIRRELVM VMCore::getVM() const
 	return mSqvm;
 }
 
+bool VMCore::useByteCodeCache(const char* scriptName) const
+{
+	// Unnamed scripts are mostly one-off strings, caching them only fills up the directory
+	return !mByteCodeCache.getString().empty() && scriptName && *scriptName != '\0' && ::strcmp(scriptName, "unnamed") != 0;
+}
+
 bool VMCore::loadScript(const char* script, int lenInByte, const char* scriptName)
 {
-	return loadScript(mSqvm, script, lenInByte, scriptName);
+	if(!useByteCodeCache(scriptName))
+		return loadScript(mSqvm, script, lenInByte, scriptName);
+
+	return loadCachedScript(script, lenInByte < 0 ? strlen(script) : size_t(lenInByte), scriptName, false);
 }
 
 bool VMCore::loadScript(std::istream& is, int sizeInByte, const char* scriptName)
 {
-	return loadScript(mSqvm, is, sizeInByte, scriptName);
+	if(!useByteCodeCache(scriptName))
+		return loadScript(mSqvm, is, sizeInByte, scriptName);
+
+	// Byte code needs no cache
+	uint16_t header = 0;
+	if(!MCD::read(is, header))
+		return false;
+	for(size_t i=sizeof(header); i--;)
+		is.unget();
+	if(header == SQ_BYTECODE_STREAM_TAG)
+		return loadScript(mSqvm, is, sizeInByte, scriptName);
+
+	// The whole source is needed for the hash
+	std::string source;
+	char buf[4096];
+	for(size_t remain = sizeInByte < 0 ? size_t(-1) : size_t(sizeInByte); remain > 0 && is;) {
+		is.read(buf, std::streamsize(remain < sizeof(buf) ? remain : sizeof(buf)));
+		source.append(buf, size_t(is.gcount()));
+		remain -= size_t(is.gcount());
+	}
+
+	return loadCachedScript(source.c_str(), source.size(), scriptName, true);
 }
 
 bool VMCore::runScript(const char* script, int lenInByte, bool retVal, bool leftClouseOnStack, const char* scriptName)
 {
-	return runScript(mSqvm, script, lenInByte, retVal, leftClouseOnStack, scriptName);
+	if(!useByteCodeCache(scriptName))
+		return runScript(mSqvm, script, lenInByte, retVal, leftClouseOnStack, scriptName);
+
+	if(!loadScript(script, lenInByte, scriptName))
+		return false;
+
+	const bool ok = call(mSqvm, retVal);
+
+	if(!leftClouseOnStack)
+		sq_poptop(mSqvm);	// Pop the closure
+
+	return ok;
 }
 
 bool VMCore::runScript(std::istream& is, int sizeInByte, bool retVal, bool leftClouseOnStack, const char* scriptName)
 {
-	return runScript(mSqvm, is, sizeInByte, retVal, leftClouseOnStack, scriptName);
+	if(!useByteCodeCache(scriptName))
+		return runScript(mSqvm, is, sizeInByte, retVal, leftClouseOnStack, scriptName);
+
+	if(!loadScript(is, sizeInByte, scriptName))
+		return false;
+
+	const bool ok = call(mSqvm, retVal);
+
+	if(!leftClouseOnStack)
+		sq_poptop(mSqvm);	// Pop the closure
+
+	return ok;
 }
 
 bool VMCore::saveByteCode(std::ostream& os, bool leftClouseOnStack)
@@ -277,6 +341,112 @@ bool VMCore::saveByteCode(HSQUIRRELVM v, std::ostream& os, bool leftClouseOnStac
 	return true;
 }
 
+namespace {
+
+//!	Header of a byte code cache file, followed by the output of sq_writeclosure().
+struct ByteCodeCacheHeader
+{
+	CacheFileHeader common;	//!< The key is the hash of the source
+	uint64_t sourceSize;
+	uint64_t byteCodeSize;
+};	// ByteCodeCacheHeader
+
+const uint32_t cByteCodeCacheMagic = 0x4342534D;	// "MSBC"
+
+// Bump it when the way of generating the byte code changes
+const uint32_t cByteCodeCacheVersion = 1;
+
+//! The byte code depends on the squirrel version and the size of its types, they go into the hash as well.
+uint64_t byteCodeCacheKey(const char* script, size_t size, const char* scriptName)
+{
+	uint64_t seed = uint64_t(cByteCodeCacheVersion) << 32 | sizeof(SQChar) << 24 | sizeof(SQInteger) << 16 | sizeof(SQFloat) << 8 | sizeof(void*);
+	seed = hashContent64(SQUIRREL_VERSION, sizeof(SQUIRREL_VERSION), seed);
+
+	// The script name is kept in the byte code for error reporting
+	seed = hashContent64(scriptName, strlen(scriptName), seed);
+
+	return hashContent64(script, size, seed);
+}
+
+Path byteCodeCacheFileName(uint64_t key) {
+	return cacheFileName(key, "cnut");
+}
+
+}	// namespace
+
+bool VMCore::setByteCodeCache(const Path& directory)
+{
+	mByteCodeCache = Path();
+	if(directory.getString().empty())
+		return true;
+
+	RawFileSystem fs(directory);
+	if(fs.getRoot().getString().empty())
+		return false;
+
+	mByteCodeCache = fs.getRoot();
+	return true;
+}
+
+Path VMCore::byteCodeCacheFile(const char* script, int lenInByte, const char* scriptName) const
+{
+	if(!useByteCodeCache(scriptName))
+		return Path();
+
+	const size_t len = lenInByte < 0 ? strlen(script) : size_t(lenInByte);
+	return mByteCodeCache / byteCodeCacheFileName(byteCodeCacheKey(script, len, scriptName));
+}
+
+bool VMCore::loadCachedScript(const char* script, size_t lenInByte, const char* scriptName, bool utf8)
+{
+	RawFileSystem fs(mByteCodeCache);
+	const uint64_t key = byteCodeCacheKey(script, lenInByte, scriptName);
+	const Path fileName = byteCodeCacheFileName(key);
+
+	// Read back the byte code
+	if(fs.isExists(fileName)) {
+		std::auto_ptr<std::istream> is = fs.openRead(fileName);
+		ByteCodeCacheHeader header;
+		if(is.get() && MCD::read(*is, &header, sizeof(header)) == sizeof(header) &&
+			header.common.isValid(cByteCodeCacheMagic, cByteCodeCacheVersion, key) && header.sourceSize == lenInByte)
+		{
+			ReadContext context = { is.get(), 0, size_t(header.byteCodeSize) };
+			if(SQ_SUCCEEDED(sq_readclosure(mSqvm, &sqReadByteCode, &context))) {
+				++mByteCodeCacheStats.hitCount;
+				return true;
+			}
+		}
+
+		Log::format(Log::Warn, "The byte code cache \"%s\" of \"%s\" is outdated or corrupted, recompiling", fileName.c_str(), scriptName);
+	}
+
+	// Compile in the same way as without the cache
+	++mByteCodeCacheStats.missCount;
+	if(utf8) {
+		std::istringstream is(std::string(script, lenInByte));
+		if(!loadScript(mSqvm, is, lenInByte, scriptName))
+			return false;
+	}
+	else if(!loadScript(mSqvm, script, lenInByte, scriptName))
+		return false;
+
+	std::ostringstream byteCode(std::ios::binary);
+	if(!saveByteCode(mSqvm, byteCode, true)) {
+		++mByteCodeCacheStats.writeFailCount;
+		return true;
+	}
+
+	const std::string& buffer = byteCode.str();
+	ByteCodeCacheHeader header;
+	header.common.set(cByteCodeCacheMagic, cByteCodeCacheVersion, key);
+	header.sourceSize = lenInByte;
+	header.byteCodeSize = buffer.size();
+	if(!writeCacheFile(fs, fileName, &header, sizeof(header), buffer.c_str(), buffer.size()))
+		++mByteCodeCacheStats.writeFailCount;
+
+	return true;
+}
+
 void VMCore::collectGarbage()
 {
 	sq_collectgarbage(mSqvm);
@@ -343,27 +513,40 @@ void VMCore::releaseThread(HSQUIRRELVM v)
 	mFreeThreads.push(v);
 }
 
-void VMCore::scheduleWakeup(HSQUIRRELVM v, float timeToWake, void* userData)
+TimingWheel::Handle VMCore::scheduleWakeup(HSQUIRRELVM v, float timeToWake, void* userData, const void* event)
 {
-	UserData d = { v, userData };
-	mSchedule.insert(std::make_pair(timeToWake, d));
+	return mSchedule.schedule(timeToWake, v, userData, event);
 }
 
-HSQUIRRELVM VMCore::popScheduled(float currentTime, void** userData)
+bool VMCore::cancelWakeup(TimingWheel::Handle handle)
 {
-	if(mSchedule.empty()) return nullptr;
+	void* v = nullptr;
+	if(!mSchedule.cancel(handle, &v))
+		return false;
 
-	Schedule::iterator i = mSchedule.begin();
-	if(i->first > currentTime)
-		return nullptr;
+	// A suspended thread cannot be reused, let the GC free it along with its stack
+	ThreadMap::iterator i = mThreadMap.find(reinterpret_cast<HSQUIRRELVM>(v));
+	MCD_ASSERT(i != mThreadMap.end());
+	HSQOBJECT thread = i->second;
+	mThreadMap.erase(i);
+	sq_release(mSqvm, &thread);
 
-	HSQUIRRELVM v = i->second.v;
-	if(userData) *userData = i->second.d;
+	return true;
+}
 
-	mSchedule.erase(i);
-	MCD_ASSERT(SQ_VMSTATE_SUSPENDED == sq_getvmstate(v));
+size_t VMCore::signalWakeup(const void* event)
+{
+	return mSchedule.signal(event);
+}
+
+HSQUIRRELVM VMCore::popScheduled(float currentTime, void** userData)
+{
+	void* v = nullptr;
+	if(!mSchedule.pop(currentTime, v, userData))
+		return nullptr;
 
-	return v;
+	MCD_ASSERT(SQ_VMSTATE_SUSPENDED == sq_getvmstate(reinterpret_cast<HSQUIRRELVM>(v)));
+	return reinterpret_cast<HSQUIRRELVM>(v);
 }
 
 float VMCore::currentTime() const
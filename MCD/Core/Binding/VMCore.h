@@ -2,8 +2,11 @@
 #define __MCD_CORE_BINDING_VMCORE__
 
 #include "../ShareLib.h"
+#include "../Entity/Component.h"
 #include "../System/Deque.h"
+#include "../System/Path.h"
 #include "../System/Timer.h"
+#include "../System/TimingWheel.h"
 #include "../../../3Party/squirrel/squirrel.h"
 #include <iosfwd>
 #include <map>
@@ -29,10 +32,14 @@ public:
 
 	HSQUIRRELVM getVM() const;
 
+	/// The ScriptComponent created in this VM, such that each VM only updates its own ones.
+	ComponentRegistry& scriptComponents() { return mScriptComponents; }
+
 // Operations
 	void collectGarbage();
 
 	/// Compile source code as a closure and push on to the stack
+	/// The compiled closure goes through the byte code cache, see setByteCodeCache()
 	sal_checkreturn bool loadScript(
 		const char* script,
 		int lenInByte=-1,
@@ -40,6 +47,7 @@ public:
 	);
 
 	/// Load source/byte code as a closure and push on to the stack
+	/// Source code goes through the byte code cache, see setByteCodeCache()
 	sal_checkreturn bool loadScript(
 		std::istream& is,
 		int sizeInByte=-1,
@@ -72,6 +80,29 @@ public:
 		bool leftClouseOnStack=false
 	);
 
+// Byte code cache
+	/// Named scripts loaded by the non-static loadScript() and runScript() are compiled once and cached
+	/// in the directory, keyed by the hash of the source, the script name and the squirrel version.
+	/// Scripts with an empty or the default "unnamed" name are always compiled and never cached.
+	/// Later loads of the same source read the byte code back instead of compiling; a changed source
+	/// simply has a different key. Give an empty path to disable the cache, which is the default.
+	/// Returns false if the directory does not exist, where the cache is disabled.
+	bool setByteCodeCache(const Path& directory);
+
+	const Path& byteCodeCache() const { return mByteCodeCache; }
+
+	/// The absolute path of the cache file for the source, empty if there is no cache directory or the script is unnamed
+	Path byteCodeCacheFile(const char* script, int lenInByte=-1, const char* scriptName="unnamed") const;
+
+	struct ByteCodeCacheStats
+	{
+		size_t hitCount;		///< Number of loads served from the cache
+		size_t missCount;		///< Number of compilations, whose byte code is then written to the cache
+		size_t writeFailCount;
+	};	// ByteCodeCacheStats
+
+	const ByteCodeCacheStats& byteCodeCacheStats() const { return mByteCodeCacheStats; }
+
 // Thread
 	/// Get a friend VM for running a thread, a squirrel thread object will also push to the VMCore's stack
 	HSQUIRRELVM allocateThraed();
@@ -79,10 +110,18 @@ public:
 	/// Release the VM back to the pool, also reset the thread's stack to zero
 	void releaseThread(HSQUIRRELVM v);
 
-	/// Schedule a suspended thread to wakeup
-	void scheduleWakeup(HSQUIRRELVM v, float timeToWake, void* userData=nullptr);
+	/// Schedule a suspended thread to wakeup, at timeToWake or when the event is signaled, whichever comes first.
+	/// A negative timeToWake means waiting for the event only.
+	TimingWheel::Handle scheduleWakeup(HSQUIRRELVM v, float timeToWake, void* userData=nullptr, const void* event=nullptr);
 
-	/// Ask if it's the time for thread(s) to wakeup
+	/// Cancel a scheduled wakeup, the suspended thread is discarded instead of going back to the pool.
+	/// Returns false if the thread is already waken up.
+	bool cancelWakeup(TimingWheel::Handle handle);
+
+	/// Make all threads waiting for the event ready to wakeup, returns the number of them.
+	size_t signalWakeup(const void* event);
+
+	/// Ask if it's the time for thread(s) to wakeup, the signaled ones and then the ones due in order of time
 	HSQUIRRELVM popScheduled(float currentTime, void** userData=nullptr);
 
 	/// For use with scheduleWakeup() and popScheduled()
@@ -132,21 +171,34 @@ public:
 	static bool printError(HSQUIRRELVM v);	// Always return false
 
 protected:
+	/// Whether the cache directory is set and the script has a name
+	bool useByteCodeCache(sal_maybenull const char* scriptName) const;
+
+	/// Load the closure of the source from the byte code cache, or compile and save it to the cache
+	/// The source is compiled as an UTF-8 stream if utf8 is true, as a buffer of SQChar otherwise
+	sal_checkreturn bool loadCachedScript(const char* script, size_t lenInByte, const char* scriptName, bool utf8);
+
 	State mState;
 	HSQUIRRELVM mSqvm;
 	HSQOBJECT mClassesTable;
 
+	typedef std::map<const void*, HSQOBJECT> ClassCache;
+	ClassCache mClassCache;	// The classes in mClassesTable, for a faster look up by ClassID
+
 	typedef std::map<HSQUIRRELVM, HSQOBJECT> ThreadMap;
 	ThreadMap mThreadMap;	// Keep tracks of all allocated threads
 	typedef std::stack<HSQUIRRELVM> FreeThreads;
 	FreeThreads mFreeThreads;	// Keep tracks of avaliable threads
 
-	struct UserData { HSQUIRRELVM v; void* d; };
-	typedef std::multimap<float, UserData> Schedule;
-	Schedule mSchedule;
+	TimingWheel mSchedule;
+
+	Path mByteCodeCache;
+	ByteCodeCacheStats mByteCodeCacheStats;
 
 	Timer mTimer;
 
+	ComponentRegistry mScriptComponents;
+
 	friend class ClassesManager;
 };	// VMCore
 
@@ -4,25 +4,16 @@
 
 namespace MCD {
 
-static BehaviourUpdaterComponent* gCurrentBehaviourUpdater = nullptr;
+static ComponentRegistry gBehaviourRegistry;
 
-void BehaviourComponent::gather()
-{
-	MCD_ASSUME(gCurrentBehaviourUpdater);
-	gCurrentBehaviourUpdater->mComponents.push_back(this);
-}
-
-void BehaviourUpdaterComponent::begin()
-{
-	mComponents.clear();
-	gCurrentBehaviourUpdater = this;
+ComponentRegistry* BehaviourComponent::registry() const {
+	return &gBehaviourRegistry;
 }
 
 void BehaviourUpdaterComponent::end(float dt)
 {
-	MCD_FOREACH(const BehaviourComponentPtr c, mComponents)
-		if(c) c->update(dt);
-	gCurrentBehaviourUpdater = nullptr;
+	for(ComponentRegistry::Iterator itr(gBehaviourRegistry, Entity::currentRoot()); !itr.ended(); itr.next())
+		static_cast<BehaviourComponent*>(itr.current())->update(dt);
 }
 
 }	// namespace MCD
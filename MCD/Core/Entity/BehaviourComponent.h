@@ -2,7 +2,6 @@
 #define __MCD_CORE_ENTITY_BEHAVIOURCOMPONENT__
 
 #include "Component.h"
-#include <vector>
 
 namespace MCD {
 
@@ -16,21 +15,17 @@ public:
 	//! The derived components should override this function for defining behaviour.
 	virtual void update(float dt) = 0;
 
-protected:
-	sal_override void gather();
+	//! All BehaviourComponent are listed in the same registry.
+	sal_override sal_maybenull ComponentRegistry* registry() const;
 };	// BehaviourComponent
 
 typedef IntrusiveWeakPtr<BehaviourComponent> BehaviourComponentPtr;
 
+//! Invokes update() of the enabled BehaviourComponent under Entity::currentRoot().
 class MCD_CORE_API BehaviourUpdaterComponent : public ComponentUpdater
 {
-	friend class BehaviourComponent;
-
 protected:
-	sal_override void begin();
 	sal_override void end(float dt);
-
-	std::vector<BehaviourComponentPtr> mComponents;
 };	// BehaviourUpdaterComponent
 
 typedef IntrusiveWeakPtr<BehaviourUpdaterComponent> BehaviourUpdaterComponentPtr;
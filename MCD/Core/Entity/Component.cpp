@@ -9,13 +9,15 @@
 namespace MCD {
 
 Component::Component()
-	: scriptVm(nullptr), mEntity(nullptr)
+	: scriptVm(nullptr), mEntity(nullptr), mRegistry(nullptr), mRegistryIndex(0)
 {
 }
 
 Component::~Component()
 {
 	MCD_ASSERT(mRefCount == 0);
+	if(mRegistry)
+		mRegistry->remove(*this);
 }
 
 // NOTE: This simply empty is put in cpp otherwise Intel Parallel Studio will
@@ -26,6 +28,9 @@ void Component::onRemove() {}
 
 void Component::destroyThis()
 {
+	// The script may still hold a reference, but the Component is no longer attached
+	if(mRegistry)
+		mRegistry->remove(*this);
 	removeThis();
 	intrusivePtrRelease(this);
 }
@@ -90,6 +95,114 @@ void ComponentUpdater::traverseEnd(Entity& entityTree, float dt)
 	}
 }
 
+ComponentRegistry::ComponentRegistry()
+	: mIteratorCount(0), mRemovedCount(0)
+{
+}
+
+ComponentRegistry::~ComponentRegistry()
+{
+	MCD_ASSERT(mIteratorCount == 0);
+	for(size_t i=0; i<mComponents.size(); ++i)
+		if(mComponents[i]) mComponents[i]->mRegistry = nullptr;
+}
+
+void ComponentRegistry::add(Component& component)
+{
+	// Only the thread owning the Component adds or removes it, no lock is needed to read mRegistry
+	if(component.mRegistry == this)
+		return;
+	if(component.mRegistry)
+		component.mRegistry->remove(component);
+
+	ScopeLock lock(mMutex);
+	component.mRegistry = this;
+	component.mRegistryIndex = mComponents.size();
+	mComponents.push_back(&component);
+}
+
+void ComponentRegistry::remove(Component& component)
+{
+	ScopeLock lock(mMutex);
+	if(component.mRegistry != this)
+		return;
+
+	const size_t index = component.mRegistryIndex;
+	MCD_ASSERT(mComponents[index] == &component);
+	component.mRegistry = nullptr;
+
+	// Leave a hole, so the order and the running iterators are not disturbed
+	mComponents[index] = nullptr;
+	++mRemovedCount;
+
+	// Without any iteration, compact once half of the list are holes
+	if(mIteratorCount == 0 && mRemovedCount * 2 > mComponents.size())
+		compact();
+}
+
+size_t ComponentRegistry::size() const
+{
+	ScopeLock lock(mMutex);
+	return mComponents.size() - mRemovedCount;
+}
+
+void ComponentRegistry::compact()
+{
+	size_t j = 0;
+	for(size_t i=0; i<mComponents.size(); ++i) {
+		if(Component* c = mComponents[i]) {
+			c->mRegistryIndex = j;
+			mComponents[j++] = c;
+		}
+	}
+	mComponents.resize(j);
+	mRemovedCount = 0;
+}
+
+//! Check that the Entity and all its ancestors are enabled, up to the root.
+static bool isEnabledInTree(const Entity* e, const Entity* root)
+{
+	const Entity* last = nullptr;
+	for(; e; last = e, e = e->parent()) {
+		if(!e->enabled) return false;
+		if(e == root) return true;	// Not looking further, root may be a sub-tree
+	}
+	return last && !root;
+}
+
+ComponentRegistry::Iterator::Iterator(ComponentRegistry& registry, const Entity* root)
+	: mRegistry(registry), mRoot(root), mCurrent(nullptr), mIndex(size_t(-1)), mEnd(0)
+{
+	{	ScopeLock lock(mRegistry.mMutex);
+		++mRegistry.mIteratorCount;
+		mEnd = mRegistry.mComponents.size();
+	}
+	next();
+}
+
+ComponentRegistry::Iterator::~Iterator()
+{
+	ScopeLock lock(mRegistry.mMutex);
+	if(--mRegistry.mIteratorCount == 0 && mRegistry.mRemovedCount > 0)
+		mRegistry.compact();
+}
+
+Component* ComponentRegistry::Iterator::next()
+{
+	// The tree is checked inside the lock too, such that a Component in the tree of another
+	// thread cannot be destroyed under our feet
+	ScopeLock lock(mRegistry.mMutex);
+	mCurrent = nullptr;
+	while(++mIndex < mEnd) {
+		Component* c = mRegistry.mComponents[mIndex];
+		if(c && isEnabledInTree(c->mEntity, mRoot)) {
+			mCurrent = c;
+			break;
+		}
+	}
+	return mCurrent;
+}
+
 ComponentPreorderIterator::ComponentPreorderIterator(Entity* start)
 	: mCurrent(nullptr), mCurrentEntity(start)
 {
@@ -3,11 +3,14 @@
 
 #include "EntityIterator.h"
 #include "../System/LinkList.h"
+#include "../System/Mutex.h"
 #include "../System/WeakPtr.h"
 #include <typeinfo>
+#include <vector>
 
 namespace MCD {
 
+class ComponentRegistry;
 class Entity;
 
 /*!	Base class for everything attached to Entity.
@@ -41,7 +44,11 @@ public:
 	 */
 	virtual sal_checkreturn bool postClone(const Entity& src, Entity& dest) { return true; }
 
-	virtual void gather() {}
+	/*!	The registry where this kind of Component is listed, for its ComponentUpdater to find
+		it without traversing the Entity tree. Returns null if the Component need no batched update.
+		The Component is listed when added to an Entity, and unlisted when it's destroyed.
+	 */
+	virtual sal_maybenull ComponentRegistry* registry() const { return nullptr; }
 
 	//!	Callback function that will invoked just after the component is added to an Entity.
 	virtual void onAdd();
@@ -84,13 +91,103 @@ public:
 
 protected:
 	friend class Entity;
+	friend class ComponentRegistry;
 
 	/*!	The Entity that this component belongs to.
 		There is no need to use EntityPtr, since the Entity itself owns this component.
 	 */
 	sal_maybenull Entity* mEntity;
+
+	sal_maybenull ComponentRegistry* mRegistry;	//!< The registry this Component is currently listed in
+	size_t mRegistryIndex;						//!< Index in the mRegistry
 };	// Component
 
+/*!	A dense list of a certain kind of Component, maintained as the Components are added to
+	an Entity and destroyed, such that no per-frame traversal of the whole Entity tree is needed
+	just to discover which Components have work to do.
+
+	The Components are visited in the order they were added, which is not the order of
+	the Entity tree. Removal leaves a hole which is compacted later, so the order is kept.
+
+	Components can be added and removed from any thread, for instance a resource loader
+	building an Entity tree in the background, while the updater iterates on the main thread.
+	The lock is only held inside add(), remove() and Iterator::next(), never while the
+	caller is working on a Component.
+	\sa Component::registry()
+ */
+class MCD_CORE_API ComponentRegistry : Noncopyable
+{
+public:
+	ComponentRegistry();
+
+	~ComponentRegistry();
+
+// Operations
+	//! Do nothing if the Component is already listed in this registry.
+	void add(Component& component);
+
+	void remove(Component& component);
+
+// Attributes
+	//! Number of listed Components, including those disabled.
+	size_t size() const;
+
+	/*!	Iterates over the listed Components that are enabled, and inside the tree of \em root;
+		that is all the ancestors of their Entity up to \em root are enabled too.
+		The \em root can also be a sub-tree, where its ancestors are not checked.
+		Components added during the iteration will not be visited, and those removed are skipped.
+		Example:
+		\code
+		for(ComponentRegistry::Iterator itr(registry, Entity::currentRoot()); !itr.ended(); itr.next()) {
+			// Do something ...
+		}
+		\endcode
+	 */
+	class MCD_CORE_API Iterator : Noncopyable
+	{
+	public:
+		//! Any tree is accepted if \em root is null.
+		Iterator(ComponentRegistry& registry, sal_maybenull const Entity* root);
+
+		~Iterator();
+
+		// NOTE: Assumming the iterator is valid and so the returned pointer will not be null.
+		sal_notnull Component* operator->() {
+			return mCurrent;
+		}
+
+		//! Return the current element.
+		sal_notnull Component* current() {
+			return mCurrent;
+		}
+
+		//! Returns true if there are NO more items in the collection.
+		bool ended() const {
+			return mCurrent == nullptr;
+		}
+
+		//! Returns the next element in the collection, and advances to the next.
+		sal_maybenull Component* next();
+
+	protected:
+		ComponentRegistry& mRegistry;
+		const Entity* mRoot;
+		Component* mCurrent;
+		size_t mIndex, mEnd;
+	};	// Iterator
+
+protected:
+	friend class Iterator;
+
+	//! Removes the slots left empty by the removal, the lock must be held.
+	void compact();
+
+	std::vector<Component*> mComponents;	//!< Contains null after a removal, until compact()
+	size_t mIteratorCount;
+	size_t mRemovedCount;
+	mutable Mutex mMutex;	//!< Protects all the above, and Component::mRegistry and mRegistryIndex
+};	// ComponentRegistry
+
 /// Class for batched update of the same type of Component
 class MCD_ABSTRACT_CLASS MCD_CORE_API ComponentUpdater : public Component
 {
@@ -386,6 +386,9 @@ Component* Entity::_addComponent(Component* component)
 	components.pushBack(*component);
 	component->mEntity = this;
 
+	if(ComponentRegistry* registry = component->registry())
+		registry->add(*component);
+
 	component->onAdd();
 
 	return component;
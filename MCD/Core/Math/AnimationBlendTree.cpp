@@ -4,28 +4,89 @@
 #include "../System/Deque.h"
 #include "../System/Log.h"
 #include "../System/ResourceManager.h"
+#include "../System/Stream.h"
 #include "../System/StrUtility.h"
 #include "../System/Timer.h"
 #include "../System/XmlParser.h"
+#include <iostream>
 #include <map>
+#include <memory>	// For auto_ptr
 
 namespace MCD {
 
 typedef AnimationBlendTree::Pose Pose;
 typedef AnimationBlendTree::INode INode;
 
+/// The compiled form of the tree, see AnimationBlendTree::compile().
+struct AnimationBlendTree::Program
+{
+	enum OpCode { Clip, Lerp, Subtractive, Additive, Switch, Fsm };
+	enum State { Skipped, Active, Ready };	///< Per node evaluation state
+	static const uint16_t cNone = 0xFFFF;
+	static const size_t cMaxRegister = 256;
+
+	/// One instruction per node, in the same order as AnimationBlendTree::nodes
+	struct Instruction
+	{
+		uint8_t op;
+		uint8_t reg;		///< The register holding the result, shared with the first child
+		uint16_t child1;	///< cNone for a leaf node
+		uint16_t child2;	///< cNone if there is only one child
+	};	// Instruction
+
+	/// The children selected by a node for the current evaluation
+	struct Step
+	{
+		uint16_t src1, src2;	///< src2 is cNone if the pose of src1 is simply forwarded
+		float t;
+	};	// Step
+
+	Program() : registerCount(0), trackCount(0) {}
+
+	void resize(size_t nodeCount)
+	{
+		instructions.resize(nodeCount);
+		steps.resize(nodeCount);
+		refTimes.resize(nodeCount);
+		states.resize(nodeCount);
+	}
+
+	AnimationClip::Sample* pose(size_t reg) {
+		return &registers[reg * trackCount];
+	}
+
+	static int opCodeOf(INode& node);	///< Returns -1 for an unknown node type
+
+	/// Fill the child indices and the registers of the instructions, where the op codes are already known.
+	sal_checkreturn bool link(const Nodes& nodes);
+
+	/// Decide the children of a switching node, with the same rules as SwitchNode::returnPose()
+	static void selectChildren(Step& step, const Instruction& ins, int lastNode, int currentNode, float changeTime, float fadeDuration, float time);
+
+	std::vector<Instruction> instructions;
+	size_t registerCount;
+
+	// Buffers reused across the evaluations
+	std::vector<Step> steps;
+	std::vector<float> refTimes;
+	std::vector<uint8_t> states;
+	size_t trackCount;
+	std::vector<AnimationClip::Sample> registers;
+};	// Program
+
 AnimationBlendTree::AnimationBlendTree()
-	: worldTime(0), referenceTime(0), mTrackCount(0), mPoseBuffer(nullptr)
+	: worldTime(0), referenceTime(0), mProgram(nullptr), mTrackCount(0), mPoseBuffer(nullptr)
 {
 }
 
 AnimationBlendTree::~AnimationBlendTree()
 {
+	uncompile();
 	resetPoseBuffer();
 }
 
 AnimationBlendTree::AnimationBlendTree(const AnimationBlendTree& rhs)
-	: mTrackCount(0), mPoseBuffer(nullptr)
+	: mProgram(nullptr), mTrackCount(0), mPoseBuffer(nullptr)
 {
 	*this = rhs;
 }
@@ -36,6 +97,10 @@ AnimationBlendTree& AnimationBlendTree::operator=(const AnimationBlendTree& rhs)
 	resetPoseBuffer();
 	for(size_t i=0; i<rhs.nodes.size(); ++i)
 		nodes.push_back(rhs.nodes[i].clone());
+
+	uncompile();
+	if(rhs.mProgram)
+		mProgram = new Program(*rhs.mProgram);
 	return *this;
 }
 
@@ -149,6 +214,7 @@ struct Sorter
 
 void AnimationBlendTree::inOrderSort()
 {
+	uncompile();
 	Sorter sorter(nodes);
 	nodes.clear(false);
 
@@ -158,6 +224,9 @@ void AnimationBlendTree::inOrderSort()
 
 Pose AnimationBlendTree::getFinalPose()
 {
+	if(mProgram)
+		return runProgram();
+
 	for(size_t i=0; i<nodes.size(); ++i)
 		nodes[i].begin(*this);
 
@@ -173,6 +242,261 @@ Pose AnimationBlendTree::getFinalPose()
 	return getPose(outputIdx);
 }
 
+int AnimationBlendTree::Program::opCodeOf(INode& node)
+{
+	if(dynamic_cast<ClipNode*>(&node)) return Clip;
+	if(dynamic_cast<LerpNode*>(&node)) return Lerp;
+	if(dynamic_cast<SubtractiveNode*>(&node)) return Subtractive;
+	if(dynamic_cast<AdditiveNode*>(&node)) return Additive;
+	if(dynamic_cast<SwitchNode*>(&node)) return Switch;
+	if(dynamic_cast<FsmNode*>(&node)) return Fsm;
+	return -1;
+}
+
+bool AnimationBlendTree::Program::link(const Nodes& nodes)
+{
+	const size_t count = nodes.size();
+	MCD_ASSERT(instructions.size() == count);
+
+	for(size_t i=0; i<count; ++i)
+		instructions[i].child1 = instructions[i].child2 = cNone;
+
+	// The in-order sort guarantees the children come before their parent, and the root is the last
+	for(size_t i=0; i<count - 1; ++i) {
+		const size_t parent = nodes[i].parent;
+		if(parent <= i || parent >= count)
+			return false;
+		Instruction& ins = instructions[parent];
+		if(ins.child1 == cNone) ins.child1 = uint16_t(i);
+		else if(ins.child2 == cNone) ins.child2 = uint16_t(i);
+	}
+	if(nodes.back().parent < count)
+		return false;
+
+	// A leaf takes a free register, while a parent writes into the register of its
+	// first child and gives back the registers of the other children
+	std::vector<uint8_t> freeRegisters;
+	registerCount = 0;
+	for(size_t i=0; i<count; ++i) {
+		Instruction& ins = instructions[i];
+		if(ins.op == Clip) {
+			if(ins.child1 != cNone)
+				return false;
+			if(freeRegisters.empty()) {
+				if(registerCount == cMaxRegister)
+					return false;
+				ins.reg = uint8_t(registerCount++);
+			}
+			else {
+				ins.reg = freeRegisters.back();
+				freeRegisters.pop_back();
+			}
+			continue;
+		}
+
+		const bool binary = ins.op == Lerp || ins.op == Subtractive || ins.op == Additive;
+		if(ins.child1 == cNone || (binary && ins.child2 == cNone))
+			return false;
+
+		ins.reg = instructions[ins.child1].reg;
+		for(size_t j=ins.child1 + 1u; j<i; ++j) {
+			if(nodes[j].parent == i)
+				freeRegisters.push_back(instructions[j].reg);
+		}
+	}
+
+	return true;
+}
+
+bool AnimationBlendTree::compile()
+{
+	uncompile();
+
+	const size_t count = nodes.size();
+	if(count == 0 || count >= Program::cNone)
+		return false;
+
+	std::auto_ptr<Program> p(new Program);
+	p->resize(count);
+
+	for(size_t i=0; i<count; ++i) {
+		const int op = Program::opCodeOf(nodes[i]);
+		if(op < 0)
+			return false;
+		p->instructions[i].op = uint8_t(op);
+	}
+
+	if(!p->link(nodes))
+		return false;
+
+	mProgram = p.release();
+	return true;
+}
+
+void AnimationBlendTree::uncompile()
+{
+	delete mProgram;
+	mProgram = nullptr;
+}
+
+void AnimationBlendTree::Program::selectChildren(Step& step, const Instruction& ins, int lastNode, int currentNode, float changeTime, float fadeDuration, float time)
+{
+	const uint16_t n1 = lastNode < 0 ? ins.child1 : uint16_t(lastNode);
+	const uint16_t n2 = currentNode < 0 ? ins.child1 : uint16_t(currentNode);
+
+	if(time >= changeTime + fadeDuration)
+		step.src1 = n2;
+	else if(time <= changeTime)
+		step.src1 = n1;
+	else {
+		step.src1 = n1;
+		step.src2 = n2;
+		step.t = (time - changeTime) / fadeDuration;
+		MCD_ASSERT(step.t >= 0 && step.t <= 1);
+	}
+}
+
+Pose AnimationBlendTree::runProgram()
+{
+	typedef Program::Instruction Instruction;
+	typedef Program::Step Step;
+	typedef AnimationClip::Sample Sample;
+
+	Program& p = *mProgram;
+	const size_t count = p.instructions.size();
+	MCD_ASSERT(count == nodes.size());
+	const float time = currentTime();
+
+	// The state machines may move the time line of their children
+	for(size_t i=0; i<count; ++i) {
+		if(p.instructions[i].op == Program::Fsm)
+			nodes[i].begin(*this);
+	}
+
+	// Top-down: accumulate the reference time, and mark the children needed by an active
+	// parent, such that the branches of zero weight are never evaluated
+	p.states.assign(count, uint8_t(Program::Skipped));
+	p.states[count - 1] = Program::Active;
+	for(size_t i=count; i--; ) {
+		const INode& node = nodes[i];
+		p.refTimes[i] = node.parent < count ? p.refTimes[node.parent] + node.localRefTime : node.localRefTime;
+		if(p.states[i] == Program::Skipped)
+			continue;
+
+		const Instruction& ins = p.instructions[i];
+		Step& step = p.steps[i];
+		step.src2 = Program::cNone;
+
+		switch(ins.op) {
+		case Program::Lerp:
+			step.t = static_cast<const LerpNode&>(node).t;
+			step.src1 = step.t == 1 ? ins.child2 : ins.child1;
+			if(step.t != 0 && step.t != 1)
+				step.src2 = ins.child2;
+			break;
+		case Program::Subtractive:
+		case Program::Additive:
+			step.src1 = ins.child1;
+			step.src2 = ins.child2;
+			break;
+		case Program::Switch: {
+			const SwitchNode& n = static_cast<const SwitchNode&>(node);
+			Program::selectChildren(step, ins, n.mLastNode, n.mCurrentNode, n.mNodeChangeTime, n.fadeDuration, time);
+		}	break;
+		case Program::Fsm: {
+			const FsmNode& n = static_cast<const FsmNode&>(node);
+			const int n2 = n.mCurrentNode < 0 ? ins.child1 : n.mCurrentNode;
+			Program::selectChildren(step, ins, n.mLastNode, n.mCurrentNode, nodes[n2].localRefTime, n.mFadeDuration, time);
+		}	break;
+		default:
+			continue;
+		}
+
+		p.states[step.src1] = Program::Active;
+		if(step.src2 != Program::cNone)
+			p.states[step.src2] = Program::Active;
+	}
+
+	// Bottom-up: calculate the poses of the active nodes
+	for(size_t i=0; i<count; ++i) {
+		if(p.states[i] == Program::Skipped)
+			continue;
+
+		const Instruction& ins = p.instructions[i];
+
+		if(ins.op == Program::Clip) {
+			ClipNode& n = static_cast<ClipNode&>(nodes[i]);
+			const float t = p.refTimes[i];
+			n.state.worldTime = time;
+			n.state.worldRefTime = (n.duration <= 0 || t + n.duration > time) ? t : time - n.duration;
+
+			if(p.trackCount == 0 && n.state.clip->trackCount() != 0) {
+				p.trackCount = n.state.clip->trackCount();
+				p.registers.resize(p.trackCount * p.registerCount);
+			}
+			if(p.trackCount == 0) {
+				Log::format(Log::Warn, "A node in AnimationBlendTree has zero track count\n");
+				continue;
+			}
+
+			n.state.assignTo(Pose(p.pose(ins.reg), p.trackCount));
+			p.states[i] = Program::Ready;
+			continue;
+		}
+
+		const Step& step = p.steps[i];
+		if(p.states[step.src1] != Program::Ready)
+			continue;
+		if(step.src2 != Program::cNone && p.states[step.src2] != Program::Ready)
+			continue;
+		p.states[i] = Program::Ready;
+
+		const size_t trackCount = p.trackCount;
+		Sample* dest = p.pose(ins.reg);
+		const Sample* s1 = p.pose(p.instructions[step.src1].reg);
+
+		if(step.src2 == Program::cNone) {
+			if(dest != s1)
+				std::copy(s1, s1 + trackCount, dest);
+			continue;
+		}
+
+		const Sample* s2 = p.pose(p.instructions[step.src2].reg);
+
+		switch(ins.op) {
+		case Program::Subtractive:
+			MCD_ASSERT(dest == s1);
+			for(size_t j=0; j<trackCount; ++j) {
+				MCD_ASSERT(dest[j].flag == s2[j].flag);
+				if(dest[j].flag == AnimationClip::Slerp)
+					dest[j].cast<Quaternionf>() = s2[j].cast<Quaternionf>().inverse() * dest[j].cast<Quaternionf>();
+				else
+					dest[j].v = dest[j].v - s2[j].v;
+			}
+			break;
+		case Program::Additive:
+			MCD_ASSERT(dest == s1);
+			for(size_t j=0; j<trackCount; ++j) {
+				if(dest[j].flag == AnimationClip::Slerp)
+					dest[j].cast<Quaternionf>() = dest[j].cast<Quaternionf>() * s2[j].cast<Quaternionf>();
+				else
+					dest[j].v = dest[j].v + s2[j].v;
+			}
+			break;
+		default:	// The blending of Lerp, Switch and Fsm, where the destination may alias either source
+			for(size_t j=0; j<trackCount; ++j) {
+				dest[j].blend(step.t, s1[j], s2[j]);
+				dest[j].flag = s1[j].flag;
+			}
+			break;
+		}
+	}
+
+	if(p.states[count - 1] != Program::Ready)
+		return Pose(nullptr, 0);
+	return Pose(p.pose(p.instructions[count - 1].reg), p.trackCount);
+}
+
 float AnimationBlendTree::INode::worldRefTime(AnimationBlendTree& tree) const
 {
 	if(parent >= tree.nodes.size()) return localRefTime;
@@ -310,6 +634,7 @@ bool AnimationBlendTree::loadFromXml(const char* xml, ResourceManager& mgr, cons
 	parser.parse(tmp);
 
 	// Reset all stateful member first
+	uncompile();
 	nodes.clear();
 	mTrackCount = 0;
 
@@ -398,6 +723,222 @@ std::string AnimationBlendTree::saveToXml() const
 	return getXmlStr(*this, nodes.size()-1, sorter.children);
 }
 
+// The binary layout, written with the utility functions in Stream.h:
+//	char[4]		"MBT2"
+//	uint16_t	Byte order mark 0xFEFF, the numbers are in the byte order of the writing machine
+//	uint16_t	Node count, register count
+//	For each node, in the order of the instruction stream:
+//		char		Op code, register
+//		uint16_t	Parent, first child, second child (0xFFFF for none)
+//		float		Duration, localRefTime
+//		string		Name, userData
+//		Clip:		float rate, string clip path
+//		Lerp:		float t
+//		Switch:		float fadeDuration, uint16_t current node
+//		Fsm:		uint16_t starting node, uint16_t transition count,
+//					for each transition: char type, uint16_t src, uint16_t dest, float duration, string userData
+static const char cBinaryMagic[4] = { 'M', 'B', 'T', '2' };
+static const uint16_t cByteOrderMark = 0xFEFF;
+
+bool AnimationBlendTree::saveToBinary(std::ostream& os) const
+{
+	if(!os || nodes.empty())
+		return false;
+
+	// Compile a temporary copy if needed, the compiled form is part of the file
+	std::auto_ptr<AnimationBlendTree> compiled;
+	const AnimationBlendTree* tree = this;
+	if(!mProgram) {
+		compiled.reset(new AnimationBlendTree(*this));
+		if(!compiled->compile())
+			return false;
+		tree = compiled.get();
+	}
+
+	const Program& p = *tree->mProgram;
+	const size_t count = p.instructions.size();
+
+	MCD::write(os, cBinaryMagic, sizeof(cBinaryMagic));
+	MCD::write(os, cByteOrderMark);
+	MCD::write(os, uint16_t(count));
+	MCD::write(os, uint16_t(p.registerCount));
+
+	for(size_t i=0; i<count; ++i) {
+		const Program::Instruction& ins = p.instructions[i];
+		const INode& node = tree->nodes[i];
+
+		MCD::write(os, char(ins.op));
+		MCD::write(os, char(ins.reg));
+		MCD::write(os, uint16_t(node.parent < count ? node.parent : Program::cNone));
+		MCD::write(os, ins.child1);
+		MCD::write(os, ins.child2);
+		MCD::write(os, node.duration);
+		MCD::write(os, node.localRefTime);
+		MCD::writeString(os, node.name.c_str(), node.name.size());
+		MCD::writeString(os, node.userData.c_str(), node.userData.size());
+
+		switch(ins.op) {
+		case Program::Clip: {
+			const ClipNode& n = static_cast<const ClipNode&>(node);
+			MCD::write(os, n.state.rate);
+			MCD::writeString(os, n.state.clip ? n.state.clip->fileId().getString() : std::string());
+		}	break;
+		case Program::Lerp:
+			MCD::write(os, static_cast<const LerpNode&>(node).t);
+			break;
+		case Program::Switch: {
+			const SwitchNode& n = static_cast<const SwitchNode&>(node);
+			MCD::write(os, n.fadeDuration);
+			MCD::write(os, uint16_t(n.mCurrentNode < 0 ? Program::cNone : n.mCurrentNode));
+		}	break;
+		case Program::Fsm: {
+			const FsmNode& n = static_cast<const FsmNode&>(node);
+			MCD::write(os, uint16_t(n.startingNode));
+			MCD::write(os, uint16_t(n.transitions.size()));
+			for(size_t j=0; j<n.transitions.size(); ++j) {
+				const FsmNode::Transition& t = n.transitions[j];
+				MCD::write(os, char(t.type));
+				MCD::write(os, uint16_t(t.src));
+				MCD::write(os, uint16_t(t.dest));
+				MCD::write(os, t.duration);
+				MCD::writeString(os, t.userData.c_str(), t.userData.size());
+			}
+		}	break;
+		default:
+			break;
+		}
+	}
+
+	return !!os;
+}
+
+bool AnimationBlendTree::loadFromBinary(std::istream& is, ResourceManager& mgr, const char* clipSearchPath)
+{
+	// Simplying the error check
+	#define ABORT_IF(expression) if(expression) { nodes.clear(); return false; }
+
+	// Reset all stateful member first
+	uncompile();
+	nodes.clear();
+	mTrackCount = 0;
+
+	char magic[sizeof(cBinaryMagic)];
+	uint16_t byteOrderMark, count, registerCount;
+	ABORT_IF(MCD::read(is, magic, sizeof(magic)) != std::streamsize(sizeof(magic)) || memcmp(magic, cBinaryMagic, sizeof(magic)) != 0);
+	ABORT_IF(!MCD::read(is, byteOrderMark));
+
+	// No byte swapping is done, refuse the data written by a machine of the other byte order
+	if(byteOrderMark != cByteOrderMark) {
+		Log::write(Log::Error, byteOrderMark == 0xFFFE ?
+			"AnimationBlendTree binary data is written with a different byte order\n" :
+			"AnimationBlendTree binary data has an invalid byte order mark\n"
+		);
+		ABORT_IF(true);
+	}
+
+	ABORT_IF(!MCD::read(is, count) || count == 0 || count == Program::cNone);
+	ABORT_IF(!MCD::read(is, registerCount) || registerCount > Program::cMaxRegister);
+
+	std::auto_ptr<Program> p(new Program);
+	p->resize(count);
+	p->registerCount = registerCount;
+
+	std::string str, name, userData;
+	for(size_t i=0; i<count; ++i) {
+		Program::Instruction& ins = p->instructions[i];
+		char op, reg;
+		uint16_t parent;
+		float duration, localRefTime;
+		ABORT_IF(!MCD::read(is, op) || !MCD::read(is, reg));
+		ABORT_IF(!MCD::read(is, parent) || !MCD::read(is, ins.child1) || !MCD::read(is, ins.child2));
+		ABORT_IF(!MCD::read(is, duration) || !MCD::read(is, localRefTime));
+		ABORT_IF(!MCD::readString(is, name) || !MCD::readString(is, userData));
+		ins.op = uint8_t(op);
+		ins.reg = uint8_t(reg);
+
+		INode* n = nullptr;
+		switch(ins.op) {
+		case Program::Clip: {
+			ClipNode* clip = new ClipNode;
+			n = clip;
+			nodes.push_back(n);
+			ABORT_IF(!MCD::read(is, clip->state.rate) || !MCD::readString(is, str));
+			Path path(str.c_str());
+			if(!path.hasRootDirectory() && clipSearchPath)
+				path = Path(clipSearchPath)/path;
+			clip->state.clip = mgr.loadAs<AnimationClip>(path, 1);
+		}	break;
+		case Program::Lerp: {
+			LerpNode* lerp = new LerpNode;
+			n = lerp;
+			nodes.push_back(n);
+			ABORT_IF(!MCD::read(is, lerp->t));
+		}	break;
+		case Program::Subtractive:
+			nodes.push_back(n = new SubtractiveNode);
+			break;
+		case Program::Additive:
+			nodes.push_back(n = new AdditiveNode);
+			break;
+		case Program::Switch: {
+			SwitchNode* s = new SwitchNode;
+			n = s;
+			nodes.push_back(n);
+			uint16_t current;
+			ABORT_IF(!MCD::read(is, s->fadeDuration) || !MCD::read(is, current));
+			// The current node must be a child of this switch, and the children come before their parent
+			ABORT_IF(current != Program::cNone && (current >= i || nodes[current].parent != i));
+			if(current != Program::cNone)
+				s->switchTo(current, 0);
+		}	break;
+		case Program::Fsm: {
+			FsmNode* fsm = new FsmNode(*this);
+			n = fsm;
+			nodes.push_back(n);
+			uint16_t starting, transitionCount;
+			ABORT_IF(!MCD::read(is, starting) || starting >= i || nodes[starting].parent != i || !MCD::read(is, transitionCount));
+			fsm->startingNode = starting;
+			fsm->transitions.resize(transitionCount);
+			for(size_t j=0; j<transitionCount; ++j) {
+				FsmNode::Transition& t = fsm->transitions[j];
+				char type;
+				uint16_t src, dest;
+				ABORT_IF(!MCD::read(is, type) || !MCD::read(is, src) || !MCD::read(is, dest));
+				ABORT_IF(type < FsmNode::Transition::Sync || type > FsmNode::Transition::Auto);
+				ABORT_IF(src >= i || dest >= i || nodes[src].parent != i || nodes[dest].parent != i);
+				t.type = FsmNode::Transition::Type(type);
+				t.src = src;
+				t.dest = dest;
+				ABORT_IF(!MCD::read(is, t.duration) || !MCD::readString(is, str));
+				t.userData = str.c_str();
+			}
+		}	break;
+		default:
+			ABORT_IF(true);
+		}
+
+		n->parent = parent == Program::cNone ? size_t(-1) : parent;
+		n->duration = duration;
+		n->localRefTime = localRefTime;
+		n->name = name.c_str();
+		n->userData = userData.c_str();
+	}
+
+	// Verify the stored instructions against the nodes, by linking them again
+	const Program stored(*p);
+	ABORT_IF(!p->link(nodes) || p->registerCount != stored.registerCount);
+	for(size_t i=0; i<count; ++i) {
+		const Program::Instruction& a = p->instructions[i], &b = stored.instructions[i];
+		ABORT_IF(a.reg != b.reg || a.child1 != b.child1 || a.child2 != b.child2);
+	}
+
+	mProgram = p.release();
+	worldTime = referenceTime = (float)Timer::sinceProgramStatup().asSecond();
+	return true;
+
+	#undef ABORT_IF
+}
+
 INode* AnimationBlendTree::ClipNode::clone() const
 {
 	return new ClipNode(*this);
@@ -684,7 +1225,8 @@ std::string AnimationBlendTree::SwitchNode::xmlEnd() const
 }
 
 AnimationBlendTree::FsmNode::FsmNode(AnimationBlendTree& tree)
-	: mTree(tree)
+	: mTargetingNode(-1)
+	, mTree(tree)
 	, mFadeDuration(0)
 	, mCurrentNode(-1), mLastNode(-1)
 	, mNode1(nullptr), mNode2(nullptr)
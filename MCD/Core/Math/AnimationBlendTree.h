@@ -5,6 +5,7 @@
 #include "ShortestPathMatrix.h"
 #include "../System/StringHash.h"
 #include "../System/PtrVector.h"
+#include <iosfwd>
 #include <vector>
 
 namespace MCD {
@@ -20,6 +21,11 @@ class ResourceManager;
 /// in the node array, intermediate results will be calculated on demand and store into
 /// a cache. Parent nodes will ask for the cached result of their children such that
 /// the result will propagate to the root node.
+///
+/// Alternatively the tree can be compiled into a linear instruction stream, one instruction
+/// per node, where the intermediate poses live in pre-allocated registers. The compiled
+/// tree skips the branches of zero weight and evaluates the remaining nodes in a single loop,
+/// it can also be saved to a compact binary file (see saveToBinary()).
 class MCD_CORE_API AnimationBlendTree
 {
 public:
@@ -136,6 +142,7 @@ public:
 		float fadeDuration;	///< The duration used during cross-fading
 
 	protected:
+		friend class AnimationBlendTree;
 		int mCurrentNode, mLastNode;
 		float mNodeChangeTime;	///< The world time when the last node change happened
 		INode* mNode1, *mNode2;
@@ -180,6 +187,7 @@ public:
 		Transitions transitions;
 
 	protected:
+		friend class AnimationBlendTree;
 		sal_maybenull Transition* findTransitionFor(int src, int dest);
 		void computeShortestPath();
 
@@ -211,9 +219,28 @@ public:
 	void inOrderSort();
 
 	/// Get the final animated data out of this blend tree.
+	/// The compiled instructions are used if compile() was invoked.
 	/// May get a null Pose if something get wrong.
 	Pose getFinalPose();
 
+	/// Flatten the in-order sorted nodes into the instruction stream used by getFinalPose().
+	/// Must be invoked again once you have changes in the tree structure, parameters
+	/// like LerpNode::t can be changed freely.
+	/// Returns false if the tree is malformed (eg. a blend node without enough children).
+	sal_checkreturn bool compile();
+
+	/// Back to the node by node evaluation.
+	void uncompile();
+
+	bool isCompiled() const { return mProgram != nullptr; }
+
+	/// Save the nodes together with their compiled instructions, the tree
+	/// is compiled on the fly if it is not yet compiled.
+	sal_checkreturn bool saveToBinary(std::ostream& os) const;
+
+	/// Load the tree saved by saveToBinary(), the loaded tree is ready to use in it's compiled form.
+	sal_checkreturn bool loadFromBinary(std::istream& is, ResourceManager& mgr, const char* clipSearchPath=nullptr);
+
 	/// Fill the blend tree from an Xml file, a ResourceManager is also needed
 	/// in order to load the animation tracks.
 	sal_checkreturn bool loadFromXml(const char* xml, ResourceManager& mgr, const char* clipSearchPath=nullptr);
@@ -227,6 +254,10 @@ protected:
 	void releasePose(int idx);
 	void resetPoseBuffer();
 
+	struct Program;
+	Pose runProgram();
+
+	Program* mProgram;	///< Null if the tree is not compiled
 	size_t mTrackCount;	///< All tree nodes should have the same number of animation channel.
 	AnimationClip::Sample* mPoseBuffer;
 	static const size_t cPoseCacheSize = 8;
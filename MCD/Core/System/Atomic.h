@@ -11,9 +11,40 @@
 
 namespace MCD {
 
-/*!	A thread safe variable of any type. Protects assignments with a mutex.
+#if defined(MCD_VC) || defined(__ATOMIC_ACQUIRE)
+#	define MCD_LOCKFREE_ATOMICVALUE 1
+#else
+#	define MCD_LOCKFREE_ATOMICVALUE 0
+#endif
+
+/*!	Types which AtomicValue can load and store without a lock:
+	pointers and the built-in types no larger than a pointer.
+ */
+template<typename T> struct IsLockFreeAtomic { static const bool RET = false; };
+template<typename T> struct IsLockFreeAtomic<T*> { static const bool RET = MCD_LOCKFREE_ATOMICVALUE != 0; };
+
+#define MCD_LOCKFREE_ATOMIC_TYPE(T) \
+	template<> struct IsLockFreeAtomic<T> { static const bool RET = MCD_LOCKFREE_ATOMICVALUE != 0 && sizeof(T) <= sizeof(void*); };
+
+MCD_LOCKFREE_ATOMIC_TYPE(bool)
+MCD_LOCKFREE_ATOMIC_TYPE(char)
+MCD_LOCKFREE_ATOMIC_TYPE(signed char)
+MCD_LOCKFREE_ATOMIC_TYPE(unsigned char)
+MCD_LOCKFREE_ATOMIC_TYPE(short)
+MCD_LOCKFREE_ATOMIC_TYPE(unsigned short)
+MCD_LOCKFREE_ATOMIC_TYPE(int)
+MCD_LOCKFREE_ATOMIC_TYPE(unsigned int)
+MCD_LOCKFREE_ATOMIC_TYPE(long)
+MCD_LOCKFREE_ATOMIC_TYPE(unsigned long)
+MCD_LOCKFREE_ATOMIC_TYPE(float)
+MCD_LOCKFREE_ATOMIC_TYPE(double)
+
+#undef MCD_LOCKFREE_ATOMIC_TYPE
+
+/*!	A thread safe variable of any type. Protects assignments with a mutex,
+	or with atomic load (acquire) and store (release) if IsLockFreeAtomic<T>.
  */
-template<typename T, typename TArg=typename ParamType<const T>::RET>
+template<typename T, typename TArg=typename ParamType<const T>::RET, bool LockFree=IsLockFreeAtomic<T>::RET>
 class AtomicValue
 {
 public:
@@ -62,6 +93,59 @@ protected:
 	mutable Mutex mMutex;
 };	// AtomicValue
 
+template<typename T, typename TArg>
+class AtomicValue<T, TArg, true>
+{
+public:
+	AtomicValue() : mVal() {}
+
+	explicit AtomicValue(TArg val) : mVal(val) {}
+
+	AtomicValue(const AtomicValue& rhs) : mVal() {
+		set(rhs.get());
+	}
+
+	AtomicValue& operator=(const AtomicValue& rhs)
+	{
+		set(rhs.get());
+		return *this;
+	}
+
+	AtomicValue& operator=(TArg val)
+	{
+		set(val);
+		return *this;
+	}
+
+	operator T() const {
+		return get();
+	}
+
+	T get() const
+	{
+#ifdef MCD_VC
+		return mVal;	// Volatile read has acquire semantic in VC
+#else
+		T ret;
+		__atomic_load(&mVal, &ret, __ATOMIC_ACQUIRE);
+		return ret;
+#endif
+	}
+
+	void set(TArg val)
+	{
+#ifdef MCD_VC
+		mVal = val;		// Volatile write has release semantic in VC
+#else
+		T tmp = val;
+		__atomic_store(&mVal, &tmp, __ATOMIC_RELEASE);
+#endif
+	}
+
+protected:
+	volatile T mVal;
+};	// AtomicValue
+
 //!	An atomic integer class for performing increment and decrement operations.
 class AtomicInteger
 {
@@ -84,13 +168,21 @@ public:
 		return --(*this) + 1;
 	}
 
-	operator int() const {
-		return value;
-	}
+	//! Atomically replace the value, returning the old one. It's also a full memory barrier.
+	inline int exchange(int i);
+
+	//! Atomic load, with acquire semantic.
+	inline operator int() const;
+
 private:
 	volatile int value;
 };	// AtomicInteger
 
+/*!	Full memory barrier, neither the compiler nor the cpu will move any memory access across it.
+	Needed by the lock free structures, like SpscQueue, to publish data to another thread.
+ */
+inline void memoryBarrier();
+
 #if defined(MCD_VC)
 
 int AtomicInteger::operator++() {
@@ -101,6 +193,20 @@ int AtomicInteger::operator--() {
 	return _InterlockedDecrement((LONG*)&value);
 }
 
+int AtomicInteger::exchange(int i) {
+	return _InterlockedExchange((LONG*)&value, i);
+}
+
+AtomicInteger::operator int() const {
+	return value;	// Volatile read has acquire semantic in VC
+}
+
+void memoryBarrier() {
+	// Any interlocked operation is a full barrier
+	LONG barrier;
+	_InterlockedExchange(&barrier, 0);
+}
+
 #elif defined(MCD_GCC)
 
 // Reference: http://gcc.gnu.org/onlinedocs/gcc-4.1.2/gcc/Atomic-Builtins.html#Atomic-Builtins
@@ -110,7 +216,7 @@ int AtomicInteger::operator++()
 #ifdef MCD_APPLE
 	return OSAtomicIncrement32(&value);
 #else
-	return __sync_add_and_fetch((long*)&value, 1);
+	return __sync_add_and_fetch(&value, 1);
 #endif
 }
 
@@ -119,7 +225,40 @@ int AtomicInteger::operator--()
 #ifdef MCD_APPLE
 	return OSAtomicDecrement32(&value);
 #else
-	return __sync_sub_and_fetch((long*)&value, 1);
+	return __sync_sub_and_fetch(&value, 1);
+#endif
+}
+
+AtomicInteger::operator int() const
+{
+#if defined(__ATOMIC_ACQUIRE)	// Gcc 4.7 or above, also visible to ThreadSanitizer
+	return __atomic_load_n(&value, __ATOMIC_ACQUIRE);
+#else
+	return value;
+#endif
+}
+
+int AtomicInteger::exchange(int i)
+{
+#ifdef MCD_APPLE
+	int old;
+	do {
+		old = value;
+	} while(!OSAtomicCompareAndSwap32Barrier(old, i, &value));
+	return old;
+#else
+	// __sync_lock_test_and_set() is only an acquire barrier
+	__sync_synchronize();
+	return __sync_lock_test_and_set(&value, i);
+#endif
+}
+
+void memoryBarrier()
+{
+#ifdef MCD_APPLE
+	OSMemoryBarrier();
+#else
+	__sync_synchronize();
 #endif
 }
 
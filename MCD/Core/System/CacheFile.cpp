@@ -0,0 +1,44 @@
+#include "Pch.h"
+#include "CacheFile.h"
+#include "Log.h"
+#include "RawFileSystem.h"
+#include <iostream>
+#include <stdio.h>	// For sprintf, remove and rename
+
+namespace MCD {
+
+Path cacheFileName(uint64_t key, const char* extension)
+{
+	char buf[32];
+	::sprintf(buf, "%08x%08x.", uint32_t(key >> 32), uint32_t(key));
+	return Path(std::string(buf) + extension);
+}
+
+bool writeCacheFile(const RawFileSystem& fs, const Path& fileName, const void* header, size_t headerSize, const void* data, size_t dataSize)
+{
+	const Path tmpFileName = fileName.getString() + ".tmp";
+	bool written = false;
+	{	std::auto_ptr<std::ostream> os = fs.openWrite(tmpFileName);
+		if(os.get()) {
+			os->write(reinterpret_cast<const char*>(header), std::streamsize(headerSize));
+			os->write(reinterpret_cast<const char*>(data), std::streamsize(dataSize));
+			written = !!(*os);
+		}
+	}
+
+	const Path target = fs.toAbsolutePath(fileName);
+	const Path tmp = fs.toAbsolutePath(tmpFileName);
+	if(written) {
+		// Rename cannot replace an existing file on Windows
+		::remove(target.c_str());
+		written = ::rename(tmp.c_str(), target.c_str()) == 0;
+	}
+	if(!written) {
+		::remove(tmp.c_str());
+		Log::format(Log::Warn, "Fail to write the cache file \"%s\"", target.c_str());
+	}
+
+	return written;
+}
+
+}	// namespace MCD
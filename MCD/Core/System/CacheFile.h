@@ -0,0 +1,47 @@
+#ifndef __MCD_CORE_SYSTEM_CACHEFILE__
+#define __MCD_CORE_SYSTEM_CACHEFILE__
+
+#include "Path.h"
+
+namespace MCD {
+
+class RawFileSystem;
+
+/*!	The common beginning of a cache file header, such as the BVH and the byte code cache.
+	A cache header embeds it as its first member and appends its own fields.
+ */
+struct CacheFileHeader
+{
+	uint32_t magic;		//!< Also tells the byte order
+	uint32_t version;
+	uint64_t key;		//!< Hash of what is cached, which is also the file name
+
+	void set(uint32_t magic, uint32_t version, uint64_t key);
+
+	bool isValid(uint32_t magic, uint32_t version, uint64_t key) const;
+};	// CacheFileHeader
+
+//! The file name of a cache entry, the key in hex followed by \em extension (without the dot).
+MCD_CORE_API Path cacheFileName(uint64_t key, sal_in_z const char* extension);
+
+/*!	Write a header followed by the data to a cache file.
+	It's written to a temporary file and then renamed, such that the others which still
+	read or map the old file never see it half written.
+	Returns false and logs a warning on failure, where no temporary file is left behind.
+ */
+MCD_CORE_API bool writeCacheFile(
+	const RawFileSystem& fs, const Path& fileName,
+	sal_in_bcount(headerSize) const void* header, size_t headerSize,
+	sal_in_bcount(dataSize) const void* data, size_t dataSize);
+
+inline void CacheFileHeader::set(uint32_t magic_, uint32_t version_, uint64_t key_) {
+	magic = magic_; version = version_; key = key_;
+}
+
+inline bool CacheFileHeader::isValid(uint32_t magic_, uint32_t version_, uint64_t key_) const {
+	return magic == magic_ && version == version_ && key == key_;
+}
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_CACHEFILE__
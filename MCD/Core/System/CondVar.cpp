@@ -2,6 +2,7 @@
 #include "CondVar.h"
 #include "PlatformInclude.h"
 #include "Timer.h"
+#include <limits.h>	// For INT_MAX
 
 namespace MCD {
 
@@ -82,6 +83,67 @@ wait:
 }
 #pragma warning(pop)
 
+#elif defined(MCD_LINUX)
+
+CondVar::CondVar()
+	: Mutex(), mSequence(0), mWaitCount(0)
+{
+}
+
+CondVar::~CondVar()
+{
+	MCD_ASSERT(mWaitCount == 0);
+}
+
+void CondVar::signalNoLock()
+{
+#ifndef NDEBUG
+	MCD_ASSERT(_locked);
+#endif
+	if(mWaitCount == 0)
+		return;
+	__sync_add_and_fetch(&mSequence, 1);
+	futexWake(&mSequence, 1);
+}
+
+void CondVar::broadcastNoLock()
+{
+#ifndef NDEBUG
+	MCD_ASSERT(_locked);
+#endif
+	if(mWaitCount == 0)
+		return;
+	__sync_add_and_fetch(&mSequence, 1);
+	futexWake(&mSequence, INT_MAX);
+}
+
+void CondVar::waitNoLock()
+{
+	(void)_waitNoLock(nullptr);
+}
+
+bool CondVar::waitNoLock(const TimeInterval& timeOut)
+{
+	const double sec = timeOut.asSecond();
+	timespec t;
+	t.tv_sec = time_t(sec);
+	t.tv_nsec = long((sec - double(t.tv_sec)) * 1e9);
+	return _waitNoLock(&t);
+}
+
+bool CondVar::_waitNoLock(const timespec* timeout)
+{
+	// Any signal after reading the sequence changes it, so the futex will not sleep
+	++mWaitCount;
+	const int sequence = mSequence;
+	unlock();
+	const bool timedOut = futexWait(&mSequence, sequence, timeout) != 0 && errno == ETIMEDOUT;
+	lock();
+	--mWaitCount;
+
+	return !timedOut;
+}
+
 #else
 
 CondVar::CondVar() : Mutex()
@@ -3,6 +3,10 @@
 
 #include "Mutex.h"
 
+#ifdef MCD_LINUX
+struct timespec;
+#endif
+
 namespace MCD {
 
 class TimeInterval;
@@ -18,6 +22,9 @@ class TimeInterval;
 	releases the associated lock and suspends the current thread.
 
 	A CondVar instance is intrinsically bound to a Mutex.
+
+	On Linux it waits on a futex, signal() and broadcast() make no system call
+	if there is no waiting thread.
  */
 class MCD_CORE_API CondVar : public Mutex
 {
@@ -77,6 +84,10 @@ private:
 	void* h[2];	// h[0]:signal, h[1]:broadcast
 	int mWaitCount;
 	int mBroadcastCount;
+#elif defined(MCD_LINUX)
+	bool _waitNoLock(const timespec* timeout);
+	volatile int mSequence;	//!< Increased by every signal, the waiting threads sleep on it
+	int mWaitCount;			//!< Protected by the mutex
 #else
 	bool _waitNoLock(useconds_t microseconds);
 	pthread_cond_t c;
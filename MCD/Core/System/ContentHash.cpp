@@ -0,0 +1,211 @@
+#include "Pch.h"
+#include "ContentHash.h"
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string.h>	// For memcpy
+
+namespace MCD {
+
+namespace {
+
+const uint64_t cPrime1 = 11400714785074694791ULL;
+const uint64_t cPrime2 = 14029467366897019727ULL;
+const uint64_t cPrime3 = 1609587929392839161ULL;
+const uint64_t cPrime4 = 9650029242287828579ULL;
+const uint64_t cPrime5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+// NOTE: memcpy for unaligned read, assuming a little endian machine
+inline uint64_t read64(const uint8_t* p) {
+	uint64_t v; ::memcpy(&v, p, sizeof(v)); return v;
+}
+
+inline uint32_t read32(const uint8_t* p) {
+	uint32_t v; ::memcpy(&v, p, sizeof(v)); return v;
+}
+
+inline uint64_t xxRound(uint64_t acc, uint64_t input) {
+	acc += input * cPrime2;
+	return rotl(acc, 31) * cPrime1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+	acc ^= xxRound(0, val);
+	return acc * cPrime1 + cPrime4;
+}
+
+static const char cIndexHeader[] = "MCDContentHashIndex";
+static const int cIndexVersion = 1;
+
+}	// namespace
+
+uint64_t hashContent64(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+	const uint8_t* end = p + size;
+	uint64_t h;
+
+	if(size >= 32) {
+		const uint8_t* limit = end - 32;
+		uint64_t v1 = seed + cPrime1 + cPrime2;
+		uint64_t v2 = seed + cPrime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - cPrime1;
+
+		do {
+			v1 = xxRound(v1, read64(p)); p += 8;
+			v2 = xxRound(v2, read64(p)); p += 8;
+			v3 = xxRound(v3, read64(p)); p += 8;
+			v4 = xxRound(v4, read64(p)); p += 8;
+		} while(p <= limit);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = mergeRound(h, v1);
+		h = mergeRound(h, v2);
+		h = mergeRound(h, v3);
+		h = mergeRound(h, v4);
+	}
+	else
+		h = seed + cPrime5;
+
+	h += uint64_t(size);
+
+	for(; p + 8 <= end; p += 8) {
+		h ^= xxRound(0, read64(p));
+		h = rotl(h, 27) * cPrime1 + cPrime4;
+	}
+
+	if(p + 4 <= end) {
+		h ^= uint64_t(read32(p)) * cPrime1;
+		h = rotl(h, 23) * cPrime2 + cPrime3;
+		p += 4;
+	}
+
+	for(; p < end; ++p) {
+		h ^= (*p) * cPrime5;
+		h = rotl(h, 11) * cPrime1;
+	}
+
+	// Avalanche
+	h ^= h >> 33;
+	h *= cPrime2;
+	h ^= h >> 29;
+	h *= cPrime3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+class ContentHashIndex::Impl
+{
+public:
+	struct Entry
+	{
+		uint64_t hash;
+		uint64_t size;
+		std::time_t lastWriteTime;
+	};	// Entry
+
+	typedef std::map<Path, Entry> Entries;
+	Entries mEntries;
+};	// Impl
+
+ContentHashIndex::ContentHashIndex()
+	: mImpl(*new Impl)
+{
+}
+
+ContentHashIndex::~ContentHashIndex()
+{
+	delete &mImpl;
+}
+
+bool ContentHashIndex::find(const Path& fileId, uint64_t size, std::time_t lastWriteTime, uint64_t& hash) const
+{
+	Impl::Entries::const_iterator i = mImpl.mEntries.find(fileId);
+	if(i == mImpl.mEntries.end() || i->second.size != size || i->second.lastWriteTime != lastWriteTime)
+		return false;
+
+	hash = i->second.hash;
+	return true;
+}
+
+void ContentHashIndex::set(const Path& fileId, uint64_t hash, uint64_t size, std::time_t lastWriteTime)
+{
+	Impl::Entry& e = mImpl.mEntries[fileId];
+	e.hash = hash;
+	e.size = size;
+	e.lastWriteTime = lastWriteTime;
+}
+
+void ContentHashIndex::remove(const Path& fileId)
+{
+	mImpl.mEntries.erase(fileId);
+}
+
+void ContentHashIndex::clear()
+{
+	mImpl.mEntries.clear();
+}
+
+/*!	The index is stored as text, one file per line:
+	<hash in hex> <size> <last write time> <path till the end of line>
+ */
+bool ContentHashIndex::load(std::istream& is)
+{
+	std::string header;
+	int version = 0;
+	if(!(is >> header >> version) || header != cIndexHeader || version != cIndexVersion)
+		return false;
+
+	Impl::Entries entries;
+	std::string line;
+	std::getline(is, line);	// Skip the end of the header line
+
+	while(std::getline(is, line)) {
+		if(line.empty())
+			continue;
+
+		std::istringstream ss(line);
+		Impl::Entry e;
+		long long lastWriteTime;
+		std::string path;
+		if(!(ss >> std::hex >> e.hash >> std::dec >> e.size >> lastWriteTime))
+			return false;
+		ss.get();	// The separating space
+		if(!std::getline(ss, path) || path.empty())
+			return false;
+
+		e.lastWriteTime = std::time_t(lastWriteTime);
+		entries[path] = e;
+	}
+
+	for(Impl::Entries::const_iterator i=entries.begin(); i!=entries.end(); ++i)
+		mImpl.mEntries[i->first] = i->second;
+
+	return true;
+}
+
+bool ContentHashIndex::save(std::ostream& os) const
+{
+	os << cIndexHeader << ' ' << cIndexVersion << '\n';
+
+	for(Impl::Entries::const_iterator i=mImpl.mEntries.begin(); i!=mImpl.mEntries.end(); ++i) {
+		const Impl::Entry& e = i->second;
+		os << std::hex << e.hash << std::dec << ' ' << e.size << ' '
+		   << (long long)e.lastWriteTime << ' ' << i->first.getString() << '\n';
+	}
+
+	return os.good();
+}
+
+size_t ContentHashIndex::size() const
+{
+	return mImpl.mEntries.size();
+}
+
+}	// namespace MCD
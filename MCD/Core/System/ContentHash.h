@@ -0,0 +1,63 @@
+#ifndef __MCD_CORE_SYSTEM_CONTENTHASH__
+#define __MCD_CORE_SYSTEM_CONTENTHASH__
+
+#include "NonCopyable.h"
+#include "Path.h"
+#include <ctime>	// For std::time_t
+#include <iosfwd>
+
+namespace MCD {
+
+/*!	A fast 64 bits hash for identifying the content of a file.
+	It's the XXH64 algorithm, which process 32 bytes per iteration and runs
+	at the memory bandwidth, much faster than the byte wise FNV-1a.
+	\note Not a cryptographic hash.
+ */
+MCD_CORE_API uint64_t hashContent64(sal_in_bcount(size) const void* data, size_t size, uint64_t seed=0);
+
+/*!	Remembers the content hash of files, so that identical files can be found
+	without reading them again.
+
+	An entry is only valid as long as the size and the last write time of the
+	file are unchanged. The index can be saved to and loaded from a stream,
+	so it can persist between runs.
+
+	\sa ResourceManager::setContentDedup()
+ */
+class MCD_CORE_API ContentHashIndex : Noncopyable
+{
+public:
+	ContentHashIndex();
+
+	~ContentHashIndex();
+
+// Operations
+	/*!	Find the hash of a file.
+		Returns false if it's not in the index, or the size or write time changed.
+	 */
+	bool find(const Path& fileId, uint64_t size, std::time_t lastWriteTime, uint64_t& hash) const;
+
+	void set(const Path& fileId, uint64_t hash, uint64_t size, std::time_t lastWriteTime);
+
+	void remove(const Path& fileId);
+
+	void clear();
+
+	/*!	Merge the entries from a stream previously written by save().
+		Returns false if the stream is not a valid index, where nothing is merged.
+	 */
+	bool load(std::istream& is);
+
+	bool save(std::ostream& os) const;
+
+// Attributes
+	size_t size() const;
+
+protected:
+	class Impl;
+	Impl& mImpl;
+};	// ContentHashIndex
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_CONTENTHASH__
@@ -2,6 +2,7 @@
 #define __MCD_CORE_SYSTEM_FILESYSTEM__
 
 #include "Path.h"
+#include "ReadSpan.h"
 #include <memory>	// For std::auto_ptr
 #include <ctime>	// For std::time_t
 #include <iosfwd>	// For declaration of istream and ostream
@@ -54,6 +55,14 @@ public:
 	//!	Returns a std::ostream for writing, null if fail.
 	virtual std::auto_ptr<std::ostream> openWrite(const Path& path) const = 0;
 
+	/*!	Returns the whole content of the file as a contiguous block of memory, null if fail.
+		File systems which can give the memory without copying (memory mapping
+		for instance) should override this; the default reads the whole openRead() stream.
+	 */
+	virtual ReadSpanPtr openReadSpan(const Path& path) const {
+		return readSpanFromFileSystem(*this, path);
+	}
+
 	virtual sal_maybenull void* openFirstChildFolder(const Path& folder) const { return nullptr; }
 
 	virtual Path getNextSiblingFolder(sal_maybenull void* context) const { return Path(); }
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <list>
 #include <set>
+#include <vector>
 
 namespace MCD {
 
@@ -26,12 +27,21 @@ public:
 			delete (*i);
 	}
 
-	void addFileSystem(IFileSystem& fileSystem)
+	void addFileSystem(IFileSystem& fileSystem, int priority)
 	{
 		Impl::FileSystems::iterator i = std::find(mFileSystems.begin(), mFileSystems.end(), &fileSystem);
-		if(i != mFileSystems.end())
+		if(i != mFileSystems.end()) {
+			mPriorities.erase(mPriorities.begin() + std::distance(mFileSystems.begin(), i));
 			mFileSystems.erase(i);
-		mFileSystems.push_back(&fileSystem);
+		}
+
+		// Insert before the first one having a lower priority
+		Priorities::iterator p = mPriorities.begin();
+		i = mFileSystems.begin();
+		for(; p != mPriorities.end() && *p >= priority; ++p, ++i) {}
+
+		mPriorities.insert(p, priority);
+		mFileSystems.insert(i, &fileSystem);
 	}
 
 	bool removeFileSystem(const Path& fileSystemRootPath)
@@ -40,8 +50,10 @@ public:
 		for(FileSystems::iterator i=mFileSystems.begin(); i!=mFileSystems.end(); ) {
 			IFileSystem* fileSystem = (*i);
 			MCD_ASSUME(fileSystem != nullptr);
-			if(fileSystem->getRoot() == fileSystemRootPath)
+			if(fileSystem->getRoot() == fileSystemRootPath) {
+				mPriorities.erase(mPriorities.begin() + std::distance(mFileSystems.begin(), i));
 				i = mFileSystems.erase(i);
+			}
 			else
 				++i;
 		}
@@ -134,6 +146,10 @@ public:
 
 	typedef std::list<IFileSystem*> FileSystems;
 	FileSystems mFileSystems;
+
+	//!	Priority of each file system in mFileSystems, in descending order.
+	typedef std::vector<int> Priorities;
+	Priorities mPriorities;
 };	// Impl
 
 FileSystemCollection::FileSystemCollection()
@@ -148,7 +164,12 @@ FileSystemCollection::~FileSystemCollection()
 
 void FileSystemCollection::addFileSystem(IFileSystem& fileSystem)
 {
-	mImpl.addFileSystem(fileSystem);
+	mImpl.addFileSystem(fileSystem, 0);
+}
+
+void FileSystemCollection::addFileSystem(IFileSystem& fileSystem, int priority)
+{
+	mImpl.addFileSystem(fileSystem, priority);
 }
 
 bool FileSystemCollection::removeFileSystem(const Path& fileSystemRootPath)
@@ -238,6 +259,15 @@ std::auto_ptr<std::istream> FileSystemCollection::openRead(const Path& path) con
 	return fileSystem->openRead(path);
 }
 
+ReadSpanPtr FileSystemCollection::openReadSpan(const Path& path) const
+{
+	IFileSystem* fileSystem = mImpl.findFileSystemForPath(path);
+	if(!fileSystem)
+		return nullptr;
+
+	return fileSystem->openReadSpan(path);
+}
+
 std::auto_ptr<std::ostream> FileSystemCollection::openWrite(const Path& path) const
 {
 	if(IFileSystem* fileSystem = mImpl.findFileSystemForPath(path))
@@ -23,9 +23,18 @@ public:
 		\note The file search order depends on the order you add the file systems.
 		\note Adding the same file system twice will make that file system place at
 			the end of the ordering list.
+		\note Equivalent to addFileSystem(fileSystem, 0).
 	 */
 	void addFileSystem(IFileSystem& fileSystem);
 
+	/*!	Add a file system with a search priority.
+		File systems with a higher priority are searched first, for example a
+		PackFileSystem containing patched data can be given a higher priority
+		than the shipping one. Those having the same priority are searched in
+		the order they are added.
+	 */
+	void addFileSystem(IFileSystem& fileSystem, int priority);
+
 	bool removeFileSystem(const Path& fileSystemRootPath);
 
 	//!	For iterating the file systems in the collection.
@@ -56,6 +65,8 @@ public:
 	//!	Open the first occuring file in the file systems.
 	sal_override std::auto_ptr<std::istream> openRead(const Path& path) const;
 
+	sal_override ReadSpanPtr openReadSpan(const Path& path) const;
+
 	//!	Serach for any existing file in the file systems first, if none then save at the first writable file system.
 	sal_override std::auto_ptr<std::ostream> openWrite(const Path& path) const;
 
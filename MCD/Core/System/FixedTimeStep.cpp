@@ -0,0 +1,53 @@
+#include "Pch.h"
+#include "FixedTimeStep.h"
+
+namespace MCD {
+
+FixedTimeStep::FixedTimeStep(float stepSize_, size_t maxSteps_)
+	: stepSize(stepSize_), maxSteps(maxSteps_), mAccumulator(0), mDroppedTime(0)
+{
+	MCD_ASSERT(stepSize > 0);
+}
+
+size_t FixedTimeStep::advance(float frameTime)
+{
+	return advance(frameTime, maxSteps);
+}
+
+size_t FixedTimeStep::advance(float frameTime, size_t maxStepsOverride)
+{
+	if(frameTime > 0)
+		mAccumulator += frameTime;
+
+	size_t steps = size_t(mAccumulator / stepSize);
+	mAccumulator -= steps * stepSize;
+
+	// Guard against rounding, the accumulator should always be less than a step
+	if(mAccumulator >= stepSize) {
+		mAccumulator -= stepSize;
+		++steps;
+	}
+	if(mAccumulator < 0)
+		mAccumulator = 0;
+
+	// Drop the time that cannot be caught up, but keep the fraction for a smooth alpha
+	if(steps > maxStepsOverride) {
+		mDroppedTime += double(steps - maxStepsOverride) * stepSize;
+		steps = maxStepsOverride;
+	}
+
+	return steps;
+}
+
+void FixedTimeStep::reset()
+{
+	mAccumulator = 0;
+	mDroppedTime = 0;
+}
+
+float FixedTimeStep::alpha() const
+{
+	return mAccumulator / stepSize;
+}
+
+}	// namespace MCD
@@ -0,0 +1,63 @@
+#ifndef __MCD_CORE_SYSTEM_FIXEDTIMESTEP__
+#define __MCD_CORE_SYSTEM_FIXEDTIMESTEP__
+
+#include "../ShareLib.h"
+#include "Platform.h"
+
+namespace MCD {
+
+/*!	Turns variable frame times into a number of fixed size steps.
+
+	The frame time is accumulated, and each call to advance() tells how many whole
+	steps fit into it. The remaining fraction of a step, given by alpha(), is used
+	to interpolate between the last two states for rendering.
+
+	If a frame takes so long that more than maxSteps steps are due, the extra time is
+	dropped instead of carried over; otherwise a slow simulation makes the next frame
+	even slower (the spiral of death).
+
+	Example:
+	\code
+	FixedTimeStep timeStep(1.0f / 30, 4);
+	while(true) {
+		for(size_t i=timeStep.advance(frameTime); i--;)
+			simulate(timeStep.stepSize);
+		render(lerp(previousState, currentState, timeStep.alpha()));
+	}
+	\endcode
+ */
+class MCD_CORE_API FixedTimeStep
+{
+public:
+	explicit FixedTimeStep(float stepSize=1.0f/60, size_t maxSteps=5);
+
+// Operations
+	/*!	Accumulate the frame time, and returns the number of steps to take,
+		which is never larger than maxSteps.
+	 */
+	size_t advance(float frameTime);
+
+	//! Use \em maxStepsOverride instead of maxSteps for this frame.
+	size_t advance(float frameTime, size_t maxStepsOverride);
+
+	//! Clear the accumulated time.
+	void reset();
+
+// Attributes
+	//! The fraction of a step left in the accumulator, in the range of [0, 1).
+	float alpha() const;
+
+	//! Total time dropped because of the maxSteps limit.
+	double droppedTime() const { return mDroppedTime; }
+
+	float stepSize;
+	size_t maxSteps;
+
+protected:
+	float mAccumulator;
+	double mDroppedTime;
+};	// FixedTimeStep
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_FIXEDTIMESTEP__
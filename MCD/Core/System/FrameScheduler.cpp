@@ -0,0 +1,148 @@
+#include "Pch.h"
+#include "FrameScheduler.h"
+
+namespace MCD {
+
+FrameScheduler::FrameScheduler(float targetFrameTime_, IClock* clock)
+	: targetFrameTime(targetFrameTime_), smoothing(0.1f)
+	, mClock(clock), mFrameBeginTime(0)
+{
+	MCD_ASSERT(targetFrameTime > 0);
+	resetStatistic();
+}
+
+size_t FrameScheduler::addPhase(const char* name)
+{
+	Phase phase;
+	Statistic s = { name, 0, 0, 0, 0 };
+	phase.statistic = s;
+	phase.beginTime = 0;
+	phase.current = 0;
+	phase.ran = false;
+	mPhases.push_back(phase);
+	return mPhases.size() - 1;
+}
+
+size_t FrameScheduler::addTask(ITask& task, const char* name, int priority, float minBudget)
+{
+	Task t;
+	Statistic s = { name, 0, 0, 0, 0 };
+	t.statistic = s;
+	t.task = &task;
+	t.priority = priority;
+	t.minBudget = minBudget;
+	mTasks.push_back(t);
+
+	// Insert after the tasks of the same priority
+	const size_t index = mTasks.size() - 1;
+	std::vector<size_t>::iterator i = mTaskOrder.begin();
+	while(i != mTaskOrder.end() && mTasks[*i].priority >= priority)
+		++i;
+	mTaskOrder.insert(i, index);
+
+	return index;
+}
+
+void FrameScheduler::beginFrame()
+{
+	mFrameBeginTime = now();
+
+	for(size_t i=0; i<mPhases.size(); ++i) {
+		mPhases[i].current = 0;
+		mPhases[i].ran = false;
+	}
+}
+
+void FrameScheduler::beginPhase(size_t phase)
+{
+	Phase& p = mPhases[phase];
+	p.beginTime = now();
+	p.ran = true;
+}
+
+void FrameScheduler::endPhase(size_t phase)
+{
+	Phase& p = mPhases[phase];
+	p.current += float(now() - p.beginTime);
+}
+
+void FrameScheduler::runTasks()
+{
+	// Reserve time for the phases yet to run in this frame
+	double reserve = 0;
+	for(size_t i=0; i<mPhases.size(); ++i) {
+		if(!mPhases[i].ran)
+			reserve += mPhases[i].statistic.average;
+	}
+	const double deadline = frameDeadline() - reserve;
+
+	for(size_t i=0; i<mTaskOrder.size(); ++i) {
+		Task& t = mTasks[mTaskOrder[i]];
+		const double begin = now();
+		const double taskDeadline = deadline > begin + t.minBudget ? deadline : begin + t.minBudget;
+
+		// Without a minimum budget, the task only runs with spare time
+		const bool pending = taskDeadline > begin ? t.task->run(taskDeadline) : true;
+
+		commit(t.statistic, float(now() - begin));
+		if(pending)
+			++t.statistic.pendingFrames;
+	}
+}
+
+void FrameScheduler::endFrame()
+{
+	for(size_t i=0; i<mPhases.size(); ++i)
+		commit(mPhases[i].statistic, mPhases[i].current);
+
+	FrameStatistic& s = mFrameStatistic;
+	s.last = float(now() - mFrameBeginTime);
+	s.average = s.frameCount == 0 ? s.last : s.average + (s.last - s.average) * smoothing;
+	s.max = s.last > s.max ? s.last : s.max;
+	if(s.last > targetFrameTime)
+		++s.overBudgetCount;
+	++s.frameCount;
+}
+
+void FrameScheduler::resetStatistic()
+{
+	FrameStatistic s = { 0, 0, 0, 0, 0 };
+	mFrameStatistic = s;
+
+	for(size_t i=0; i<mPhases.size(); ++i)
+		mPhases[i].statistic.max = 0;
+	for(size_t i=0; i<mTasks.size(); ++i) {
+		mTasks[i].statistic.max = 0;
+		mTasks[i].statistic.pendingFrames = 0;
+	}
+}
+
+// NOTE: The moving averages start from the first sample, instead of ramping up from zero
+void FrameScheduler::commit(Statistic& statistic, float time)
+{
+	statistic.last = time;
+	statistic.average = mFrameStatistic.frameCount == 0 ? time : statistic.average + (time - statistic.average) * smoothing;
+	statistic.max = time > statistic.max ? time : statistic.max;
+}
+
+double FrameScheduler::now() const
+{
+	return mClock ? mClock->now() : mTimer.get().asSecond();
+}
+
+double FrameScheduler::frameDeadline() const
+{
+	return mFrameBeginTime + targetFrameTime;
+}
+
+const FrameScheduler::Statistic& FrameScheduler::phaseStatistic(size_t phase) const
+{
+	return mPhases[phase].statistic;
+}
+
+const FrameScheduler::Statistic& FrameScheduler::taskStatistic(size_t task) const
+{
+	return mTasks[task].statistic;
+}
+
+}	// namespace MCD
@@ -0,0 +1,162 @@
+#ifndef __MCD_CORE_SYSTEM_FRAMESCHEDULER__
+#define __MCD_CORE_SYSTEM_FRAMESCHEDULER__
+
+#include "../ShareLib.h"
+#include "NonCopyable.h"
+#include "Timer.h"
+#include <vector>
+
+namespace MCD {
+
+/*!	Spends the time of a frame on the fixed phases, and whatever left on the deferrable work.
+
+	Phases (eg. update and render) always run, and their cost is measured every frame.
+	Deferrable work, like committing resources and waking up scripts, is wrapped as tasks.
+	runTasks() gives the tasks the time left before the target frame time, minus the
+	estimated cost of the phases not yet run in this frame. Tasks run in the order of their
+	priority, and whatever a task cannot finish is carried over to the next frame.
+
+	A task with a non-zero minBudget runs at least for that long every frame, even when the
+	frame is already over budget; so a low priority task is never starved. A task with zero
+	minBudget only runs when there is spare time.
+
+	Example:
+	\code
+	FrameScheduler scheduler(1.0f / 60);
+	const size_t update = scheduler.addPhase("Update");
+	const size_t render = scheduler.addPhase("Render");
+	scheduler.addTask(resourceCommitTask, "Resource commit", 1);
+
+	// Each frame
+	scheduler.beginFrame();
+	scheduler.beginPhase(update);	...	scheduler.endPhase(update);
+	scheduler.runTasks();			// Reserves the estimated time of render
+	scheduler.beginPhase(render);	...	scheduler.endPhase(render);
+	scheduler.endFrame();
+	\endcode
+
+	\note This class is not thread safe, it should be used by the thread running the frame.
+ */
+class MCD_CORE_API FrameScheduler : Noncopyable
+{
+public:
+	//! Where the time comes from, can be faked for testing.
+	class MCD_ABSTRACT_CLASS IClock
+	{
+	public:
+		virtual ~IClock() {}
+
+		//! Current time in second.
+		virtual double now() const = 0;
+	};	// IClock
+
+	//! A piece of deferrable work.
+	class MCD_ABSTRACT_CLASS ITask
+	{
+	public:
+		virtual ~ITask() {}
+
+		/*!	Do as much work as possible before the deadline, given in the time of the IClock.
+			\return True if there is still work pending.
+		 */
+		virtual bool run(double deadline) = 0;
+	};	// ITask
+
+	struct Statistic
+	{
+		const char* name;
+		float last;				//!< Time spent in the last frame, in second
+		float average;			//!< Exponential moving average of the time spent
+		float max;				//!< Maximum time spent in a frame since resetStatistic()
+		size_t pendingFrames;	//!< Number of frames a task left work pending, always zero for phases
+	};	// Statistic
+
+	struct FrameStatistic
+	{
+		size_t frameCount;
+		size_t overBudgetCount;	//!< Number of frames longer than targetFrameTime
+		float last;				//!< Duration of the last frame, in second
+		float average;
+		float max;
+	};	// FrameStatistic
+
+	/*!	\param clock The FrameScheduler does not take ownership, a Timer is used if null.
+	 */
+	explicit FrameScheduler(float targetFrameTime=1.0f/30, sal_maybenull IClock* clock=nullptr);
+
+// Operations
+	//! Returns the index of the phase, for use in beginPhase() and endPhase().
+	size_t addPhase(sal_in_z const char* name);
+
+	/*!	Tasks of higher priority run first, tasks of the same priority run in the order they are added.
+		\note The FrameScheduler does not take ownership of the task.
+	 */
+	size_t addTask(ITask& task, sal_in_z const char* name, int priority=0, float minBudget=0.001f);
+
+	void beginFrame();
+
+	//! A phase can be run more than once in a frame, the time is summed.
+	void beginPhase(size_t phase);
+
+	void endPhase(size_t phase);
+
+	//! Run the tasks with the time left, see the class description.
+	void runTasks();
+
+	void endFrame();
+
+	void resetStatistic();
+
+// Attributes
+	//! Current time of the clock.
+	double now() const;
+
+	//! When the current frame should end to meet the targetFrameTime.
+	double frameDeadline() const;
+
+	size_t phaseCount() const { return mPhases.size(); }
+
+	size_t taskCount() const { return mTasks.size(); }
+
+	const Statistic& phaseStatistic(size_t phase) const;
+
+	const Statistic& taskStatistic(size_t task) const;
+
+	const FrameStatistic& frameStatistic() const { return mFrameStatistic; }
+
+	float targetFrameTime;
+
+	//! Weight of the latest frame in the moving averages, in the range of (0, 1].
+	float smoothing;
+
+protected:
+	struct Phase
+	{
+		Statistic statistic;
+		double beginTime;
+		float current;	//!< Time spent in the current frame
+		bool ran;		//!< Whether it ran in the current frame
+	};	// Phase
+
+	struct Task
+	{
+		Statistic statistic;
+		ITask* task;
+		int priority;
+		float minBudget;
+	};	// Task
+
+	void commit(Statistic& statistic, float time);
+
+	IClock* mClock;
+	Timer mTimer;
+	double mFrameBeginTime;
+	std::vector<Phase> mPhases;
+	std::vector<Task> mTasks;
+	std::vector<size_t> mTaskOrder;	//!< Indices of mTasks sorted by priority
+	FrameStatistic mFrameStatistic;
+};	// FrameScheduler
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_FRAMESCHEDULER__
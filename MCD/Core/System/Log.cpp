@@ -1,14 +1,33 @@
 #include "Pch.h"
 #include "Log.h"
+#include "Atomic.h"
+#include "Mutex.h"
+#include "PlatformInclude.h"
+#include "SpscQueue.h"
+#include "Thread.h"
+#include "Timer.h"
 #include "Utility.h"
+#include <algorithm>
 #include <iostream>
 #include <stdarg.h>
 #include <stdio.h>	// For vsprintf
+#include <vector>
 
 #ifdef MCD_CYGWIN
 #	include "StrUtility.h"
 #endif
 
+#ifndef MCD_WIN
+#	include <pthread.h>
+#endif
+
+#ifdef MCD_VC
+#	define MCD_THREAD_LOCAL __declspec(thread)
+#	define snprintf _snprintf
+#else
+#	define MCD_THREAD_LOCAL __thread
+#endif
+
 namespace MCD {
 
 static std::ostream* gOutStream = nullptr;
@@ -23,6 +42,244 @@ static const char* cPrefixTable[5] =
 	"Info:  ",
 };
 
+// Serialize the writes of the synchronous mode
+static Mutex& gSyncMutex() {
+	static Mutex mutex;
+	return mutex;
+}
+
+namespace {
+
+//! A message captured by the logging thread, waiting for the background writer.
+struct Record
+{
+	double time;
+	int threadId;
+	Log::Level level;
+	char message[256 - sizeof(double) - 2 * sizeof(int)];
+};	// Record
+
+typedef SpscQueue<Record> RecordQueue;
+
+//!	The queue of a logging thread, which knows when its thread has exited.
+struct ThreadQueue : public RecordQueue
+{
+	explicit ThreadQueue(size_t size)
+		: RecordQueue(size)
+	{
+#ifdef MCD_WIN
+		thread = ::OpenThread(SYNCHRONIZE, false, ::GetCurrentThreadId());
+#else
+		exited = false;
+#endif
+	}
+
+	~ThreadQueue()
+	{
+#ifdef MCD_WIN
+		if(thread)
+			::CloseHandle(thread);
+#endif
+	}
+
+	//!	Once it returns true, nothing will be pushed to the queue anymore.
+	bool hasExited() const
+	{
+#ifdef MCD_WIN
+		return thread && ::WaitForSingleObject(thread, 0) == WAIT_OBJECT_0;
+#else
+		return exited;
+#endif
+	}
+
+#ifdef MCD_WIN
+	HANDLE thread;
+#else
+	AtomicValue<bool> exited;	//!< Set by the destructor of the thread specific key
+#endif
+};	// ThreadQueue
+
+#ifndef MCD_WIN
+void onLogThreadExit(void* queue)
+{
+	static_cast<ThreadQueue*>(queue)->exited = true;
+}
+#endif
+
+/*!	Owns one queue per logging thread. A thread keeps its queue in the thread local storage
+	without any lock; the background thread deletes the queue after the thread has exited and
+	the queue is drained, the rest are deleted in stop().
+ */
+class AsyncLog : public Thread::IRunnable
+{
+public:
+	AsyncLog(size_t queueSize, Log::Overflow overflow)
+		: queueSize(queueSize), overflow(overflow), batchSize(0)
+	{
+#ifndef MCD_WIN
+		MCD_VERIFY(::pthread_key_create(&threadKey, &onLogThreadExit) == 0);
+#endif
+	}
+
+	~AsyncLog()
+	{
+#ifndef MCD_WIN
+		// No more onLogThreadExit() for the queues deleted below
+		::pthread_key_delete(threadKey);
+#endif
+		for(size_t i=0; i<queues.size(); ++i)
+			delete queues[i];
+	}
+
+	//!	Register a new queue for the calling thread.
+	ThreadQueue* newQueue()
+	{
+		ThreadQueue* q = new ThreadQueue(queueSize);
+#ifndef MCD_WIN
+		MCD_VERIFY(::pthread_setspecific(threadKey, q) == 0);
+#endif
+		ScopeLock lock(queuesMutex);
+		queues.push_back(q);
+		return q;
+	}
+
+	size_t queueCount()
+	{
+		ScopeLock lock(queuesMutex);
+		return queues.size();
+	}
+
+	void push(RecordQueue& q, const Record& r)
+	{
+		while(!q.push(r)) {
+			if(overflow == Log::Discard) {
+				++discarded;
+				return;
+			}
+			mSleep(0);
+		}
+	}
+
+	sal_override void run(Thread& thread)
+	{
+		size_t lastDiscarded = 0;
+
+		// The queues are drained once more after postQuit()
+		for(bool keepRun = true; keepRun; ) {
+			keepRun = thread.keepRun();
+			const int request = flushRequest;
+
+			// Work on a copy of the list, a new logging thread never waits for the stream
+			{	ScopeLock lock(queuesMutex);
+				snapshot = queues;
+			}
+
+			size_t count = 0;
+			for(size_t i=0; i<snapshot.size(); ++i) {
+				ThreadQueue* q = snapshot[i];
+				const bool exited = q->hasExited();	// Checked before the last drain
+				count += drain(*q);
+				if(exited)
+					reclaim(q);
+			}
+
+			if(lastDiscarded != size_t(int(discarded))) {
+				lastDiscarded = size_t(int(discarded));
+				char buf[64];
+				sprintf(buf, "%d log messages discarded", int(lastDiscarded));
+				append(timer.get().asSecond(), getCurrentThreadId(), Log::Warn, buf);
+			}
+
+			writeBatch();
+			flushed = request;
+
+			// Give the logging threads some time to fill their queues, so the next batch is larger
+			if(count == 0 && keepRun)
+				mSleep(1);
+		}
+	}
+
+	void reclaim(ThreadQueue* q)
+	{
+		{	ScopeLock lock(queuesMutex);
+			queues.erase(std::find(queues.begin(), queues.end(), q));
+		}
+		delete q;
+	}
+
+	size_t drain(RecordQueue& q)
+	{
+		size_t count = 0;
+		Record r;
+		while(q.pop(r)) {
+			append(r.time, r.threadId, r.level, r.message);
+			++count;
+		}
+		return count;
+	}
+
+	//!	Format the line into the batch buffer, the batch is written to the stream once it's full.
+	void append(double time, int threadId, Log::Level level, const char* message)
+	{
+		char* buf = batch + batchSize;
+		const size_t capacity = sizeof(batch) - batchSize;
+		int n = snprintf(buf, capacity, "%10.6f [%08x] %s%s\n", time, threadId, cPrefixTable[level], message);
+
+		if(n < 0 || size_t(n) >= capacity) {
+			writeBatch();
+			n = snprintf(batch, sizeof(batch), "%10.6f [%08x] %s%s\n", time, threadId, cPrefixTable[level], message);
+			n = n < 0 ? 0 : int(std::min(size_t(n), sizeof(batch) - 1));
+		}
+		batchSize += size_t(n);
+	}
+
+	void writeBatch()
+	{
+		if(batchSize == 0)
+			return;
+		gOutStream->write(batch, batchSize);
+		gOutStream->flush();
+		batchSize = 0;
+	}
+
+	const size_t queueSize;
+	const Log::Overflow overflow;
+	Mutex queuesMutex;
+	std::vector<ThreadQueue*> queues;
+	std::vector<ThreadQueue*> snapshot;	//!< Only used by the background thread
+#ifndef MCD_WIN
+	pthread_key_t threadKey;
+#endif
+	Timer timer;
+	AtomicInteger discarded;
+	AtomicInteger flushRequest;
+	AtomicInteger flushed;	//!< The last flush request that the writer has served
+	char batch[64 * 1024];
+	size_t batchSize;
+};	// AsyncLog
+
+}	// namespace
+
+static AsyncLog* gAsyncLog = nullptr;
+static Thread* gAsyncThread = nullptr;
+static AtomicInteger gAsyncGeneration;	// Invalidates the thread local queue of the last startAsync()
+
+static MCD_THREAD_LOCAL RecordQueue* tQueue = nullptr;
+static MCD_THREAD_LOCAL int tQueueGeneration = 0;
+static MCD_THREAD_LOCAL int tThreadId = 0;
+
+//!	Get the calling thread's queue, create one if needed.
+static RecordQueue& threadQueue()
+{
+	const int generation = gAsyncGeneration;
+	if(!tQueue || tQueueGeneration != generation) {
+		tQueue = gAsyncLog->newQueue();
+		tQueueGeneration = generation;
+		tThreadId = getCurrentThreadId();
+	}
+	return *tQueue;
+}
+
 void Log::start(std::ostream* os)
 {
 	MCD_ASSUME(os != nullptr);
@@ -30,6 +287,39 @@ void Log::start(std::ostream* os)
 	gOutStream = os;
 }
 
+void Log::startAsync(std::ostream* os, size_t queueSize, Overflow overflow)
+{
+	start(os);
+	++gAsyncGeneration;
+	gAsyncLog = new AsyncLog(queueSize, overflow);
+	gAsyncThread = new Thread(*gAsyncLog, false);
+}
+
+void Log::flush()
+{
+	if(!gAsyncLog) {
+		if(gOutStream) {
+			ScopeLock lock(gSyncMutex());
+			gOutStream->flush();
+		}
+		return;
+	}
+
+	const int request = ++gAsyncLog->flushRequest;
+	while(gAsyncLog->flushed < request)
+		mSleep(0);
+}
+
+size_t Log::discardedCount()
+{
+	return gAsyncLog ? size_t(int(gAsyncLog->discarded)) : 0;
+}
+
+size_t Log::queueCount()
+{
+	return gAsyncLog ? gAsyncLog->queueCount() : 0;
+}
+
 void Log::setLevel(Level level)
 {
 	gLogLevel = level;
@@ -40,6 +330,20 @@ void Log::write(Level level, const char* msg)
 	if(!gOutStream || !(gLogLevel & level))
 		return;
 	MCD_ASSUME(uint(level) < MCD_COUNTOF(cPrefixTable));
+
+	if(gAsyncLog) {
+		RecordQueue& q = threadQueue();
+		Record r;
+		r.time = gAsyncLog->timer.get().asSecond();
+		r.threadId = tThreadId;
+		r.level = level;
+		strncpy(r.message, msg, sizeof(r.message) - 1);
+		r.message[sizeof(r.message) - 1] = '\0';
+		gAsyncLog->push(q, r);
+		return;
+	}
+
+	ScopeLock lock(gSyncMutex());
 	(*gOutStream) << cPrefixTable[level] << msg << std::endl;
 }
 
@@ -58,6 +362,20 @@ void Log::format(Level level, const char* fmt, ...)
 	va_list argList;
 	va_start(argList, fmt);
 
+	// Format directly into the record, no allocation and no lock
+	if(gAsyncLog) {
+		RecordQueue& q = threadQueue();
+		Record r;
+		r.time = gAsyncLog->timer.get().asSecond();
+		r.threadId = tThreadId;
+		r.level = level;
+		(void)vsnprintf(r.message, sizeof(r.message), fmt, argList);
+		r.message[sizeof(r.message) - 1] = '\0';	// Truncated if it's too long
+		va_end(argList);
+		gAsyncLog->push(q, r);
+		return;
+	}
+
 	// In visual stdio we have to magically - 4 on the count of char,
 	// otherwise malloc is invoked all the time rather than _alloca
 	size_t bufCount = _ALLOCA_S_THRESHOLD / sizeof(char) - 4;
@@ -72,6 +390,7 @@ void Log::format(Level level, const char* fmt, ...)
 			return;
 		int result = vsprintf(buf, /*bufCount,*/ fmt, argList);
 		if(result >= 0) {
+			ScopeLock lock(gSyncMutex());
 			(*gOutStream) << cPrefixTable[level];
 			gOutStream->write(buf, result);
 			(*gOutStream) << std::endl;
@@ -85,6 +404,15 @@ void Log::format(Level level, const char* fmt, ...)
 
 void Log::stop(bool destroyStream)
 {
+	// Let the writer drain the queues before the stream is gone
+	if(gAsyncThread) {
+		gAsyncThread->wait();
+		delete gAsyncThread;
+		delete gAsyncLog;
+		gAsyncThread = nullptr;
+		gAsyncLog = nullptr;
+	}
+
 	if(destroyStream)
 		delete gOutStream;
 	gOutStream = nullptr;
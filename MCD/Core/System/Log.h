@@ -8,7 +8,12 @@
 namespace MCD {
 
 /*! A simple logging class.
-	\note Multiple threads can call write()/format() but not with start()/stop()
+	\note Multiple threads can call write()/format() but not with start()/startAsync()/stop()
+
+	By default the message is written to the stream and flushed immediately, in the calling thread.
+	Once started with startAsync(), the message is formatted into a fixed size queue of the calling
+	thread, without any lock or heap allocation; a background thread then writes the messages of all
+	threads in batches, prefixed with the time since startAsync() and the thread id.
 
 	Example:
 	\code
@@ -32,6 +37,29 @@ public:
 	 */
 	static void start(sal_in std::ostream* os);
 
+	//! What to do when the queue of the logging thread is full.
+	enum Overflow
+	{
+		Discard,	//!< Discard the message and count it in discardedCount().
+		Wait		//!< Wait for the background thread to make room.
+	};
+
+	/*!	Same as start(), but the stream is written by a background thread.
+		\param queueSize Maximum number of pending messages of each logging thread,
+			each message occupy around 256 bytes and longer messages are truncated.
+	 */
+	static void startAsync(sal_in std::ostream* os, size_t queueSize=256, Overflow overflow=Discard);
+
+	//!	Block until all the messages logged so far are written to the stream.
+	static void flush();
+
+	//!	Number of messages discarded because of Log::Discard, since startAsync().
+	static size_t discardedCount();
+
+	//!	Number of the per thread queues of startAsync(), the queue of an exited thread is
+	//!	deleted by the background thread once it's drained.
+	static size_t queueCount();
+
 	/*!	Set the logging level.
 		All level are on by default.
 	 */
@@ -50,6 +78,7 @@ public:
 #endif
 
 	//! De-initialize the log, with the option to delete the stream or not.
+	//! The pending messages of startAsync() are written before that.
 	static void stop(bool destroyStream=true);
 };	// Log
 
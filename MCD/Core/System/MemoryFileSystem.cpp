@@ -1,25 +1,12 @@
 #include "Pch.h"
 #include "MemoryFileSystem.h"
-#include "Stream.h"
+#include <istream>
 
 namespace MCD {
 
-namespace {
-
-class MemoryFileStreamProxy : public StreamProxy
-{
-public:
-	MemoryFileStreamProxy(char* buffer, size_t size) {
-		setbuf(buffer, size, size, nullptr);
-	}
-};	// MemoryFileStreamProxy
-
-}	// namespace
-
-MemoryFileSystem::MemoryFile::MemoryFile(const Path& key, const void* ptr, size_t sz)
+MemoryFileSystem::MemoryFile::MemoryFile(const Path& key, const ReadSpanPtr& data)
 	: MapBase<Path>::Node<MemoryFile>(key)
-	, fileData(ptr)
-	, fileSize(sz)
+	, fileData(data)
 {}
 
 MemoryFileSystem::MemoryFileSystem(const Path& root)
@@ -37,30 +24,40 @@ bool MemoryFileSystem::isExists(const Path& path) const
 uint64_t MemoryFileSystem::getSize(const Path& path) const
 {
 	if(const MemoryFile* file = mMemoryFiles.find(path))
-		return file->fileSize;
+		return file->fileData->size();
 	else
 		return 0;
 }
 
 std::auto_ptr<std::istream> MemoryFileSystem::openRead(const Path& path) const
 {
-	std::auto_ptr<std::istream> stream;
-	if(const MemoryFile* file = mMemoryFiles.find(path)) {
-		std::auto_ptr<MemoryFileStreamProxy> sp(new MemoryFileStreamProxy((char*)file->fileData, file->fileSize));
-		stream.reset(new Stream(*sp.release()));
-	}
+	// The stream holds a reference to the span, and so the storage
+	if(const MemoryFile* file = mMemoryFiles.find(path))
+		return createSpanStream(file->fileData);
+	return std::auto_ptr<std::istream>();
+}
 
-	return stream;
+ReadSpanPtr MemoryFileSystem::openReadSpan(const Path& path) const
+{
+	if(const MemoryFile* file = mMemoryFiles.find(path))
+		return file->fileData;
+	return nullptr;
 }
 
 bool MemoryFileSystem::add(const Path& fileId, const void* fileData, size_t fileSize)
 {
 	MCD_ASSUME(fileData && fileSize > 0);
+	return add(fileId, new ReadSpan((const char*)fileData, fileSize));
+}
+
+bool MemoryFileSystem::add(const Path& fileId, const ReadSpanPtr& fileData)
+{
+	MCD_ASSUME(fileData && fileData->size() > 0);
 	const Path key = mRoot / fileId;
 	if(mMemoryFiles.find(key) != nullptr)
 		return false;
 
-	mMemoryFiles.insert(*new MemoryFile(key, fileData, fileSize));
+	mMemoryFiles.insert(*new MemoryFile(key, fileData));
 
 	return true;
 }
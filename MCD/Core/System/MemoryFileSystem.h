@@ -50,6 +50,9 @@ public:
 	///	Returns a std::istream for reading, null if fail.
 	sal_override std::auto_ptr<std::istream> openRead(const Path& path) const;
 
+	///	The span shares the storage of the file, see add().
+	sal_override ReadSpanPtr openReadSpan(const Path& path) const;
+
 	///	Returns a std::ostream for writing, null if fail.
 	///	\note NOT supported in this file system.
 	sal_override std::auto_ptr<std::ostream> openWrite(const Path& path) const {
@@ -57,18 +60,23 @@ public:
 	}
 
 	/// Adds a block of memory to this file system.
-	///	This will NOT take ownership of fileData.
+	///	This will NOT take ownership of fileData, the memory must out live this
+	///	file system and all the streams and spans opened on it.
 	///	Returns false if this fileId already exists.
 	sal_checkreturn bool add(const Path& fileId, sal_in_bcount(fileSize) const void* fileData, size_t fileSize);
 
+	/// Adds a file sharing the storage of a span, eg. one given by createOwnedReadSpan().
+	///	The storage is kept alive by this file system and by the streams and spans opened on it.
+	///	Returns false if this fileId already exists.
+	sal_checkreturn bool add(const Path& fileId, const ReadSpanPtr& fileData);
+
 private:
 	Path mRoot;
 
 	struct MemoryFile : MapBase<Path>::Node<MemoryFile>
 	{
-		MemoryFile(const Path& key, const void* ptr, size_t sz);
-		const void* fileData;
-		size_t fileSize;
+		MemoryFile(const Path& key, const ReadSpanPtr& data);
+		const ReadSpanPtr fileData;
 	};	// MemoryFile
 
 	Map<MemoryFile> mMemoryFiles;
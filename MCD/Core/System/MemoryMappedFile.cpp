@@ -0,0 +1,144 @@
+#include "Pch.h"
+#include "MemoryMappedFile.h"
+#include "Log.h"
+#include "PlatformInclude.h"
+#include "StrUtility.h"
+
+#ifndef MCD_WIN
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace MCD {
+
+MemoryMappedFile::MemoryMappedFile()
+	: mData(nullptr), mSize(0), mCopyOnWrite(false)
+#ifdef MCD_WIN
+	, mFileHandle(INVALID_HANDLE_VALUE), mMappingHandle(nullptr)
+#endif
+{}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	close();
+}
+
+size_t MemoryMappedFile::pageSize()
+{
+#ifdef MCD_WIN
+	SYSTEM_INFO info;
+	::GetSystemInfo(&info);
+	return info.dwPageSize;
+#else
+	const long size = ::sysconf(_SC_PAGESIZE);
+	return size > 0 ? size_t(size) : 4096;
+#endif
+}
+
+#ifdef MCD_WIN
+
+bool MemoryMappedFile::open(const Path& path, bool copyOnWrite)
+{
+	close();
+
+	std::wstring wideStr;
+	if(!utf8ToWStr(path.getString(), wideStr))
+		return false;
+
+	HANDLE file = ::CreateFileW(wideStr.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE) {
+		Log::format(Log::Warn, "Fail to open \"%s\" for memory mapping", path.c_str());
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if(!::GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		::CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = ::CreateFileMappingW(file, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+	if(!mapping) {
+		::CloseHandle(file);
+		return false;
+	}
+
+	void* p = ::MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if(!p) {
+		::CloseHandle(mapping);
+		::CloseHandle(file);
+		return false;
+	}
+
+	mFileHandle = file;
+	mMappingHandle = mapping;
+	mData = reinterpret_cast<const char*>(p);
+	mSize = uint64_t(size.QuadPart);
+	mCopyOnWrite = copyOnWrite;
+	return true;
+}
+
+void MemoryMappedFile::close()
+{
+	if(mData)
+		::UnmapViewOfFile(mData);
+	if(mMappingHandle)
+		::CloseHandle(mMappingHandle);
+	if(mFileHandle != INVALID_HANDLE_VALUE)
+		::CloseHandle(mFileHandle);
+
+	mData = nullptr;
+	mSize = 0;
+	mCopyOnWrite = false;
+	mMappingHandle = nullptr;
+	mFileHandle = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MemoryMappedFile::open(const Path& path, bool copyOnWrite)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if(fd == -1) {
+		Log::format(Log::Warn, "Fail to open \"%s\" for memory mapping", path.c_str());
+		return false;
+	}
+
+	struct stat fileStat;
+	if(::fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	const int protection = copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+	void* p = ::mmap(nullptr, size_t(fileStat.st_size), protection, MAP_PRIVATE, fd, 0);
+
+	// The mapping stays valid after the descriptor is closed
+	::close(fd);
+
+	if(p == MAP_FAILED)
+		return false;
+
+	mData = reinterpret_cast<const char*>(p);
+	mSize = uint64_t(fileStat.st_size);
+	mCopyOnWrite = copyOnWrite;
+	return true;
+}
+
+void MemoryMappedFile::close()
+{
+	if(mData)
+		::munmap(const_cast<char*>(mData), size_t(mSize));
+
+	mData = nullptr;
+	mSize = 0;
+	mCopyOnWrite = false;
+}
+
+#endif	// MCD_WIN
+
+}	// namespace MCD
@@ -0,0 +1,68 @@
+#ifndef __MCD_CORE_SYSTEM_MEMORYMAPPEDFILE__
+#define __MCD_CORE_SYSTEM_MEMORYMAPPEDFILE__
+
+#include "Atomic.h"
+#include "IntrusivePtr.h"
+#include "NonCopyable.h"
+#include "Path.h"
+
+namespace MCD {
+
+/*!	A read-only view of a whole file mapped into the address space.
+	The object is reference counted so that streams reading from the mapped
+	memory can keep the mapping alive after the owner is gone.
+
+	Example:
+	\code
+	MemoryMappedFilePtr file = new MemoryMappedFile;
+	if(file->open("data.pak"))
+		doSomething(file->data(), file->size());
+	\endcode
+
+	\note Truncating the file while it's mapped makes accessing the pages beyond
+		the new end fail with SIGBUS (or an access violation on Windows), so only
+		map files which are not modified while they are mapped.
+ */
+class MCD_CORE_API MemoryMappedFile : public IntrusiveSharedObject<AtomicInteger>, Noncopyable
+{
+public:
+	MemoryMappedFile();
+
+	sal_override ~MemoryMappedFile();
+
+	/*!	Map the whole file specified by \em path, any previous mapping is closed first.
+		\param copyOnWrite If true, the mapped memory can be written through writableData(),
+			where the modified pages become private to this process and never go to the file.
+	 */
+	sal_checkreturn bool open(const Path& path, bool copyOnWrite=false);
+
+	void close();
+
+	bool isOpen() const { return mData != nullptr; }
+
+	sal_maybenull const char* data() const { return mData; }
+
+	//! Null unless the file is opened with copyOnWrite.
+	sal_maybenull char* writableData() { return mCopyOnWrite ? const_cast<char*>(mData) : nullptr; }
+
+	uint64_t size() const { return mSize; }
+
+	//! The virtual memory page size of the system, the granularity of the mapping.
+	static size_t pageSize();
+
+protected:
+	const char* mData;
+	uint64_t mSize;
+	bool mCopyOnWrite;
+
+#ifdef MCD_WIN
+	void* mFileHandle;
+	void* mMappingHandle;
+#endif
+};	// MemoryMappedFile
+
+typedef IntrusivePtr<MemoryMappedFile> MemoryMappedFilePtr;
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_MEMORYMAPPEDFILE__
@@ -112,6 +112,95 @@ bool RecursiveMutex::tryLock()
 
 #else
 
+#ifdef MCD_LINUX
+
+// Reference: "Futexes Are Tricky" by Ulrich Drepper, the third mutex
+static inline int relaxedLoad(volatile int& value)
+{
+#if defined(__ATOMIC_RELAXED)
+	return __atomic_load_n(&value, __ATOMIC_RELAXED);
+#else
+	return value;
+#endif
+}
+
+static inline void cpuRelax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	__asm__ __volatile__("pause");
+#endif
+}
+
+Mutex::Mutex(int spinCount)
+	: mMutex(0), mSpinCount(spinCount < 0 ? 0 : spinCount)
+{
+#ifndef NDEBUG
+	_locked = false;
+#endif
+}
+
+Mutex::~Mutex()
+{
+#ifndef NDEBUG
+	MCD_ASSUME(!_locked && "Delete before unlock");
+#endif
+}
+
+void Mutex::lock()
+{
+	int c = __sync_val_compare_and_swap(&mMutex, 0, 1);
+
+	// The lock is usually held for a short while, spin before going to sleep
+	for(int i=0; c != 0 && i<mSpinCount; ++i) {
+		cpuRelax();
+		if(relaxedLoad(mMutex) == 0)
+			c = __sync_val_compare_and_swap(&mMutex, 0, 1);
+	}
+
+	if(c != 0) {
+		// Mark the mutex as contended, such that unlock() will wake us up
+		if(c != 2)
+			c = __sync_lock_test_and_set(&mMutex, 2);
+		while(c != 0) {
+			futexWait(&mMutex, 2);
+			c = __sync_lock_test_and_set(&mMutex, 2);
+		}
+	}
+
+#ifndef NDEBUG
+	MCD_ASSUME(!_locked && "Double lock");
+	_locked = true;
+#endif
+}
+
+void Mutex::unlock()
+{
+#ifndef NDEBUG
+	MCD_ASSUME(_locked && "Unlock when not locked");
+	_locked = false;
+#endif
+	// No system call unless someone may be sleeping
+	if(__sync_fetch_and_sub(&mMutex, 1) != 1) {
+		__sync_lock_release(&mMutex);
+		futexWake(&mMutex, 1);
+	}
+}
+
+bool Mutex::tryLock()
+{
+	if(__sync_bool_compare_and_swap(&mMutex, 0, 1)) {
+#ifndef NDEBUG
+		MCD_ASSUME(!_locked && "Double lock");
+		_locked = true;
+#endif
+		return true;
+	} else {
+		return false;
+	}
+}
+
+#else
+
 Mutex::Mutex(int spinCount)
 {
 #ifndef NDEBUG
@@ -160,6 +249,8 @@ bool Mutex::tryLock()
 	}
 }
 
+#endif	// MCD_LINUX
+
 RecursiveMutex::RecursiveMutex(int spinCount)
 {
 	// TODO: Support spin lock on posix
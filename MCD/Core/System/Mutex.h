@@ -4,13 +4,18 @@
 #include "../ShareLib.h"
 #include "NonCopyable.h"
 
+#include "Platform.h"
+
 #if !defined(MCD_WIN)
 #	include <pthread.h>
 #endif
 
 namespace MCD {
 
-//! Mutex.
+/*!	Mutex.
+	On Linux it's a futex, a contended lock() spins for spinCount times
+	before it goes to sleep in the kernel.
+ */
 class MCD_CORE_API Mutex : Noncopyable
 {
 public:
@@ -38,6 +43,10 @@ public:
 		The sizeof(CRITICAL_SECTION) is 24 on win32
 	 */
 	char mMutex[8 + 4 * sizeof(void*)];
+#elif defined(MCD_LINUX)
+	//! 0: unlocked, 1: locked, 2: locked and may have threads sleeping on it
+	volatile int mMutex;
+	int mSpinCount;
 #else
 	pthread_mutex_t mMutex;
 #endif
@@ -0,0 +1,574 @@
+#include "Pch.h"
+#include "PackFileSystem.h"
+#include "Log.h"
+#include "MemoryMappedFile.h"
+#include "StringHash.h"
+#include <map>
+#include <string.h>	// For memcpy, strncmp
+#include "../../../3Party/zlib/zlib.h"
+
+#ifdef MCD_VC
+#ifdef MCD_WIN32
+#	pragma comment(lib, "zlib")
+#elif defined(MCD_WIN64)
+#	pragma comment(lib, "zlib_x64")
+#endif
+#endif	// MCD_VC
+
+// NOTE: The on-disk structures are written in the native (little) endian,
+// the pack files are generated per target platform anyway.
+
+namespace MCD {
+
+namespace {
+
+static const char cMagic[4] = { 'M', 'P', 'A', 'K' };
+static const uint32_t cVersion = 1;
+static const uint64_t cAlignment = 4096;
+
+enum EntryFlag
+{
+	Used		= 1 << 0,
+	Deflated	= 1 << 1
+};	// EntryFlag
+
+struct PackHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t slotCount;			//!< Always a power of 2
+	uint64_t directoryOffset;	//!< Offset of PackEntry[slotCount]
+	uint64_t nameTableOffset;
+	uint64_t nameTableSize;
+};	// PackHeader
+
+//!	A slot of the open addressing hash table, linear probing is used.
+struct PackEntry
+{
+	uint32_t pathHash;
+	uint32_t flags;
+	uint32_t nameOffset;		//!< Offset in the name table, names are null terminated
+	uint32_t nameLength;
+	uint64_t offset;			//!< Offset of the data in the pack file, 4K aligned
+	uint64_t storedSize;		//!< Size of the data in the pack file
+	uint64_t size;				//!< Size after decompression
+	uint64_t contentHash;
+	int64_t lastWriteTime;
+};	// PackEntry
+
+static uint64_t alignUp(uint64_t val) {
+	return (val + cAlignment - 1) & ~(cAlignment - 1);
+}
+
+//!	Strip the "./" prefix and unify the seperators, as what Path::normalize() does.
+static std::string normalizedString(const Path& path)
+{
+	Path p = path;
+	p.normalize();
+	std::string s = p.getString();
+	while(s.size() >= 2 && s[0] == '.' && s[1] == '/')
+		s.erase(0, 2);
+	if(s == ".")
+		s.clear();
+	return s;
+}
+
+}	// namespace
+
+class PackFileSystem::Impl : public IntrusiveSharedObject<AtomicInteger>
+{
+public:
+	Impl() : mHeader(nullptr), mSlots(nullptr), mNames(nullptr) {}
+
+	sal_checkreturn bool setRoot(const Path& packFilePath)
+	{
+		Path absolutePath = packFilePath;
+		if(!absolutePath.hasRootDirectory())
+			absolutePath = Path::getCurrentPath() / absolutePath;
+
+		MemoryMappedFilePtr file = new MemoryMappedFile;
+		if(!file->open(absolutePath))
+			return false;
+
+		const char* base = file->data();
+		const uint64_t fileSize = file->size();
+
+		if(fileSize < sizeof(PackHeader))
+			return false;
+
+		const PackHeader* header = reinterpret_cast<const PackHeader*>(base);
+		if(memcmp(header->magic, cMagic, sizeof(cMagic)) != 0 || header->version != cVersion)
+			return false;
+
+		// The slot count must be a non-zero power of 2
+		if(header->slotCount == 0 || (header->slotCount & (header->slotCount - 1)) != 0)
+			return false;
+
+		if(header->directoryOffset + uint64_t(header->slotCount) * sizeof(PackEntry) > fileSize ||
+			header->nameTableOffset + header->nameTableSize > fileSize)
+			return false;
+
+		mFile = file;
+		mPath = absolutePath;
+		mHeader = header;
+		mSlots = reinterpret_cast<const PackEntry*>(base + header->directoryOffset);
+		mNames = base + header->nameTableOffset;
+
+		return true;
+	}
+
+	//! The null terminated name of the entry, null if it lies outside the name table of a corrupted pack file.
+	sal_maybenull const char* entryName(const PackEntry& e) const
+	{
+		if(uint64_t(e.nameOffset) + e.nameLength >= mHeader->nameTableSize || mNames[e.nameOffset + e.nameLength] != '\0')
+			return nullptr;
+		return mNames + e.nameOffset;
+	}
+
+	sal_maybenull const PackEntry* find(const char* str, size_t length) const
+	{
+		if(!mHeader)
+			return nullptr;
+
+		const uint32_t hash = StringHash(str, 0).hash;
+		const uint32_t mask = mHeader->slotCount - 1;
+
+		for(uint32_t i = hash & mask, probe = 0; probe <= mask; i = (i + 1) & mask, ++probe) {
+			const PackEntry& e = mSlots[i];
+			if(!(e.flags & Used))
+				return nullptr;
+			if(e.pathHash != hash || e.nameLength != length)
+				continue;
+			const char* name = entryName(e);
+			if(name && memcmp(name, str, length) == 0)
+				return &e;
+		}
+		return nullptr;
+	}
+
+	sal_maybenull const PackEntry* find(const Path& path) const
+	{
+		// Most of the paths are already in normalized form, try it first
+		// to avoid the string allocation in normalize.
+		const std::string& s = path.getString();
+		if(const PackEntry* e = find(s.c_str(), s.size()))
+			return e;
+
+		const std::string normalized = normalizedString(path);
+		if(normalized == s)
+			return nullptr;
+		return find(normalized.c_str(), normalized.size());
+	}
+
+	bool isDirectory(const Path& path) const
+	{
+		if(!mHeader)
+			return false;
+
+		std::string prefix = normalizedString(path);
+		if(prefix.empty())
+			return true;	// The root
+		prefix += '/';
+
+		for(uint32_t i=0; i<mHeader->slotCount; ++i) {
+			const PackEntry& e = mSlots[i];
+			if(!(e.flags & Used) || e.nameLength <= prefix.size())
+				continue;
+			const char* name = entryName(e);
+			if(name && strncmp(name, prefix.c_str(), prefix.size()) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	ReadSpanPtr openReadSpan(const Path& path) const
+	{
+		const PackEntry* e = find(path);
+		if(!e)
+			return nullptr;
+
+		if(e->offset + e->storedSize > mFile->size())
+			return nullptr;
+
+		if(!(e->flags & Deflated))
+			return createMappedReadSpan(mFile, e->offset, size_t(e->size));
+
+		char* buffer = (char*)::malloc(size_t(e->size));
+		if(!buffer)
+			return nullptr;
+
+		const char* data = mFile->data() + e->offset;
+		uLongf destLen = uLongf(e->size);
+		if(::uncompress((Bytef*)buffer, &destLen, (const Bytef*)data, uLong(e->storedSize)) != Z_OK || destLen != e->size) {
+			Log::format(Log::Warn, "Corrupted pack entry \"%s\"", path.c_str());
+			::free(buffer);
+			return nullptr;
+		}
+
+		return createOwnedReadSpan(buffer, size_t(e->size));
+	}
+
+	struct FileInFolderContext {
+		std::string folder;	//!< With a trailing '/' unless it's the root
+		uint32_t slot;
+	};	// FileInFolderContext
+
+	Path getNextFileInFolder(FileInFolderContext& c) const
+	{
+		for(; mHeader && c.slot < mHeader->slotCount; ++c.slot) {
+			const PackEntry& e = mSlots[c.slot];
+			if(!(e.flags & Used))
+				continue;
+
+			const char* name = entryName(e);
+			if(!name || strncmp(name, c.folder.c_str(), c.folder.size()) != 0)
+				continue;
+
+			// Skip the files in sub-folders
+			if(strchr(name + c.folder.size(), '/'))
+				continue;
+
+			++c.slot;
+			return Path(name);
+		}
+		return Path();
+	}
+
+	Path mPath;
+	MemoryMappedFilePtr mFile;
+	const PackHeader* mHeader;
+	const PackEntry* mSlots;
+	const char* mNames;
+};	// Impl
+
+PackFileSystem::PackFileSystem(const Path& packFilePath)
+	: mImpl(new Impl)
+{
+	if(!PackFileSystem::setRoot(packFilePath))
+		Log::format(Log::Warn, "The pack file \"%s\" does not exist or corrupted", packFilePath.c_str());
+}
+
+PackFileSystem::~PackFileSystem()
+{}
+
+Path PackFileSystem::getRoot() const {
+	return mImpl->mPath;
+}
+
+bool PackFileSystem::setRoot(const Path& packFilePath)
+{
+	// Swap to a new Impl, streams opened from the old one keep the old mapping
+	ImplPtr impl = new Impl;
+	if(!impl->setRoot(packFilePath))
+		return false;
+	mImpl = impl;
+	return true;
+}
+
+bool PackFileSystem::isExists(const Path& path) const {
+	return mImpl->find(path) != nullptr || mImpl->isDirectory(path);
+}
+
+bool PackFileSystem::isDirectory(const Path& path) const {
+	return mImpl->find(path) == nullptr && mImpl->isDirectory(path);
+}
+
+uint64_t PackFileSystem::getSize(const Path& path) const
+{
+	const PackEntry* e = mImpl->find(path);
+	return e ? e->size : 0;
+}
+
+std::time_t PackFileSystem::getLastWriteTime(const Path& path) const
+{
+	const PackEntry* e = mImpl->find(path);
+	return e ? std::time_t(e->lastWriteTime) : 0;
+}
+
+bool PackFileSystem::makeDir(const Path& path) const {
+	return false;
+}
+
+bool PackFileSystem::remove(const Path& path) const {
+	return false;
+}
+
+std::auto_ptr<std::istream> PackFileSystem::openRead(const Path& path) const {
+	return createSpanStream(mImpl->openReadSpan(path));
+}
+
+ReadSpanPtr PackFileSystem::openReadSpan(const Path& path) const {
+	return mImpl->openReadSpan(path);
+}
+
+std::auto_ptr<std::ostream> PackFileSystem::openWrite(const Path& path) const {
+	return std::auto_ptr<std::ostream>();
+}
+
+void* PackFileSystem::openFirstFileInFolder(const Path& folder) const
+{
+	Impl::FileInFolderContext* c = new Impl::FileInFolderContext;
+	c->folder = normalizedString(folder);
+	if(!c->folder.empty())
+		c->folder += '/';
+	c->slot = 0;
+	return c;
+}
+
+Path PackFileSystem::getNextFileInFolder(void* context) const
+{
+	Impl::FileInFolderContext* c = reinterpret_cast<Impl::FileInFolderContext*>(context);
+	if(!c)
+		return Path();
+	return mImpl->getNextFileInFolder(*c);
+}
+
+void PackFileSystem::closeFirstFileInFolder(void* context) const
+{
+	Impl::FileInFolderContext* c = reinterpret_cast<Impl::FileInFolderContext*>(context);
+	delete c;
+}
+
+size_t PackFileSystem::entryCount() const {
+	return mImpl->mHeader ? mImpl->mHeader->entryCount : 0;
+}
+
+class PackFileWriter::Impl
+{
+public:
+	explicit Impl(std::iostream& os)
+		: mOs(os), mCommitted(false), mDataEnd(0), mDedupCount(0), mDedupBytes(0)
+	{
+		mBase = os.tellp();
+
+		// Reserve space for the header, the first entry starts at the next aligned offset
+		PackHeader header;
+		memset(&header, 0, sizeof(header));
+		mOs.write((const char*)&header, sizeof(header));
+		mDataEnd = sizeof(header);
+	}
+
+	sal_checkreturn bool writeAt(uint64_t offset, const void* data, size_t size)
+	{
+		mOs.seekp(mBase + std::streamoff(offset));
+		mOs.write((const char*)data, size);
+		return mOs.good();
+	}
+
+	sal_checkreturn bool add(const Path& path, const void* data, size_t size, bool compress, std::time_t lastWriteTime)
+	{
+		if(mCommitted)
+			return false;
+
+		const std::string name = normalizedString(path);
+		if(name.empty() || mNames.find(name) != mNames.end())
+			return false;
+
+		PackEntry e;
+		memset(&e, 0, sizeof(e));
+		e.pathHash = StringHash(name.c_str(), 0).hash;
+		e.flags = Used;
+		e.size = size;
+		e.contentHash = hashContent(data, size);
+		e.lastWriteTime = int64_t(lastWriteTime);
+
+		// Share the data with an identical entry if any, the bytes are compared
+		// since different contents may still have the same hash
+		const ContentKey key(e.contentHash, e.size);
+		ContentMap::const_iterator i = mContents.lower_bound(key);
+		const ContentMap::const_iterator end = mContents.upper_bound(key);
+		while(i != end && !isSameContent(i->second, data, size))
+			++i;
+
+		if(i != end) {
+			const PackEntry& other = mEntries[i->second];
+			e.flags = other.flags;
+			e.offset = other.offset;
+			e.storedSize = other.storedSize;
+			++mDedupCount;
+			mDedupBytes += e.storedSize;
+		}
+		else {
+			const char* storedData = (const char*)data;
+			e.storedSize = size;
+
+			std::vector<char> compressed;
+			if(compress && size > 0) {
+				uLongf destLen = ::compressBound(uLong(size));
+				compressed.resize(destLen);
+				if(::compress2((Bytef*)&compressed[0], &destLen, (const Bytef*)data, uLong(size), Z_BEST_COMPRESSION) == Z_OK && destLen < size) {
+					storedData = &compressed[0];
+					e.storedSize = destLen;
+					e.flags |= Deflated;
+				}
+			}
+
+			e.offset = alignUp(mDataEnd);
+			if(!writeAt(e.offset, storedData, size_t(e.storedSize)))
+				return false;
+			mDataEnd = e.offset + e.storedSize;
+			mContents.insert(std::make_pair(key, mEntries.size()));
+		}
+
+		mNames[name] = mEntries.size();
+		mEntries.push_back(e);
+		return true;
+	}
+
+	//! Read back what was written for mEntries[index].
+	sal_checkreturn bool readAt(uint64_t offset, void* data, size_t size)
+	{
+		mOs.seekg(mBase + std::streamoff(offset));
+		mOs.read((char*)data, size);
+		if(mOs.good())
+			return true;
+
+		// Leave the stream writable
+		mOs.clear();
+		return false;
+	}
+
+	//! Compare the data with what was stored for mEntries[index], decompress it if needed.
+	bool isSameContent(size_t index, const void* data, size_t size)
+	{
+		const PackEntry& other = mEntries[index];
+		if(other.size != size)
+			return false;
+		if(size == 0)
+			return true;
+
+		std::vector<char> stored(size_t(other.storedSize));
+		if(!readAt(other.offset, &stored[0], stored.size()))
+			return false;
+
+		if(!(other.flags & Deflated))
+			return memcmp(&stored[0], data, size) == 0;
+
+		std::vector<char> buffer(size);
+		uLongf destLen = uLongf(size);
+		return ::uncompress((Bytef*)&buffer[0], &destLen, (const Bytef*)&stored[0], uLong(stored.size())) == Z_OK &&
+			destLen == size && memcmp(&buffer[0], data, size) == 0;
+	}
+
+	sal_checkreturn bool commit()
+	{
+		if(mCommitted)
+			return false;
+
+		// Load factor no more than 0.5
+		uint32_t slotCount = 1;
+		while(slotCount < mEntries.size() * 2)
+			slotCount <<= 1;
+
+		std::vector<PackEntry> slots(slotCount);
+		memset(&slots[0], 0, sizeof(PackEntry) * slotCount);
+
+		std::string nameTable;
+		const uint32_t mask = slotCount - 1;
+		for(NameMap::const_iterator i=mNames.begin(); i!=mNames.end(); ++i) {
+			PackEntry e = mEntries[i->second];
+			e.nameOffset = uint32_t(nameTable.size());
+			e.nameLength = uint32_t(i->first.size());
+			nameTable.append(i->first.c_str(), i->first.size() + 1);
+
+			uint32_t slot = e.pathHash & mask;
+			while(slots[slot].flags & Used)
+				slot = (slot + 1) & mask;
+			slots[slot] = e;
+		}
+
+		PackHeader header;
+		memcpy(header.magic, cMagic, sizeof(cMagic));
+		header.version = cVersion;
+		header.entryCount = uint32_t(mEntries.size());
+		header.slotCount = slotCount;
+		header.directoryOffset = alignUp(mDataEnd);
+		header.nameTableOffset = header.directoryOffset + sizeof(PackEntry) * slotCount;
+		header.nameTableSize = nameTable.size();
+
+		if(!writeAt(header.directoryOffset, &slots[0], sizeof(PackEntry) * slotCount))
+			return false;
+		if(!nameTable.empty() && !writeAt(header.nameTableOffset, nameTable.c_str(), nameTable.size()))
+			return false;
+		if(!writeAt(0, &header, sizeof(header)))
+			return false;
+
+		mOs.seekp(mBase + std::streamoff(header.nameTableOffset + header.nameTableSize));
+		mOs.flush();
+		mCommitted = true;
+		return mOs.good();
+	}
+
+	typedef std::pair<uint64_t, uint64_t> ContentKey;	//!< Content hash and size
+	typedef std::multimap<ContentKey, size_t> ContentMap;	//!< Maps to index of mEntries
+	typedef std::map<std::string, size_t> NameMap;		//!< Maps to index of mEntries
+
+	std::iostream& mOs;
+	std::streampos mBase;
+	bool mCommitted;
+	uint64_t mDataEnd;
+	size_t mDedupCount;
+	uint64_t mDedupBytes;
+	std::vector<PackEntry> mEntries;
+	ContentMap mContents;	//!< Only for the entries owning their data
+	NameMap mNames;
+};	// Impl
+
+PackFileWriter::PackFileWriter(std::iostream& os)
+	: mImpl(*new Impl(os))
+{
+}
+
+PackFileWriter::~PackFileWriter()
+{
+	delete &mImpl;
+}
+
+bool PackFileWriter::add(const Path& path, const void* data, size_t size, bool compress, std::time_t lastWriteTime)
+{
+	MCD_ASSERT(data || size == 0);
+	return mImpl.add(path, data, size, compress, lastWriteTime);
+}
+
+bool PackFileWriter::add(const Path& path, std::istream& is, bool compress, std::time_t lastWriteTime)
+{
+	std::vector<char> buffer;
+	char tmp[4096];
+	while(is) {
+		is.read(tmp, sizeof(tmp));
+		buffer.insert(buffer.end(), tmp, tmp + is.gcount());
+	}
+
+	return mImpl.add(path, buffer.empty() ? nullptr : &buffer[0], buffer.size(), compress, lastWriteTime);
+}
+
+bool PackFileWriter::commit() {
+	return mImpl.commit();
+}
+
+size_t PackFileWriter::entryCount() const {
+	return mImpl.mEntries.size();
+}
+
+size_t PackFileWriter::dedupCount() const {
+	return mImpl.mDedupCount;
+}
+
+uint64_t PackFileWriter::dedupBytes() const {
+	return mImpl.mDedupBytes;
+}
+
+uint64_t PackFileWriter::hashContent(const void* data, size_t size)
+{
+	// Reference: http://www.isthe.com/chongo/tech/comp/fnv/
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+	uint64_t hash = 14695981039346656037ULL;
+	for(size_t i=0; i<size; ++i) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+}	// namespace MCD
@@ -0,0 +1,135 @@
+#ifndef __MCD_CORE_SYSTEM_PACKFILESYSTEM__
+#define __MCD_CORE_SYSTEM_PACKFILESYSTEM__
+
+#include "FileSystem.h"
+#include "IntrusivePtr.h"
+#include "NonCopyable.h"
+
+namespace MCD {
+
+/// A read-only file system over a single pack file produced by PackFileWriter.
+///
+/// The pack file is memory mapped on setRoot(), and the directory is an open
+/// addressing hash table keyed by the StringHash of the normalized path, so a
+/// lookup neither allocate nor parse anything in the common case.
+/// Uncompressed entries are returned as streams pointing directly into the
+/// mapped memory without any copying; compressed entries are inflated into
+/// a buffer owned by the returned stream.
+///
+/// \note This class is multi-thread safe, since the mapped data is immutable.
+/// \note Like ZipFileSystem, opened streams hold a reference to the mapping,
+/// 	so it's fine to destroy the PackFileSystem while the streams are in use.
+/// \sa PackFileWriter
+class MCD_CORE_API PackFileSystem : public IFileSystem
+{
+public:
+	/// Construct the pack file system with the supplied pack file path.
+	/// \sa setRoot
+	explicit PackFileSystem(const Path& packFilePath);
+
+	sal_override ~PackFileSystem();
+
+	sal_override Path getRoot() const;
+
+	/// Map another pack file, the state is unchanged if the new pack file is invalid.
+	/// \param packFilePath If it's a relative path,
+	/// 	Path::getCurrentPath() will be used in front of it.
+	sal_override bool setRoot(const Path& packFilePath);
+
+	sal_override bool isExists(const Path& path) const;
+
+	/// Directories are not stored explicitly, a path is a directory if some entry is inside it.
+	sal_override bool isDirectory(const Path& path) const;
+
+	sal_override uint64_t getSize(const Path& path) const;
+
+	sal_override std::time_t getLastWriteTime(const Path& path) const;
+
+	/// Not supported.
+	sal_override bool makeDir(const Path& path) const;
+
+	/// Not supported.
+	sal_override bool remove(const Path& path) const;
+
+	/// Returns a seekable std::istream for reading, null if fail.
+	sal_override std::auto_ptr<std::istream> openRead(const Path& path) const;
+
+	/// Uncompressed entries point directly into the mapped memory.
+	sal_override ReadSpanPtr openReadSpan(const Path& path) const;
+
+	/// Not supported.
+	sal_override std::auto_ptr<std::ostream> openWrite(const Path& path) const;
+
+	sal_override sal_maybenull void* openFirstFileInFolder(const Path& folder) const;
+
+	sal_override Path getNextFileInFolder(sal_maybenull void* context) const;
+
+	sal_override void closeFirstFileInFolder(sal_maybenull void* context) const;
+
+	/// Number of files in the pack.
+	size_t entryCount() const;
+
+private:
+	class Impl;
+	typedef IntrusivePtr<Impl> ImplPtr;
+	ImplPtr mImpl;
+};	// PackFileSystem
+
+/// Creates a pack file that can be read by PackFileSystem.
+///
+/// The data of each entry is written to the stream right away at a 4K aligned
+/// offset, the directory is kept in memory until commit() is called.
+/// Entries having the same content (found by size and a 64 bits hash, then
+/// compared byte by byte) are stored once, with the later entries pointing to
+/// the first copy. Only the hash, size and offset of each entry are kept in
+/// memory, the bytes to compare are read back from the stream.
+///
+/// Example:
+/// \code
+/// std::fstream os("data.pak", std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+/// PackFileWriter writer(os);
+/// writer.add("textures/a.png", data, size);
+/// writer.add("scripts/main.nut", script, scriptSize, true);	// Deflate compressed
+/// writer.commit();
+/// \endcode
+class MCD_CORE_API PackFileWriter : Noncopyable
+{
+public:
+	/// The stream should be opened in binary mode for both reading and writing, and must support seeking.
+	explicit PackFileWriter(std::iostream& os);
+
+	/// Will NOT invoke commit(), an un-committed pack file is invalid.
+	~PackFileWriter();
+
+	/// Write a block of memory as a new entry.
+	/// Returns false if the path already exist in the pack or upon write failure.
+	/// \param compress Deflate the data, the entry is still stored uncompressed
+	/// 	if compression does not make it smaller.
+	sal_checkreturn bool add(const Path& path, sal_in_bcount(size) const void* data, size_t size, bool compress=false, std::time_t lastWriteTime=0);
+
+	/// Read the whole stream and add it as a new entry.
+	sal_checkreturn bool add(const Path& path, std::istream& is, bool compress=false, std::time_t lastWriteTime=0);
+
+	/// Write the directory and header, no more entry can be added afterward.
+	sal_checkreturn bool commit();
+
+	/// Number of entries added so far.
+	size_t entryCount() const;
+
+	/// Number of entries which shared the data of a previously added entry.
+	size_t dedupCount() const;
+
+	/// Bytes saved by sharing identical data among entries.
+	uint64_t dedupBytes() const;
+
+	/// The 64 bits FNV-1a hash used for detecting identical content.
+	static uint64_t hashContent(sal_in_bcount(size) const void* data, size_t size);
+
+private:
+	class Impl;
+	Impl& mImpl;
+};	// PackFileWriter
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_PACKFILESYSTEM__
@@ -27,6 +27,10 @@
 #	define MCD_CYGWIN
 #endif
 
+#ifdef __linux__
+#	define MCD_LINUX
+#endif
+
 #ifdef __APPLE__
 #	include <Availability.h>
 #	include <TargetConditionals.h>
@@ -249,6 +253,7 @@ typedef unsigned char byte_t;
 #define sal_in_ecount_opt(count)
 #define sal_out_ecount(count)
 #define sal_out_ecount_opt(count)
+#define sal_in_bcount(count)
 #define sal_inout_bcount(count)
 #define sal_format_guard
 
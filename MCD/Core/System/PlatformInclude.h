@@ -42,4 +42,27 @@
 
 #endif	// MCD_GCC
 
+#ifdef MCD_LINUX
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace MCD {
+
+//!	Sleep while *addr == val, returns -1 with errno set to ETIMEDOUT, EAGAIN (*addr != val) or EINTR.
+inline int futexWait(volatile int* addr, int val, const timespec* relativeTimeout=nullptr) {
+	return int(::syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, relativeTimeout, nullptr, 0));
+}
+
+//!	Wake up at most count threads sleeping on addr, returns the number of woken threads.
+inline int futexWake(volatile int* addr, int count) {
+	return int(::syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0));
+}
+
+}	// namespace MCD
+
+#endif	// MCD_LINUX
+
 #endif	//__MCD_CORE_SYSTEM_PLATFORMINCLUDE__
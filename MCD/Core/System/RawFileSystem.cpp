@@ -2,6 +2,7 @@
 #include "RawFileSystem.h"
 #include "ErrorCode.h"
 #include "Log.h"
+#include "MemoryMappedFile.h"
 #include "PlatformInclude.h"
 #include "StrUtility.h"
 #include <fstream>
@@ -111,6 +112,7 @@ bool isDirectoryImpl(sal_in_z sal_notnull const char* path)
 }
 
 RawFileSystem::RawFileSystem(const Path& rootPath)
+	: mMemoryMapping(false)
 {
 	if(!RawFileSystem::setRoot(rootPath))
 		logError("The path ", rootPath.c_str(), " does not exist or not a directory");
@@ -309,6 +311,19 @@ std::auto_ptr<std::istream> RawFileSystem::openRead(const Path& path) const
 	return is;
 }
 
+ReadSpanPtr RawFileSystem::openReadSpan(const Path& path) const
+{
+	if(mMemoryMapping) {
+		MemoryMappedFilePtr file = new MemoryMappedFile;
+
+		// Zero sized file cannot be mapped
+		if(file->open(toAbsolutePath(path)))
+			return createMappedReadSpan(file, 0, size_t(file->size()));
+	}
+
+	return readSpanFromFileSystem(*this, path);
+}
+
 std::auto_ptr<std::ostream> RawFileSystem::openWrite(const Path& path) const
 {
 	using namespace std;
@@ -40,6 +40,11 @@ public:
 
 	sal_override std::auto_ptr<std::istream> openRead(const Path& path) const;
 
+	/*!	Reads the whole file, or memory maps it if setMemoryMapping(true).
+		Mapping falls back to reading if it fails.
+	 */
+	sal_override ReadSpanPtr openReadSpan(const Path& path) const;
+
 	sal_override std::auto_ptr<std::ostream> openWrite(const Path& path) const;
 
 	sal_override sal_maybenull void* openFirstChildFolder(const Path& folder) const;
@@ -57,8 +62,18 @@ public:
 	//! Convert our virtualized path into OS's absolute path
 	Path toAbsolutePath(const Path& path) const;
 
+	/*!	Let openReadSpan() memory map the files, instead of reading them. Off by default.
+		Only turn it on if the files under the root are not modified while a span is alive,
+		since truncating a mapped file crashes the reader with SIGBUS. So keep it off for
+		directories being watched for hot reloading, as those added by Framework.
+	 */
+	void setMemoryMapping(bool enable) { mMemoryMapping = enable; }
+
+	bool memoryMapping() const { return mMemoryMapping; }
+
 private:
 	Path mRootPath;
+	bool mMemoryMapping;
 };	// RawFileSystem
 
 }	// namespace MCD
@@ -0,0 +1,114 @@
+#include "Pch.h"
+#include "ReadSpan.h"
+#include "FileSystem.h"
+#include "MemoryMappedFile.h"
+#include "Stream.h"
+#include <stdlib.h>	// For malloc, realloc, free
+
+namespace MCD {
+
+namespace {
+
+class OwnedReadSpan : public ReadSpan
+{
+public:
+	OwnedReadSpan(char* buffer, size_t size) : ReadSpan(buffer, size) {}
+
+	sal_override ~OwnedReadSpan() {
+		::free(const_cast<char*>(mData));
+	}
+};	// OwnedReadSpan
+
+class MappedReadSpan : public ReadSpan
+{
+public:
+	MappedReadSpan(const MemoryMappedFilePtr& file, const char* data, size_t size)
+		: ReadSpan(data, size), mFile(file)
+	{}
+
+protected:
+	//!	Keep the mapping alive during the life time of the span
+	const MemoryMappedFilePtr mFile;
+};	// MappedReadSpan
+
+class SpanStreamProxy : public StreamProxy
+{
+public:
+	explicit SpanStreamProxy(const ReadSpanPtr& span)
+		: mSpan(span)
+	{
+		setbuf(const_cast<char*>(span->data()), span->size(), span->size(), nullptr);
+	}
+
+	//!	Keep the span alive during the life time of the stream
+	const ReadSpanPtr mSpan;
+};	// SpanStreamProxy
+
+}	// namespace
+
+ReadSpanPtr createOwnedReadSpan(char* buffer, size_t size)
+{
+	return new OwnedReadSpan(buffer, size);
+}
+
+ReadSpanPtr createMappedReadSpan(const MemoryMappedFilePtr& file, uint64_t offset, size_t size)
+{
+	if(!file || offset + size > file->size())
+		return nullptr;
+	return new MappedReadSpan(file, file->data() + offset, size);
+}
+
+ReadSpanPtr readSpanFromStream(std::istream& is, size_t sizeHint)
+{
+	size_t capacity = sizeHint > 0 ? sizeHint : 4096;
+	size_t size = 0;
+	char* buffer = (char*)::malloc(capacity);
+	if(!buffer)
+		return nullptr;
+
+	while(is) {
+		if(size == capacity) {
+			// One more byte than the hint to detect the end of stream without an extra grow
+			const size_t newCapacity = capacity == sizeHint ? capacity + 1 : capacity * 2;
+			char* p = (char*)::realloc(buffer, newCapacity);
+			if(!p) {
+				::free(buffer);
+				return nullptr;
+			}
+			buffer = p;
+			capacity = newCapacity;
+		}
+		is.read(buffer + size, std::streamsize(capacity - size));
+		size += size_t(is.gcount());
+	}
+
+	return createOwnedReadSpan(buffer, size);
+}
+
+ReadSpanPtr readSpanFromFileSystem(const IFileSystem& fs, const Path& path)
+{
+	std::auto_ptr<std::istream> is = fs.openRead(path);
+	if(!is.get())
+		return nullptr;
+	return readSpanFromStream(*is, size_t(fs.getSize(path)));
+}
+
+std::auto_ptr<std::istream> createSpanStream(const ReadSpanPtr& span)
+{
+	std::auto_ptr<std::istream> is;
+	if(span)
+		is.reset(new Stream(*new SpanStreamProxy(span)));
+	return is;
+}
+
+ReadSpan* getReadSpan(std::istream* is)
+{
+	Stream* stream = dynamic_cast<Stream*>(is);
+	if(!stream)
+		return nullptr;
+
+	SpanStreamProxy* proxy = dynamic_cast<SpanStreamProxy*>(stream->rdbuf()->proxy());
+	return proxy ? proxy->mSpan.get() : nullptr;
+}
+
+}	// namespace MCD
@@ -0,0 +1,70 @@
+#ifndef __MCD_CORE_SYSTEM_READSPAN__
+#define __MCD_CORE_SYSTEM_READSPAN__
+
+#include "Atomic.h"
+#include "IntrusivePtr.h"
+#include "NonCopyable.h"
+#include <iosfwd>
+#include <memory>	// For std::auto_ptr
+
+namespace MCD {
+
+class IFileSystem;
+class Path;
+typedef IntrusivePtr<class MemoryMappedFile> MemoryMappedFilePtr;
+
+/*!	A contiguous, read-only block of memory holding the whole content of a file.
+	The memory may be a memory mapped file or a buffer owned by the span, the span
+	keeps the underlying storage alive as long as it's referenced. A span created
+	by the constructor of this class refers to memory owned by someone else (eg.
+	the block given to MemoryFileSystem::add()), which must out live the span.
+
+	\sa IFileSystem::openReadSpan()
+ */
+class MCD_CORE_API ReadSpan : public IntrusiveSharedObject<AtomicInteger>, Noncopyable
+{
+public:
+	//!	The memory is NOT owned by the span.
+	ReadSpan(sal_in_bcount(size) const char* data, size_t size) : mData(data), mSize(size) {}
+
+	sal_notnull const char* data() const { return mData; }
+
+	size_t size() const { return mSize; }
+
+protected:
+	const char* mData;
+	size_t mSize;
+};	// ReadSpan
+
+typedef IntrusivePtr<ReadSpan> ReadSpanPtr;
+
+//!	Create a span which will free() the buffer, the buffer must be allocated by malloc().
+MCD_CORE_API ReadSpanPtr createOwnedReadSpan(sal_in_bcount(size) char* buffer, size_t size);
+
+//!	Create a span pointing into a memory mapped file, the mapping is kept alive by the span.
+MCD_CORE_API ReadSpanPtr createMappedReadSpan(const MemoryMappedFilePtr& file, uint64_t offset, size_t size);
+
+/*!	Read the whole stream into an owned span.
+	\param sizeHint The expected size, for reserving the buffer in one go; 0 for unknown.
+ */
+MCD_CORE_API ReadSpanPtr readSpanFromStream(std::istream& is, size_t sizeHint=0);
+
+/*!	The generic IFileSystem::openReadSpan() implementation: reads the whole
+	stream given by IFileSystem::openRead() into an owned span.
+ */
+MCD_CORE_API ReadSpanPtr readSpanFromFileSystem(const IFileSystem& fs, const Path& path);
+
+/*!	Create a seekable std::istream reading from the span without any copying.
+	Returns null if the span is null.
+ */
+MCD_CORE_API std::auto_ptr<std::istream> createSpanStream(const ReadSpanPtr& span);
+
+/*!	Returns the span behind a stream created by createSpanStream(), null otherwise.
+	Loaders can use it as a fast path to decode directly from memory, together
+	with the current read position given by std::istream::tellg().
+ */
+MCD_CORE_API sal_maybenull ReadSpan* getReadSpan(sal_maybenull std::istream* is);
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_READSPAN__
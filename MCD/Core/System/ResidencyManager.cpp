@@ -0,0 +1,259 @@
+#include "Pch.h"
+#include "ResidencyManager.h"
+#include "FileSystem.h"
+#include "Resource.h"
+#include "ResourceLoader.h"
+#include "ResourceManager.h"
+#include <list>
+#include <map>
+#include <string.h>	// For memset
+
+namespace MCD {
+
+class ResidencyManager::Impl
+{
+public:
+	struct Entry;
+	typedef std::map<Path, Entry> Entries;
+	typedef std::list<Entries::iterator> LruList;	//!< Most recently used at the front
+
+	enum State
+	{
+		Loading,
+		Loaded,	//!< Committed at least once
+		Failed	//!< The loader aborted, it's never charged against the budget
+	};	// State
+
+	struct Entry
+	{
+		ResourcePtr resource;
+		State state;
+		uint64_t bytes;
+		bool sized;			//!< The size is known, either by the resource, the file size or setResourceSize()
+		bool prefetched;	//!< Prefetched but not yet acquired
+		double deadline;	//!< Zero for no deadline
+		LruList::iterator lru;
+	};	// Entry
+
+	Impl(ResourceManager& resourceManager, uint64_t budgetBytes)
+		: mResourceManager(resourceManager), mBudget(budgetBytes)
+	{
+		::memset(&mStats, 0, sizeof(mStats));
+	}
+
+	//! Update the state of a loading entry, the loader is only asked until the load is finished.
+	State updateState(const Path& fileId, Entry& e)
+	{
+		if(e.state != Loading)
+			return e.state;
+
+		if(e.resource->commitCount() > 0)
+			e.state = Loaded;
+		else {
+			IResourceLoaderPtr loader = mResourceManager.getLoader(fileId);
+			if(!loader || loader->loadingState() == IResourceLoader::Aborted) {
+				e.state = Failed;
+				++mStats.failCount;
+				mStats.residentBytes -= e.bytes;	// In case setResourceSize() is called
+				e.bytes = 0;
+				e.sized = true;
+			}
+		}
+
+		return e.state;
+	}
+
+	//! The resource is not referenced by anyone other than us, and not in the middle of loading.
+	static bool isEvictable(const Entry& e) {
+		return e.resource->referenceCount() == 1 && e.state != Loading;
+	}
+
+	sal_maybenull Entry* findOrLoad(const Path& fileId, int priority, bool& isNew)
+	{
+		isNew = false;
+		Entries::iterator i = mEntries.find(fileId);
+		if(i != mEntries.end())
+			return &i->second;
+
+		ResourcePtr resource = mResourceManager.load(fileId, 0, priority);
+		if(!resource)
+			return nullptr;
+
+		i = mEntries.insert(std::make_pair(fileId, Entry())).first;
+		Entry& e = i->second;
+		e.resource = resource;
+		e.state = Loading;
+		e.bytes = 0;
+		e.sized = false;
+		e.prefetched = false;
+		e.deadline = 0;
+		e.lru = mLru.insert(mLru.begin(), i);
+		++mStats.residentCount;
+		isNew = true;
+
+		return &e;
+	}
+
+	void touch(Entry& e)
+	{
+		mLru.splice(mLru.begin(), mLru, e.lru);
+	}
+
+	/*!	The size reported by the resource is used once it's loaded, or the file size
+		if the resource doesn't know; where we know the file exists.
+	 */
+	void updateSize(const Path& fileId, Entry& e)
+	{
+		if(e.sized || updateState(fileId, e) != Loaded)
+			return;
+		e.bytes = e.resource->memorySize();
+		if(e.bytes == 0)
+			e.bytes = mResourceManager.fileSystem().getSize(fileId);
+		e.sized = true;
+		mStats.residentBytes += e.bytes;
+	}
+
+	void evictTill(uint64_t budget)
+	{
+		// Walk from the least recently used
+		for(LruList::iterator i=mLru.end(); i!=mLru.begin() && (budget == 0 || mStats.residentBytes > budget);) {
+			Entries::iterator entry = *(--i);
+			const Entry& e = entry->second;
+			if(!isEvictable(e))
+				continue;
+
+			++mStats.evictionCount;
+			mStats.evictedBytes += e.bytes;
+			mStats.residentBytes -= e.bytes;
+			--mStats.residentCount;
+			i = mLru.erase(i);
+			mEntries.erase(entry);	// The resource will be gone together with the last reference
+		}
+	}
+
+	ResourceManager& mResourceManager;
+	uint64_t mBudget;
+	Entries mEntries;
+	LruList mLru;
+	Stats mStats;
+};	// Impl
+
+ResidencyManager::ResidencyManager(ResourceManager& resourceManager, uint64_t budgetBytes)
+	: mImpl(*new Impl(resourceManager, budgetBytes))
+{
+}
+
+ResidencyManager::~ResidencyManager()
+{
+	delete &mImpl;
+}
+
+void ResidencyManager::prefetch(const Path& fileId, int priority, double deadline)
+{
+	bool isNew;
+	Impl::Entry* e = mImpl.findOrLoad(fileId, priority, isNew);
+	if(!e || !isNew)
+		return;
+
+	e->prefetched = true;
+	e->deadline = deadline;
+	++mImpl.mStats.prefetchCount;
+}
+
+void ResidencyManager::prefetch(const std::vector<Path>& fileIds, int priority, double deadline)
+{
+	for(size_t i=0; i<fileIds.size(); ++i)
+		prefetch(fileIds[i], priority, deadline);
+}
+
+ResourcePtr ResidencyManager::acquire(const Path& fileId, int priority)
+{
+	bool isNew;
+	Impl::Entry* e = mImpl.findOrLoad(fileId, priority, isNew);
+	if(!e)
+		return nullptr;
+
+	mImpl.touch(*e);
+	mImpl.updateSize(fileId, *e);
+
+	// Not loading it again, until it's evicted
+	if(e->state == Impl::Failed) {
+		e->prefetched = false;
+		e->deadline = 0;
+		return nullptr;
+	}
+
+	if(e->state != Impl::Loaded)
+		++mImpl.mStats.stallCount;
+	else if(e->prefetched)
+		++mImpl.mStats.prefetchHit;
+
+	e->prefetched = false;
+	e->deadline = 0;
+
+	return e->resource;
+}
+
+void ResidencyManager::update(double currentTime)
+{
+	for(Impl::Entries::iterator i=mImpl.mEntries.begin(); i!=mImpl.mEntries.end(); ++i) {
+		Impl::Entry& e = i->second;
+		mImpl.updateSize(i->first, e);
+
+		if(e.deadline > 0 && e.deadline <= currentTime) {
+			if(e.state == Impl::Loading)
+				++mImpl.mStats.lateCount;
+			e.deadline = 0;
+		}
+	}
+
+	mImpl.evictTill(mImpl.mBudget);
+}
+
+void ResidencyManager::evictAll()
+{
+	mImpl.evictTill(0);
+}
+
+uint64_t ResidencyManager::budget() const {
+	return mImpl.mBudget;
+}
+
+void ResidencyManager::setBudget(uint64_t budgetBytes) {
+	mImpl.mBudget = budgetBytes;
+}
+
+void ResidencyManager::setResourceSize(const Path& fileId, uint64_t bytes)
+{
+	Impl::Entries::iterator i = mImpl.mEntries.find(fileId);
+	if(i == mImpl.mEntries.end())
+		return;
+
+	Impl::Entry& e = i->second;
+	if(e.state == Impl::Failed)
+		return;
+
+	mImpl.mStats.residentBytes -= e.bytes;
+	mImpl.mStats.residentBytes += bytes;
+	e.bytes = bytes;
+	e.sized = true;
+}
+
+bool ResidencyManager::isResident(const Path& fileId) const {
+	return mImpl.mEntries.find(fileId) != mImpl.mEntries.end();
+}
+
+const ResidencyManager::Stats& ResidencyManager::stats() const {
+	return mImpl.mStats;
+}
+
+void ResidencyManager::resetStats()
+{
+	const uint64_t residentBytes = mImpl.mStats.residentBytes;
+	const size_t residentCount = mImpl.mStats.residentCount;
+	::memset(&mImpl.mStats, 0, sizeof(mImpl.mStats));
+	mImpl.mStats.residentBytes = residentBytes;
+	mImpl.mStats.residentCount = residentCount;
+}
+
+}	// namespace MCD
@@ -0,0 +1,111 @@
+#ifndef __MCD_CORE_SYSTEM_RESIDENCYMANAGER__
+#define __MCD_CORE_SYSTEM_RESIDENCYMANAGER__
+
+#include "NonCopyable.h"
+#include "Path.h"
+#include "IntrusivePtr.h"
+#include <vector>
+
+namespace MCD {
+
+class ResourceManager;
+typedef IntrusivePtr<class Resource> ResourcePtr;
+
+/*!	Keeps resources resident in memory ahead of their use, under a memory budget.
+
+	ResourceManager itself only caches resources weakly, a resource is gone as soon
+	as nobody reference it. The ResidencyManager holds a strong reference to every
+	resource it knows about, so that:
+	 -	Resources can be prefetched (background loaded) before they are needed,
+		for example the assets of the region in front of the camera.
+	 -	Resources not referenced by anyone else are kept as a cache, and the least
+		recently used ones are released once the total size exceed the budget.
+
+	The size of a resource is given by Resource::memorySize() once it's loaded, or the
+	file size if the resource doesn't know, which can be overrided with setResourceSize().
+	A resource failed to load is kept with a zero size, so acquire() returns null
+	without loading it again until it's evicted.
+
+	Example:
+	\code
+	ResidencyManager residency(resourceManager, 64 * 1024 * 1024);
+
+	// Each frame
+	residency.prefetch(pathsOfNextRegion, 1, currentTime + 2);
+	ResourcePtr texture = residency.acquire("textures/ground.png");
+	residency.update(currentTime);
+	\endcode
+
+	\note The time used for deadlines is supplied by the user, in second.
+	\note This class is not thread safe, it should be used in the main thread
+		along with ResourceManager::popEvent().
+ */
+class MCD_CORE_API ResidencyManager : Noncopyable
+{
+public:
+	struct Stats
+	{
+		size_t prefetchCount;	//!< Number of prefetch issued, excluding the already resident ones
+		size_t prefetchHit;		//!< Number of acquire() served by a prefetched resource
+		size_t lateCount;		//!< Number of prefetch not yet loaded when the deadline reached
+		size_t stallCount;		//!< Number of acquire() on a resource which is not loaded yet
+		size_t failCount;		//!< Number of resources failed to load
+		size_t evictionCount;
+		uint64_t evictedBytes;
+		uint64_t residentBytes;	//!< Total size of the resources currently held
+		size_t residentCount;
+	};	// Stats
+
+	/*!	\param budgetBytes The total size of resource to be kept, resources still
+			referenced by others are counted but never evicted. Zero means no
+			unreferenced resource is kept after update().
+	 */
+	ResidencyManager(ResourceManager& resourceManager, uint64_t budgetBytes);
+
+	~ResidencyManager();
+
+// Operations
+	/*!	Hint that a resource will be needed before the deadline.
+		The resource is loaded in background using the given priority.
+	 */
+	void prefetch(const Path& fileId, int priority=0, double deadline=0);
+
+	void prefetch(const std::vector<Path>& fileIds, int priority=0, double deadline=0);
+
+	/*!	Get the resource which is needed right now, and mark it as the most recently used.
+		The resource is loaded in background if it's not already resident, and
+		a stall is counted if it's not yet loaded.
+		Returns null if the ResourceManager cannot load it, or the load failed.
+	 */
+	sal_maybenull ResourcePtr acquire(const Path& fileId, int priority=0);
+
+	/*!	Check for deadlines and evict resources to meet the budget.
+		\param currentTime The time in the same unit as the deadline.
+	 */
+	void update(double currentTime);
+
+	//! Release all the unreferenced resources, regardless of the budget.
+	void evictAll();
+
+// Attributes
+	uint64_t budget() const;
+
+	void setBudget(uint64_t budgetBytes);
+
+	//! Override the size of a resident resource, for those without Resource::memorySize().
+	void setResourceSize(const Path& fileId, uint64_t bytes);
+
+	bool isResident(const Path& fileId) const;
+
+	const Stats& stats() const;
+
+	void resetStats();
+
+protected:
+	class Impl;
+	Impl& mImpl;
+};	// ResidencyManager
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_RESIDENCYMANAGER__
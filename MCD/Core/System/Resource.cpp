@@ -12,4 +12,9 @@ Resource::~Resource()
 	MCD_ASSERT(mRefCount == 0);
 }
 
+size_t Resource::memorySize() const
+{
+	return 0;
+}
+
 }	// namespace MCD
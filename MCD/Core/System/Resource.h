@@ -24,6 +24,11 @@ public:
 	/// To track how many times the resource is committed (by loader or any other means).
 	size_t commitCount() const { return mCommitCount; }
 
+	/*!	The memory used by the committed resource in byte, for budgeting like ResidencyManager.
+		Zero if unknown, which is the default.
+	 */
+	virtual size_t memorySize() const;
+
 protected:
 	/*!	Virtual function to make Resource a polymorphic type so
 		that we can apply dynamic_cast on concrete resource type.
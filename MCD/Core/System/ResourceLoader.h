@@ -86,6 +86,11 @@ public:
 	/// Force the blocing iteration no matter what option the user pass to ResourceManager::load().
 	virtual int forceBlockingIteration() const { return -1; }
 
+	/// Return true if the loader has a fast path decoding directly from memory, in which
+	/// case the stream given to load() is created with IFileSystem::openReadSpan() and
+	/// the loader can get the whole file content with getReadSpan().
+	virtual bool preferReadSpan() const { return false; }
+
 	/// \note All dependency functions only accounts for direct dependency.
 
 	/// Number of resource that depending on this.
@@ -107,6 +112,9 @@ private:
 
 	void releaseThis();
 
+	/// Put this loader into the task pool, or into the I/O stage if the file is not read yet.
+	void enqueueNoLock();
+
 	sal_override void run(Thread& thread);
 
 	LoadingState _load(const Path* fileId, sal_in_z const char* args);
@@ -135,6 +143,8 @@ private:
 
 	// Intermediate states
 	bool mNeedEnqueu;						///< Prevent summitting a loader into the task pool multiple times
+	bool mIoPending;						///< The file is being read by the I/O stage
+	bool mIoDone;							///< The I/O stage is over, even if it gave no stream (eg. missing file)
 	bool mPendForCommit;
 	size_t mOutstandingContinueCount;		///< Make sure no (multiple) call to continueLoad() will ignored
 
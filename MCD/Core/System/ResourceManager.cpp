@@ -1,10 +1,13 @@
 #include "Pch.h"
 #include "ResourceManager.h"
+#include "Atomic.h"
 #include "CondVar.h"
+#include "ContentHash.h"
 #include "Deque.h"
 #include "FileSystem.h"
 #include "Log.h"
 #include "Macros.h"
+#include "MemoryMappedFile.h"
 #include "MemoryProfiler.h"
 #include "PtrVector.h"
 #include "Resource.h"
@@ -13,6 +16,9 @@
 #include "Timer.h"
 #include "Utility.h"
 #include <algorithm>	// for std::find
+#include <map>
+#include <set>
+#include <string.h>	// For memcmp, memset
 
 namespace MCD {
 
@@ -25,6 +31,16 @@ public:
 	sal_override void commit(Resource&) {}
 };	// DummyLoader
 
+//!	Touch every page, so a memory mapped span is read from the disk right now rather than during decode.
+static void prefault(const ReadSpan& span)
+{
+	volatile char sum = 0;
+	const size_t pageSize = MemoryMappedFile::pageSize();
+	for(size_t i=0; i<span.size(); i+=pageSize)
+		sum += span.data()[i];
+	(void)sum;
+}
+
 }	// namespace
 
 class ResourceManager::Impl
@@ -87,6 +103,51 @@ class ResourceManager::Impl
 		std::deque<IResourceLoaderPtr> mQueue;
 	};	// EventQueue
 
+	/*!	Reads the whole file of a loader in the I/O threads, and then hand the loader to the decoding task pool.
+		With the content deduplication, the bytes read are also hashed here rather than in the thread calling load().
+	 */
+	class IoRequest : public TaskPool::Task
+	{
+	public:
+		IoRequest(IResourceLoader& loader, Impl& impl)
+			: TaskPool::Task(loader.priority())
+			, mLoader(&loader), mImpl(impl), mFileId(loader.mPathKey.getKey()), mArgs(loader.mArgs)
+		{}
+
+		sal_override void run(Thread& thread)
+		{
+			ReadSpanPtr span;
+
+			// When the I/O task pool is stopping, leave the read to the loader
+			if(thread.keepRun()) {
+				span = mImpl.mFileSystem.openReadSpan(mFileId);
+				if(span) {
+					prefault(*span);
+					if(mImpl.mContentDedup)
+						mImpl.indexContent(mFileId, mArgs.c_str(), *span);
+				}
+			}
+
+			{	ScopeLock lock(mLoader->mMutex);
+				mLoader->mIoPending = false;
+				mLoader->mIoDone = true;
+
+				// A blocking load may have opened the file in the mean time
+				if(span && !mLoader->mIStream.get() && !(mLoader->mState & IResourceLoader::Stopped))
+					mLoader->mIStream = createSpanStream(span);
+
+				mLoader->enqueueNoLock();
+			}
+
+			delete this;
+		}
+
+		IResourceLoaderPtr mLoader;
+		Impl& mImpl;
+		Path mFileId;
+		std::string mArgs;
+	};	// IoRequest
+
 public:
 	Impl(TaskPool* externalTaskPool, ResourceManager& manager, IFileSystem& fileSystem, bool takeFileSystemOwnership)
 		: mTaskPool(externalTaskPool)
@@ -94,11 +155,13 @@ public:
 		, mFileSystem(fileSystem)
 		, mTakeFileSystemOwnership(takeFileSystemOwnership)
 		, mCreatorThreadId(getCurrentThreadId())
+		, mContentDedup(false)
 	{
 		mIsExternalTaskPool = externalTaskPool != nullptr;
 		if(!externalTaskPool)
 			mTaskPool.reset(new TaskPool);
 		mEventQueue.mMutex = &mMutex;
+		::memset(&mDedupStats, 0, sizeof(mDedupStats));
 	}
 
 	~Impl()
@@ -107,6 +170,8 @@ public:
 		// Tasks may be invoked in this thread context and so they
 		// may try to acquire mMutex. Acquiring the mutex
 		// before calling task pool stop will result a dead lock.
+		// The I/O stage goes first since it feeds the task pool.
+		mIoTaskPool.stop();
 		mTaskPool->stop();
 
 		{	ScopeLock lock(mMutex);
@@ -119,11 +184,220 @@ public:
 			mTaskPool.release();
 	}
 
+	/*!	Returns false if the I/O stage is disabled.
+		Without the I/O threads, the content deduplication still reads the file in a task of the
+		decoding task pool, so it can be hashed off the calling thread.
+	 */
+	bool enqueueIo(IResourceLoader& loader)
+	{
+		MCD_ASSERT(loader.mMutex.isLocked());
+
+		if(loader.mPathKey.getKey().getString().empty())
+			return false;
+
+		TaskPool* taskPool = &mIoTaskPool;
+		if(mIoTaskPool.getThreadCount() == 0) {
+			if(!mContentDedup)
+				return false;
+			taskPool = mTaskPool.get();
+		}
+
+		MCD_VERIFY(taskPool->enqueue(*new IoRequest(loader, *this)));
+		return true;
+	}
+
 	IResourceLoaderPtr findCache(const Path& fileId)
 	{
 		return mResourceMap.find(fileId)->getOuterSafe();
 	}
 
+	//! Find the cache, or the cache of the original path if \em fileId is an alias.
+	IResourceLoaderPtr findCacheOrAlias(const Path& fileId)
+	{
+		MCD_ASSERT(mMutex.isLocked());
+		if(IResourceLoaderPtr cache = findCache(fileId))
+			return cache;
+
+		Aliases::const_iterator i = mAliases.find(fileId);
+		return i == mAliases.end() ? nullptr : findCache(i->second);
+	}
+
+	// For the content addressed deduplication, see setContentDedup()
+	typedef std::pair<uint64_t, uint64_t> ContentId;			//!< Content hash and size
+	typedef std::pair<ContentId, std::string> ContentKey;	//!< Along with the extension and args
+	typedef std::map<ContentKey, Path> ContentOwners;
+	typedef std::map<Path, Path> Aliases;
+	typedef std::pair<Path, Path> VerifiedPair;			//!< A path and its original, whose bytes are compared equal
+	typedef std::set<VerifiedPair> Verified;
+
+	/*!	Returns the path of a resource still alive having the content key, other than \em fileId.
+		If there is none, \em fileId becomes the owner of the content and an empty path is returned.
+	 */
+	Path findOwnerNoLock(const ContentKey& key, const Path& fileId)
+	{
+		MCD_ASSERT(mMutex.isLocked());
+		Path& owner = mContentOwners[key];
+
+		if(!owner.getString().empty() && owner != fileId) {
+			IResourceLoaderPtr cache = findCache(owner);
+			if(cache && cache->resource())
+				return owner;
+		}
+
+		// The first one (or the only one alive) having this content becomes the original
+		owner = fileId;
+		mAliases.erase(fileId);
+		return Path();
+	}
+
+	//! Returns false if \em owner is no longer alive.
+	bool aliasNoLock(const Path& fileId, const Path& owner, uint64_t size)
+	{
+		MCD_ASSERT(mMutex.isLocked());
+		IResourceLoaderPtr cache = findCache(owner);
+		if(!cache || !cache->resource())
+			return false;
+
+		Aliases::iterator i = mAliases.find(fileId);
+		if(i == mAliases.end() || i->second != owner) {
+			mAliases[fileId] = owner;
+			++mDedupStats.aliasCount;
+			mDedupStats.aliasedBytes += size;
+		}
+		return true;
+	}
+
+	void setHashNoLock(const Path& fileId, uint64_t hash, uint64_t size, std::time_t lastWriteTime)
+	{
+		MCD_ASSERT(mMutex.isLocked());
+		mContentHashIndex.set(fileId, hash, size, lastWriteTime);
+		++mDedupStats.hashCount;
+		mDedupStats.hashedBytes += size;
+
+		// The content is new or modified, compare it again
+		for(Verified::iterator i=mVerified.lower_bound(VerifiedPair(fileId, Path())); i!=mVerified.end() && i->first == fileId;)
+			mVerified.erase(i++);
+	}
+
+	/*!	Compare the bytes before making an alias, since the hash and size alone can collide.
+		The file of \em owner is read in the calling thread.
+	 */
+	bool isSameContent(const ReadSpan& span, const Path& owner)
+	{
+		ReadSpanPtr ownerSpan = mFileSystem.openReadSpan(owner);
+
+		{	ScopeLock lock(mMutex);
+			++mDedupStats.compareCount;
+		}
+
+		return ownerSpan && ownerSpan->size() == span.size()
+			&& ::memcmp(ownerSpan->data(), span.data(), span.size()) == 0;
+	}
+
+	/*!	Returns true if the content of \em fileId is identical to a resource that is still
+		alive, whose path is given in \em original.
+
+		For a background load, nothing is read here: only an unchanged file in the index
+		whose content was already compared with the original can become an alias, the
+		hashing and comparison are done by indexContent() in the IoRequest.
+		For a blocking load, the file is going to be read in the calling thread anyway,
+		so it's hashed and compared right here; the bytes read are given in \em span.
+	 */
+	bool findOriginal(const Path& fileId, const char* args, bool blocking, ReadSpanPtr& span, Path& original)
+	{
+		{	ScopeLock lock(mMutex);
+			IResourceLoaderPtr cache = findCache(fileId);
+			if(cache && cache->resource())
+				return false;
+		}
+
+		// Try the index first, the file is read and hashed only if it's new or modified
+		if(!mFileSystem.isExists(fileId))
+			return false;
+		uint64_t size = mFileSystem.getSize(fileId);
+		const std::time_t lastWriteTime = mFileSystem.getLastWriteTime(fileId);
+		uint64_t hash;
+
+		bool indexed;
+		{	ScopeLock lock(mMutex);
+			indexed = mContentHashIndex.find(fileId, size, lastWriteTime, hash);
+		}
+
+		if(!indexed) {
+			if(!blocking)
+				return false;
+			span = mFileSystem.openReadSpan(fileId);
+			if(!span)
+				return false;
+			size = span->size();
+			hash = hashContent64(span->data(), span->size());
+
+			ScopeLock lock(mMutex);
+			setHashNoLock(fileId, hash, size, lastWriteTime);
+		}
+
+		Path owner;
+		{	ScopeLock lock(mMutex);
+			owner = findOwnerNoLock(ContentKey(ContentId(hash, size), fileId.getExtension() + '|' + args), fileId);
+			if(owner.getString().empty())
+				return false;
+
+			if(mVerified.count(VerifiedPair(fileId, owner))) {
+				if(!aliasNoLock(fileId, owner, size))
+					return false;
+				original = owner;
+				return true;
+			}
+		}
+
+		if(!blocking)
+			return false;
+		if(!span && !(span = mFileSystem.openReadSpan(fileId)))
+			return false;
+		if(!isSameContent(*span, owner))
+			return false;
+
+		ScopeLock lock(mMutex);
+		mVerified.insert(VerifiedPair(fileId, owner));
+		if(!aliasNoLock(fileId, owner, span->size()))	// The original may be gone during the comparison
+			return false;
+		original = owner;
+		return true;
+	}
+
+	/*!	Called in the IoRequest of a background load with the bytes it read, to hash the file
+		and compare it with the original having the same hash, so that the next load of
+		\em fileId can be an alias without reading it in the calling thread.
+	 */
+	void indexContent(const Path& fileId, const char* args, const ReadSpan& span)
+	{
+		const uint64_t size = span.size();
+		const std::time_t lastWriteTime = mFileSystem.getLastWriteTime(fileId);
+		uint64_t hash;
+
+		bool indexed;
+		{	ScopeLock lock(mMutex);
+			indexed = mContentHashIndex.find(fileId, size, lastWriteTime, hash);
+		}
+
+		if(!indexed)
+			hash = hashContent64(span.data(), span.size());
+
+		Path owner;
+		{	ScopeLock lock(mMutex);
+			if(!indexed)
+				setHashNoLock(fileId, hash, size, lastWriteTime);
+			owner = findOwnerNoLock(ContentKey(ContentId(hash, size), fileId.getExtension() + '|' + args), fileId);
+			if(owner.getString().empty() || mVerified.count(VerifiedPair(fileId, owner)))
+				return;
+		}
+
+		if(isSameContent(span, owner)) {
+			ScopeLock lock(mMutex);
+			mVerified.insert(VerifiedPair(fileId, owner));
+		}
+	}
+
 	void addCache(const IResourceLoaderPtr& cache)
 	{
 		MCD_VERIFY(mResourceMap.insertUnique(cache->mPathKey));
@@ -253,6 +527,8 @@ public:
 	std::auto_ptr<TaskPool> mTaskPool;
 	bool mIsExternalTaskPool;
 
+	TaskPool mIoTaskPool;	//!< For the I/O stage, see setIoThreadCount()
+
 	Map<IResourceLoader::PathKey> mResourceMap;
 
 	typedef ptr_vector<IFactory> Factories;
@@ -268,6 +544,14 @@ public:
 
 	std::vector<ResourcePtr> mResourceHolder;	/// To prolong the life of a Resource till at least popEvent()
 
+	// For the content addressed deduplication, see setContentDedup()
+	AtomicValue<bool> mContentDedup;
+	ContentHashIndex mContentHashIndex;
+	ContentOwners mContentOwners;
+	Aliases mAliases;
+	Verified mVerified;
+	DedupStats mDedupStats;
+
 	CondVar mMutex;
 };	// Impl
 
@@ -290,6 +574,15 @@ ResourcePtr ResourceManager::load(const Path& fileId, int blockIteration, int pr
 {
 	args = args ? args : "";
 	MCD_ASSUME(mImpl != nullptr);
+
+	// Identical content already loaded under another path
+	ReadSpanPtr span;
+	if(mImpl->mContentDedup) {
+		Path original;
+		if(mImpl->findOriginal(fileId, args, blockIteration > 0, span, original))
+			return load(original, blockIteration, priority, args);
+	}
+
 	ScopeLock lock(mImpl->mMutex);
 
 	// Find for existing resource (Cache hit!)
@@ -337,6 +630,12 @@ ResourcePtr ResourceManager::load(const Path& fileId, int blockIteration, int pr
 	if(!cache)
 		mImpl->addCache(loader);
 
+	// Don't read the file again if it's already read for hashing
+	if(span) {
+		ScopeLock lock2(loader->mMutex);
+		loader->mIStream = createSpanStream(span);
+	}
+
 	// Now we can begin the load operation
 	lock.unlockAndCancel();
 	return mImpl->actualLoad(fileId, *loader, blockIteration, priority, args);
@@ -382,7 +681,7 @@ IResourceLoaderPtr ResourceManager::getLoader(const Path& fileId)
 {
 	MCD_ASSUME(mImpl != nullptr);
 	ScopeLock lock(mImpl->mMutex);
-	return mImpl->findCache(fileId);
+	return mImpl->findCacheOrAlias(fileId);
 }
 
 ResourcePtr ResourceManager::cache(const ResourcePtr& resource)
@@ -423,6 +722,7 @@ ResourcePtr ResourceManager::uncache(const Path& fileId)
 {
 	MCD_ASSUME(mImpl != nullptr);
 	ScopeLock lock(mImpl->mMutex);
+	mImpl->mAliases.erase(fileId);
 
 	// Find and remove the existing resource linkage from the manager
 	IResourceLoaderPtr cache = mImpl->findCache(fileId);
@@ -491,12 +791,61 @@ void ResourceManager::removeAllFactory()
 	mImpl->removeAllFactory();
 }
 
+void ResourceManager::setIoThreadCount(size_t count)
+{
+	MCD_ASSUME(mImpl != nullptr);
+	mImpl->mIoTaskPool.setThreadCount(count);
+}
+
 TaskPool& ResourceManager::taskPool()
 {
 	MCD_ASSUME(mImpl != nullptr);
 	return *mImpl->mTaskPool;
 }
 
+IFileSystem& ResourceManager::fileSystem()
+{
+	MCD_ASSUME(mImpl != nullptr);
+	return mImpl->mFileSystem;
+}
+
+size_t ResourceManager::ioThreadCount() const
+{
+	MCD_ASSUME(mImpl != nullptr);
+	return mImpl->mIoTaskPool.getThreadCount();
+}
+
+void ResourceManager::setContentDedup(bool enable)
+{
+	MCD_ASSUME(mImpl != nullptr);
+	ScopeLock lock(mImpl->mMutex);
+	mImpl->mContentDedup = enable;
+	if(!enable) {
+		mImpl->mContentOwners.clear();
+		mImpl->mAliases.clear();
+		mImpl->mVerified.clear();
+	}
+}
+
+bool ResourceManager::contentDedup() const
+{
+	MCD_ASSUME(mImpl != nullptr);
+	return mImpl->mContentDedup;
+}
+
+ContentHashIndex& ResourceManager::contentHashIndex()
+{
+	MCD_ASSUME(mImpl != nullptr);
+	return mImpl->mContentHashIndex;
+}
+
+ResourceManager::DedupStats ResourceManager::dedupStats() const
+{
+	MCD_ASSUME(mImpl != nullptr);
+	ScopeLock lock(mImpl->mMutex);
+	return mImpl->mDedupStats;
+}
+
 void IResourceLoader::PathKey::destroyThis()
 {
 	IResourceLoader* l = getOuterSafe();
@@ -509,7 +858,7 @@ IResourceLoader::IResourceLoader()
 	: Task(0), mPathKey("")//resource.fileId())
 	, mLoadCount(0), mState(NotLoaded)
 	, mResourceManager(nullptr)
-	, mNeedEnqueu(true), mPendForCommit(false)
+	, mNeedEnqueu(true), mIoPending(false), mIoDone(false), mPendForCommit(false)
 	, mOutstandingContinueCount(0)
 {
 }
@@ -519,7 +868,25 @@ void IResourceLoader::continueLoad()
 	ScopeLock lock(mMutex);
 	IResourceLoaderPtr holdThis(this);
 	++mOutstandingContinueCount;
-	if(mNeedEnqueu && mResourceManager->taskPool().enqueue(*this)) {
+	enqueueNoLock();
+}
+
+void IResourceLoader::enqueueNoLock()
+{
+	MCD_ASSERT(mMutex.isLocked());
+
+	// The loader will be enqueued once the I/O stage finished
+	if(!mNeedEnqueu || mIoPending)
+		return;
+
+	// Read the file in the I/O stage first, so the decoding will not block on the disk.
+	// Without a stream from it, the loader opens the file itself and fails the usual way.
+	if(!mIStream.get() && !mIoDone && !(mState & Stopped) && mResourceManager->mImpl->enqueueIo(*this)) {
+		mIoPending = true;
+		return;
+	}
+
+	if(mResourceManager->taskPool().enqueue(*this)) {
 		mNeedEnqueu = false;
 		// Increment the reference count to indicate the loader is shared by the thread
 		intrusivePtrAddRef(this);
@@ -597,8 +964,21 @@ IResourceLoader::LoadingState IResourceLoader::_load(const Path* fileId, const c
 {
 	MCD_ASSUME(args);
 
-	if(fileId && !mIStream.get() && mResourceManager)
-		mIStream = mResourceManager->mImpl->mFileSystem.openRead(*fileId);
+	if(fileId && !mIStream.get() && mResourceManager) {
+		IFileSystem& fs = mResourceManager->mImpl->mFileSystem;
+		const Path path(*fileId);
+		const bool span = preferReadSpan();
+		std::auto_ptr<std::istream> is;
+
+		// Reading the whole file into a span can be slow, don't block the users of the loader meanwhile
+		{	ScopeUnlock unlock(mMutex);
+			is = span ? createSpanStream(fs.openReadSpan(path)) : fs.openRead(path);
+		}
+
+		// The I/O stage may have given a stream in the mean time
+		if(!mIStream.get())
+			mIStream = is;
+	}
 
 	LoadingState state;
 	{	ScopeUnlock unlock(mMutex);
@@ -8,6 +8,7 @@
 
 namespace MCD {
 
+class ContentHashIndex;
 class IFileSystem;
 class TaskPool;
 class Timer;
@@ -182,10 +183,61 @@ public:
 	 */
 	void removeAllFactory();
 
+	/*!	Set the number of threads dedicated to file reading.
+		When it's non-zero, background loads first read the whole file (see IFileSystem::openReadSpan())
+		in the I/O threads, in the order of the load priority, and only then the loader is put into
+		the task pool for decoding; so the decoding threads never sit idle waiting for the disk.
+		Zero (the default) means the file is read by the loader itself in the task pool.
+		\note Blocking loads always read the file in the calling thread.
+	 */
+	void setIoThreadCount(size_t count);
+
+	/*!	Enable content addressed deduplication.
+		When enabled, loading a path which is not in the cache first gets the hash of
+		the file content, and if a resource of identical content (and the same extension
+		and args) is still alive, that resource is returned instead of decoding the
+		file again; the path becomes an alias of the original one.
+		The hash is taken from contentHashIndex() if the file is unchanged, and the bytes
+		are always compared with the original file before making an alias, since
+		the hash and size alone can collide.
+		A blocking load reads, hashes and compares the file in the calling thread, where
+		the bytes read are passed to the loader so the file is not read twice.
+		A background load never reads the file in the calling thread: the file is hashed
+		and compared in the I/O stage (see setIoThreadCount(), or a task of the task pool
+		if there is no I/O thread), so it's only an alias on the next load.
+		\note The returned resource keeps the fileId of the original path.
+	 */
+	void setContentDedup(bool enable);
+
+	struct DedupStats
+	{
+		size_t hashCount;		//!< Number of files read and hashed because they are not in the index
+		uint64_t hashedBytes;
+		size_t compareCount;	//!< Number of files compared byte by byte with the original of the same hash
+		size_t aliasCount;		//!< Number of paths aliased to an identical resource, ie. the loads saved
+		uint64_t aliasedBytes;	//!< Size of the aliased files, ie. the bytes not decoded again
+	};	// DedupStats
+
 // Attributes
 	//! Get the underlaying TaskPool used by the ResourceManager.
 	TaskPool& taskPool();
 
+	//! Get the file system used by the ResourceManager.
+	IFileSystem& fileSystem();
+
+	size_t ioThreadCount() const;
+
+	bool contentDedup() const;
+
+	/*!	The hash of the file contents used by the deduplication.
+		Save it along with other on-disk cache and load it on the next run,
+		so unchanged files need not be read for hashing.
+		\note Not thread safe, access it while no loading is in progress.
+	 */
+	ContentHashIndex& contentHashIndex();
+
+	DedupStats dedupStats() const;
+
 protected:
 	friend class IResourceLoader;
 	class Impl;
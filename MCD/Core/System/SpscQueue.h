@@ -0,0 +1,106 @@
+#ifndef __MCD_CORE_SYSTEM_SPSCQUEUE__
+#define __MCD_CORE_SYSTEM_SPSCQUEUE__
+
+#include "Atomic.h"
+#include "NonCopyable.h"
+
+namespace MCD {
+
+/*!	A fixed capacity, lock free queue for exactly one producer thread and one consumer thread.
+
+	The elements are copied into a pre-allocated ring buffer, so no heap allocation
+	happens after construction; it is intended for small POD like elements, for
+	instance the commands sent from the main thread to a worker thread.
+
+	Only the producer may call push() and only the consumer may call pop().
+
+	Example:
+	\code
+	SpscQueue<int> queue(1024);
+
+	// Producer thread
+	if(!queue.push(123))
+		;	// The queue is full, try again later
+
+	// Consumer thread
+	int i;
+	while(queue.pop(i))
+		process(i);
+	\endcode
+ */
+template<typename T>
+class SpscQueue : Noncopyable
+{
+public:
+	//!	The capacity is rounded up to the next power of 2.
+	explicit SpscQueue(size_t capacity)
+		: mHead(0), mTail(0)
+	{
+		size_t n = 2;
+		while(n < capacity)
+			n *= 2;
+		mMask = n - 1;
+		mBuffer = new T[n];
+	}
+
+	~SpscQueue() {
+		delete[] mBuffer;
+	}
+
+// Operations
+	//!	Producer only. Returns false if the queue is full.
+	bool push(const T& val)
+	{
+		const size_t tail = mTail;
+		if(tail - mHead > mMask)
+			return false;
+
+		mBuffer[tail & mMask] = val;
+		memoryBarrier();	// The element must be visible before the new tail
+		mTail = tail + 1;
+		return true;
+	}
+
+	//!	Consumer only. Returns false if the queue is empty.
+	bool pop(T& val)
+	{
+		const size_t head = mHead;
+		if(head == mTail)
+			return false;
+
+		memoryBarrier();	// Read the element only after seeing the new tail
+		val = mBuffer[head & mMask];
+		memoryBarrier();	// Finish reading before the producer can overwrite it
+		mHead = head + 1;
+		return true;
+	}
+
+// Attributes
+	//!	Only a snapshot when the other thread is running.
+	size_t size() const {
+		return mTail - mHead;
+	}
+
+	bool isEmpty() const {
+		return mTail == mHead;
+	}
+
+	size_t capacity() const {
+		return mMask + 1;
+	}
+
+protected:
+	T* mBuffer;
+	size_t mMask;
+
+	// Keep the head and tail on different cache lines, since they are written by different threads
+	char mPadding1[64];
+	volatile size_t mHead;	//!< Index of the next pop, written by the consumer only
+	char mPadding2[64];
+	volatile size_t mTail;	//!< Index of the next push, written by the producer only
+	char mPadding3[64];
+};	// SpscQueue
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_SPSCQUEUE__
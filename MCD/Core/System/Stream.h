@@ -22,6 +22,9 @@ public:
 
 	sal_override ~StreamBuf();
 
+	//!	The proxy which this buffer operates on.
+	IStreamProxy* proxy() const { return mProxy; }
+
 protected:
 	sal_override StreamBuf* setbuf(char* buffer, std::streamsize size);
 
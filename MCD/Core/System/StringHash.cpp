@@ -121,9 +121,10 @@ StringHash::StringHash(const wchar_t* buf, size_t len)
 struct FixString::Node
 {
 	uint32_t hashValue;
-	Node* next;
 	AtomicInteger refCount;
+	AtomicInteger immortal;	//!< Non-zero if the node is never freed, no more reference counting is needed
 	size_t size;	//!< Length of the string
+	Node* next;
 	const char* stringValue() const {
 		return reinterpret_cast<const char*>(this + 1);
 	}
@@ -131,118 +132,248 @@ struct FixString::Node
 
 namespace {
 
+/*!	The hash table is split into shards by the hash value, each shard has its own mutex, buckets
+	and node allocator, such that threads working on different strings seldom contend with each other.
+
+	The reference count is atomic, only the first reference (add or find) and the release of the
+	last reference need to lock the shard. Since add() may revive a node whose reference count just
+	dropped to zero, the releasing thread checks again under the lock before freeing it.
+ */
 class FixStringHashTable
 {
 public:
 	typedef FixString::Node Node;
 
-	FixStringHashTable() : mCount(0), mBuckets(1), mNullNode(add(""))
+	static const size_t cShardBits = 5;
+	static const size_t cShardCount = 1 << cShardBits;
+
+	FixStringHashTable() : mNullNode(nullptr)
 	{
-		++mNullNode.refCount;
+		mNullNode = &add("", true);
 	}
 
 	~FixStringHashTable()
 	{
-		remove(mNullNode);
-		MCD_ASSERT(mCount == 0 && "All instance of FixString should be destroyed before FixStringHashTable");
+		for(size_t i=0; i<cShardCount; ++i) {
+			Shard& s = mShards[i];
+			MCD_ASSERT(s.count == s.immortalCount && "All instance of FixString should be destroyed before FixStringHashTable");
+
+			for(size_t j=0; j<s.buckets.size(); ++j) {
+				for(Node* n = s.buckets[j]; n; ) {
+					Node* next = n->next;
+					if(sizeClass(*n) >= cSizeClassCount)
+						free(n);
+					n = next;
+				}
+			}
+			for(size_t j=0; j<s.chunks.size(); ++j)
+				free(s.chunks[j]);
+		}
 	}
 
-	Node& find(uint32_t hashValue) const
+	Node& nullNode() const {
+		return *mNullNode;
+	}
+
+	//!	Returns the node with an added reference, or the null node if not found.
+	Node& find(uint32_t hashValue)
 	{
-		ScopeLock lock(mMutex);
+		Shard& s = shard(hashValue);
+		ScopeLock lock(s.mutex);
 
-		const size_t index = hashValue % mBuckets.size();
-		for(Node* n = mBuckets[index]; n; n = n->next) {
+		for(Node* n = s.buckets[hashValue % s.buckets.size()]; n; n = n->next) {
 			if(n->hashValue != hashValue)
 				continue;
+			addRef(*n);
 			return *n;
 		}
-		return mNullNode;
+		return *mNullNode;
 	}
 
-	Node& add(sal_in_z const char* str)
+	//!	Returns the node with an added reference, the node is marked as immortal if \em immortal is true.
+	Node& add(sal_in_z_opt const char* str, bool immortal)
 	{
-		if(!str)
-			return mNullNode;
+		if(!str || (*str == '\0' && mNullNode))
+			return *mNullNode;
 
 		const uint32_t hashValue = StringHash(str, 0).hash;
-
-		ScopeLock lock(mMutex);
-		const size_t index = hashValue % mBuckets.size();
+		Shard& s = shard(hashValue);
+		ScopeLock lock(s.mutex);
+		const size_t index = hashValue % s.buckets.size();
 
 		// Find any string with the same hash value
-		for(Node* n = mBuckets[index]; n; n = n->next) {
+		for(Node* n = s.buckets[index]; n; n = n->next) {
 			if(n->hashValue == hashValue) {
 				MCD_ASSERT(strcmp(n->stringValue(), str) == 0 && "String hash collision in FixString" );
+				if(immortal && !n->immortal) {
+					// The extra reference is never released, so the threads that see the old flag are still safe
+					++n->refCount;
+					n->immortal = 1;
+					++s.immortalCount;
+				}
+				addRef(*n);
 				return *n;
 			}
 		}
 
 		const size_t length = strlen(str) + 1;
-		if(Node* n = (Node*)malloc(sizeof(Node) + length)) {
+		if(Node* n = s.allocate(sizeof(Node) + length)) {
 			memcpy((void*)n->stringValue(), str, length);
 			n->hashValue = hashValue;
-			n->refCount = 0;
+			n->refCount = 1;
+			n->immortal = immortal ? 1 : 0;
 			n->size = length - 1;
 
-			n->next = mBuckets[index];
-			mBuckets[index] = n;
-			++mCount;
+			n->next = s.buckets[index];
+			s.buckets[index] = n;
+			++s.count;
+			if(immortal)
+				++s.immortalCount;
 
 			// Enlarge the bucket if necessary
-			if(mCount * 2 > mBuckets.size() * 3)
-				resizeBucket(mBuckets.size() * 2);
+			if(s.count * 2 > s.buckets.size() * 3)
+				s.resizeBucket(s.buckets.size() * 2);
 
 			return *n;
 		}
-		return mNullNode;
+		return *mNullNode;
+	}
+
+	static void addRef(Node& node)
+	{
+		if(!node.immortal)
+			++node.refCount;
 	}
 
-	void remove(Node& node)
+	void release(Node& node)
 	{
+		if(node.immortal)
+			return;
+
+		// Once the count reach zero, another thread may free the node at any time
+		const uint32_t hashValue = node.hashValue;
 		if(--node.refCount != 0)
 			return;
 
-		ScopeLock lock(mMutex);
-		const size_t index = node.hashValue % mBuckets.size();
+		Shard& s = shard(hashValue);
+		ScopeLock lock(s.mutex);
+		const size_t index = hashValue % s.buckets.size();
 		Node* last = nullptr;
 
-		for(Node* n = mBuckets[index]; n; last = n, n = n->next) {
-			if(n->hashValue == node.hashValue) {
-				if(last)
-					last->next = n->next;
-				else
-					mBuckets[index] = n->next;
-				free(n);
-				--mCount;
+		for(Node* n = s.buckets[index]; n; last = n, n = n->next) {
+			if(n != &node)
+				continue;
+
+			// Revived by add() or find() before we get the lock
+			if(n->refCount > 0)
 				return;
-			}
+
+			if(last)
+				last->next = n->next;
+			else
+				s.buckets[index] = n->next;
+			--s.count;
+			s.deallocate(n);
+			return;
 		}
-		MCD_ASSERT(false);
+
+		// Already freed by the thread which revived and then released it
 	}
 
-	void resizeBucket(size_t bucketSize)
+protected:
+	static const size_t cGranularity = 16;
+	static const size_t cSizeClassCount = 16;	//!< Nodes up to 256 bytes are allocated from the chunks
+	static const size_t cChunkSize = 16 * 1024;
+
+	static size_t sizeClass(size_t bytes) {
+		return (bytes + cGranularity - 1) / cGranularity - 1;
+	}
+
+	static size_t sizeClass(const Node& node) {
+		return sizeClass(sizeof(Node) + node.size + 1);
+	}
+
+	struct Shard
 	{
-		std::vector<Node*> newBuckets(bucketSize, nullptr);
-
-		MCD_ASSERT(mMutex.isLocked());
-		for(size_t i=0; i<mBuckets.size(); ++i) {
-			for(Node* n = mBuckets[i]; n; ) {
-				Node* next = n->next;
-				const size_t index = n->hashValue % bucketSize;
-				n->next = newBuckets[index];
-				newBuckets[index] = n;
-				n = next;
+		Shard() : count(0), immortalCount(0), buckets(16, nullptr), chunkPos(nullptr), chunkEnd(nullptr)
+		{
+			for(size_t i=0; i<cSizeClassCount; ++i)
+				freeLists[i] = nullptr;
+		}
+
+		//!	Small nodes are carved from chunks and recycled by free lists of the same size class.
+		Node* allocate(size_t bytes)
+		{
+			const size_t c = sizeClass(bytes);
+			if(c >= cSizeClassCount)
+				return (Node*)malloc(bytes);
+
+			if(Node* n = freeLists[c]) {
+				freeLists[c] = n->next;
+				return n;
+			}
+
+			const size_t rounded = (c + 1) * cGranularity;
+			if(chunkPos + rounded > chunkEnd) {
+				char* chunk = (char*)malloc(cChunkSize);
+				if(!chunk)
+					return nullptr;
+				chunks.push_back(chunk);
+				chunkPos = chunk;
+				chunkEnd = chunk + cChunkSize;
 			}
+
+			Node* n = reinterpret_cast<Node*>(chunkPos);
+			chunkPos += rounded;
+			return n;
 		}
 
-		std::swap(newBuckets, mBuckets);
+		void deallocate(Node* n)
+		{
+			const size_t c = sizeClass(*n);
+			if(c >= cSizeClassCount) {
+				free(n);
+				return;
+			}
+			n->next = freeLists[c];
+			freeLists[c] = n;
+		}
+
+		void resizeBucket(size_t bucketSize)
+		{
+			std::vector<Node*> newBuckets(bucketSize, nullptr);
+
+			MCD_ASSERT(mutex.isLocked());
+			for(size_t i=0; i<buckets.size(); ++i) {
+				for(Node* n = buckets[i]; n; ) {
+					Node* next = n->next;
+					const size_t index = n->hashValue % bucketSize;
+					n->next = newBuckets[index];
+					newBuckets[index] = n;
+					n = next;
+				}
+			}
+
+			std::swap(newBuckets, buckets);
+		}
+
+		Mutex mutex;
+		size_t count;	//!< The actuall number of elements in this shard, can be <=> buckets.size()
+		size_t immortalCount;
+		std::vector<Node*> buckets;
+		Node* freeLists[cSizeClassCount];
+		std::vector<char*> chunks;
+		char* chunkPos;
+		char* chunkEnd;
+	};	// Shard
+
+	//!	Fibonacci hashing, such that the shard index don't correlate with the bucket index
+	Shard& shard(uint32_t hashValue) {
+		return mShards[(hashValue * 2654435761u) >> (32 - cShardBits)];
 	}
 
-	mutable Mutex mMutex;
-	size_t mCount;	//!< The actuall number of elements in this table, can be <=> mBuckets.size()
-	std::vector<Node*> mBuckets;
-	Node& mNullNode;
+	Shard mShards[cShardCount];
+	Node* mNullNode;
 };	// FixStringHashTable
 
 static FixStringHashTable& gFixStringHashTable() {
@@ -253,31 +384,35 @@ static FixStringHashTable& gFixStringHashTable() {
 }	// namespace
 
 FixString::FixString()
-	: mNode(&gFixStringHashTable().add(""))
+	: mNode(&gFixStringHashTable().nullNode())
 {
-	++mNode->refCount;
 }
 
 FixString::FixString(const char* str)
-	: mNode(&gFixStringHashTable().add(str))
+	: mNode(&gFixStringHashTable().add(str, false))
 {
-	++mNode->refCount;
 }
 
 FixString::FixString(uint32_t hashValue)
 	: mNode(&gFixStringHashTable().find(hashValue))
 {
-	++mNode->refCount;
 }
 
 FixString::FixString(const FixString& rhs)
 	: mNode(rhs.mNode)
 {
-	++mNode->refCount;
+	FixStringHashTable::addRef(*mNode);
 }
 
 FixString::~FixString() {
-	gFixStringHashTable().remove(*mNode);
+	gFixStringHashTable().release(*mNode);
+}
+
+FixString FixString::immortal(const char* str)
+{
+	FixString ret;
+	ret.mNode = &gFixStringHashTable().add(str, true);
+	return ret;
 }
 
 FixString& FixString::operator=(const char* rhs)
@@ -288,9 +423,10 @@ FixString& FixString::operator=(const char* rhs)
 
 FixString& FixString::operator=(const FixString& rhs)
 {
-	gFixStringHashTable().remove(*mNode);
+	// Add the reference first, in case of self assignment
+	FixStringHashTable::addRef(*rhs.mNode);
+	gFixStringHashTable().release(*mNode);
 	mNode = rhs.mNode;
-	++mNode->refCount;
 	return *this;
 }
 
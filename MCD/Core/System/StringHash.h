@@ -20,9 +20,12 @@ class StringHash;
 
 	Every FixString instances are reference counted by the global hash table, once it's reference
 	count become zero the FixString's corresponding entry in the hash table along with the string
-	data will be deleted.
+	data will be deleted. Strings which live for the whole program, like the names of some well
+	known attributes, can be created by immortal() to skip the reference counting altogether.
 
-	This class is thread safe regarding the read/write to the global hash table.
+	This class is thread safe regarding the read/write to the global hash table. The table is
+	sharded by the hash value, each shard with its own lock and node allocator, while copying and
+	destroying a FixString is only an atomic increment/decrement in most cases.
  */
 class MCD_CORE_API FixString
 {
@@ -43,6 +46,12 @@ public:
 	FixString(const FixString& rhs);
 	~FixString();
 
+	/*!	Create a FixString which is never removed from the global table, all copies of it
+		are free from the atomic reference counting.
+		An existing string in the table will become immortal as well.
+	 */
+	static FixString immortal(sal_in_z_opt const char* str);
+
 	FixString& operator=(const char* rhs);
 	FixString& operator=(const FixString& rhs);
 	FixString& operator=(const StringHash& stringHash);
@@ -1,6 +1,5 @@
 #include "Pch.h"
 #include "TaskPool.h"
-#include "CondVar.h"
 #include "ThreadPool.h"
 #include "Timer.h"
 
@@ -180,4 +179,50 @@ void TaskPool::stop()
 		task->run(dummyThread);
 }
 
+TaskGroup::TaskGroup(size_t count)
+	: mRemaining(count)
+{
+}
+
+void TaskGroup::reset(size_t count)
+{
+	mRemaining = count;
+}
+
+void TaskGroup::done()
+{
+	ScopeLock lock(mCondVar);
+	MCD_ASSERT(mRemaining > 0);
+	if(--mRemaining == 0)
+		mCondVar.broadcastNoLock();
+}
+
+void TaskGroup::wait()
+{
+	ScopeLock lock(mCondVar);
+	while(mRemaining > 0)
+		mCondVar.waitNoLock();
+}
+
+void forkJoin(TaskPool* taskPool, TaskPool::Task* const* tasks, size_t count, TaskGroup& group)
+{
+	Thread dummyThread;
+	dummyThread.setKeepRun(true);
+
+	if(!taskPool || count == 1) {
+		for(size_t i=0; i<count; ++i)
+			tasks[i]->run(dummyThread);
+		return;
+	}
+
+	for(size_t i=0; i<count; ++i) {
+		if(!taskPool->enqueue(*tasks[i]))
+			tasks[i]->run(dummyThread);
+	}
+
+	// Help the pool, then sleep until the tasks taken by the other threads are done
+	taskPool->processTaskInThisThread();
+	group.wait();
+}
+
 }	// namespace MCD
@@ -1,6 +1,7 @@
 #ifndef __MCD_CORE_SYSTEM_TASKPOOL__
 #define __MCD_CORE_SYSTEM_TASKPOOL__
 
+#include "CondVar.h"
 #include "Thread.h"
 #include "Map.h"
 
@@ -121,6 +122,33 @@ protected:
 	ThreadPool* mThreadPool;
 };	// TaskPool
 
+/*!	Counts down the tasks forked by forkJoin(), the forking thread sleeps on it until all are done.
+	Every task calls done() as the last thing it does, after which it should not touch the group.
+ */
+class MCD_CORE_API TaskGroup : Noncopyable
+{
+public:
+	explicit TaskGroup(size_t count=0);
+
+	//! Not thread safe, only call it while no task of the group is running.
+	void reset(size_t count);
+
+	void done();
+
+	//! Block until every task called done().
+	void wait();
+
+protected:
+	CondVar mCondVar;
+	size_t mRemaining;	//!< Protected by mCondVar
+};	// TaskGroup
+
+/*!	Run \em count tasks on the TaskPool together with the calling thread, and return after all are done.
+	\em group must be reset to \em count, and every task calls TaskGroup::done() as the last thing.
+	A task failed to enqueue is run in place; without a TaskPool, all tasks are run in the calling thread.
+ */
+MCD_CORE_API void forkJoin(sal_maybenull TaskPool* taskPool, sal_in_ecount(count) TaskPool::Task* const* tasks, size_t count, TaskGroup& group);
+
 }	// namespace MCD
 
 #endif	// __MCD_CORE_SYSTEM_TASKPOOL__
@@ -7,6 +7,8 @@
 
 #ifdef MCD_APPLE
 #	include <mach/mach_time.h>
+#elif defined(MCD_LINUX)
+#	include <time.h>
 #elif defined(MCD_WIN32)
 #	define USE_RDTSC 1
 #endif
@@ -45,6 +47,11 @@ uint64_t ticksSinceMachineStartup()
 	::QueryPerformanceCounter((LARGE_INTEGER*)(&ret));
 #elif defined(MCD_APPLE)
 	ret = mach_absolute_time();
+#elif defined(MCD_LINUX)
+	// Monotonic, not affected by any change of the system time, in unit of nano second
+	timespec ts;
+	MCD_VERIFY(::clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+	ret = uint64_t(ts.tv_sec) * 1000000000u + uint64_t(ts.tv_nsec);
 #else
 	timeval tv;
 	::gettimeofday(&tv, nullptr);
@@ -116,6 +123,16 @@ double TimeInterval::asSecond() const {
 	return mTicks * cInvTicksPerSecond;
 }
 
+#elif defined(MCD_LINUX)
+
+void TimeInterval::set(double sec) {
+	mTicks = uint64_t(sec * 1e9);
+}
+
+double TimeInterval::asSecond() const {
+	return mTicks * 1e-9;
+}
+
 #else
 
 void TimeInterval::set(double sec) {
@@ -0,0 +1,283 @@
+#include "Pch.h"
+#include "TimingWheel.h"
+#include <math.h>
+
+namespace MCD {
+
+TimingWheel::TimingWheel(float resolution)
+	: mResolution(resolution), mNow(0), mSize(0), mReadyCount(0), mWheelCount(0)
+{
+	MCD_ASSERT(mResolution > 0);
+	for(size_t i=0; i<cListCount; ++i)
+		mLists[i].head = mLists[i].tail = cNull;
+	for(size_t i=0; i<=cLevelCount; ++i)
+		mLevelCounts[i] = 0;
+}
+
+TimingWheel::Handle TimingWheel::schedule(double time, void* object, void* userData, const void* event)
+{
+	MCD_ASSERT(object);
+	MCD_ASSERT("Either a time or an event should be given" && (time >= 0 || event));
+
+	// Reuse a free entry, or grow the pool
+	uint32_t index = mLists[cFreeList].head;
+	if(index != cNull)
+		unlink(index);
+	else {
+		Entry e;
+		e.generation = 1;
+		e.list = cNoList;
+		mEntries.push_back(e);
+		index = uint32_t(mEntries.size() - 1);
+	}
+
+	Entry& e = mEntries[index];
+	e.object = object;
+	e.userData = userData;
+	e.event = event;
+	e.list = cNoList;
+	e.prev = e.next = cNull;
+	e.eventPrev = e.eventNext = cNull;
+	++mSize;
+
+	if(event) {
+		// Insert at the head of the event's list
+		std::pair<Events::iterator, bool> ret = mEvents.insert(std::make_pair(event, index));
+		if(!ret.second) {
+			e.eventNext = ret.first->second;
+			mEntries[e.eventNext].eventPrev = index;
+			ret.first->second = index;
+		}
+	}
+
+	if(time >= 0) {
+		e.tick = uint64_t(ceil(time / mResolution));
+		place(index);
+	}
+
+	return (Handle(e.generation) << 32) | index;
+}
+
+bool TimingWheel::cancel(Handle handle, void** object, void** userData)
+{
+	if(!isValid(handle))
+		return false;
+
+	const uint32_t index = uint32_t(handle);
+	if(object) *object = mEntries[index].object;
+	if(userData) *userData = mEntries[index].userData;
+	release(index);
+
+	return true;
+}
+
+size_t TimingWheel::signal(const void* event)
+{
+	Events::iterator i = mEvents.find(event);
+	if(i == mEvents.end())
+		return 0;
+
+	size_t count = 0;
+	for(uint32_t index = i->second; index != cNull; ++count) {
+		Entry& e = mEntries[index];
+		const uint32_t next = e.eventNext;
+		e.eventPrev = e.eventNext = cNull;
+		e.event = nullptr;
+
+		if(e.list != cReadyList) {
+			unlink(index);
+			pushBack(cReadyList, index);
+		}
+		index = next;
+	}
+
+	mEvents.erase(i);
+	return count;
+}
+
+void TimingWheel::advance(double currentTime)
+{
+	const uint64_t target = currentTime > 0 ? uint64_t(floor(currentTime / mResolution)) : 0;
+
+	while(mNow < target)
+	{
+		// Nothing in the wheel, jump straight to the target
+		if(mWheelCount == 0) {
+			mNow = target;
+			break;
+		}
+
+		// Nothing can happen before the next wrap around of the lowest non-empty level
+		size_t lowest = 0;
+		while(mLevelCounts[lowest] == 0)
+			++lowest;
+		const uint64_t n = lowest == 0 ? mNow + 1 : (mNow | ((uint64_t(1) << (lowest * cLevelBits)) - 1)) + 1;
+		if(n > target) {
+			mNow = target;
+			break;
+		}
+		mNow = n;
+
+		// Cascade the higher levels when the lower ones wrap around, from top to bottom
+		if((n & (cSlotCount - 1)) == 0) {
+			if((n & ((uint64_t(1) << (cLevelCount * cLevelBits)) - 1)) == 0)
+				cascade(cOverflowList);
+			for(size_t level = cLevelCount; level-- > 1;) {
+				if((n & ((uint64_t(1) << (level * cLevelBits)) - 1)) == 0)
+					cascade(uint32_t(level * cSlotCount + ((n >> (level * cLevelBits)) & (cSlotCount - 1))));
+			}
+		}
+
+		cascade(uint32_t(n & (cSlotCount - 1)));
+	}
+}
+
+bool TimingWheel::pop(double currentTime, void*& object, void** userData)
+{
+	advance(currentTime);
+
+	const uint32_t index = mLists[cReadyList].head;
+	if(index == cNull)
+		return false;
+
+	object = mEntries[index].object;
+	if(userData) *userData = mEntries[index].userData;
+	release(index);
+
+	return true;
+}
+
+bool TimingWheel::isValid(Handle handle) const
+{
+	const uint32_t index = uint32_t(handle);
+	if(index >= mEntries.size())
+		return false;
+
+	const Entry& e = mEntries[index];
+	return e.list != cFreeList && e.generation == uint32_t(handle >> 32);
+}
+
+void TimingWheel::place(uint32_t index)
+{
+	Entry& e = mEntries[index];
+	if(e.tick <= mNow) {
+		pushBack(cReadyList, index);
+		return;
+	}
+
+	// The lowest level where the tick and now differ only in the bits of that level
+	for(size_t level=0; level<cLevelCount; ++level) {
+		const size_t shift = (level + 1) * cLevelBits;
+		if((e.tick >> shift) == (mNow >> shift)) {
+			pushBack(uint32_t(level * cSlotCount + ((e.tick >> (level * cLevelBits)) & (cSlotCount - 1))), index);
+			return;
+		}
+	}
+
+	pushBack(cOverflowList, index);
+}
+
+void TimingWheel::pushBack(uint32_t list, uint32_t index)
+{
+	Entry& e = mEntries[index];
+	List& l = mLists[list];
+	e.list = list;
+	e.prev = l.tail;
+	e.next = cNull;
+
+	if(l.tail != cNull)
+		mEntries[l.tail].next = index;
+	else
+		l.head = index;
+	l.tail = index;
+
+	if(list == cReadyList)
+		++mReadyCount;
+	else if(list <= cOverflowList) {
+		++mWheelCount;
+		++mLevelCounts[list / cSlotCount];
+	}
+}
+
+void TimingWheel::unlink(uint32_t index)
+{
+	Entry& e = mEntries[index];
+	if(e.list == cNoList)
+		return;
+
+	List& l = mLists[e.list];
+	if(e.prev != cNull)
+		mEntries[e.prev].next = e.next;
+	else
+		l.head = e.next;
+	if(e.next != cNull)
+		mEntries[e.next].prev = e.prev;
+	else
+		l.tail = e.prev;
+
+	if(e.list == cReadyList)
+		--mReadyCount;
+	else if(e.list <= cOverflowList) {
+		--mWheelCount;
+		--mLevelCounts[e.list / cSlotCount];
+	}
+
+	e.list = cNoList;
+	e.prev = e.next = cNull;
+}
+
+void TimingWheel::unlinkEvent(uint32_t index)
+{
+	Entry& e = mEntries[index];
+	if(!e.event)
+		return;
+
+	if(e.eventPrev != cNull)
+		mEntries[e.eventPrev].eventNext = e.eventNext;
+	else {
+		// It's the head of the event's list
+		Events::iterator i = mEvents.find(e.event);
+		MCD_ASSERT(i != mEvents.end() && i->second == index);
+		if(e.eventNext != cNull)
+			i->second = e.eventNext;
+		else
+			mEvents.erase(i);
+	}
+	if(e.eventNext != cNull)
+		mEntries[e.eventNext].eventPrev = e.eventPrev;
+
+	e.event = nullptr;
+	e.eventPrev = e.eventNext = cNull;
+}
+
+void TimingWheel::release(uint32_t index)
+{
+	unlinkEvent(index);
+	unlink(index);
+
+	Entry& e = mEntries[index];
+	e.object = e.userData = nullptr;
+	if(++e.generation == 0)	// Zero is reserved for the invalid handle
+		e.generation = 1;
+	pushBack(cFreeList, index);
+	--mSize;
+}
+
+void TimingWheel::cascade(uint32_t list)
+{
+	// Detach the whole list first, since place() may append to the same overflow list
+	uint32_t index = mLists[list].head;
+	mLists[list].head = mLists[list].tail = cNull;
+
+	while(index != cNull) {
+		Entry& e = mEntries[index];
+		const uint32_t next = e.next;
+		e.list = cNoList;
+		--mWheelCount;
+		--mLevelCounts[list / cSlotCount];
+		place(index);
+		index = next;
+	}
+}
+
+}	// namespace MCD
@@ -0,0 +1,143 @@
+#ifndef __MCD_CORE_SYSTEM_TIMINGWHEEL__
+#define __MCD_CORE_SYSTEM_TIMINGWHEEL__
+
+#include "../ShareLib.h"
+#include "NonCopyable.h"
+#include "Platform.h"
+#include <map>
+#include <vector>
+
+namespace MCD {
+
+/*!	A hierarchical timing wheel, for waking up a large number of sleeping objects (eg. script coroutines).
+
+	Time is quantized into ticks of a fixed resolution. The wheel has 4 levels of 256 slots, level 0
+	covering the next 256 ticks, and each higher level covering 256 times the range of the one below.
+	An entry is put into the slot of the lowest level that can hold its wake time, and is moved down
+	(cascaded) as the time approaches; entries further than 2^32 ticks away wait in an overflow list.
+
+	 -	schedule() and cancel() are O(1), no tree rebalancing involved.
+	 -	Entries are pooled in a single array, with the slots being linked lists of indices into it;
+		so no memory allocation after the pool has grown to the peak size.
+	 -	An entry can also wait for an event, with or without a timeout. signal() wakes up all the
+		entries waiting for that event, no matter what the wake time is.
+
+	Expired and signaled entries are moved into a ready list, in the order of their wake time,
+	where they are popped one by one with pop(); so the user can limit the number of wakeups per frame.
+
+	Example:
+	\code
+	TimingWheel wheel;
+	TimingWheel::Handle h = wheel.schedule(currentTime + 2, thread);
+	wheel.schedule(-1, anotherThread, nullptr, "doorOpened");	// No timeout, only wakeup by the event
+
+	// Each frame
+	wheel.signal("doorOpened");
+	void* object;
+	while(wheel.pop(currentTime, object))
+		wakeup(object);
+	\endcode
+
+	\note The time is supplied by the user, in second.
+	\note This class is not thread safe.
+ */
+class MCD_CORE_API TimingWheel : Noncopyable
+{
+public:
+	//! Identifies a scheduled entry, zero is never a valid handle.
+	typedef uint64_t Handle;
+
+	//!	\param resolution Duration of a tick in second, an entry may wake up later than its time by less than that.
+	explicit TimingWheel(float resolution=0.001f);
+
+// Operations
+	/*!	Schedule an object to wake up at the given time.
+		\param time Negative for no timeout, in such case an event should be given.
+		\param event Any unique pointer (eg. an interned string) for the entry to be waken up by signal().
+	 */
+	Handle schedule(double time, sal_notnull void* object, sal_maybenull void* userData=nullptr, sal_maybenull const void* event=nullptr);
+
+	//!	Remove a scheduled entry before it's popped, returns false if the handle is no longer valid.
+	bool cancel(Handle handle, sal_maybenull void** object=nullptr, sal_maybenull void** userData=nullptr);
+
+	//!	Make all entries waiting for the event ready, returns the number of entries affected.
+	size_t signal(sal_notnull const void* event);
+
+	//!	Move the entries due at currentTime to the ready list.
+	void advance(double currentTime);
+
+	/*!	Advance to currentTime, and pop one ready entry.
+		\return False if there is no entry ready.
+	 */
+	bool pop(double currentTime, void*& object, sal_maybenull void** userData=nullptr);
+
+// Attributes
+	//!	Whether the entry of the handle is still waiting or ready, but not yet popped.
+	bool isValid(Handle handle) const;
+
+	//!	Number of entries waiting or ready.
+	size_t size() const { return mSize; }
+
+	//!	Number of entries ready to be popped, as of the last advance().
+	size_t readyCount() const { return mReadyCount; }
+
+	float resolution() const { return mResolution; }
+
+protected:
+	enum {
+		cLevelBits = 8,
+		cSlotCount = 1 << cLevelBits,
+		cLevelCount = 4,
+		cOverflowList = cLevelCount * cSlotCount,
+		cReadyList,
+		cNoList,	//!< Waiting for an event only
+		cFreeList,
+		cListCount = cFreeList + 1
+	};
+
+	static const uint32_t cNull = uint32_t(-1);
+
+	struct Entry
+	{
+		uint64_t tick;
+		void* object;
+		void* userData;
+		const void* event;
+		uint32_t generation;
+		uint32_t list;
+		uint32_t prev, next;			//!< Links in the slot, ready or free list
+		uint32_t eventPrev, eventNext;	//!< Links in the list of the same event
+	};	// Entry
+
+	struct List { uint32_t head, tail; };
+
+	//!	Put the entry into the slot, the overflow or the ready list, according to its tick.
+	void place(uint32_t index);
+
+	void pushBack(uint32_t list, uint32_t index);
+
+	void unlink(uint32_t index);
+
+	void unlinkEvent(uint32_t index);
+
+	void release(uint32_t index);
+
+	//!	Move the entries of a slot to lower levels, or the ready list if it's level 0.
+	void cascade(uint32_t list);
+
+	float mResolution;
+	uint64_t mNow;	//!< Current tick
+	size_t mSize;
+	size_t mReadyCount;
+	size_t mWheelCount;	//!< Number of entries in the slots and the overflow list
+	size_t mLevelCounts[cLevelCount + 1];	//!< Number of entries in each level, the last one is the overflow list
+	std::vector<Entry> mEntries;
+	List mLists[cListCount];
+
+	typedef std::map<const void*, uint32_t> Events;
+	Events mEvents;	//!< Head of the list of entries waiting for each event
+};	// TimingWheel
+
+}	// namespace MCD
+
+#endif	// __MCD_CORE_SYSTEM_TIMINGWHEEL__
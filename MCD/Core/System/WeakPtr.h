@@ -286,6 +286,11 @@ public:
 
 	virtual ~IntrusiveSharedWeakPtrTarget() {}
 
+	//!	Number of IntrusivePtr currently pointing to this object.
+	size_t referenceCount() const {
+		return size_t(mRefCount);
+	}
+
 	friend void intrusivePtrAddRef(IntrusiveSharedWeakPtrTarget* p) {
 		++(p->mRefCount);
 	}
@@ -1,9 +1,20 @@
 #include "Pch.h"
 #include "XmlParser.h"
 #include "StrUtility.h"
+#include "StringHash.h"
 #include <vector>
 #include <memory.h>	// For memcpy
 
+#if !defined(MCD_GCC) || defined(__SSE2__)
+#	define MCD_XML_SSE2 1
+#	include <emmintrin.h>
+#	ifdef MCD_VC
+#		include <intrin.h>
+#	endif
+#else
+#	define MCD_XML_SSE2 0
+#endif
+
 namespace MCD {
 
 // Adopted from Irrlicht engine's xml parser
@@ -15,6 +26,88 @@ static inline bool isWhiteSpace(char c)
 	return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
 }
 
+namespace {
+
+/*!	Search for the first character which is '\0' or within a small set of characters.
+	With SSE2 it compares 16 characters at a time, otherwise a look up table is used.
+ */
+class CharScanner
+{
+public:
+	explicit CharScanner(sal_in_z const char* chars)
+	{
+		::memset(mTable, 0, sizeof(mTable));
+		mTable[0] = true;
+		mCount = 0;
+		for(; *chars && mCount < cMaxChars; ++chars, ++mCount) {
+			mTable[(unsigned char)*chars] = true;
+#if MCD_XML_SSE2
+			mChars[mCount] = _mm_set1_epi8(*chars);
+#endif
+		}
+	}
+
+	char* find(char* p) const
+	{
+#if MCD_XML_SSE2
+		// An aligned load never cross a page boundary, so reading before p or beyond the '\0' is safe
+		const size_t offset = size_t(p) & 15;
+		const __m128i* a = reinterpret_cast<const __m128i*>(p - offset);
+		unsigned mask = match(_mm_load_si128(a)) >> offset;
+		if(mask)
+			return p + firstBit(mask);
+
+		for(;;) {
+			++a;
+			if((mask = match(_mm_load_si128(a))) != 0)
+				return (char*)a + firstBit(mask);
+		}
+#else
+		while(!mTable[(unsigned char)*p])
+			++p;
+		return p;
+#endif
+	}
+
+protected:
+#if MCD_XML_SSE2
+	unsigned match(__m128i v) const
+	{
+		__m128i m = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+		for(size_t i=0; i<mCount; ++i)
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(v, mChars[i]));
+		return unsigned(_mm_movemask_epi8(m));
+	}
+
+	static size_t firstBit(unsigned mask)
+	{
+#ifdef MCD_VC
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	__m128i mChars[6];
+#endif
+	static const size_t cMaxChars = 6;
+	size_t mCount;
+	bool mTable[256];
+};	// CharScanner
+
+static const CharScanner cOpenTag("<");
+static const CharScanner cCloseTag(">");
+static const CharScanner cTagOrCloseTag("<>");
+static const CharScanner cNameEnd("> \t\n\r");
+static const CharScanner cAttributeNameEnd("= \t\n\r");
+static const CharScanner cQuote("\"'");
+static const CharScanner cDoubleQuote("\"");
+static const CharScanner cSingleQuote("'");
+
+}	// namespace
+
 static const char* createString(const char* begin, char* end)
 {
 	*end = '\0';
@@ -39,30 +132,33 @@ static const char* escapeString(char* begin, char* end)
 	static const char* cEscapeString[5] = {"&amp;", "&lt;", "&gt;", "&apos;", "&quot;"};
 	static const size_t cEscapeStringLen[5] = {5, 4, 4, 6, 6};
 
-	char* str = begin;
+	// Scan for '&' character, most string has none
+	char* str = (char*)::memchr(begin, '&', end - begin);
+	if(!str) {
+		*end = '\0';
+		return begin;
+	}
 
-	// Scan for '&' character
-	for(; str != end; ++str) {
-		if(*str != '&')
-			continue;
+	// Compact the string in a single pass, the writing position never pass the reading one
+	char* dest = str;
+	while(str != end) {
+		if(*str == '&') {
+			size_t i = 0;
+			for(; i<5; ++i) {
+				if(MyStrCmpLhsFixed(cEscapeString[i], str))
+					break;
+			}
 
-		// Loop for all escape string
-		for(size_t i = 0; i<5; ++i) {
-			if(!MyStrCmpLhsFixed(cEscapeString[i], str))
+			if(i < 5) {
+				*(dest++) = cEscapeChar[i];
+				str += cEscapeStringLen[i];
 				continue;
-
-			// Replace with cEscapeChar
-			*str = cEscapeChar[i];
-			// Move the chars to the front
-			const char* trailPos = str + cEscapeStringLen[i];
-			::memcpy(str+1, trailPos, end - trailPos);
-			// Adjust the new end
-			end -= (cEscapeStringLen[i] - 1);
-			break;
+			}
 		}
+		*(dest++) = *(str++);
 	}
 
-	*end = '\0';
+	*dest = '\0';
 
 	return begin;
 }
@@ -71,15 +167,11 @@ class XmlParser::Impl
 {
 	typedef XmlParser::Event Event;
 
-	struct Attribute {
-		const char* name;
-		const char* value;
-	};	// Attribute
-
+	typedef XmlParser::Attribute Attribute;
 	typedef std::vector<Attribute> Attrubutes;
 
 public:
-	Impl() : mIsEmptyElement(false)
+	Impl() : mIsEmptyElement(false), mAttributeHashed(false)
 	{
 		parse(nullptr);
 	}
@@ -92,6 +184,7 @@ public:
 		mHasBackupOpenTag = false;
 		mCurrentNodeType = Event::Error;
 		mAttrubutes.clear();
+		mAttributeHashed = false;
 	}
 
 	Event::Enum nextEvent()
@@ -128,8 +221,8 @@ public:
 			;
 		}
 		// Move forward until '<' found
-		else if(!mHasBackupOpenTag) while(*p != '<' && *p)
-			++p;
+		else if(!mHasBackupOpenTag)
+			p = cOpenTag.find(p);
 		else
 			*p = '<';
 
@@ -201,8 +294,7 @@ public:
 		mCurrentNodeType = Event::Unknown;
 
 		// Move until end marked with '>' reached
-		while(*p && *p != '>')
-			++p;
+		p = cCloseTag.find(p);
 		++p;
 	}
 
@@ -217,10 +309,10 @@ public:
 		int count = 1;
 
 		// Move until end of comment reached
-		while(*p && count) {
+		while(count && *(p = cTagOrCloseTag.find(p))) {
 			if(*p == '>')
 				--count;
-			else if(*p == '<')
+			else
 				++count;
 			++p;
 		}
@@ -234,13 +326,13 @@ public:
 		mCurrentNodeType = Event::BeginElement;
 		mIsEmptyElement = false;
 		mAttrubutes.clear();
+		mAttributeHashed = false;
 
 		// Find name
 		const char* startName = p;
 
 		// find end of element
-		while(*p != '>' && !isWhiteSpace(*p))
-			++p;
+		p = cNameEnd.find(p);
 
 		char* endName = p;
 
@@ -258,15 +350,13 @@ public:
 					// Read the attribute names
 					const char* attributeNameBegin = p;
 
-					while(!isWhiteSpace(*p) && *p != '=')
-						++p;
+					p = cAttributeNameEnd.find(p);
 
 					char* attributeNameEnd = p;
 					++p;
 
 					// Read the attribute value, check for quotes and single quotes
-					while((*p != '\"') && (*p != '\'') && *p)
-						++p;
+					p = cQuote.find(p);
 
 					if(!*p) // Malformatted xml file
 						return;
@@ -276,8 +366,7 @@ public:
 					++p;
 					char* attributeValueBegin = p;
 
-					while(*p != attributeQuoteChar && *p)
-						++p;
+					p = (attributeQuoteChar == '\"' ? cDoubleQuote : cSingleQuote).find(p);
 
 					if(!*p) // Malformatted xml file
 						return;
@@ -319,12 +408,12 @@ public:
 		mCurrentNodeType = Event::EndElement;
 		mIsEmptyElement = false;
 		mAttrubutes.clear();
+		mAttributeHashed = false;
 
 		++p;
 		char* pBeginClose = p;
 
-		while(*p && *p != '>')
-			++p;
+		p = cCloseTag.find(p);
 
 		if(!*p) {
 			mCurrentNodeType = Event::Error;
@@ -393,6 +482,53 @@ public:
 		return nullptr;
 	}
 
+	const char* attributeValue(const FixString& name) const
+	{
+		// Hash the names only when they are needed, once for each element
+		if(!mAttributeHashed) {
+			mAttributeHashes.resize(mAttrubutes.size());
+			for(size_t i=0; i<mAttrubutes.size(); ++i)
+				mAttributeHashes[i] = StringHash(mAttrubutes[i].name, 0).hash;
+			mAttributeHashed = true;
+		}
+
+		const uint32_t hash = name.hashValue();
+		for(size_t i=0; i<mAttributeHashes.size(); ++i)
+			if(mAttributeHashes[i] == hash)
+				return mAttrubutes[i].value;
+		return nullptr;
+	}
+
+	size_t nextEvents(EventInfo* events, size_t maxCount)
+	{
+		// Attributes of all the events in this batch
+		mBatchAttributes.clear();
+
+		size_t count = 0;
+		while(count < maxCount) {
+			EventInfo& info = events[count++];
+			info.type = nextEvent();
+			info.elementName = mElementName;
+			info.textData = mText;
+			info.isEmptyElement = mIsEmptyElement;
+			info.attributeCount = info.type == Event::BeginElement ? mAttrubutes.size() : 0;
+			mBatchAttributes.insert(mBatchAttributes.end(), mAttrubutes.begin(), mAttrubutes.begin() + info.attributeCount);
+
+			if(info.type == Event::EndDocument || info.type == Event::Error)
+				break;
+		}
+
+		// Assign the pointers at last, since mBatchAttributes may be re-allocated during the batch
+		size_t offset = 0;
+		for(size_t i=0; i<count; ++i) {
+			EventInfo& info = events[i];
+			info.attributes = info.attributeCount ? &mBatchAttributes[offset] : nullptr;
+			offset += info.attributeCount;
+		}
+
+		return count;
+	}
+
 	char* p;	//!< The current pointer
 	const char* mText;
 	const char* mElementName;
@@ -401,6 +537,9 @@ public:
 	Event::Enum mCurrentNodeType;
 
 	Attrubutes mAttrubutes;
+	mutable bool mAttributeHashed;	//!< mAttributeHashes is up to date with mAttrubutes
+	mutable std::vector<uint32_t> mAttributeHashes;
+	Attrubutes mBatchAttributes;
 };	// Impl
 
 XmlParser::XmlParser()
@@ -423,6 +562,11 @@ XmlParser::Event::Enum XmlParser::nextEvent()
 	return mImpl.nextEvent();
 }
 
+size_t XmlParser::nextEvents(EventInfo* events, size_t maxCount)
+{
+	return mImpl.nextEvents(events, maxCount);
+}
+
 const char* XmlParser::elementName() const
 {
 	return mImpl.mElementName;
@@ -463,6 +607,11 @@ const char* XmlParser::attributeValueIgnoreCase(const char* name) const
 	return mImpl.attributeValueIgnoreCase(name);
 }
 
+const char* XmlParser::attributeValue(const FixString& name) const
+{
+	return mImpl.attributeValue(name);
+}
+
 float XmlParser::attributeValueAsFloat(size_t idx, float defaultValue) const
 {
 	return stringToFloat(attributeValue(idx), defaultValue);
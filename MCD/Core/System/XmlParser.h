@@ -6,6 +6,8 @@
 
 namespace MCD {
 
+class FixString;
+
 /*!	XmlParser is intended to be a high speed and easy-to-use XML Parser specialized for
 	game development.
 
@@ -79,6 +81,10 @@ namespace MCD {
 		}
 	}
 	\endcode
+
+	The structural characters ('<', '>', quotes and white spaces) are searched 16 bytes at a time
+	with SSE2 where available. When the document is large, nextEvents() can fill an array of
+	EventInfo in one call, instead of calling nextEvent() and the accessors for each event.
  */
 class MCD_CORE_API XmlParser : Noncopyable
 {
@@ -94,6 +100,23 @@ public:
 		Error			//!< Error occurred during parsing.
 	}; };	// Event
 
+	struct Attribute
+	{
+		const char* name;
+		const char* value;
+	};	// Attribute
+
+	//! A snapshot of the accessors of XmlParser after nextEvent().
+	struct EventInfo
+	{
+		Event::Enum type;
+		const char* elementName;	//!< Same as XmlParser::elementName()
+		const char* textData;		//!< Same as XmlParser::textData()
+		bool isEmptyElement;
+		const Attribute* attributes;	//!< Null if attributeCount is zero
+		size_t attributeCount;
+	};	// EventInfo
+
 	XmlParser();
 
 	~XmlParser();
@@ -114,6 +137,13 @@ public:
 	 */
 	Event::Enum nextEvent();
 
+	/*!	Parse up to \em maxCount events in one call, giving the same events as calling nextEvent() repeatedly.
+		The batch stops after an \em EndDocument or \em Error event.
+		The attributes pointed by the EventInfo are valid until the next call to nextEvents() or nextEvent().
+		\return The number of events written to \em events.
+	 */
+	size_t nextEvents(sal_out_ecount(maxCount) EventInfo* events, size_t maxCount);
+
 	/*!	Get the name of the element.
 		Valid when the current event is BeginElement or EndElement.
 		\return "" if there is error.
@@ -149,6 +179,16 @@ public:
 
 	const char* attributeValueIgnoreCase(sal_in_z const char* name) const;
 
+	/*!	Get the value of attrubute with an interned \em name, the names are compared by their hash values.
+		Useful when an element is queried for many attributes, for example:
+		\code
+		static const FixString cFile = FixString::immortal("file");
+		parser.attributeValue(cFile);
+		\endcode
+		\return null if there is error.
+	 */
+	const char* attributeValue(const FixString& name) const;
+
 	float attributeValueAsFloat(size_t idx, float defaultValue = 0.0f) const;
 
 	float attributeValueAsFloat(sal_in_z const char* name, float defaultValue = 0.0f) const;
@@ -78,7 +78,7 @@ FFLAGS=
 ASFLAGS=
 
 # Link Libraries and Options
-LDLIBSOPTIONS=-Wl,-rpath ../../3Party/squirrel/dist/Release/GNU-Linux-x86 -L../../3Party/squirrel/dist/Release/GNU-Linux-x86 -lsquirrel -lpthread -lz -lX11
+LDLIBSOPTIONS=-Wl,-rpath ../../3Party/squirrel/dist/Release/GNU-Linux-x86 -L../../3Party/squirrel/dist/Release/GNU-Linux-x86 -lsquirrel -lpthread -lrt -lz -lX11
 
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
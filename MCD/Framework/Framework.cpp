@@ -12,6 +12,7 @@
 #include "../Core/Entity/PrefabLoaderComponent.h"
 #include "../Core/Entity/SystemComponent.h"
 #include "../Core/System/FileSystemCollection.h"
+#include "../Core/System/FrameScheduler.h"
 #include "../Core/System/Log.h"
 #include "../Core/System/MemoryFileSystem.h"
 #include "../Core/System/PtrVector.h"
@@ -38,6 +39,7 @@
 #include "../Render/Material.h"
 #include "../Render/RenderBindings.h"
 #include "../Render/Renderer.h"
+#include "../Render/RenderSnapshot.h"
 #include "../Render/RenderTarget.h"
 #include "../Render/RenderWindow.h"
 #include "../Render/Skeleton.h"
@@ -62,6 +64,84 @@ extern void registerFrameworkBinding(VMCore& vm, Framework& framework);
 
 }	// namespace Binding
 
+namespace {
+
+//! Lets the FrameScheduler use the time of a Timer, so its deadlines can be passed to the functions taking a Timer.
+class TimerClock : public FrameScheduler::IClock
+{
+public:
+	explicit TimerClock(const Timer& timer) : mTimer(timer) {}
+
+	sal_override double now() const {
+		return mTimer.get().asSecond();
+	}
+
+	const Timer& mTimer;
+};	// TimerClock
+
+//! Commits the loaded resources, and invokes the resource callbacks.
+class ResourceCommitTask : public FrameScheduler::ITask
+{
+public:
+	explicit ResourceCommitTask(Timer& timer) : mTimer(timer) {}
+
+	sal_override bool run(double deadline)
+	{
+		if(!component)
+			return false;
+
+		// The update stops when either the event queue is empty or the time is up
+		component->update(&mTimer, float(deadline));
+		return mTimer.get().asSecond() >= deadline;
+	}
+
+	Timer& mTimer;
+	ResourceManagerComponentPtr component;
+};	// ResourceCommitTask
+
+//! Wakes up the sleeping scripts which are due.
+class ScriptWakeupTask : public FrameScheduler::ITask
+{
+public:
+	explicit ScriptWakeupTask(Timer& timer) : mTimer(timer) {}
+
+	sal_override bool run(double deadline) {
+		return component ? component->wakeup(&mTimer, float(deadline)) : false;
+	}
+
+	Timer& mTimer;
+	IntrusiveWeakPtr<Binding::ScriptManagerComponent> component;
+};	// ScriptWakeupTask
+
+//! Collects the reference cycles in the script VM, at most once every interval.
+class GarbageCollectTask : public FrameScheduler::ITask
+{
+public:
+	explicit GarbageCollectTask(Timer& timer)
+		: interval(1), vm(nullptr), mTimer(timer), mLastTime(0)
+	{}
+
+	sal_override bool run(double deadline)
+	{
+		const double time = mTimer.get().asSecond();
+		if(!vm || time - mLastTime < interval)
+			return false;
+
+		vm->collectGarbage();
+		mLastTime = time;
+		return false;
+	}
+
+	float interval;	//!< In second
+	Binding::VMCore* vm;
+
+protected:
+	Timer& mTimer;
+	double mLastTime;
+};	// GarbageCollectTask
+
+}	// namespace
+
 class Framework::Impl
 {
 public:
@@ -76,6 +156,7 @@ public:
 	void enableDebuggerOnPort(uint16_t tcpPort);
 	PrefabLoaderComponent* loadPrefabTo(const char* resourcePath, Entity& location, bool blockingLoad);
 	void registerResourceCallback(const char* path, BehaviourComponent& behaviour, bool isRecursive, int minLoadIteration);
+	bool setPipelined(bool pipelined);
 	bool update(Event& e);
 
 	EntityPtr mRootEntity, mSystemEntity, mSceneLayer, mGuiLayer;
@@ -87,6 +168,13 @@ public:
 	bool mTakeWindowOwership;
 
 	Timer mTimer;
+	TimerClock mClock;
+	FrameScheduler mScheduler;
+	size_t mEventPhase, mUpdatePhase, mRenderPhase;
+	ResourceCommitTask mResourceCommitTask;
+	ScriptWakeupTask mScriptWakeupTask;
+	GarbageCollectTask mGarbageCollectTask;
+
 	float mDeltaTime, mCurrentTime;
 	size_t mFrameCounter;	//! For calculating fps, reset every one second.
 	float mOneSecondCountDown;
@@ -97,13 +185,16 @@ public:
 	ResourceManagerComponentPtr mResourceManagerComponent;
 	std::auto_ptr<RenderWindow> mWindow;
 	std::auto_ptr<TaskPool> mTaskPool;
+	std::auto_ptr<RenderPipeline> mRenderPipeline;	//!< Null if not pipelined
 	TextLabelComponentPtr mFpsLabel;
 
 	sal_notnull Binding::VMCore* vm;
 };	// Impl
 
 Framework::Impl::Impl()
-	: mFrameCounter(0), mOneSecondCountDown(0), mFramePerSecond(0)
+	: mClock(mTimer), mScheduler(1.0f / 30, &mClock)
+	, mResourceCommitTask(mTimer), mScriptWakeupTask(mTimer), mGarbageCollectTask(mTimer)
+	, mFrameCounter(0), mOneSecondCountDown(0), mFramePerSecond(0)
 {
 	vm = new Binding::VMCore;
 
@@ -153,6 +244,7 @@ Framework::Impl::Impl()
 		mResourceManagerComponent = new ResourceManagerComponent(*mResourceManager);
 		Entity* e = mSystemEntity->addFirstChild("Resource manager");
 		e->addComponent(mResourceManagerComponent.get());
+		mResourceCommitTask.component = mResourceManagerComponent;
 	}
 
 	{	// Register default resource loaders
@@ -200,7 +292,10 @@ Framework::Impl::Impl()
 		using namespace Binding;
 		Entity* e = mSystemEntity->addFirstChild("Script manager");
 		ScriptManagerComponent* c = new ScriptManagerComponent(vm);
+		c->manualWakeup = true;
 		e->addComponent(c);
+		mScriptWakeupTask.component = c;
+		mGarbageCollectTask.vm = vm;
 	}
 
 	{	// Animation updater
@@ -215,6 +310,16 @@ Framework::Impl::Impl()
 		e->addComponent(c);
 	}
 
+	{	// Frame scheduler, the deferred work is done in the order of resource commits,
+		// script wakeups, and garbage collection only with spare time
+		mEventPhase = mScheduler.addPhase("Events");
+		mUpdatePhase = mScheduler.addPhase("Update");
+		mRenderPhase = mScheduler.addPhase("Render");
+		mScheduler.addTask(mResourceCommitTask, "Resource commit", 2, 0.002f);
+		mScheduler.addTask(mScriptWakeupTask, "Script wakeup", 1, 0.001f);
+		mScheduler.addTask(mGarbageCollectTask, "Garbage collection", 0, 0);
+	}
+
 	// Audio
 	MCD_VERIFY(initAudioDevice());
 
@@ -227,6 +332,9 @@ Framework::Impl::Impl()
 
 Framework::Impl::~Impl()
 {
+	// Finish the frame being rendered, and release its snapshot before anything is destroyed
+	mRenderPipeline.reset();
+
 	mTaskPool->stop();
 
 	if(mWindow.get())
@@ -463,16 +571,13 @@ bool Framework::Impl::update(Event& e)
 {
 	Entity::setCurrentRoot(mRootEntity.getNotNull());
 
-	const float frameTime = 1.0f / 30;
+	mScheduler.beginFrame();
 	float newTime = float(mTimer.get().asSecond());
 	mDeltaTime = newTime - mCurrentTime;
-
-	const float overBuget = newTime - mCurrentTime - frameTime;
-	float buget = frameTime - overBuget;
-	buget = buget < frameTime/3 ? frameTime/3 : buget;
-	const float timeOut = newTime + buget;
 	mCurrentTime = newTime;
 
+	mScheduler.beginPhase(mEventPhase);
+
 	// Check for window events
 	bool hasWindowEvent = false;
 	if(mWindow.get())
@@ -486,8 +591,16 @@ bool Framework::Impl::update(Event& e)
 		}
 	}
 
-	if(mResourceManagerComponent)
-		mResourceManagerComponent->update(&mTimer, timeOut);
+	mScheduler.endPhase(mEventPhase);
+
+	// The pipeline renders with the RendererComponent, which may have been destroyed
+	if(!mRenderer)
+		mRenderPipeline.reset();
+
+	// Deferred work like resource commits, with the time left after the estimated update and render.
+	// NOTE: When pipelined, they run at the sync point below, while nothing is being rendered.
+	if(!mRenderPipeline.get())
+		mScheduler.runTasks();
 
 	{	// Frame rate calculation
 		mOneSecondCountDown -= mDeltaTime;
@@ -502,33 +615,53 @@ bool Framework::Impl::update(Event& e)
 		mFpsLabel->text = FixString(float2Str(mFramePerSecond).c_str());
 	}
 
-	{	// Entity and Component traversal
-		ComponentUpdater::traverseBegin(*mSystemEntity);
+	{	// Component update
+		mScheduler.beginPhase(mUpdatePhase);
 
-		// Gather components into the corresponding updater
-		for(EntityPreorderIterator i(mRootEntity.get()); !i.ended(); )
-		{
-			if(!i->enabled) {
-				i.skipChildren();
-				continue;
-			}
-
-			for(Component* c = i->components.begin(); c != i->components.end(); c = c->next())
-				c->gather();
-
-			i.next();
-		}
+		// NOTE: The updaters find their Components in the ComponentRegistry,
+		// without traversing the whole Entity tree.
+		ComponentUpdater::traverseBegin(*mSystemEntity);
 
 		// Preform the updater's update(dt) function
 		ComponentUpdater::traverseEnd(*mSystemEntity, mDeltaTime);
 
-		// Perform rendering
-		if(mRenderer) mRenderer->render(*mRootEntity);
+		mScheduler.endPhase(mUpdatePhase);
 	}
 
+	// Perform rendering
+	if(mRenderPipeline.get()) {
+		// Wait for the last frame, the resources it draws can then be modified
+		mRenderPipeline->sync();
+		mScheduler.runTasks();
+
+		mScheduler.beginPhase(mRenderPhase);
+		mRenderPipeline->submit(*mRootEntity);
+		mScheduler.endPhase(mRenderPhase);
+	}
+	else if(mRenderer) {
+		mScheduler.beginPhase(mRenderPhase);
+		mRenderer->render(*mRootEntity);
+		mScheduler.endPhase(mRenderPhase);
+	}
+
+	mScheduler.endFrame();
+
 	return hasWindowEvent;
 }
 
+bool Framework::Impl::setPipelined(bool pipelined)
+{
+	mRenderPipeline.reset();
+	if(!pipelined)
+		return true;
+
+	if(!mRenderer || !RendererComponent::canRenderInThread())
+		return false;
+
+	mRenderPipeline.reset(new RenderPipeline(*mRenderer, true));
+	return true;
+}
+
 static Framework* gCurrentUpdatingFramework = nullptr;
 
 Framework::Framework()
@@ -540,6 +673,15 @@ Framework::Framework()
 		Binding::registerRenderBinding(*mImpl.vm);
 		Binding::registerFrameworkBinding(*mImpl.vm, *this);
 	}
+
+	{	// Cache the compiled named scripts across runs
+		RawFileSystem fs("");
+		const Path cacheDir = fs.getRoot() / "ScriptCache";
+		if(!fs.isExists(cacheDir))
+			(void)fs.makeDir(cacheDir);
+		if(!mImpl.vm->setByteCodeCache(cacheDir))
+			Log::format(Log::Warn, "Cannot create the script cache folder \"%s\", scripts are compiled on every load", cacheDir.c_str());
+	}
 }
 
 Framework::~Framework()
@@ -631,6 +773,18 @@ InputComponentPtr Framework::inputComponent() {
 	return mImpl.mInput;
 }
 
+FrameScheduler& Framework::frameScheduler() {
+	return mImpl.mScheduler;
+}
+
+bool Framework::setPipelined(bool pipelined) {
+	return mImpl.setPipelined(pipelined);
+}
+
+bool Framework::pipelined() const {
+	return mImpl.mRenderPipeline.get() != nullptr;
+}
+
 float Framework::dt() const {
 	return mImpl.mDeltaTime;
 }
@@ -11,6 +11,7 @@ namespace MCD {
 class Entity;
 class BehaviourComponent;
 class FileSystemCollection;
+class FrameScheduler;
 class Path;
 class PrefabLoaderComponent;
 class RenderWindow;
@@ -66,6 +67,13 @@ public:
 
 	void mainLoop();
 
+	/// Render frame N in a render thread while updating frame N+1, for more throughput with one frame more latency.
+	/// The render thread draws a RenderSnapshot owning copies of the draw calls and materials, and the
+	/// frame scheduler tasks (eg. resource commits) run while it is idle. Call after initWindow().
+	/// \return false if the renderer cannot render in another thread, the frames are then rendered as before.
+	/// \sa RenderPipeline
+	sal_checkreturn bool setPipelined(bool pipelined);
+
 // Attributes
 	FileSystemCollection& fileSystemCollection();
 
@@ -73,11 +81,17 @@ public:
 
 	TaskPool& taskPool();
 
+	/// The scheduler measuring the phases of update(), and doing the deferred work like resource commits.
+	/// Set FrameScheduler::targetFrameTime for the frame time to aim at, or add more tasks to it.
+	FrameScheduler& frameScheduler();
+
 	Entity& rootEntity();
 	Entity& systemEntity();
 	Entity& sceneLayer();
 	Entity& guiLayer();
 
+	/// Named scripts are byte code cached in the "ScriptCache" folder of the working directory,
+	/// call VMCore::setByteCodeCache() to use another folder or an empty path to disable it.
 	Binding::VMCore& vm();
 
 	sal_maybenull RenderWindow* window();
@@ -86,6 +100,8 @@ public:
 
 	InputComponentPtr inputComponent();
 
+	bool pipelined() const;
+
 	float dt() const;	//!< Duration of LAST frame
 	float fps() const;	//!< Frame per second over the last second
 
@@ -3,7 +3,9 @@
 #include "TextureLoaderBaseImpl.inc"
 #include "../Render/Texture.h"
 #include "../Core/System/Log.h"
+#include "../Core/System/ReadSpan.h"
 #include "../Core/System/StrUtility.h"
+#include <string.h>	// For memcpy
 #include "../../3Party/glew/glew.h"
 
 // http://www.mindcontrol.org/~hplus/graphics/dds-info/
@@ -205,9 +207,50 @@ public:
 
 	int load(std::istream& is)
 	{
+		// Fast path: copy directly from the file content in memory
+		if(const ReadSpan* span = getReadSpan(&is)) {
+			const size_t pos = size_t(is.tellg());
+			return pos <= span->size() ? load(span->data() + pos, span->size() - pos) : -1;
+		}
+
 		DDS_header hdr;
 		is.read((char*)&hdr, sizeof(hdr));
 		if(is.gcount() != sizeof(hdr)) return -1;
+
+		size_t size = 0;
+		if(parseHeader(hdr, size) != 0)
+			return -1;
+
+		mImageData = ImageData(size);
+		is.read(mImageData, size);
+		if(size_t(is.gcount()) != size)
+			return -1;
+
+		return 0;
+	}
+
+	int load(const char* data, size_t dataSize)
+	{
+		DDS_header hdr;
+		if(dataSize < sizeof(hdr)) return -1;
+		::memcpy(&hdr, data, sizeof(hdr));
+
+		size_t size = 0;
+		if(parseHeader(hdr, size) != 0)
+			return -1;
+
+		if(dataSize - sizeof(hdr) < size)
+			return -1;
+
+		mImageData = ImageData(size);
+		::memcpy(mImageData, data + sizeof(hdr), size);
+
+		return 0;
+	}
+
+	//!	Validate the header and get the total size of the image data of all mip levels.
+	int parseHeader(const DDS_header& hdr, size_t& size)
+	{
 		if(hdr.dwMagic != DDS_MAGIC) return -1;
 		if(hdr.dwSize != 124) return -1;
 
@@ -254,7 +297,7 @@ public:
 		mLoadInfo = li;
 		mGpuFormat = mSrcFormat = li->format;
 
-		size_t size = 0;
+		size = 0;
 		uint x = hdr.dwWidth;
 		uint y = hdr.dwHeight;
 
@@ -264,11 +307,6 @@ public:
 			y = (y + 1) >> 1;
 		}
 
-		mImageData = ImageData(size);
-		is.read(mImageData, size);
-		if(size_t(is.gcount()) != size)
-			return -1;
-
 		return 0;
 	}
 
@@ -22,6 +22,9 @@ public:
 	sal_override LoadingState load(
 		sal_maybenull std::istream* is, sal_maybenull const Path* fileId=nullptr, sal_in_z_opt const char* args=nullptr);
 
+	//!	The header and image data are copied directly from the file content in memory.
+	sal_override bool preferReadSpan() const { return true; }
+
 protected:
 	sal_override void uploadData(Texture& texture);
 };	// DdsLoader
@@ -4,6 +4,7 @@
 #include "../Render/Texture.h"
 #include "../Core/System/Log.h"
 #include "../Core/System/MemoryProfiler.h"
+#include "../Core/System/ReadSpan.h"
 #include "../Core/System/StrUtility.h"
 #include "../../3Party/SmallJpeg/jpegdecoder.h"
 
@@ -21,12 +22,26 @@ namespace MCD {
 class Stream : public jpeg_decoder_stream
 {
 public:
-	explicit Stream(std::istream& is) : mIStream(is) {}
+	explicit Stream(std::istream& is)
+		: mIStream(is), mSpan(getReadSpan(&is))
+		, mSpanPos(mSpan ? size_t(is.tellg()) : 0)
+	{}
 
 	sal_override int read(uchar* Pbuf, int max_bytes_to_read, bool* Peof_flag)
 	{
-		mIStream.read((char*)Pbuf, max_bytes_to_read);
-		std::streamsize readCount = mIStream.gcount();
+		std::streamsize readCount = 0;
+
+		// Fast path: copy directly from the file content in memory
+		if(mSpan) {
+			const size_t remain = mSpanPos < mSpan->size() ? mSpan->size() - mSpanPos : 0;
+			readCount = std::streamsize(remain < size_t(max_bytes_to_read) ? remain : size_t(max_bytes_to_read));
+			memcpy(Pbuf, mSpan->data() + mSpanPos, size_t(readCount));
+			mSpanPos += size_t(readCount);
+		}
+		else {
+			mIStream.read((char*)Pbuf, max_bytes_to_read);
+			readCount = mIStream.gcount();
+		}
 
 		if(Peof_flag)
 			*Peof_flag = (readCount == 0);
@@ -35,6 +50,8 @@ public:
 	}
 
 	std::istream& mIStream;
+	ReadSpanPtr mSpan;
+	size_t mSpanPos;
 };	// Stream
 
 class JpegLoader::LoaderImpl : public TextureLoaderBase::LoaderBaseImpl
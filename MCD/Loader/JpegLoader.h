@@ -23,6 +23,9 @@ public:
 	sal_override LoadingState load(
 		sal_maybenull std::istream* is, sal_maybenull const Path* fileId=nullptr, sal_in_z_opt const char* args=nullptr);
 
+	//!	The decoder reads directly from the file content in memory.
+	sal_override bool preferReadSpan() const { return true; }
+
 protected:
 	sal_override void uploadData(Texture& texture);
 };	// JpegLoader
@@ -4,6 +4,7 @@
 #include "../Render/Texture.h"
 #include "../Core/System/Log.h"
 #include "../Core/System/MemoryProfiler.h"
+#include "../Core/System/ReadSpan.h"
 #include "../Core/System/StrUtility.h"
 #include "../../3Party/png/png.h"
 #include <stdexcept>
@@ -173,13 +174,26 @@ IResourceLoader::LoadingState PngLoader::load(std::istream* is, const Path*, con
 	}
 
 	// Process the data (used for progressive loading).
-	char buff[1024*8];
-	{	ScopeUnlock unlock(mutex);
-		is->read(buff, sizeof(buff));
+	png_size_t readCount = 0;
+	if(const ReadSpan* span = getReadSpan(is)) {
+		// Feed libpng directly from the file content in memory, with a larger
+		// chunk since there is no copying, while still keeping progressive loading.
+		const size_t pos = size_t(is->tellg());
+		const size_t remain = pos < span->size() ? span->size() - pos : 0;
+		readCount = static_cast<png_size_t>(remain < 1024*256 ? remain : 1024*256);
+		is->seekg(std::streamoff(readCount), std::ios_base::cur);
+
+		png_process_data(impl->png_ptr, impl->info_ptr, (png_bytep)(span->data() + pos), readCount);
 	}
-	png_size_t readCount = static_cast<png_size_t>(is->gcount());
+	else {
+		char buff[1024*8];
+		{	ScopeUnlock unlock(mutex);
+			is->read(buff, sizeof(buff));
+		}
+		readCount = static_cast<png_size_t>(is->gcount());
 
-	png_process_data(impl->png_ptr, impl->info_ptr, (png_bytep)buff, readCount);
+		png_process_data(impl->png_ptr, impl->info_ptr, (png_bytep)buff, readCount);
+	}
 
 	if(readCount == 0)
 		return Aborted;
@@ -24,6 +24,9 @@ public:
 	sal_override LoadingState load(
 		sal_maybenull std::istream* is, sal_maybenull const Path* fileId=nullptr, sal_in_z_opt const char* args=nullptr);
 
+	//!	libpng is fed directly from the file content in memory, in larger chunks.
+	sal_override bool preferReadSpan() const { return true; }
+
 protected:
 	sal_override void uploadData(Texture& texture);
 };	// PngLoader
@@ -9,18 +9,15 @@
 
 namespace MCD {
 
-static AnimationUpdaterComponent* gAnimationUpdater = nullptr;
+static ComponentRegistry gAnimationRegistry;
+static ComponentRegistry gAnimatedRegistry;
 
-void AnimationComponent::gather()
-{
-	MCD_ASSUME(gAnimationUpdater);
-	gAnimationUpdater->mAnimationComponents.push_back(this);
+ComponentRegistry* AnimationComponent::registry() const {
+	return &gAnimationRegistry;
 }
 
-void AnimatedComponent::gather()
-{
-	MCD_ASSUME(gAnimationUpdater);
-	gAnimationUpdater->mAnimatedComponents.push_back(this);
+ComponentRegistry* AnimatedComponent::registry() const {
+	return &gAnimatedRegistry;
 }
 
 float AnimationUpdaterComponent::worldTime()
@@ -28,25 +25,18 @@ float AnimationUpdaterComponent::worldTime()
 	return float(Timer::sinceProgramStatup().asSecond());
 }
 
-void AnimationUpdaterComponent::begin()
-{
-	mAnimationComponents.clear();
-	mAnimatedComponents.clear();
-	gAnimationUpdater = this;
-	mWorldTime = worldTime();
-}
-
 void AnimationUpdaterComponent::end(float dt)
 {
+	const Entity* root = Entity::currentRoot();
+	const float time = worldTime();
+
 	// Update the animation data first
-	MCD_FOREACH(AnimationComponent* c, mAnimationComponents)
-		c->update(mWorldTime);
+	for(ComponentRegistry::Iterator itr(gAnimationRegistry, root); !itr.ended(); itr.next())
+		static_cast<AnimationComponent*>(itr.current())->update(time);
 
 	// Then update the compoents that depends on animation data
-	MCD_FOREACH(AnimatedComponent* c, mAnimatedComponents)
-		c->update();
-
-	gAnimationUpdater = nullptr;
+	for(ComponentRegistry::Iterator itr(gAnimatedRegistry, root); !itr.ended(); itr.next())
+		static_cast<AnimatedComponent*>(itr.current())->update();
 }
 
 SimpleAnimationComponent::SimpleAnimationComponent()
@@ -30,9 +30,7 @@ public:
 
 	virtual void update(float worldTime) = 0;
 
-protected:
-	friend class AnimationUpdaterComponent;
-	sal_override void gather();
+	sal_override sal_maybenull ComponentRegistry* registry() const;
 };	// AnimationComponent
 
 typedef IntrusiveWeakPtr<AnimationComponent> AnimationComponentPtr;
@@ -43,10 +41,11 @@ class MCD_ABSTRACT_CLASS MCD_RENDER_API AnimatedComponent : public Component
 {
 	friend class AnimationUpdaterComponent;
 
+public:
+	sal_override sal_maybenull ComponentRegistry* registry() const;
+
 protected:
 	virtual void update() = 0;
-
-	sal_override void gather();
 };	// AnimatedComponent
 
 /// Centralize the update of many AnimationComponent, to make the update order
@@ -55,17 +54,9 @@ class MCD_RENDER_API AnimationUpdaterComponent : public ComponentUpdater
 {
 public:
 // Operations
-	sal_override void begin();
 	sal_override void end(float dt);
 
 	static float worldTime();
-
-protected:
-	friend class AnimationComponent;
-	friend class AnimatedComponent;
-	float mWorldTime;
-	std::vector<AnimationComponent*> mAnimationComponents;
-	std::vector<AnimatedComponent*> mAnimatedComponents;
 };	// AnimationUpdaterComponent
 
 typedef IntrusiveWeakPtr<AnimationUpdaterComponent> AnimationUpdaterComponentPtr;
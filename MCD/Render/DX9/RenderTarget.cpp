@@ -19,10 +19,10 @@ RenderTargetComponent::RenderTargetComponent()
 RenderTargetComponent::~RenderTargetComponent()
 {}
 
-void RenderTargetComponent::gather()
-{
-	RendererComponent& r = RendererComponent::current();
-	r.mImpl.mRenderTargets.push_back(this);
+ComponentRegistry gRenderTargetRegistry;
+
+ComponentRegistry* RenderTargetComponent::registry() const {
+	return &gRenderTargetRegistry;
 }
 
 TexturePtr RenderTargetComponent::createTexture(const GpuDataFormat& format, size_t width, size_t height)
@@ -129,13 +129,11 @@ void RendererComponent::Impl::render(Entity& entityTree)
 	UniqueWindows uniqueWindows;
 
 	// Process the render targets one by one
-	for(size_t i=0; i<mRenderTargets.size(); ++i) {
-		if(RenderTargetComponent* r = mRenderTargets[i].get()) {
-			r->render(*mBackRef);
-			uniqueWindows.insert(r->window);
-		}
+	for(ComponentRegistry::Iterator itr(gRenderTargetRegistry, &entityTree); !itr.ended(); itr.next()) {
+		RenderTargetComponent* r = static_cast<RenderTargetComponent*>(itr.current());
+		r->render(*mBackRef);
+		uniqueWindows.insert(r->window);
 	}
-	mRenderTargets.clear();
 
 	for(UniqueWindows::const_iterator i=uniqueWindows.begin(); i!=uniqueWindows.end(); ++i)
 		if(RenderWindow* w = *i) w->postUpdate();
@@ -200,6 +198,23 @@ void RendererComponent::render(Entity& entityTree, RenderTargetComponent& render
 	mImpl.render(entityTree, renderTarget);
 }
 
+void RendererComponent::extract(Entity& entityTree, RenderSnapshot& snapshot)
+{
+	mImpl.extract(entityTree, snapshot);
+}
+
+// NOTE: The graphics context is bound to the window's thread, the snapshot is not rendered,
+// RenderPipeline renders the Entity tree with render(Entity&) instead.
+void RendererComponent::render(RenderSnapshot& snapshot)
+{
+	MCD_ASSERT(false && "Not supported, see canRenderInThread()");
+}
+
+bool RendererComponent::canRenderInThread()
+{
+	return false;
+}
+
 static RendererComponent* gCurrentRendererComponent = nullptr;
 
 RendererComponent& RendererComponent::current()
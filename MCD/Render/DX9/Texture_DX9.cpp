@@ -31,6 +31,7 @@ void Texture::clear()
 
 	handle = 0;
 	width = height = 0;
+	mipLevelCount = surfaceCount = 0;
 	format = GpuDataFormat::get("none");
 	type = 0;	// NOTE: Not used in DirectX
 }
@@ -143,6 +144,8 @@ bool Texture::create(
 		size_t s = width < height ? width : height;
 		for(;s >= 1; s /= 2) ++mipLevelCount;
 	}
+	this->mipLevelCount = mipLevelCount;
+	this->surfaceCount = surfaceCount;
 
 	if(surfaceCount == 1) {
 		IDirect3DTexture9*& texture = reinterpret_cast<IDirect3DTexture9*&>(handle);
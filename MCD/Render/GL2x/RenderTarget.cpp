@@ -64,10 +64,10 @@ static void setViewPort(RenderTargetComponent& renderTarget)
 		renderTarget.cameraComponent->frustum.setAcpectRatio(float(width) / height);
 }
 
-void RenderTargetComponent::gather()
-{
-	RendererComponent& r = RendererComponent::current();
-	r.mImpl.mRenderTargets.push_back(this);
+ComponentRegistry gRenderTargetRegistry;
+
+ComponentRegistry* RenderTargetComponent::registry() const {
+	return &gRenderTargetRegistry;
 }
 
 void RenderTargetComponent::render(RendererComponent& renderer)
@@ -33,6 +33,7 @@ void Texture::clear()
 	if(handle) glDeleteTextures(1, &handle);
 	handle = 0;
 	width = height = 0;
+	mipLevelCount = surfaceCount = 0;
 	type = GL_INVALID_ENUM;
 	format = GpuDataFormat::get("none");
 }
@@ -78,6 +79,8 @@ bool Texture::create(
 	this->width = width_;
 	this->height = height_;
 	this->type = surfaceCount == 1 ? GL_TEXTURE_2D : GL_TEXTURE_CUBE_MAP;
+	this->surfaceCount = surfaceCount;
+	this->mipLevelCount = mipLevelCount;
 
 	glEnable(type);
 	glGenTextures(1, &handle);
@@ -92,6 +95,11 @@ bool Texture::create(
 	if(true && !hasMipMap) {
 		glHint(GL_GENERATE_MIPMAP_HINT, GL_NICEST);
 		glTexParameteri(type, GL_GENERATE_MIPMAP, GL_TRUE);
+
+		// The driver generates the whole chain down to 1x1
+		this->mipLevelCount = 1;
+		for(size_t s = _max(width_, height_); s > 1; s /= 2)
+			++this->mipLevelCount;
 	}
 	else {
 		glTexParameteri(type, GL_TEXTURE_MAX_LEVEL, mipLevelCount - 1);
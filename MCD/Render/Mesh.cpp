@@ -32,6 +32,14 @@ size_t Mesh::bufferSize(size_t bufferIndex) const
 	return 0;
 }
 
+size_t Mesh::memorySize() const
+{
+	size_t ret = 0;
+	for(size_t i=0; i<bufferCount; ++i)
+		ret += bufferSize(i);
+	return ret;
+}
+
 MeshPtr Mesh::clone(const char* name, StorageHint hint)
 {
 	MeshPtr ret = new Mesh(name);
@@ -122,7 +130,7 @@ Component* MeshComponent::clone() const
 	return cloned;
 }
 
-void MeshComponent::draw(void* context, Statistic& statistic)
+static void drawMesh(Mesh* mesh, IDrawCall::Statistic& statistic)
 {
 	if(mesh) {
 		mesh->draw();
@@ -131,4 +139,31 @@ void MeshComponent::draw(void* context, Statistic& statistic)
 	}
 }
 
+void MeshComponent::draw(void* context, Statistic& statistic)
+{
+	drawMesh(mesh.get(), statistic);
+}
+
+namespace {
+
+//! Draws the mesh it holds, without the MeshComponent.
+class MeshDrawCall : public IDrawCall
+{
+public:
+	explicit MeshDrawCall(const MeshPtr& mesh) : mMesh(mesh) {}
+
+	sal_override void draw(void* context, Statistic& statistic) {
+		drawMesh(mMesh.get(), statistic);
+	}
+
+	const MeshPtr mMesh;
+};	// MeshDrawCall
+
+}	// namespace
+
+IDrawCall* MeshComponent::cloneDrawCall() const
+{
+	return mesh ? new MeshDrawCall(mesh) : nullptr;
+}
+
 }	// namespace MCD
@@ -90,6 +90,9 @@ public:
 	//!	Get the size in byte of a particular buffer, it calculates base on an attribute's stride.
 	size_t bufferSize(size_t bufferIndex) const;
 
+	//! Sum of bufferSize() of all the buffers.
+	sal_override size_t memorySize() const;
+
 	typedef Array<Attribute, cMaxAttributeCount> Attributes;
 	Attributes attributes;
 	size_t attributeCount;	//!< Number of attributes in attributes
@@ -201,6 +204,9 @@ public:
 	sal_override void render(sal_in void* context);
 	sal_override void draw(sal_in void* context, Statistic& statistic);
 
+	//!	The returned draw call holds a reference to the mesh.
+	sal_override sal_maybenull IDrawCall* cloneDrawCall() const;
+
 // Attributes
 	MeshPtr mesh;
 };	// MeshComponent
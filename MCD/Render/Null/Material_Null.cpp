@@ -1,5 +1,6 @@
 #include "Pch.h"
 #include "../Material.h"
+#include "Renderer.inc"
 #include "../Texture.h"
 
 namespace MCD {
@@ -15,7 +16,11 @@ MaterialComponent::MaterialComponent()
 
 MaterialComponent::~MaterialComponent() {}
 
-void MaterialComponent::render(void* context) {}
+void MaterialComponent::render(void* context)
+{
+	RendererComponent::Impl& renderer = *reinterpret_cast<RendererComponent::Impl*>(context);
+	renderer.mCurrentMaterial = this;
+}
 
 void MaterialComponent::preRender(size_t pass, void* context) {}
 
@@ -1,5 +1,6 @@
 #include "Pch.h"
 #include "../Mesh.h"
+#include "Renderer.inc"
 
 namespace MCD {
 
@@ -21,6 +22,13 @@ bool Mesh::create(const void* const* data, Mesh::StorageHint storageHint)
 	return false;
 }
 
-void MeshComponent::render(void* context) {}
+void MeshComponent::render(void* context)
+{
+	Entity* e = entity();
+	MCD_ASSUME(e);
+
+	RendererComponent::Impl& renderer = *reinterpret_cast<RendererComponent::Impl*>(context);
+	renderer.submitDrawCall(*this, *e, e->worldTransform());
+}
 
 }	// namespace MCD
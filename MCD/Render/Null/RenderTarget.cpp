@@ -9,7 +9,8 @@
 namespace MCD {
 
 RenderTargetComponent::RenderTargetComponent()
-	: clearColor(0, 1)
+	: shouldClearColor(true), shouldClearDepth(true)
+	, clearColor(0, 1)
 	, viewPortLeftTop(0), viewPortWidthHeight(0)
 	, window(nullptr), mImpl(0)
 {}
@@ -21,7 +22,11 @@ TexturePtr RenderTargetComponent::createTexture(const GpuDataFormat& format, siz
 	return nullptr;
 }
 
-void RenderTargetComponent::gather() {}
+ComponentRegistry gRenderTargetRegistry;
+
+ComponentRegistry* RenderTargetComponent::registry() const {
+	return &gRenderTargetRegistry;
+}
 
 void RenderTargetComponent::render(RendererComponent& renderer) {}
 
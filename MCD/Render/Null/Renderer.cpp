@@ -1,13 +1,56 @@
 #include "Pch.h"
-#include "../Renderer.h"
+#include "Renderer.inc"
 
 namespace MCD {
 
-class RendererComponent::Impl {};
+RendererComponent::Impl::Impl()
+{
+	resetStatistic();
+}
+
+void RendererComponent::Impl::render(RenderSnapshot& snapshot)
+{
+	for(size_t i=0; i<snapshot.views.size(); ++i)
+	{
+		const RenderSnapshot::View& v = snapshot.views[i];
+
+		mProjMatrix = v.projection;
+		mCameraTransform = v.cameraTransform;
+		mViewMatrix = v.viewMatrix;
+		mViewProjMatrix = mProjMatrix * mViewMatrix;
+
+		processRenderItems(v.opaque, snapshot.opaqueStatistic);
+		processRenderItems(v.transparent, snapshot.transparentStatistic);
+	}
+
+	// Reset the last material
+	if(mLastMaterial) {
+		mLastMaterial->postRender(0, this);
+		mLastMaterial = nullptr;
+	}
+}
+
+void RendererComponent::Impl::processRenderItems(const std::vector<RenderSnapshot::Item>& items, IDrawCall::Statistic& statistic)
+{
+	for(size_t i=0; i<items.size(); ++i)
+	{
+		const RenderSnapshot::Item& item = items[i];
+
+		mWorldMatrix = item.worldTransform;
+		mWorldViewProjMatrix = mViewProjMatrix * mWorldMatrix;
+
+		item.material->preRender(0, this);
+		item.drawCall->draw(this, statistic);
+		item.material->postRender(0, this);
+
+		mLastMaterial = item.material;
+	}
+}
 
 RendererComponent::RendererComponent()
 	: mImpl(*new Impl)
 {
+	mImpl.mBackRef = this;
 }
 
 RendererComponent::~RendererComponent()
@@ -23,6 +66,21 @@ void RendererComponent::render(Entity& entityTree, RenderTargetComponent& render
 {
 }
 
+void RendererComponent::extract(Entity& entityTree, RenderSnapshot& snapshot)
+{
+	mImpl.extract(entityTree, snapshot);
+}
+
+void RendererComponent::render(RenderSnapshot& snapshot)
+{
+	mImpl.render(snapshot);
+}
+
+bool RendererComponent::canRenderInThread()
+{
+	return true;
+}
+
 RendererComponent& RendererComponent::current()
 {
 	return *reinterpret_cast<RendererComponent*>(nullptr);
@@ -12,6 +12,7 @@ void Texture::clear()
 {
 	handle = 0;
 	width = height = 0;
+	mipLevelCount = surfaceCount = 0;
 	type = 0;
 	format = GpuDataFormat::get("none");
 }
@@ -25,6 +26,17 @@ bool Texture::create(
 	int apiSpecificflags
 )
 {
+	if(surfaceCount != 1 && surfaceCount != 6)
+		return false;
+
+	clear();
+
+	// Nothing is uploaded, but the attributes are kept as the other renderers do
+	format = gpuFormat;
+	width = width_;
+	height = height_;
+	this->mipLevelCount = mipLevelCount;
+	this->surfaceCount = surfaceCount;
 	return true;
 }
 
@@ -0,0 +1,235 @@
+#include "Pch.h"
+#include "RenderSnapshot.h"
+#include "Camera.h"
+#include "Material.h"
+#include "Renderer.h"
+#include "RenderTarget.h"
+#include "Texture.h"
+#include "../Core/Entity/Entity.h"
+#include "../Core/System/CondVar.h"
+#include "../Core/System/Thread.h"
+#include <algorithm>
+
+namespace MCD {
+
+RenderSnapshot::RenderSnapshot()
+	: skippedCount(0)
+{
+	::memset(&opaqueStatistic, 0, sizeof(opaqueStatistic));
+	::memset(&transparentStatistic, 0, sizeof(transparentStatistic));
+}
+
+RenderSnapshot::~RenderSnapshot()
+{
+	clear();
+}
+
+void RenderSnapshot::clear()
+{
+	for(size_t i=0; i<views.size(); ++i) {
+		View& v = views[i];
+		for(size_t j=0; j<v.opaque.size(); ++j)
+			delete v.opaque[j].drawCall;
+		for(size_t j=0; j<v.transparent.size(); ++j)
+			delete v.transparent[j].drawCall;
+	}
+
+	for(MaterialCopies::const_iterator i=mMaterialCopies.begin(); i!=mMaterialCopies.end(); ++i)
+		intrusivePtrRelease(i->second);
+
+	views.clear();
+	mMaterialCopies.clear();
+	skippedCount = 0;
+	::memset(&opaqueStatistic, 0, sizeof(opaqueStatistic));
+	::memset(&transparentStatistic, 0, sizeof(transparentStatistic));
+}
+
+RenderSnapshot::View& RenderSnapshot::beginView(const RenderTargetComponent& renderTarget, const CameraComponent& camera)
+{
+	views.push_back(View());
+	View& v = views.back();
+
+	camera.frustum.computeProjection(v.projection.data);
+	v.projectionType = camera.frustum.projectionType;
+	v.cameraTransform = camera.entity() ? camera.entity()->worldTransform() : Mat44f::cIdentity;
+	v.viewMatrix = v.cameraTransform.inverse();
+
+	v.shouldClearColor = renderTarget.shouldClearColor;
+	v.shouldClearDepth = renderTarget.shouldClearDepth;
+	v.clearColor = renderTarget.clearColor;
+	v.viewPortLeftTop = renderTarget.viewPortLeftTop;
+	v.viewPortWidthHeight = renderTarget.viewPortWidthHeight;
+	v.window = renderTarget.window;
+	for(size_t i=0; i<v.textures.size(); ++i)
+		v.textures[i] = renderTarget.textures[i];
+
+	return v;
+}
+
+void RenderSnapshot::addItem(const IDrawCall& drawCall, IMaterialComponent& material, const Mat44f& worldTransform, float viewDepth)
+{
+	MCD_ASSERT(!views.empty());
+
+	IMaterialComponent*& copy = mMaterialCopies[&material];
+	if(!copy) {
+		copy = static_cast<IMaterialComponent*>(material.clone());
+		if(copy)
+			intrusivePtrAddRef(copy);
+		else
+			mMaterialCopies.erase(&material);
+	}
+
+	IDrawCall* clonedDrawCall = copy ? drawCall.cloneDrawCall() : nullptr;
+	if(!clonedDrawCall) {
+		++skippedCount;
+		return;
+	}
+
+	// Same ordering as RendererCommon::submitDrawCall()
+	const bool transparent = copy->isTransparent();
+	Item item = { clonedDrawCall, copy, worldTransform, transparent ? viewDepth : -viewDepth };
+	(transparent ? views.back().transparent : views.back().opaque).push_back(item);
+}
+
+static bool itemLess(const RenderSnapshot::Item& lhs, const RenderSnapshot::Item& rhs) {
+	return lhs.sortKey < rhs.sortKey;
+}
+
+void RenderSnapshot::endView()
+{
+	MCD_ASSERT(!views.empty());
+	View& v = views.back();
+	std::stable_sort(v.opaque.begin(), v.opaque.end(), itemLess);
+	std::stable_sort(v.transparent.begin(), v.transparent.end(), itemLess);
+}
+
+size_t RenderSnapshot::itemCount() const
+{
+	size_t count = 0;
+	for(size_t i=0; i<views.size(); ++i)
+		count += views[i].opaque.size() + views[i].transparent.size();
+	return count;
+}
+
+class RenderPipeline::Impl : public Thread::IRunnable
+{
+public:
+	Impl(RendererComponent& renderer, bool threaded)
+		: mRenderer(renderer), mThreaded(threaded && RendererComponent::canRenderInThread()), mPending(false)
+	{
+		if(mThreaded)
+			mThread.start(*this, false);
+	}
+
+	~Impl()
+	{
+		if(!mThreaded)
+			return;
+
+		sync();
+		{	ScopeLock lock(mCondVar);
+			mThread.postQuit();
+			mCondVar.broadcastNoLock();
+		}
+		mThread.wait();
+	}
+
+	sal_override void run(Thread& thread)
+	{
+		ScopeLock lock(mCondVar);
+
+		while(true) {
+			while(!mPending && thread.keepRun())
+				mCondVar.waitNoLock();
+			if(!mPending)
+				break;
+
+			{	ScopeUnlock unlock(mCondVar);
+				render();
+			}
+
+			mPending = false;
+			mCondVar.broadcastNoLock();
+		}
+	}
+
+	void render()
+	{
+		mRenderer.render(mSnapshot);
+		mFinishTime = Timer::sinceProgramStatup();
+	}
+
+	void sync()
+	{
+		if(!mThreaded)
+			return;
+
+		ScopeLock lock(mCondVar);
+		while(mPending)
+			mCondVar.waitNoLock();
+	}
+
+	void submit(Entity& entityTree)
+	{
+		MCD_ASSERT(!mPending && "Call sync() before submit()");
+
+		if(!RendererComponent::canRenderInThread()) {
+			mRenderer.render(entityTree);
+			mFinishTime = Timer::sinceProgramStatup();
+			return;
+		}
+
+		// The render thread is idle, the copies of the last frame can be released in this thread
+		mRenderer.extract(entityTree, mSnapshot);
+
+		if(!mThreaded) {
+			render();
+			return;
+		}
+
+		ScopeLock lock(mCondVar);
+		mPending = true;
+		mCondVar.broadcastNoLock();
+	}
+
+	RendererComponent& mRenderer;
+	const bool mThreaded;
+	RenderSnapshot mSnapshot;
+	TimeInterval mFinishTime;
+
+	CondVar mCondVar;
+	bool mPending;	//!< A snapshot is submitted but not yet rendered, protected by mCondVar
+	Thread mThread;
+};	// Impl
+
+RenderPipeline::RenderPipeline(RendererComponent& renderer, bool threaded)
+	: mImpl(*new Impl(renderer, threaded))
+{
+}
+
+RenderPipeline::~RenderPipeline()
+{
+	delete &mImpl;
+}
+
+void RenderPipeline::sync() {
+	mImpl.sync();
+}
+
+void RenderPipeline::submit(Entity& entityTree) {
+	mImpl.submit(entityTree);
+}
+
+bool RenderPipeline::threaded() const {
+	return mImpl.mThreaded;
+}
+
+const RenderSnapshot& RenderPipeline::lastSnapshot() const {
+	return mImpl.mSnapshot;
+}
+
+TimeInterval RenderPipeline::lastRenderFinishTime() const {
+	return mImpl.mFinishTime;
+}
+
+}	// namespace MCD
@@ -0,0 +1,155 @@
+#ifndef __MCD_RENDER_RENDERSNAPSHOT__
+#define __MCD_RENDER_RENDERSNAPSHOT__
+
+#include "Color.h"
+#include "Frustum.h"
+#include "Renderable.h"
+#include "../Core/Math/Mat44.h"
+#include "../Core/Math/Vec2.h"
+#include "../Core/System/Array.h"
+#include "../Core/System/IntrusivePtr.h"
+#include "../Core/System/NonCopyable.h"
+#include "../Core/System/Timer.h"
+#include <map>
+#include <vector>
+
+namespace MCD {
+
+class CameraComponent;
+class Entity;
+class IMaterialComponent;
+class RendererComponent;
+class RenderTargetComponent;
+class RenderWindow;
+typedef IntrusivePtr<class Texture> TexturePtr;
+
+/*!	What the RendererComponent needs for rendering a frame, extracted from the Entity tree
+	by RendererComponent::extract(). Such that the frame can be rendered in another thread,
+	while the Entity tree is being updated for the next frame.
+
+	The snapshot owns everything it draws: the draw calls are created by IDrawCall::cloneDrawCall(),
+	the materials are copies of the IMaterialComponent, and the transforms, camera, lights and
+	render target states are copied. Nothing of the Entity tree is touched when rendering.
+	The draw calls which cannot be cloned are left out, see skippedCount.
+
+	The resources referenced by the snapshot (eg. Mesh and Texture) should only be modified
+	while the snapshot is not being rendered, that is at the sync point of the RenderPipeline.
+
+	\note extract() and clear() must be called in the thread that owns the Entity tree.
+ */
+class MCD_RENDER_API RenderSnapshot : Noncopyable
+{
+public:
+	RenderSnapshot();
+
+	~RenderSnapshot();
+
+	struct Item
+	{
+		sal_notnull IDrawCall* drawCall;
+		sal_notnull IMaterialComponent* material;
+		Mat44f worldTransform;
+		float sortKey;	//!< Front to back for opaque items, back to front for transparent items
+	};	// Item
+
+	struct Light
+	{
+		ColorRGBf color;
+		Vec3f position;
+	};	// Light
+
+	//! What a RenderTargetComponent sees.
+	struct View
+	{
+		Mat44f projection, cameraTransform, viewMatrix;
+		Frustum::ProjectionType projectionType;
+
+		bool shouldClearColor, shouldClearDepth;
+		ColorRGBAf clearColor;
+		Vec2<size_t> viewPortLeftTop, viewPortWidthHeight;
+		sal_maybenull RenderWindow* window;
+		Array<TexturePtr, 4> textures;
+
+		std::vector<Light> lights;
+		std::vector<Item> opaque, transparent;	//!< Sorted in the drawing order
+	};	// View
+
+// Operations
+	//! Release everything the snapshot owns.
+	void clear();
+
+	//! Begin a view, for the renderer extracting the snapshot.
+	View& beginView(const RenderTargetComponent& renderTarget, const CameraComponent& camera);
+
+	//! Add an item to the current view. The material is copied once per extraction.
+	void addItem(const IDrawCall& drawCall, IMaterialComponent& material, const Mat44f& worldTransform, float viewDepth);
+
+	//! Sort the items of the current view.
+	void endView();
+
+// Attributes
+	std::vector<View> views;
+
+	size_t skippedCount;	//!< The number of draw calls left out since they cannot be cloned
+
+	IDrawCall::Statistic opaqueStatistic, transparentStatistic;	//!< Filled by RendererComponent::render(RenderSnapshot&)
+
+	size_t itemCount() const;
+
+protected:
+	typedef std::map<const IMaterialComponent*, IMaterialComponent*> MaterialCopies;
+	MaterialCopies mMaterialCopies;	//!< Source to copy, the copies are owned
+};	// RenderSnapshot
+
+/*!	Pipelines the rendering with the update of the Entity tree.
+	The snapshot of frame N is rendered in a render thread, while frame N+1 is being updated.
+	This gives one more frame of latency in exchange of throughput.
+
+	The thread updating the Entity tree should do the following every frame:
+	\code
+	// Update the Entity tree ...
+	pipeline.sync();	// Wait for the last frame to finish rendering, commit any resources here
+	pipeline.submit(rootEntity);
+	\endcode
+
+	When not threaded, the snapshot is rendered right inside submit().
+	A threaded pipeline is only possible if RendererComponent::canRenderInThread(),
+	otherwise submit() simply renders the Entity tree.
+ */
+class MCD_RENDER_API RenderPipeline : Noncopyable
+{
+public:
+	RenderPipeline(RendererComponent& renderer, bool threaded);
+
+	//! Waits for the frame being rendered.
+	~RenderPipeline();
+
+// Operations
+	//! Wait until the last submitted frame is rendered.
+	void sync();
+
+	//! Extract a snapshot from \em entityTree and render it. Call sync() before this.
+	void submit(Entity& entityTree);
+
+// Attributes
+	//! Whether a render thread is used.
+	bool threaded() const;
+
+	/*!	The snapshot of the last submitted frame.
+		Only valid after sync(), until the next submit().
+	 */
+	const RenderSnapshot& lastSnapshot() const;
+
+	/*!	When the last submitted frame had finished rendering, in Timer::sinceProgramStatup().
+		Only valid after sync().
+	 */
+	TimeInterval lastRenderFinishTime() const;
+
+protected:
+	class Impl;
+	Impl& mImpl;
+};	// RenderPipeline
+
+}	// namespace MCD
+
+#endif	// __MCD_RENDER_RENDERSNAPSHOT__
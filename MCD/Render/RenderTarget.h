@@ -24,8 +24,8 @@ public:
 
 	sal_override ~RenderTargetComponent();
 
-	//! Will register the itself into the RendererComponent
-	sal_override void gather();
+	//! All RenderTargetComponent are listed for the RendererComponent to go through.
+	sal_override sal_maybenull ComponentRegistry* registry() const;
 	sal_override void render(sal_in void* context) {}
 
 	/*!	Will invoked by Renderer, preform some preparation and then calling
@@ -21,6 +21,11 @@ public:
 	virtual ~IDrawCall() {}
 
 	virtual void draw(sal_in void* context, Statistic& statistic) = 0;
+
+	/*!	Creates a draw call owning everything it draws, such that it can be drawn from a
+		RenderSnapshot while this one is being modified. Returns null if not supported.
+	 */
+	virtual sal_maybenull IDrawCall* cloneDrawCall() const { return nullptr; }
 };	// IDrawCall
 
 /*!	The component family which is something renderable.
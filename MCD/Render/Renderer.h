@@ -5,6 +5,7 @@
 
 namespace MCD {
 
+class RenderSnapshot;
 class RenderTargetComponent;
 
 class MCD_RENDER_API RendererComponent : public ComponentUpdater
@@ -25,6 +26,22 @@ public:
 	void render(Entity& entityTree);
 	void render(Entity& entityTree, RenderTargetComponent& renderTarget);
 
+	/*!	Fill the snapshot with what render(Entity&) would draw, the snapshot owns a copy of
+		every draw call and material. Must be invoked in the thread updating the Entity tree.
+		\sa RenderPipeline
+	 */
+	void extract(Entity& entityTree, RenderSnapshot& snapshot);
+
+	/*!	Render a snapshot filled by extract(), without touching the Entity tree.
+		May be invoked in another thread if canRenderInThread().
+	 */
+	void render(RenderSnapshot& snapshot);
+
+	/*!	Whether render(RenderSnapshot&) is supported, and can run in a render thread.
+		False for renderers where the graphics context is bound to the thread owning the window.
+	 */
+	static bool canRenderInThread();
+
 	class Impl;
 	Impl& mImpl;
 
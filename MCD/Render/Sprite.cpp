@@ -4,7 +4,7 @@
 
 namespace MCD {
 
-static SpriteUpdaterComponent* gSpriteUpdater = nullptr;
+static ComponentRegistry gSpriteAtlasRegistry;
 
 SpriteComponent::SpriteComponent()
 	: color(1, 1), textureRect(0, 0, 1, 1), anchor(0.5f), width(0), height(0), trackOffset(0)
@@ -24,10 +24,8 @@ void SpriteComponent::update()
 	}
 }
 
-void SpriteAtlasComponent::gather()
-{
-	MCD_ASSUME(gSpriteUpdater);
-	gSpriteUpdater->mSpriteAtlas.push_back(this);
+ComponentRegistry* SpriteAtlasComponent::registry() const {
+	return &gSpriteAtlasRegistry;
 }
 
 // NOTE: Re-generating the vertex buffer every frame is going to be slower
@@ -89,16 +87,9 @@ void SpriteAtlasComponent::gatherSprite(SpriteComponent* sprite)
 
 void SpriteUpdaterComponent::begin()
 {
-	gSpriteUpdater = this;
-	for(size_t i=0; i<mSpriteAtlas.size(); ++i)
-		if(SpriteAtlasComponent* c = mSpriteAtlas[i].get())
-			c->mVertexBuffer.clear();
-	mSpriteAtlas.clear();
-}
-
-void SpriteUpdaterComponent::end(float dt)
-{
-	gSpriteUpdater = nullptr;
+	// The SpriteComponent will fill the vertex buffer again in AnimationUpdaterComponent::end()
+	for(ComponentRegistry::Iterator itr(gSpriteAtlasRegistry, Entity::currentRoot()); !itr.ended(); itr.next())
+		static_cast<SpriteAtlasComponent*>(itr.current())->mVertexBuffer.clear();
 }
 
 }	// namespace MCD
@@ -63,6 +63,7 @@ public:
 	sal_override ~SpriteAtlasComponent();
 
 // Operations
+	sal_override sal_maybenull ComponentRegistry* registry() const;
 
 // Attributes
 	TexturePtr textureAtlas;
@@ -71,7 +72,6 @@ protected:
 	friend class SpriteComponent;
 	friend class SpriteUpdaterComponent;
 	void gatherSprite(SpriteComponent* sprite);
-	sal_override void gather();
 	sal_override void render(sal_in void* context);
 	sal_override void draw(sal_in void* context, Statistic& statistic);
 
@@ -96,11 +96,6 @@ class MCD_RENDER_API SpriteUpdaterComponent : public ComponentUpdater
 public:
 // Operations
 	sal_override void begin();
-	sal_override void end(float dt);
-
-protected:
-	friend class SpriteAtlasComponent;
-	std::vector<SpriteAtlasComponentPtr> mSpriteAtlas;
 };	// SpriteUpdaterComponent
 
 typedef IntrusiveWeakPtr<SpriteUpdaterComponent> SpriteUpdaterComponentPtr;
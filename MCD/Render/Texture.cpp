@@ -21,6 +21,32 @@ bool Texture::isValid() const
 	return (type != GL_INVALID_ENUM);
 }
 
+//! DXT1 stores a block of 4x4 texels in 8 bytes, DXT3 and DXT5 in 16 bytes.
+static size_t mipLevelSize(const GpuDataFormat& format, size_t w, size_t h)
+{
+	if(!format.isCompressed)
+		return w * h * format.sizeInByte();
+
+	const size_t blockSize = StringHash(format.name) == StringHash("dxt1") ? 8 : 16;
+	return blockSize * ((w + 3) / 4) * ((h + 3) / 4);
+}
+
+size_t Texture::memorySize() const
+{
+	if(!isValid())
+		return 0;
+
+	size_t size = 0;
+	size_t w = width, h = height;
+	for(size_t level=0; level<mipLevelCount; ++level) {
+		size += mipLevelSize(format, w, h);
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+
+	return size * surfaceCount;
+}
+
 bool Texture::hasAlpha(int format)
 {
 	return (
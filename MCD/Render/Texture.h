@@ -27,6 +27,12 @@ public:
 
 	size_t height;
 
+	//! Number of mip levels, including those generated automatically.
+	size_t mipLevelCount;
+
+	//! 6 for a cube map, 1 otherwise.
+	size_t surfaceCount;
+
 	/*!	Type of the texture.
 		Can be GL_TEXTURE_2D, GL_TEXTURE_RECTANGLE_ARB
 	 */
@@ -46,6 +52,9 @@ public:
 	//! Check whether the format has an alpha channel or not.
 	static bool hasAlpha(int format);
 
+	//! Size of all the mip levels of all surfaces, the compressed formats are counted by their 4x4 blocks.
+	sal_override size_t memorySize() const;
+
 // Operations
 	void clear();
 
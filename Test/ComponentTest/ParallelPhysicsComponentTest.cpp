@@ -0,0 +1,141 @@
+#include "Pch.h"
+#include "../../MCD/Core/Entity/Entity.h"
+#include "../../MCD/Core/System/TaskPool.h"
+#include "../../MCD/Core/System/Timer.h"
+#include "../../MCD/Component/Physics/CollisionShape.h"
+#include "../../MCD/Component/Physics/DynamicsWorld.h"
+#include "../../MCD/Component/Physics/RigidBodyComponent.h"
+
+using namespace MCD;
+
+namespace {
+
+/*!	Stacks of boxes topped with a sphere, standing on a plane.
+	The stacks are apart from each other, so each one forms its own simulation island.
+ */
+class StackScene
+{
+public:
+	StackScene(size_t stackCount, size_t stackHeight, sal_maybenull TaskPool* taskPool)
+		: dynamicsWorld(makeConfig(taskPool))
+	{
+		dynamicsWorld.setGravity(Vec3f(0, -10, 0));
+		addBody(new StaticPlaneShape(Vec3f(0, 1, 0), 0), 0, Vec3f::cZero);
+
+		CollisionShapePtr boxShape = new BoxShape(Vec3f(0.5f));
+		CollisionShapePtr sphereShape = new SphereShape(0.5f);
+		const size_t side = size_t(::sqrt(float(stackCount))) + 1;
+
+		for(size_t i=0; i<stackCount; ++i) {
+			// A little offset on each level, so the stacks have something to solve
+			const Vec3f base(float(i % side) * 4, 0, float(i / side) * 4);
+			for(size_t j=0; j<stackHeight; ++j)
+				bodies.push_back(addBody(boxShape, 1, base + Vec3f(0.05f * (j % 3), 0.5f + j, 0)));
+			bodies.push_back(addBody(sphereShape, 1, base + Vec3f(0, 0.5f + stackHeight, 0)));
+		}
+	}
+
+	~StackScene()
+	{
+		while(Entity* child = rootNode.firstChild())
+			child->destroyThis();
+	}
+
+	static DynamicsWorld::Config makeConfig(TaskPool* taskPool)
+	{
+		DynamicsWorld::Config config;
+		config.taskPool = taskPool;
+		config.batchSync = true;
+		config.interpolation = DynamicsWorld::Config::NoInterpolation;
+		return config;
+	}
+
+	Entity* addBody(const CollisionShapePtr& shape, float mass, const Vec3f& position)
+	{
+		std::auto_ptr<Entity> e(new Entity);
+		e->localTransform.setTranslation(position);
+		e->addComponent(new RigidBodyComponent(dynamicsWorld, mass, shape));
+		e->asChildOf(&rootNode);
+		return e.release();
+	}
+
+	void step(size_t steps)
+	{
+		for(size_t i=0; i<steps; ++i) {
+			dynamicsWorld.stepSimulation(dynamicsWorld.config().fixedTimeStep, 1);
+			dynamicsWorld.syncTransforms();
+		}
+	}
+
+	Entity rootNode;
+	DynamicsWorld dynamicsWorld;
+	std::vector<Entity*> bodies;
+};	// StackScene
+
+}	// namespace
+
+TEST(Stack_ParallelPhysicsComponentTest)
+{
+	TaskPool taskPool;
+	taskPool.setThreadCount(2, true);
+
+	StackScene scene(4, 4, &taskPool);
+	scene.step(120);
+
+	// The stacks keep standing
+	for(size_t i=0; i<scene.bodies.size(); ++i) {
+		const float height = 0.5f + float(i % 5);
+		CHECK_CLOSE(height, scene.bodies[i]->localTransform.translation().y, 0.1f);
+	}
+}
+
+TEST(Deterministic_ParallelPhysicsComponentTest)
+{
+	const size_t stackCount = 20, stackHeight = 5, stepCount = 180;
+
+	// The reference, where all tasks run in this thread
+	TaskPool taskPool;
+	StackScene reference(stackCount, stackHeight, &taskPool);
+	reference.step(stepCount);
+
+	const size_t threadCounts[] = { 1, 2, 4, 7 };
+	for(size_t i=0; i<sizeof(threadCounts)/sizeof(*threadCounts); ++i) {
+		taskPool.setThreadCount(threadCounts[i], true);
+		StackScene scene(stackCount, stackHeight, &taskPool);
+		scene.step(stepCount);
+
+		bool same = true;
+		for(size_t j=0; j<scene.bodies.size(); ++j)
+			same &= ::memcmp(scene.bodies[j]->localTransform.data, reference.bodies[j]->localTransform.data, sizeof(Mat44f)) == 0;
+		CHECK(same);
+	}
+}
+
+//! Step many independent stacks with 1 to 16 threads
+TEST(Benchmark_ParallelPhysicsComponentTest)
+{
+	const size_t stackCount = 400, stackHeight = 8, stepCount = 120;
+
+	double single;
+	{	StackScene scene(stackCount, stackHeight, nullptr);
+		Timer timer;
+		scene.step(stepCount);
+		single = timer.get().asSecond() * 1000 / stepCount;
+	}
+	std::cout << "DynamicsWorld without TaskPool: " << single << "ms per step" << std::endl;
+
+	const size_t threadCounts[] = { 1, 2, 4, 8, 16 };
+	for(size_t i=0; i<sizeof(threadCounts)/sizeof(*threadCounts); ++i) {
+		TaskPool taskPool;
+		// The stepping thread is also working, so one less thread for the pool
+		taskPool.setThreadCount(threadCounts[i] - 1, true);
+
+		StackScene scene(stackCount, stackHeight, &taskPool);
+		Timer timer;
+		scene.step(stepCount);
+		const double ms = timer.get().asSecond() * 1000 / stepCount;
+
+		std::cout << "DynamicsWorld with " << threadCounts[i] << " threads: " << ms << "ms per step, "
+			<< single / ms << "x" << std::endl;
+	}
+}
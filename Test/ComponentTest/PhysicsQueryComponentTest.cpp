@@ -0,0 +1,263 @@
+#include "Pch.h"
+#include "../../MCD/Core/Binding/CoreBindings.h"
+#include "../../MCD/Core/Binding/VMCore.h"
+#include "../../MCD/Core/Entity/Entity.h"
+#include "../../MCD/Core/System/Atomic.h"
+#include "../../MCD/Core/System/TaskPool.h"
+#include "../../MCD/Core/System/Timer.h"
+#include "../../MCD/Component/Physics/CollisionShape.h"
+#include "../../MCD/Component/Physics/DynamicsWorld.h"
+#include "../../MCD/Component/Physics/PhysicsBindings.h"
+#include "../../MCD/Component/Physics/RigidBodyComponent.h"
+#include "../../MCD/Render/PlaneMeshBuilder.h"
+
+using namespace MCD;
+
+namespace {
+
+//! A ground made of a static triangle mesh, with a few spheres above it.
+class QueryTestScene
+{
+public:
+	QueryTestScene(float groundSize, uint16_t groundSegmentCount)
+	{
+		{	// The ground, lying on the xz plane
+			PlaneMeshBuilder builder(groundSize, groundSize, groundSegmentCount, groundSegmentCount);
+			ground = addBody(new StaticTriMeshShape(builder, builder.posId), 0, Vec3f::cZero, "Ground");
+		}
+
+		CollisionShapePtr sphereShape = new SphereShape(1);
+		for(int i=0; i<3; ++i)
+			spheres[i] = addBody(sphereShape, 1, Vec3f(float(i) * 4, 5, 0), "Sphere");
+	}
+
+	~QueryTestScene()
+	{
+		while(Entity* child = rootNode.firstChild())
+			child->destroyThis();
+	}
+
+	Entity* addBody(const CollisionShapePtr& shape, float mass, const Vec3f& position, const char* name)
+	{
+		std::auto_ptr<Entity> e(new Entity);
+		e->name = name;
+		e->localTransform.setTranslation(position);
+		e->addComponent(new RigidBodyComponent(dynamicsWorld, mass, shape));
+		e->asChildOf(&rootNode);
+		return e.release();
+	}
+
+	Entity rootNode;
+	DynamicsWorld dynamicsWorld;
+	Entity* ground;
+	Entity* spheres[3];
+};	// QueryTestScene
+
+//! Keeps a thread of the TaskPool busy until released, at most 5 seconds.
+class BlockingTask : public TaskPool::Task
+{
+public:
+	BlockingTask() : TaskPool::Task(0) {}
+
+	sal_override void run(Thread&)
+	{
+		++started;
+		Timer timer;
+		while(release == 0 && timer.get().asSecond() < 5)
+			mSleep(1);
+		++finished;
+	}
+
+	AtomicInteger started, finished, release;
+};	// BlockingTask
+
+}	// namespace
+
+TEST(Raycast_PhysicsQueryComponentTest)
+{
+	QueryTestScene scene(20, 10);
+	DynamicsWorld& world = scene.dynamicsWorld;
+	DynamicsWorld::QueryHit hit;
+
+	// Hit the top of the first sphere
+	CHECK(world.raycast(Vec3f(0, 10, 0), Vec3f(0, -10, 0), hit));
+	CHECK_EQUAL(scene.spheres[0], hit.entity);
+	CHECK_CLOSE(0.2f, hit.fraction, 1e-4f);
+	CHECK(hit.position.isNearEqual(Vec3f(0, 6, 0), 1e-3f));
+	CHECK(hit.normal.isNearEqual(Vec3f::c010, 1e-3f));
+
+	// The spheres are filtered out
+	CHECK(world.raycast(Vec3f(0, 10, 0), Vec3f(0, -10, 0), hit, DynamicsWorld::StaticBodies));
+	CHECK_EQUAL(scene.ground, hit.entity);
+	CHECK_CLOSE(0.5f, hit.fraction, 1e-4f);
+
+	// Only the spheres
+	CHECK(!world.raycast(Vec3f(2, 10, 0), Vec3f(2, -10, 0), hit, DynamicsWorld::DynamicBodies));
+	CHECK(!hit.hasHit());
+	CHECK(!hit.entity);
+
+	// Miss everything
+	CHECK(!world.raycast(Vec3f(50, 10, 0), Vec3f(50, -10, 0), hit));
+	CHECK_EQUAL(1.0f, hit.fraction);
+
+	// The batched version gives the same result, with and without a task pool
+	const Vec3f from[] = { Vec3f(0, 10, 0), Vec3f(4, 10, 0), Vec3f(2, 10, 0), Vec3f(50, 10, 0) };
+	const Vec3f to[] = { Vec3f(0, -10, 0), Vec3f(4, -10, 0), Vec3f(2, -10, 0), Vec3f(50, -10, 0) };
+	DynamicsWorld::QueryHit hits[4];
+	CHECK_EQUAL(3u, world.raycast(from, to, hits, 4));
+	CHECK_EQUAL(scene.spheres[0], hits[0].entity);
+	CHECK_EQUAL(scene.spheres[1], hits[1].entity);
+	CHECK_EQUAL(scene.ground, hits[2].entity);
+	CHECK(!hits[3].hasHit());
+
+
+	// Enough rays to be split into chunks for the pool
+	const size_t cRayCount = 1024;
+	std::vector<Vec3f> manyFrom, manyTo;
+	for(size_t i=0; i<cRayCount; ++i) {
+		manyFrom.push_back(from[i % 4]);
+		manyTo.push_back(to[i % 4]);
+	}
+	std::vector<DynamicsWorld::QueryHit> manyHits(cRayCount);
+
+	{	TaskPool taskPool;
+		taskPool.setThreadCount(2, true);
+		CHECK_EQUAL(cRayCount * 3 / 4, world.raycast(&manyFrom[0], &manyTo[0], &manyHits[0], cRayCount, DynamicsWorld::StaticBodies, &taskPool));
+		for(size_t i=0; i<cRayCount; ++i)
+			CHECK_EQUAL(i % 4 == 3, manyHits[i].entity == nullptr);
+		CHECK_EQUAL(scene.ground, manyHits[0].entity);
+	}
+
+	{	// The query neither runs nor waits for the other tasks of the pool
+		BlockingTask blocker;
+		TaskPool taskPool;
+		taskPool.setThreadCount(1, true);
+		CHECK(taskPool.enqueue(blocker));
+		Timer timer;
+		while(blocker.started == 0 && timer.get().asSecond() < 5)
+			mSleep(1);
+
+		CHECK_EQUAL(cRayCount * 3 / 4, world.raycast(&manyFrom[0], &manyTo[0], &manyHits[0], cRayCount, DynamicsWorld::StaticBodies, &taskPool));
+		CHECK_EQUAL(0, int(blocker.finished));
+		blocker.release = 1;
+	}
+}
+
+TEST(Sweep_PhysicsQueryComponentTest)
+{
+	QueryTestScene scene(20, 10);
+	DynamicsWorld& world = scene.dynamicsWorld;
+	DynamicsWorld::QueryHit hit;
+
+	// Rest on the ground, in between the spheres
+	CHECK(world.sweepSphere(0.5f, Vec3f(2, 10, 0), Vec3f(2, -10, 0), hit));
+	CHECK_EQUAL(scene.ground, hit.entity);
+	CHECK_CLOSE(0.475f, hit.fraction, 1e-3f);
+	CHECK(hit.normal.isNearEqual(Vec3f::c010, 1e-3f));
+
+	// A box wide enough to touch the spheres on both sides
+	CHECK(world.sweepBox(Vec3f(1.5f, 0.5f, 0.5f), Vec3f(2, 10, 0), Vec3f(2, -10, 0), hit));
+	CHECK(hit.entity == scene.spheres[0] || hit.entity == scene.spheres[1]);
+	CHECK(hit.fraction < 0.475f);
+
+	CHECK(!world.sweepSphere(0.5f, Vec3f(2, 10, 0), Vec3f(2, -10, 0), hit, DynamicsWorld::DynamicBodies));
+}
+
+TEST(Overlap_PhysicsQueryComponentTest)
+{
+	QueryTestScene scene(20, 10);
+	DynamicsWorld& world = scene.dynamicsWorld;
+	std::vector<Entity*> result;
+
+	CHECK_EQUAL(1u, world.overlapSphere(Vec3f(0, 5, 0), 0.5f, result));
+	CHECK_EQUAL(scene.spheres[0], result[0]);
+
+	// Results are appended
+	CHECK_EQUAL(1u, world.overlapSphere(Vec3f(4, 0, 0), 0.5f, result));
+	CHECK_EQUAL(2u, result.size());
+	CHECK_EQUAL(scene.ground, result[1]);
+
+	// Touching two spheres and the ground
+	result.clear();
+	CHECK_EQUAL(3u, world.overlapBox(Vec3f(2, 4, 0), Vec3f(1.5f, 4, 0.5f), result));
+	CHECK_EQUAL(2u, world.overlapBox(Vec3f(2, 4, 0), Vec3f(1.5f, 4, 0.5f), result, DynamicsWorld::DynamicBodies));
+
+	// In the gap between the spheres
+	result.clear();
+	CHECK_EQUAL(0u, world.overlapSphere(Vec3f(2, 5, 0), 0.5f, result));
+}
+
+TEST(Binding_PhysicsQueryComponentTest)
+{
+	QueryTestScene scene(20, 10);
+	Binding::VMCore vm;
+	Binding::registerCoreBinding(vm);
+	Binding::registerPhysicsBinding(vm, scene.dynamicsWorld);
+
+	CHECK(vm.runScript(
+		"local hit = PhysicsHit();\n"
+		"if(!physicsWorld.raycast(Vec3(0, 10, 0), Vec3(0, -10, 0), hit)) throw \"raycast\";\n"
+		"if(hit.entity.name != \"Sphere\" || hit.fraction < 0.19 || hit.fraction > 0.21) throw \"raycast hit\";\n"
+		"if(!physicsWorld.raycast(Vec3(0, 10, 0), Vec3(0, -10, 0), hit, DynamicsWorld.staticBodies)) throw \"filter\";\n"
+		"if(hit.entity.name != \"Ground\") throw \"filter hit\";\n"
+		"if(!physicsWorld.sweepSphere(0.5, Vec3(4, 10, 0), Vec3(4, -10, 0), hit)) throw \"sweep\";\n"
+
+		// Each query returns its own array
+		"local a = physicsWorld.overlapSphere(Vec3(0, 5, 0), 1.5);\n"
+		"local b = physicsWorld.overlapBox(Vec3(4, 0, 0), Vec3(5, 7, 1));\n"
+		"if(a.len() != 1 || a[0].name != \"Sphere\") throw \"overlapSphere\";\n"
+		"if(b.len() != 4) throw \"overlapBox\";\n"
+		"if(physicsWorld.overlapBox(Vec3(4, 0, 0), Vec3(5, 7, 1), DynamicsWorld.dynamicBodies).len() != 3) throw \"overlapBox filter\";\n"
+		"if(physicsWorld.overlapSphere(Vec3(50, 5, 0), 1).len() != 0) throw \"overlap nothing\";\n"
+	));
+
+	// Wrong parameter type
+	CHECK(!vm.runScript("physicsWorld.overlapSphere(1, 1);"));
+}
+
+//! Cast 100k random rays against a triangle mesh level, one by one and batched on a TaskPool
+TEST(Benchmark_PhysicsQueryComponentTest)
+{
+	QueryTestScene scene(200, 180);
+	DynamicsWorld& world = scene.dynamicsWorld;
+
+	const size_t rayCount = 100000;
+	std::vector<Vec3f> from(rayCount), to(rayCount);
+	unsigned seed = 4321;
+	for(size_t i=0; i<rayCount; ++i) {
+		float r[4];
+		for(size_t j=0; j<4; ++j) {
+			seed = seed * 1103515245u + 12345u;
+			r[j] = float((seed >> 16) & 0x7FFF) / 0x7FFF * 180 - 90;
+		}
+		from[i] = Vec3f(r[0], 50, r[1]);
+		to[i] = Vec3f(r[2], -50, r[3]);
+	}
+
+	std::vector<DynamicsWorld::QueryHit> hits1(rayCount), hits2(rayCount);
+
+	Timer timer;
+	size_t hitCount1 = 0;
+	for(size_t i=0; i<rayCount; ++i)
+		hitCount1 += world.raycast(from[i], to[i], hits1[i], DynamicsWorld::StaticBodies) ? 1 : 0;
+	const double ms1 = timer.get().asSecond() * 1000;
+
+	TaskPool taskPool;
+	taskPool.setThreadCount(3, true);
+
+	timer.reset();
+	const size_t hitCount2 = world.raycast(&from[0], &to[0], &hits2[0], rayCount, DynamicsWorld::StaticBodies, &taskPool);
+	const double ms2 = timer.get().asSecond() * 1000;
+
+	// Every ray crosses the ground at the half way
+	CHECK_EQUAL(rayCount, hitCount1);
+	CHECK_EQUAL(rayCount, hitCount2);
+	for(size_t i=0; i<rayCount; ++i) {
+		CHECK_EQUAL(hits1[i].fraction, hits2[i].fraction);
+		CHECK_EQUAL(scene.ground, hits2[i].entity);
+	}
+	CHECK_CLOSE(0.5f, hits1[0].fraction, 1e-4f);
+
+	std::cout << "raycast() one by one: " << ms1 << "ms for " << rayCount << " rays" << std::endl;
+	std::cout << "raycast() batched with 3 threads: " << ms2 << "ms for " << rayCount << " rays" << std::endl;
+}
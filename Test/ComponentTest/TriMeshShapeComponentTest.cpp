@@ -0,0 +1,139 @@
+#include "Pch.h"
+#include "../../MCD/Core/Entity/Entity.h"
+#include "../../MCD/Core/System/RawFileSystem.h"
+#include "../../MCD/Core/System/Timer.h"
+#include "../../MCD/Component/Physics/CollisionShape.h"
+#include "../../MCD/Component/Physics/DynamicsWorld.h"
+#include "../../MCD/Component/Physics/RigidBodyComponent.h"
+#include "../../MCD/Render/PlaneMeshBuilder.h"
+#include <stdio.h>	// For remove()
+
+#ifdef MCD_WIN
+#	include "../../MCD/Core/System/PlatformInclude.h"
+#	include <psapi.h>
+#	pragma comment(lib, "psapi")
+#endif
+
+using namespace MCD;
+
+namespace {
+
+const char* cCacheDirectory = "BvhCache";
+
+//! The resident memory of the process in bytes, zero if not supported.
+size_t residentMemory()
+{
+#if defined(MCD_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	if(::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+#elif defined(__linux__)
+	size_t pages = 0, resident = 0;
+	if(FILE* f = ::fopen("/proc/self/statm", "r")) {
+		if(::fscanf(f, "%lu %lu", &pages, &resident) != 2)
+			resident = 0;
+		::fclose(f);
+	}
+	return resident * 4096;
+#endif
+	return 0;
+}
+
+//! Casts a ray straight down through a shape, returns the fraction.
+float raycastDown(const StaticTriMeshShapePtr& shape, const Vec3f& xz)
+{
+	Entity root;
+	DynamicsWorld world;
+	std::auto_ptr<Entity> e(new Entity);
+	e->addComponent(new RigidBodyComponent(world, 0, shape));
+	e->asChildOf(&root);
+	e.release();
+
+	DynamicsWorld::QueryHit hit;
+	world.raycast(xz + Vec3f(0, 10, 0), xz - Vec3f(0, 10, 0), hit);
+
+	root.firstChild()->destroyThis();
+	return hit.fraction;
+}
+
+}	// namespace
+
+TEST(BvhCache_TriMeshShapeComponentTest)
+{
+	RawFileSystem fs("./");
+	fs.makeDir(cCacheDirectory);
+
+	PlaneMeshBuilder builder(10, 10, 20, 20);
+
+	// Cold cache, the BVH is built and saved
+	StaticTriMeshShapePtr shape1 = new StaticTriMeshShape(builder, builder.posId, true, cCacheDirectory);
+	::remove(shape1->bvhCacheFile().c_str());
+	shape1 = new StaticTriMeshShape(builder, builder.posId, true, cCacheDirectory);
+	CHECK(!shape1->isBvhCached());
+	CHECK(fs.isExists(shape1->bvhCacheFile()));
+
+	// Warm cache, the BVH is memory mapped
+	StaticTriMeshShapePtr shape2 = new StaticTriMeshShape(builder, builder.posId, false, cCacheDirectory);
+	CHECK(shape2->isBvhCached());
+	CHECK(shape1->bvhCacheFile() == shape2->bvhCacheFile());
+	CHECK_CLOSE(0.5f, raycastDown(shape2, Vec3f(1.3f, 0, -2.7f)), 1e-5f);
+	CHECK_EQUAL(raycastDown(shape1, Vec3f(-4.1f, 0, 3.3f)), raycastDown(shape2, Vec3f(-4.1f, 0, 3.3f)));
+
+	// A different mesh never picks up the cache of another one
+	PlaneMeshBuilder builder2(10, 12, 20, 20);
+	StaticTriMeshShapePtr shape3 = new StaticTriMeshShape(builder2, builder2.posId, true, cCacheDirectory);
+	CHECK(shape3->bvhCacheFile() != shape1->bvhCacheFile());
+	::remove(shape3->bvhCacheFile().c_str());
+
+	// A truncated cache file is rebuilt, release the mapping before touching the file
+	shape2 = nullptr;
+	{	std::auto_ptr<std::ostream> os = fs.openWrite(shape1->bvhCacheFile());
+		CHECK(os.get());
+		os->write("MBVH", 4);
+	}
+	StaticTriMeshShapePtr shape4 = new StaticTriMeshShape(builder, builder.posId, true, cCacheDirectory);
+	CHECK(!shape4->isBvhCached());
+	CHECK_EQUAL(0.5f, raycastDown(shape4, Vec3f(1.3f, 0, -2.7f)));
+
+	::remove(shape1->bvhCacheFile().c_str());
+	fs.remove(cCacheDirectory);
+}
+
+//! Load a level of over 1M triangles, with and without the BVH cache
+TEST(Benchmark_TriMeshShapeComponentTest)
+{
+	RawFileSystem fs("./");
+	fs.makeDir(cCacheDirectory);
+
+	// The index is 16 bits, so the level is made of 16 meshes of 64800 triangles
+	const size_t meshCount = 16;
+	std::vector<PlaneMeshBuilder*> builders;
+	for(size_t i=0; i<meshCount; ++i)
+		builders.push_back(new PlaneMeshBuilder(100.0f + i, 100, 180, 180));
+
+	std::vector<StaticTriMeshShapePtr> shapes;
+	const char* names[] = { "no cache", "cold cache", "warm cache" };
+	for(size_t pass=0; pass<3; ++pass) {
+		const Path cacheDirectory = pass == 0 ? "" : cCacheDirectory;
+
+		const size_t memory = residentMemory();
+		Timer timer;
+		for(size_t i=0; i<meshCount; ++i)
+			shapes.push_back(new StaticTriMeshShape(*builders[i], builders[i]->posId, false, cacheDirectory));
+		const double ms = timer.get().asSecond() * 1000;
+		const double mb = double(residentMemory() - memory) / (1 << 20);
+
+		for(size_t i=0; i<meshCount; ++i)
+			CHECK_EQUAL(pass == 2, shapes[i]->isBvhCached());
+
+		std::cout << "StaticTriMeshShape with " << names[pass] << ": " << ms << "ms, " << mb << "MB resident" << std::endl;
+
+		if(pass == 2) for(size_t i=0; i<meshCount; ++i)
+			::remove(shapes[i]->bvhCacheFile().c_str());
+		shapes.clear();
+	}
+
+	for(size_t i=0; i<meshCount; ++i)
+		delete builders[i];
+	fs.remove(cCacheDirectory);
+}
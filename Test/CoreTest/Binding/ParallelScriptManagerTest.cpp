@@ -0,0 +1,133 @@
+#include "Pch.h"
+#include "../../../MCD/Core/Binding/CoreBindings.h"
+#include "../../../MCD/Core/Binding/ParallelScriptManager.h"
+#include "../../../MCD/Core/Binding/ScriptComponent.h"
+#include "../../../MCD/Core/Binding/VMCore.h"
+#include "../../../MCD/Core/Entity/Entity.h"
+#include "../../../MCD/Core/System/TaskPool.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <stdio.h>
+
+using namespace MCD;
+
+namespace {
+
+const char* cScript = "\
+	class Mover extends ScriptComponent {\
+		function update(dt) { ++count; for(local i=0; i<20; ++i) x += dt; }\
+		count = 0; x = 0;\
+	}\
+	class Poster extends ScriptComponent {\
+		function update(dt) {\
+			::postMessage((::vmIndex + 1) % ::vmCount, \"hello\", ::vmIndex);\
+			::postMessage(-1, \"score\", ::vmIndex * 10);\
+			::postMessage(-1, \"score\", ::vmIndex * 10 + 1);\
+		}\
+	}\
+	received <- [];\
+	function onMessage(name, value, fromVm) { if(name == \"hello\" && value == fromVm) received.append(fromVm); }\
+	function add(type, n) { for(local i=0; i<n; ++i) partition.addLastChild(Entity(\"\")).addComponent(type); }\
+	function count() {\
+		local sum = 0;\
+		for(local e=partition.firstChild; e; e=e.nextSibling) foreach(c in e.components) if(c instanceof Mover) sum += c.count;\
+		return sum;\
+	}";
+
+bool setup(Binding::ParallelScriptManager& manager, Entity& root, size_t vmCount, size_t moverCount)
+{
+	char buf[64];
+	for(size_t i=0; i<vmCount; ++i) {
+		Entity* partition = root.addLastChild(new Entity("partition"));
+		const size_t index = manager.addVM(*partition, &Binding::registerCoreBinding);
+		sprintf(buf, "vmCount <- %d; add(Mover, %d);", int(vmCount), int(moverCount));
+		if(!manager.runScript(index, cScript) || !manager.runScript(index, buf))
+			return false;
+	}
+	return true;
+}
+
+}	// namespace
+
+TEST(ParallelScriptManager_BindingTest)
+{
+	const size_t vmCount = 3;
+	Entity root;
+	TaskPool taskPool;
+	taskPool.setThreadCount(2);
+
+	{	Binding::ParallelScriptManager manager(&taskPool);
+		CHECK(setup(manager, root, vmCount, 10));
+		CHECK_EQUAL(vmCount, manager.vmCount());
+
+		// Each VM lists only its own ScriptComponent
+		for(size_t i=0; i<vmCount; ++i) {
+			CHECK_EQUAL(10u, manager.vm(i).scriptComponents().size());
+			CHECK_EQUAL(&root, manager.partition(i)->parent());
+		}
+
+		for(size_t i=0; i<5; ++i)
+			manager.update(0.1f);
+		CHECK(manager.hostMessages().empty());
+
+		for(size_t i=0; i<vmCount; ++i)
+			CHECK(manager.runScript(i, "add(Poster, 1); if(count() != 50) throw \"Mover\";"));
+
+		// The messages to the host are merged in the order of the source VM and then the posting order
+		manager.update(0.1f);
+		CHECK_EQUAL(vmCount * 2, manager.hostMessages().size());
+		for(size_t i=0; i<manager.hostMessages().size(); ++i) {
+			const Binding::ParallelScriptManager::Message& m = manager.hostMessages()[i];
+			CHECK_EQUAL(i / 2, m.from);
+			CHECK_EQUAL(Binding::ParallelScriptManager::cHost, m.to);
+			CHECK_EQUAL(std::string("score"), m.name);
+			CHECK_EQUAL(OT_INTEGER, m.type);
+			CHECK_EQUAL(SQInteger(m.from * 10 + i % 2), m.integer);
+		}
+
+		// The messages between the VMs are delivered in the next update
+		for(size_t i=0; i<vmCount; ++i)
+			CHECK(manager.runScript(i, "if(received.len() != 0) throw \"received\";"));
+		manager.update(0.1f);
+		CHECK(manager.runScript(0, "if(received.len() != 1 || received[0] != 2) throw \"received\";"));
+		CHECK(manager.runScript(1, "if(received.len() != 1 || received[0] != 0) throw \"received\";"));
+		CHECK(manager.runScript(2, "if(received.len() != 1 || received[0] != 1) throw \"received\";"));
+
+		// Only primitive values can be posted
+		CHECK(!manager.runScript(0, "postMessage(1, \"table\", {});"));
+		CHECK(!manager.runScript(0, "postMessage(3, \"invalid\", 0);"));
+	}
+}
+
+//! A fixed number of scripts, split among 1 to 8 VMs
+TEST(BenchmarkParallelScriptManager_BindingTest)
+{
+	const size_t moverCount = 8000, frameCount = 10;
+	double singleVm = 0;
+
+	for(size_t vmCount=1; vmCount<=8; vmCount*=2)
+	{
+		Entity root;
+		TaskPool taskPool;
+		taskPool.setThreadCount(vmCount - 1);	// The calling thread also runs the VMs
+
+		{	Binding::ParallelScriptManager manager(&taskPool);
+			CHECK(setup(manager, root, vmCount, moverCount / vmCount));
+
+			manager.update(0.1f);	// Warm up
+			Timer timer;
+			for(size_t i=0; i<frameCount; ++i)
+				manager.update(0.1f);
+			const double ms = timer.get().asSecond() * 1000 / frameCount;
+			if(vmCount == 1)
+				singleVm = ms;
+
+			for(size_t i=0; i<vmCount; ++i)
+				CHECK(manager.runScript(i, "if(count() != (8000 / vmCount) * 11) throw \"Mover\";"));
+
+			std::cout << "ParallelScriptManager " << vmCount << " VM: " << ms << "ms per frame, "
+				<< singleVm / ms << "x" << std::endl;
+		}
+
+		taskPool.stop();
+	}
+}
@@ -0,0 +1,168 @@
+#include "Pch.h"
+#include "../../../MCD/Core/Binding/CoreBindings.h"
+#include "../../../MCD/Core/Binding/ScriptComponent.h"
+#include "../../../MCD/Core/Binding/VMCore.h"
+#include "../../../MCD/Core/Entity/Entity.h"
+#include "../../../MCD/Core/System/Thread.h"
+#include "../../../MCD/Core/System/Timer.h"
+
+using namespace MCD;
+
+namespace {
+
+const char* cScriptClasses = "\
+	class Mover extends ScriptComponent {\
+		function update(dt) { ++count; x += dt; }\
+		count = 0; x = 0;\
+	}\
+	class Idle extends ScriptComponent {\
+		count = 0;\
+	}\
+	class Sleeper extends ScriptComponent {\
+		function update(dt) { ++count; sleep(1000); }\
+		count = 0;\
+	}\
+	class Waiter extends ScriptComponent {\
+		function update(dt) { ++count; waitFor(\"go\"); ++woken; }\
+		count = 0; woken = 0;\
+	}\
+	class Timeout extends ScriptComponent {\
+		function update(dt) { ++count; waitFor(\"never\", 0); ++woken; }\
+		count = 0; woken = 0;\
+	}\
+	root <- Entity(\"root\");\
+	function add(type, enabled) {\
+		local e = root.addLastChild(Entity(\"\"));\
+		e.enabled = enabled;\
+		return e.addComponent(type);\
+	}\
+	function sum(type, field) {\
+		local sum = 0;\
+		for(local e=root.firstChild; e; e=e.nextSibling) foreach(c in e.components) if(c instanceof type) sum += c[field];\
+		return sum;\
+	}";
+
+}	// namespace
+
+TEST(ScriptComponent_BindingTest)
+{
+	Entity::setCurrentRoot(nullptr);
+
+	Binding::VMCore vm;
+	Binding::registerCoreBinding(vm);
+	CHECK(vm.runScript(cScriptClasses));
+
+	CHECK(vm.runScript("\
+		for(local i=0; i<3; ++i) add(Mover, true);\
+		add(Mover, false);\
+		add(Idle, true);\
+		add(Sleeper, true);\
+		add(Sleeper, true);"
+	));
+
+	{	Binding::ScriptManagerComponent manager(&vm);
+		for(size_t i=0; i<5; ++i)
+			manager.updateScripts(0.5f);
+
+		// Only the enabled ones are updated, and the sleeping ones are skipped
+		CHECK(vm.runScript("if(sum(Mover, \"count\") != 15) throw \"Mover\";"));
+		CHECK(vm.runScript("if(sum(Sleeper, \"count\") != 2) throw \"Sleeper\";"));
+		CHECK(vm.runScript("if(::fabs(sum(Mover, \"x\") - 7.5) > 0.0001) throw \"dt\";"));
+
+		// Components added or destroyed in between
+		CHECK(vm.runScript("add(Mover, true); root.firstChild.destroyThis();"));
+		manager.updateScripts(0.5f);
+		CHECK(vm.runScript("if(sum(Mover, \"count\") != 13) throw \"Mover\";"));
+	}
+
+	CHECK(vm.runScript("root = null;"));
+}
+
+TEST(Wakeup_ScriptComponent_BindingTest)
+{
+	Entity::setCurrentRoot(nullptr);
+
+	Binding::VMCore vm;
+	Binding::registerCoreBinding(vm);
+	CHECK(vm.runScript(cScriptClasses));
+	CHECK(vm.runScript("for(local i=0; i<5; ++i) add(Waiter, true);"));
+
+	{	Binding::ScriptManagerComponent manager(&vm);
+		manager.updateScripts(0);
+		CHECK(vm.runScript("if(sum(Waiter, \"count\") != 5) throw \"Waiter\";"));
+
+		// Not signaled yet
+		CHECK(!manager.wakeup());
+		CHECK_EQUAL(0u, manager.signal("stop"));
+		CHECK(vm.runScript("if(sum(Waiter, \"woken\") != 0) throw \"Waiter\";"));
+
+		// The burst is spread by the limit
+		manager.wakeupLimit = 2;
+		CHECK_EQUAL(5u, manager.signal("go"));
+		CHECK(manager.wakeup());
+		CHECK(vm.runScript("if(sum(Waiter, \"woken\") != 2) throw \"Waiter\";"));
+		CHECK(manager.wakeup());
+		CHECK(!manager.wakeup());
+		CHECK(vm.runScript("if(sum(Waiter, \"woken\") != 5) throw \"Waiter\";"));
+
+		// Waiting again, and destroyed before the signal
+		manager.updateScripts(0);
+		CHECK(vm.runScript("root.firstChild.destroyThis();"));
+		CHECK_EQUAL(4u, manager.signal("go"));
+		CHECK(manager.wakeup());
+		CHECK(manager.wakeup());
+		CHECK(!manager.wakeup());
+		CHECK(vm.runScript("if(sum(Waiter, \"woken\") != 8) throw \"Waiter\";"));
+
+		// Time out, without the signal
+		manager.wakeupLimit = 0;
+		CHECK(vm.runScript("add(Timeout, true);"));
+		manager.updateScripts(0);
+		mSleep(2);	// Longer than the resolution of the schedule
+		CHECK(!manager.wakeup());
+		CHECK(vm.runScript("if(sum(Timeout, \"woken\") != 1) throw \"Timeout\";"));
+		CHECK(vm.runScript("if(sum(Waiter, \"woken\") != 8) throw \"Waiter\";"));
+	}
+
+	CHECK(vm.runScript("root = null;"));
+}
+
+//! The batched updateScripts() versus calling ScriptComponent::update() one by one
+TEST(BenchmarkScriptComponent_BindingTest)
+{
+	const size_t componentCount = 10000, frameCount = 20;
+	Entity::setCurrentRoot(nullptr);
+
+	Binding::VMCore vm;
+	Binding::registerCoreBinding(vm);
+	CHECK(vm.runScript(cScriptClasses));
+	CHECK(vm.runScript("for(local i=0; i<10000; ++i) add(Mover, true);"));
+
+	ComponentRegistry& registry = vm.scriptComponents();
+	CHECK_EQUAL(componentCount, registry.size());
+
+	double unbatched;
+	{	Timer timer;
+		for(size_t i=0; i<frameCount; ++i) {
+			for(ComponentRegistry::Iterator itr(registry, nullptr); !itr.ended(); itr.next())
+				static_cast<BehaviourComponent*>(itr.current())->update(0.1f);
+		}
+		unbatched = timer.get().asSecond() * 1000 / frameCount;
+	}
+
+	double batched;
+	{	Binding::ScriptManagerComponent manager(&vm);
+		Timer timer;
+		for(size_t i=0; i<frameCount; ++i)
+			manager.updateScripts(0.1f);
+		batched = timer.get().asSecond() * 1000 / frameCount;
+	}
+
+	CHECK(vm.runScript("if(sum(Mover, \"count\") != 10000 * 40) throw \"Mover\";"));
+
+	std::cout << "ScriptComponent::update() one by one: " << unbatched << "ms per frame" << std::endl;
+	std::cout << "ScriptManagerComponent::updateScripts(): " << batched << "ms per frame, "
+		<< unbatched / batched << "x" << std::endl;
+
+	CHECK(vm.runScript("root = null;"));
+}
@@ -2,7 +2,10 @@
 #include "../../../MCD/Core/Binding/CoreBindings.h"
 #include "../../../MCD/Core/Binding/VMCore.h"
 #include "../../../MCD/Core/System/RawFileSystem.h"
+#include "../../../MCD/Core/System/Timer.h"
 #include <fstream>
+#include <sstream>
+#include <stdio.h>	// For remove()
 
 using namespace MCD;
 
@@ -42,3 +45,160 @@ TEST(StrLen_BindingTest)
 	Binding::VMCore vm;
 	CHECK(vm.runScript("local a=0;~!@#$%", 10));
 }
+
+namespace {
+
+const char* cByteCodeCacheDirectory = "ByteCodeCache";
+
+//! A script of some classes and functions, distinguished by the id
+std::string generateScript(size_t id, size_t functionCount)
+{
+	std::ostringstream ss;
+	for(size_t i=0; i<functionCount; ++i) {
+		ss	<< "class Class" << id << "_" << i << " {\n"
+			<< "\tconstructor(a) { x = a; y = a * 2; }\n"
+			<< "\tfunction sum(n) { local s = 0; for(local j=0; j<n; ++j) s += x * j + y; return s; }\n"
+			<< "\tfunction name() { return \"Class" << id << "_" << i << "\" + x; }\n"
+			<< "\tx = 0; y = 0;\n"
+			<< "}\n"
+			<< "function func" << id << "_" << i << "(a, b) {\n"
+			<< "\tlocal t = { a = a, b = b, c = [a, b, a + b] };\n"
+			<< "\tif(a > b) return t.c[2] - b; else return Class" << id << "_" << i << "(a).sum(b);\n"
+			<< "}\n";
+	}
+	ss << "result <- func" << id << "_0(1, 2);\n";
+	return ss.str();
+}
+
+}	// namespace
+
+TEST(ByteCodeCache_BindingTest)
+{
+	RawFileSystem fs("./");
+	fs.makeDir(cByteCodeCacheDirectory);
+
+	const std::string script1 = generateScript(1, 2);
+	std::string script2 = script1;
+	script2.replace(script2.find("a * 2"), 5, "a * 3");
+
+	const char* name1 = "script1.nut";
+	const char* name2 = "script2.nut";
+
+	Binding::VMCore vm1;
+	CHECK(!vm1.setByteCodeCache("NonExistingDirectory"));
+	CHECK(vm1.byteCodeCache().getString().empty());
+	CHECK(vm1.setByteCodeCache(cByteCodeCacheDirectory));
+	const Path file1 = vm1.byteCodeCacheFile(script1.c_str(), -1, name1);
+	const Path file2 = vm1.byteCodeCacheFile(script2.c_str(), -1, name2);
+	CHECK(file1 != file2);
+	CHECK(vm1.byteCodeCacheFile(script1.c_str()).getString().empty());
+	::remove(file1.c_str());
+	::remove(file2.c_str());
+
+	{	// Compiled, and written to the cache
+		std::istringstream is(script1);
+		CHECK(vm1.runScript(is, -1, false, false, name1));
+		CHECK_EQUAL(1u, vm1.byteCodeCacheStats().missCount);
+		CHECK(fs.isExists(file1));
+	}
+
+	{	// Another VM, read back from the cache
+		Binding::VMCore vm2;
+		CHECK(vm2.setByteCodeCache(cByteCodeCacheDirectory));
+		std::istringstream is(script1);
+		CHECK(vm2.runScript(is, -1, false, false, name1));
+		CHECK(vm2.runScript(script1.c_str(), -1, false, false, name1));
+		CHECK_EQUAL(2u, vm2.byteCodeCacheStats().hitCount);
+		CHECK_EQUAL(0u, vm2.byteCodeCacheStats().missCount);
+
+		// Unnamed scripts are compiled without touching the cache
+		CHECK(vm2.runScript("if(result != 5) throw \"result\";"));
+		CHECK(vm2.runScript("if(result != 5) throw \"result\";", -1, false, false, ""));
+		CHECK_EQUAL(2u, vm2.byteCodeCacheStats().hitCount);
+		CHECK_EQUAL(0u, vm2.byteCodeCacheStats().missCount);
+
+		// The changed source is compiled again
+		std::istringstream is2(script2);
+		CHECK(vm2.runScript(is2, -1, false, false, name2));
+		CHECK_EQUAL(1u, vm2.byteCodeCacheStats().missCount);
+		CHECK(fs.isExists(file2));
+		CHECK(vm2.runScript("if(Class1_0(1).y != 3) throw \"changed\";"));
+	}
+
+	{	// A corrupted cache file is recompiled and rewritten
+		{	std::auto_ptr<std::ostream> os = fs.openWrite(file1);
+			*os << "garbage";
+		}
+		Binding::VMCore vm3;
+		CHECK(vm3.setByteCodeCache(cByteCodeCacheDirectory));
+		CHECK(vm3.runScript(script1.c_str(), -1, false, false, name1));
+		CHECK_EQUAL(1u, vm3.byteCodeCacheStats().missCount);
+		CHECK_EQUAL(0u, vm3.byteCodeCacheStats().writeFailCount);
+		CHECK(vm3.runScript(script1.c_str(), -1, false, false, name1));
+		CHECK_EQUAL(1u, vm3.byteCodeCacheStats().hitCount);
+	}
+
+	{	// Compile error is not cached
+		Binding::VMCore vm4;
+		CHECK(vm4.setByteCodeCache(cByteCodeCacheDirectory));
+		CHECK(!vm4.runScript("local a = ;", -1, false, false, "error.nut"));
+		CHECK_EQUAL(1u, vm4.byteCodeCacheStats().missCount);
+		CHECK(!fs.isExists(vm4.byteCodeCacheFile("local a = ;", -1, "error.nut")));
+	}
+
+	::remove(file1.c_str());
+	::remove(file2.c_str());
+	fs.remove(cByteCodeCacheDirectory);
+}
+
+//! Startup of a project with a few hundred script files, with a cold and a warm cache.
+TEST(BenchmarkByteCodeCache_BindingTest)
+{
+	const size_t fileCount = 300;
+	RawFileSystem fs("./");
+	fs.makeDir(cByteCodeCacheDirectory);
+
+	std::vector<std::string> fileNames(fileCount);
+	for(size_t i=0; i<fileCount; ++i) {
+		std::ostringstream ss;
+		ss << cByteCodeCacheDirectory << "/script" << i << ".nut";
+		fileNames[i] = ss.str();
+		std::auto_ptr<std::ostream> os = fs.openWrite(fileNames[i]);
+		*os << generateScript(i, 10);
+	}
+
+	double times[3];
+	std::vector<Path> cacheFiles(fileCount);
+	for(size_t pass=0; pass<3; ++pass) {
+		Binding::VMCore vm;
+		if(pass > 0)
+			CHECK(vm.setByteCodeCache(cByteCodeCacheDirectory));
+
+		Timer timer;
+		for(size_t i=0; i<fileCount; ++i) {
+			std::auto_ptr<std::istream> is = fs.openRead(fileNames[i]);
+			CHECK(vm.runScript(*is, -1, false, false, fileNames[i].c_str()));
+		}
+		times[pass] = timer.get().asSecond() * 1000;
+
+		if(pass == 1) {
+			CHECK_EQUAL(fileCount, vm.byteCodeCacheStats().missCount);
+			for(size_t i=0; i<fileCount; ++i) {
+				std::auto_ptr<std::istream> is = fs.openRead(fileNames[i]);
+				const std::string source((std::istreambuf_iterator<char>(*is)), std::istreambuf_iterator<char>());
+				cacheFiles[i] = vm.byteCodeCacheFile(source.c_str(), int(source.size()), fileNames[i].c_str());
+			}
+		}
+		if(pass == 2)
+			CHECK_EQUAL(fileCount, vm.byteCodeCacheStats().hitCount);
+	}
+
+	std::cout << "Loading " << fileCount << " scripts, without cache: " << times[0] << "ms, "
+		<< "cold cache: " << times[1] << "ms, warm cache: " << times[2] << "ms" << std::endl;
+
+	for(size_t i=0; i<fileCount; ++i) {
+		::remove(cacheFiles[i].c_str());
+		::remove(fs.toAbsolutePath(fileNames[i]).c_str());
+	}
+	fs.remove(cByteCodeCacheDirectory);
+}
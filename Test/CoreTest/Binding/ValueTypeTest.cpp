@@ -0,0 +1,210 @@
+#include "Pch.h"
+#include "../../../MCD/Core/Binding/CoreBindings.h"
+#include "../../../MCD/Core/Binding/Declarator.h"
+#include "../../../MCD/Core/Binding/VMCore.h"
+#include "../../../MCD/Core/Entity/Entity.h"
+#include "../../../MCD/Core/System/Timer.h"
+
+using namespace MCD;
+
+namespace {
+
+// Two identical small value types, which count their heap allocations
+template<int N>
+struct CountedVec
+{
+	CountedVec() : x(0), y(0), z(0) {}
+	CountedVec(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+
+	static void* operator new(size_t size) { ++allocCount; return ::operator new(size); }
+	static void operator delete(void* p) { ::operator delete(p); }
+
+	float x, y, z;
+	static size_t allocCount;
+};	// CountedVec
+
+template<int N> size_t CountedVec<N>::allocCount = 0;
+
+typedef CountedVec<0> BoxedVec;		// Returned with the objOwn policy
+typedef CountedVec<1> InlineVec;	// Returned with the inlineValue policy
+
+template<class T> T add(const T& lhs, const T& rhs) { return T(lhs.x + rhs.x, lhs.y + rhs.y, lhs.z + rhs.z); }
+template<class T> void scale(T& self, float s) { self.x *= s; self.y *= s; self.z *= s; }
+
+static SQInteger create_InlineVec(HSQUIRRELVM vm)
+{
+	using namespace Binding;
+	InlineVec v;
+	if(sq_gettop(vm) == 4)
+		v = InlineVec(get(TypeSelect<float>(), vm, 2), get(TypeSelect<float>(), vm, 3), get(TypeSelect<float>(), vm, 4));
+	sq_settop(vm, 1);
+	inlineValue::constructAt(vm, 1, v);
+	return 1;
+}
+
+}	// namespace
+
+namespace MCD {
+namespace Binding {
+
+SCRIPT_CLASS_DECLAR(BoxedVec);
+SCRIPT_CLASS_REGISTER(BoxedVec)
+	.declareClass<BoxedVec>("BoxedVec")
+	.constructor<float, float, float>()
+	.var("x", &BoxedVec::x)
+	.method("_add", &add<BoxedVec>)
+;}
+
+SCRIPT_CLASS_DECLAR(InlineVec);
+SCRIPT_CLASS_INLINE_VALUE(InlineVec);
+SCRIPT_CLASS_REGISTER(InlineVec)
+	.declareClass<InlineVec>("InlineVec")
+	.inlineStorage()
+	.rawMethod("constructor", &create_InlineVec)
+	.var("x", &InlineVec::x)
+	.method("_add", &add<InlineVec>)
+	.arrayMethod("scaleAll", &scale<InlineVec>)
+;}
+
+}	// namespace Binding
+}   // namespace MCD
+
+TEST(InlineValue_BindingTest)
+{
+	Binding::VMCore vm;
+	Binding::ClassTraits<BoxedVec>::bind(&vm);
+	Binding::ClassTraits<InlineVec>::bind(&vm);
+
+	BoxedVec::allocCount = 0;
+	CHECK(vm.runScript("local v = BoxedVec(1, 2, 3) + BoxedVec(1, 1, 1); if(v.x != 2) throw \"add\";"));
+	CHECK_EQUAL(3u, BoxedVec::allocCount);
+
+	// Neither the constructor nor the returned value allocate
+	InlineVec::allocCount = 0;
+	CHECK(vm.runScript("local v = InlineVec(1, 2, 3) + InlineVec(1, 1, 1); if(v.x != 2) throw \"add\";"));
+	CHECK_EQUAL(0u, InlineVec::allocCount);
+
+	// Cloning copies the value
+	CHECK(vm.runScript("local a = InlineVec(1, 2, 3); local b = clone a; b.x = 5; if(a.x != 1 || b.x != 5) throw \"clone\";"));
+	CHECK_EQUAL(0u, InlineVec::allocCount);
+
+	// A script sub-class has no inline storage, it falls back to the heap
+	CHECK(vm.runScript("class SubVec extends InlineVec { function twice() { return this + this; } }"));
+	CHECK(vm.runScript("local v = SubVec(1, 2, 3); local c = clone v; if(v.twice().x != 2 || c.x != 1) throw \"sub-class\";"));
+	CHECK_EQUAL(2u, InlineVec::allocCount);
+
+	// Batch call
+	CHECK(vm.runScript("local v = InlineVec(1, 0, 0); v.scaleAll([2, 3.0]); if(v.x != 6) throw \"scaleAll\";"));
+	CHECK(!vm.runScript("InlineVec().scaleAll([2, InlineVec()]);"));
+	CHECK(!vm.runScript("InlineVec().scaleAll(2);"));
+}
+
+TEST(CoreValueType_BindingTest)
+{
+	Entity root;	// Out live the VM
+	Entity* parent = root.addFirstChild("parent");
+	Binding::VMCore vm;
+	Binding::registerCoreBinding(vm);
+
+	CHECK(vm.runScript("local v = Vec3(1, 2, 3) + Vec3(1); if(!v.isEqual(Vec3(2, 3, 4))) throw \"Vec3\";"));
+	CHECK(vm.runScript("local v = clone Vec2(1, 2); if(v.x != 1 || v.y != 2) throw \"Vec2\";"));
+	CHECK(vm.runScript("local m = Mat44(1, 0, 0, 1, 0, 1, 0, 2, 0, 0, 1, 3, 0, 0, 0, 1); if(!m.translation.isEqual(Vec3(1, 2, 3))) throw \"Mat44\";"));
+
+	// Transform an array of points in place
+	CHECK(vm.runScript("\
+		local m = Mat44(); m.translation = Vec3(1, 2, 3);\
+		local p = [Vec3(0, 0, 0), Vec3(1, 1, 1)]; local n = [Vec3(1, 1, 1)];\
+		m.transformPoints(p); m.transformNormals(n);\
+		if(!p[0].isEqual(Vec3(1, 2, 3)) || !p[1].isEqual(Vec3(2, 3, 4)) || !n[0].isEqual(Vec3(1, 1, 1))) throw \"transform\";"
+	));
+
+	// Set the transforms of many entities in one call
+	CHECK(vm.runScript("\
+		function setTransforms(root) {\
+			local e = [root.addLastChild(\"e1\"), root.addLastChild(\"e2\")]; local t = [Mat44(), Mat44()];\
+			t[1].translation = Vec3(1, 2, 3);\
+			Entity.setLocalTransforms(e, t);\
+		}"));
+	CHECK(vm.runScript("function fail(root) { Entity.setLocalTransforms([root], []); }"));
+
+	HSQUIRRELVM v = vm.getVM();
+	sq_pushroottable(v);
+	sq_pushstring(v, "setTransforms", -1);
+	CHECK(SQ_SUCCEEDED(sq_get(v, -2)));
+	sq_pushroottable(v);
+	Binding::push(v, parent, parent);
+	CHECK(SQ_SUCCEEDED(sq_call(v, 2, false, true)));
+	sq_pop(v, 1);
+	CHECK(parent->lastChild()->localTransform.translation() == Vec3f(1, 2, 3));
+
+	sq_pushstring(v, "fail", -1);
+	CHECK(SQ_SUCCEEDED(sq_get(v, -2)));
+	sq_pushroottable(v);
+	Binding::push(v, parent, parent);
+	CHECK(SQ_FAILED(sq_call(v, 2, false, false)));
+	sq_settop(v, 0);
+}
+
+namespace {
+
+template<class T>
+bool benchmarkAdd(Binding::VMCore& vm, const char* className, size_t opCount, double& seconds)
+{
+	char buf[256];
+	sprintf(buf, "local a = %s(0, 0, 0), b = %s(1, 1, 1); for(local i=0; i<%d; ++i) a = a + b; if(a.x != %d) throw \"add\";",
+		className, className, int(opCount), int(opCount));
+
+	T::allocCount = 0;
+	Timer timer;
+	const bool ok = vm.runScript(buf);
+	seconds = timer.get().asSecond();
+	return ok;
+}
+
+}	// namespace
+
+//! 1M vector additions in script, the allocation count is the heap (and garbage) caused by the returned values
+TEST(BenchmarkValueType_BindingTest)
+{
+	const size_t opCount = 1000000;
+
+	Binding::VMCore vm;
+	Binding::registerCoreBinding(vm);
+	Binding::ClassTraits<BoxedVec>::bind(&vm);
+	Binding::ClassTraits<InlineVec>::bind(&vm);
+
+	double boxed = 0, inlined = 0;
+	CHECK(benchmarkAdd<BoxedVec>(vm, "BoxedVec", opCount, boxed));
+	const size_t boxedAlloc = BoxedVec::allocCount;
+	CHECK(benchmarkAdd<InlineVec>(vm, "InlineVec", opCount, inlined));
+	const size_t inlineAlloc = InlineVec::allocCount;
+
+	Timer timer;
+	CHECK(vm.runScript("local a = Vec3(0), b = Vec3(1); for(local i=0; i<1000000; ++i) a = a + b; if(a.x != 1000000) throw \"add\";"));
+	const double vec3 = timer.get().asSecond();
+
+	CHECK_EQUAL(opCount + 2, boxedAlloc);
+	CHECK_EQUAL(0u, inlineAlloc);
+
+	std::cout << opCount << " script vector additions, objOwn: " << boxed * 1000 << "ms with " << boxedAlloc << " heap objects, "
+		<< "inlineValue: " << inlined * 1000 << "ms with " << inlineAlloc << " heap objects, "
+		<< "Vec3: " << vec3 * 1000 << "ms" << std::endl;
+
+	// Setting the transforms of entities one by one, compared to a single batch call
+	CHECK(vm.runScript("\
+		root <- Entity(\"root\"); entities <- []; transforms <- [];\
+		for(local i=0; i<10000; ++i) { entities.append(root.addLastChild(\"e\")); transforms.append(Mat44()); }"));
+
+	timer.reset();
+	CHECK(vm.runScript("for(local j=0; j<10; ++j) foreach(i, e in entities) e.localTransform = transforms[i];"));
+	const double oneByOne = timer.get().asSecond();
+
+	timer.reset();
+	CHECK(vm.runScript("for(local j=0; j<10; ++j) Entity.setLocalTransforms(entities, transforms);"));
+	const double batch = timer.get().asSecond();
+
+	CHECK(vm.runScript("entities = null; root = null;"));
+
+	std::cout << "Setting 100k Entity.localTransform one by one: " << oneByOne * 1000 << "ms, "
+		<< "by Entity.setLocalTransforms(): " << batch * 1000 << "ms" << std::endl;
+}
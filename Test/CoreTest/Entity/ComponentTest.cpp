@@ -1,6 +1,10 @@
 #include "Pch.h"
 #include "../../../MCD/Core/Entity/Component.h"
 #include "../../../MCD/Core/Entity/Entity.h"
+#include "../../../MCD/Core/Entity/BehaviourComponent.h"
+#include "../../../MCD/Core/System/Atomic.h"
+#include "../../../MCD/Core/System/Thread.h"
+#include "../../../MCD/Core/System/Timer.h"
 
 using namespace MCD;
 
@@ -207,3 +211,241 @@ TEST(ComponentPreorderIterator_ComponentTest)
 		CHECK_EQUAL(1u, i);
 	}
 }
+
+namespace {
+
+class CounterComponent : public BehaviourComponent
+{
+public:
+	CounterComponent() : count(0), destroyOnUpdate(nullptr) {}
+
+	sal_override void update(float dt)
+	{
+		++count;
+		if(destroyOnUpdate) {
+			Entity* e = destroyOnUpdate;
+			destroyOnUpdate = nullptr;
+			e->destroyThis();
+		}
+	}
+
+	size_t count;
+	Entity* destroyOnUpdate;
+};	// CounterComponent
+
+class TestUpdaterComponent : public BehaviourUpdaterComponent
+{
+public:
+	void update(float dt) { end(dt); }
+};	// TestUpdaterComponent
+
+}	// namespace
+
+TEST(Registry_ComponentTest)
+{
+	Entity root;
+	Entity* oldRoot = Entity::currentRoot();
+	Entity::setCurrentRoot(&root);
+	TestUpdaterComponent updater;
+
+	Entity* e1 = root.addFirstChild("e1");
+	Entity* e2 = e1->addFirstChild("e2");
+	Entity* e3 = root.addFirstChild("e3");
+
+	CounterComponent* c1 = e1->addComponent(new CounterComponent);
+	CounterComponent* c2 = e2->addComponent(new CounterComponent);
+	CounterComponent* c3 = e3->addComponent(new CounterComponent);
+
+	updater.update(0);
+	CHECK_EQUAL(1u, c1->count);
+	CHECK_EQUAL(1u, c2->count);
+	CHECK_EQUAL(1u, c3->count);
+
+	// The disabled parent also disables its children
+	e1->enabled = false;
+	updater.update(0);
+	CHECK_EQUAL(1u, c1->count);
+	CHECK_EQUAL(1u, c2->count);
+	CHECK_EQUAL(2u, c3->count);
+	e1->enabled = true;
+
+	// Not in the tree of the current root
+	Entity outside;
+	CounterComponent* c4 = outside.addComponent(new CounterComponent);
+	updater.update(0);
+	CHECK_EQUAL(0u, c4->count);
+	CHECK_EQUAL(2u, c1->count);
+
+	// Iterating a sub-tree
+	size_t subTreeCount = 0;
+	for(ComponentRegistry::Iterator itr(*c1->registry(), e1); !itr.ended(); itr.next()) {
+		CHECK(itr.current() == c1 || itr.current() == c2);
+		++subTreeCount;
+	}
+	CHECK_EQUAL(2u, subTreeCount);
+
+	// Destroying a not yet updated Entity, and the Entity being updated, during the update
+	c1->destroyOnUpdate = e3;
+	c2->destroyOnUpdate = e1;
+	updater.update(0);
+	CHECK(!root.firstChild());
+
+	// Any tree is accepted without a current root
+	Entity::setCurrentRoot(nullptr);
+	updater.update(0);
+	CHECK_EQUAL(1u, c4->count);
+
+	// Removing the Component unlists it
+	ComponentRegistry* registry = c4->registry();
+	const size_t size = registry->size();
+	outside.removeComponent(typeid(BehaviourComponent));
+	CHECK_EQUAL(size - 1, registry->size());
+
+	Entity::setCurrentRoot(oldRoot);
+}
+
+TEST(RegistryOrder_ComponentTest)
+{
+	Entity root;
+	Entity* e1 = root.addLastChild("e1");
+	Entity* e2 = root.addLastChild("e2");
+	Entity* e3 = root.addLastChild("e3");
+
+	// Listed in the order of adding, not the order of the tree
+	CounterComponent* c3 = e3->addComponent(new CounterComponent);
+	CounterComponent* c1 = e1->addComponent(new CounterComponent);
+	CounterComponent* c2 = e2->addComponent(new CounterComponent);
+	ComponentRegistry& registry = *c1->registry();
+
+	{	Component* expected[] = { c3, c1, c2 };
+		size_t i = 0;
+		for(ComponentRegistry::Iterator itr(registry, &root); !itr.ended(); itr.next(), ++i)
+			CHECK(i < 3 && itr.current() == expected[i]);
+		CHECK_EQUAL(3u, i);
+	}
+
+	// Removal keeps the order of the others
+	e1->removeComponent(typeid(BehaviourComponent));
+	CounterComponent* c4 = e1->addComponent(new CounterComponent);
+
+	{	Component* expected[] = { c3, c2, c4 };
+		size_t i = 0;
+		for(ComponentRegistry::Iterator itr(registry, &root); !itr.ended(); itr.next(), ++i)
+			CHECK(i < 3 && itr.current() == expected[i]);
+		CHECK_EQUAL(3u, i);
+	}
+}
+
+namespace {
+
+//! Builds and destroys Entity trees in the background, like a resource loader does.
+class TreeBuilder : public Thread::IRunnable
+{
+public:
+	TreeBuilder() : updated(0), done(false) {}
+
+	sal_override void run(Thread&)
+	{
+		for(size_t i=0; i<50; ++i) {
+			Entity root;
+			std::vector<CounterComponent*> counters;
+			for(size_t j=0; j<100; ++j)
+				counters.push_back(root.addLastChild("e")->addComponent(new CounterComponent));
+			for(size_t j=0; j<counters.size(); ++j)
+				updated += counters[j]->count;
+		}
+		done = true;
+	}
+
+	size_t updated;
+	AtomicValue<bool> done;
+};	// TreeBuilder
+
+}	// namespace
+
+TEST(RegistryThread_ComponentTest)
+{
+	Entity root;
+	Entity* oldRoot = Entity::currentRoot();
+	Entity::setCurrentRoot(&root);
+	TestUpdaterComponent updater;
+
+	CounterComponent* c = root.addLastChild("e")->addComponent(new CounterComponent);
+
+	TreeBuilder builder;
+	Thread thread(builder, false);
+	size_t frame = 0;
+	while(!builder.done) {
+		updater.update(0);
+		++frame;
+	}
+	thread.wait();
+
+	// Components outside the current root are never updated
+	CHECK_EQUAL(0u, builder.updated);
+	CHECK_EQUAL(frame, c->count);
+
+	Entity::setCurrentRoot(oldRoot);
+}
+
+//! Frame overhead of updating 100k mostly idle entities, compared to gathering the Components by a tree traversal
+TEST(Benchmark_ComponentTest)
+{
+	const size_t entityCount = 100000, activeInterval = 100, frameCount = 100;
+
+	Entity root;
+	Entity* oldRoot = Entity::currentRoot();
+	Entity::setCurrentRoot(&root);
+
+	Entity* system = root.addFirstChild("System");
+	system->addComponent(new TestUpdaterComponent);
+
+	// Groups of 10 entities, with a BehaviourComponent every 100 entities
+	std::vector<CounterComponent*> counters;
+	Entity* group = nullptr;
+	for(size_t i=0; i<entityCount; ++i) {
+		if(i % 10 == 0)
+			group = root.addFirstChild(new Entity("Group"));
+		Entity* e = group->addFirstChild(new Entity("Idle"));
+		e->addComponent(new DummyComponent1);
+		if(i % activeInterval == 0)
+			counters.push_back(e->addComponent(new CounterComponent));
+	}
+
+	// What the frame loop did before, a traversal on the whole tree to gather the Components
+	Timer timer;
+	size_t gathered = 0;
+	for(size_t frame=0; frame<frameCount; ++frame) {
+		std::vector<BehaviourComponent*> components;
+		for(EntityPreorderIterator i(&root); !i.ended(); ) {
+			if(!i->enabled) {
+				i.skipChildren();
+				continue;
+			}
+			for(Component* c = i->components.begin(); c != i->components.end(); c = c->next())
+				if(c->familyType() == typeid(BehaviourComponent))
+					components.push_back(static_cast<BehaviourComponent*>(c));
+			i.next();
+		}
+		for(size_t j=0; j<components.size(); ++j)
+			components[j]->update(0);
+		gathered += components.size();
+	}
+	const double traversalMs = timer.get().asSecond() * 1000 / frameCount;
+
+	timer.reset();
+	for(size_t frame=0; frame<frameCount; ++frame) {
+		ComponentUpdater::traverseBegin(*system);
+		ComponentUpdater::traverseEnd(*system, 0);
+	}
+	const double registryMs = timer.get().asSecond() * 1000 / frameCount;
+
+	CHECK_EQUAL(entityCount / activeInterval * frameCount, gathered);
+	for(size_t i=0; i<counters.size(); ++i)
+		CHECK_EQUAL(frameCount * 2, counters[i]->count);
+
+	std::cout << "Frame overhead of " << entityCount << " entities, by tree traversal: " << traversalMs << "ms, "
+		<< "by ComponentRegistry: " << registryMs << "ms" << std::endl;
+
+	Entity::setCurrentRoot(oldRoot);
+}
@@ -4,6 +4,8 @@
 #include "../../../MCD/Core/Math/AnimationBlendTree.h"
 #include "../../../MCD/Core/System/ResourceManager.h"
 #include "../../../MCD/Core/System/RawFileSystem.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <sstream>
 
 using namespace MCD;
 
@@ -62,6 +64,7 @@ public:
 typedef AnimationBlendTree::ClipNode ClipNode;
 typedef AnimationBlendTree::LerpNode LerpNode;
 typedef AnimationBlendTree::SwitchNode SwitchNode;
+typedef AnimationBlendTree::FsmNode FsmNode;
 
 TEST_FIXTURE(AnimationBlendTreeTestFixture, Basic)
 {
@@ -156,4 +159,330 @@ TEST_FIXTURE(AnimationBlendTreeTestFixture, FSM)
 	CHECK(tree.loadFromXml(xml, mgr));
 	std::string s = tree.saveToXml();
 	(void)s;
-}
\ No newline at end of file
+}
+namespace {
+
+// Even tracks are linear positions, odd tracks are slerped rotations
+AnimationClipPtr createClip(const char* name, size_t trackCount, size_t keyCount, float phase)
+{
+	AnimationClipPtr clip = new AnimationClip(name);
+	std::vector<size_t> tmp(trackCount, keyCount);
+	MCD_VERIFY(clip->init(StrideArray<const size_t>(&tmp[0], trackCount)));
+	clip->framerate = 30;
+	clip->length = clip->framerate * (keyCount - 1);
+
+	for(size_t i=0; i<trackCount; ++i) {
+		AnimationClip::Keys keys = clip->getKeysForTrack(i);
+		clip->tracks[i].flag = (i % 2 == 0) ? AnimationClip::Linear : AnimationClip::Slerp;
+		for(size_t j=0; j<keys.size; ++j) {
+			const float v = float(i + j) + phase;
+			keys[j].pos = float(j) * clip->framerate;
+			if(i % 2 == 0)
+				keys[j].cast<Vec3f>() = Vec3f(v, v * 0.5f, -v);
+			else
+				keys[j].cast<Quaternionf>().fromAxisAngle(Vec3f(0, 1, 0), v * 0.1f);
+		}
+	}
+
+	return clip;
+}
+
+bool poseEqual(const AnimationBlendTree::Pose& a, const AnimationBlendTree::Pose& b)
+{
+	if(a.size != b.size)
+		return false;
+	for(size_t i=0; i<a.size; ++i) {
+		if(a[i].flag != b[i].flag || a[i].v.x != b[i].v.x || a[i].v.y != b[i].v.y || a[i].v.z != b[i].v.z || a[i].v.w != b[i].v.w)
+			return false;
+	}
+	return true;
+}
+
+void setTime(AnimationBlendTree& tree, float time)
+{
+	tree.referenceTime = 0;
+	tree.worldTime = time;
+}
+
+const char* cCompileTestXml = "\
+<switch name=\"root\" fadeDuration=\"0.5\" current=\"a\">\
+	<additive name=\"a\">\
+		<lerp t=\"0.25\">\
+			<clip src=\"clip3.clip\" />\
+			<clip rate=\"0.5\" src=\"clip4.clip\" />\
+		</lerp>\
+		<subtractive>\
+			<clip src=\"clip4.clip\" />\
+			<clip src=\"clip3.clip\" />\
+		</subtractive>\
+	</additive>\
+	<lerp name=\"b\" t=\"0\">\
+		<clip src=\"clip3.clip\" />\
+		<lerp name=\"bb\" t=\"1\">\
+			<clip src=\"clip3.clip\" />\
+			<clip src=\"clip4.clip\" duration=\"0.5\" />\
+		</lerp>\
+	</lerp>\
+	<clip name=\"c\" src=\"clip4.clip\" duration=\"0.5\" />\
+</switch>";
+
+const char* cCompileTestFsmXml = "\
+<fsm current=\"idle\">\
+	<transitions>\
+		<transition type=\"auto\" src=\"idle\" dest=\"walk\" duration=\"0.3\" />\
+		<transition type=\"auto\" src=\"walk\" dest=\"idle\" duration=\"0.2\" />\
+	</transitions>\
+	<clip name=\"idle\" src=\"clip3.clip\" duration=\"1\" />\
+	<lerp name=\"walk\" t=\"0.5\" duration=\"0.8\">\
+		<clip src=\"clip3.clip\" />\
+		<clip src=\"clip4.clip\" />\
+	</lerp>\
+</fsm>";
+
+}	// namespace
+
+TEST_FIXTURE(AnimationBlendTreeTestFixture, Compiled)
+{
+	ResourceManager mgr(*new RawFileSystem(""));
+	mgr.cache(createClip("clip3.clip", 6, 4, 0));
+	mgr.cache(createClip("clip4.clip", 6, 4, 0.5f));
+
+	{	// Switching and cross fading, with zero weight branches in the lerp nodes
+		AnimationBlendTree compiled;
+		CHECK(tree.loadFromXml(cCompileTestXml, mgr));
+		CHECK(compiled.loadFromXml(cCompileTestXml, mgr));
+		CHECK(compiled.compile());
+		CHECK(compiled.isCompiled());
+
+		SwitchNode& s1 = static_cast<SwitchNode&>(*tree.findNodeByName("root"));
+		SwitchNode& s2 = static_cast<SwitchNode&>(*compiled.findNodeByName("root"));
+
+		for(int i=0; i<40; ++i) {
+			const float time = i * 0.1f;
+			if(i == 10) {
+				s1.switchTo(tree.findNodeIndexByName("b"), time);
+				s2.switchTo(compiled.findNodeIndexByName("b"), time);
+			}
+			if(i == 20) {
+				s1.switchTo(tree.findNodeIndexByName("c"), time);
+				s2.switchTo(compiled.findNodeIndexByName("c"), time);
+			}
+			if(i == 22) {
+				static_cast<LerpNode&>(*tree.findNodeByName("bb")).t = 0.5f;
+				static_cast<LerpNode&>(*compiled.findNodeByName("bb")).t = 0.5f;
+			}
+
+			setTime(tree, time);
+			setTime(compiled, time);
+			AnimationBlendTree::Pose p1 = tree.getFinalPose();
+			AnimationBlendTree::Pose p2 = compiled.getFinalPose();
+			CHECK_EQUAL(6u, p2.size);
+			CHECK(poseEqual(p1, p2));
+		}
+
+		// The copy is compiled too
+		AnimationBlendTree copy(compiled);
+		CHECK(copy.isCompiled());
+		setTime(copy, 1.5f);
+		setTime(compiled, 1.5f);
+		CHECK(poseEqual(compiled.getFinalPose(), copy.getFinalPose()));
+
+		compiled.uncompile();
+		CHECK(!compiled.isCompiled());
+	}
+
+	{	// The state machine
+		AnimationBlendTree compiled;
+		CHECK(tree.loadFromXml(cCompileTestFsmXml, mgr));
+		CHECK(compiled.loadFromXml(cCompileTestFsmXml, mgr));
+		CHECK(compiled.compile());
+
+		for(int i=0; i<50; ++i) {
+			setTime(tree, i * 0.1f);
+			setTime(compiled, i * 0.1f);
+			AnimationBlendTree::Pose p1 = tree.getFinalPose();
+			AnimationBlendTree::Pose p2 = compiled.getFinalPose();
+			CHECK_EQUAL(6u, p2.size);
+			CHECK(poseEqual(p1, p2));
+		}
+	}
+
+	{	// Malformed tree, a lerp node with one child
+		AnimationBlendTree t;
+		ClipNode* n1 = new ClipNode;
+		n1->state.clip = clip1;
+		n1->parent = 1;
+		t.nodes.push_back(n1);
+		t.nodes.push_back(new LerpNode);
+		t.inOrderSort();
+		CHECK(!t.compile());
+		CHECK(!t.isCompiled());
+	}
+}
+
+TEST_FIXTURE(AnimationBlendTreeTestFixture, Binary)
+{
+	ResourceManager mgr(*new RawFileSystem(""));
+	mgr.cache(createClip("clip3.clip", 6, 4, 0));
+	mgr.cache(createClip("clip4.clip", 6, 4, 0.5f));
+
+	const char* xmls[] = { cCompileTestXml, cCompileTestFsmXml };
+	for(size_t i=0; i<MCD_COUNTOF(xmls); ++i) {
+		CHECK(tree.loadFromXml(xmls[i], mgr));
+
+		// The tree is compiled on the fly
+		std::stringstream ss;
+		CHECK(tree.saveToBinary(ss));
+		CHECK(!tree.isCompiled());
+
+		AnimationBlendTree loaded;
+		CHECK(loaded.loadFromBinary(ss, mgr));
+		CHECK(loaded.isCompiled());
+		CHECK_EQUAL(tree.saveToXml(), loaded.saveToXml());
+
+		for(int j=0; j<30; ++j) {
+			setTime(tree, j * 0.1f);
+			setTime(loaded, j * 0.1f);
+			CHECK(poseEqual(tree.getFinalPose(), loaded.getFinalPose()));
+		}
+
+		// Truncated or corrupted data
+		const std::string data = ss.str();
+		std::stringstream truncated(data.substr(0, data.size() / 2));
+		CHECK(!loaded.loadFromBinary(truncated, mgr));
+		CHECK(loaded.nodes.empty());
+
+		std::stringstream corrupted("MBT0" + data.substr(4));
+		CHECK(!loaded.loadFromBinary(corrupted, mgr));
+
+		// Written by a machine of the other byte order
+		std::string swapped = data;
+		std::swap(swapped[4], swapped[5]);
+		std::stringstream swappedStream(swapped);
+		CHECK(!loaded.loadFromBinary(swappedStream, mgr));
+		CHECK(loaded.nodes.empty());
+	}
+
+	{	// The current node of a switch is not its child
+		CHECK(tree.loadFromXml(cCompileTestXml, mgr));
+		static_cast<SwitchNode&>(*tree.findNodeByName("root")).switchTo(tree.findNodeIndexByName("bb"), 0);
+		std::stringstream ss;
+		CHECK(tree.saveToBinary(ss));
+		AnimationBlendTree loaded;
+		CHECK(!loaded.loadFromBinary(ss, mgr));
+	}
+
+	{	// The starting state and a transition of a fsm refer to a grand child
+		CHECK(tree.loadFromXml(cCompileTestFsmXml, mgr));
+		FsmNode& fsm = static_cast<FsmNode&>(tree.nodes.back());
+		const int grandChild = int(tree.findNodeIndexByName("walk")) - 1;
+
+		std::stringstream ss1;
+		const int starting = fsm.startingNode;
+		fsm.startingNode = grandChild;
+		CHECK(tree.saveToBinary(ss1));
+		AnimationBlendTree loaded;
+		CHECK(!loaded.loadFromBinary(ss1, mgr));
+
+		std::stringstream ss2;
+		fsm.startingNode = starting;
+		fsm.transitions[0].dest = grandChild;
+		CHECK(tree.saveToBinary(ss2));
+		CHECK(!loaded.loadFromBinary(ss2, mgr));
+	}
+}
+
+namespace {
+
+// Append a lerp sub-tree of the given depth, with some of the lerp parameters at 0 or 1
+void appendLerpTree(std::string& xml, size_t depth, size_t& counter)
+{
+	static const char* cClips[] = { "clip3.clip", "clip4.clip", "clip5.clip", "clip6.clip" };
+	static const char* cT[] = { "0.3", "1", "0.5", "0", "0.7" };
+	char buf[128];
+	const size_t i = counter++;
+
+	if(depth == 0) {
+		sprintf(buf, "<clip rate=\"%f\" src=\"%s\" />", 0.8f + 0.05f * (i % 8), cClips[i % MCD_COUNTOF(cClips)]);
+		xml += buf;
+		return;
+	}
+
+	sprintf(buf, "<lerp t=\"%s\">", cT[i % MCD_COUNTOF(cT)]);
+	xml += buf;
+	appendLerpTree(xml, depth - 1, counter);
+	appendLerpTree(xml, depth - 1, counter);
+	xml += "</lerp>";
+}
+
+}	// namespace
+
+//! 1000 characters with a tree of 31 nodes each, evaluated node by node and by the compiled instructions
+TEST_FIXTURE(AnimationBlendTreeTestFixture, Benchmark)
+{
+	const size_t characterCount = 1000, frameCount = 30, trackCount = 30;
+
+	ResourceManager mgr(*new RawFileSystem(""));
+	mgr.cache(createClip("clip3.clip", trackCount, 20, 0));
+	mgr.cache(createClip("clip4.clip", trackCount, 20, 0.25f));
+	mgr.cache(createClip("clip5.clip", trackCount, 20, 0.5f));
+	mgr.cache(createClip("clip6.clip", trackCount, 20, 0.75f));
+
+	// A switch node over two lerp sub-trees of 15 nodes
+	std::string xml = "<switch name=\"root\" fadeDuration=\"0.3\" current=\"a\">";
+	size_t counter = 0;
+	xml += "<lerp name=\"a\" t=\"0.5\">";
+	appendLerpTree(xml, 2, counter);
+	appendLerpTree(xml, 2, counter);
+	xml += "</lerp><lerp name=\"b\" t=\"0.4\">";
+	appendLerpTree(xml, 2, counter);
+	appendLerpTree(xml, 2, counter);
+	xml += "</lerp></switch>";
+
+	CHECK(tree.loadFromXml(xml.c_str(), mgr));
+	CHECK_EQUAL(31u, tree.nodes.size());
+
+	ptr_vector<AnimationBlendTree> recursive, compiled;
+	for(size_t i=0; i<characterCount; ++i) {
+		recursive.push_back(new AnimationBlendTree(tree));
+		compiled.push_back(new AnimationBlendTree(tree));
+		CHECK(compiled.back().compile());
+	}
+
+	const int b = tree.findNodeIndexByName("b");
+	double recursiveTime = 0, compiledTime = 0;
+	size_t mismatch = 0;
+
+	for(size_t frame=0; frame<frameCount; ++frame) {
+		const float time = frame / 30.0f;
+
+		// Half of the frames are cross fading
+		for(size_t i=0; frame == frameCount / 2 && i<characterCount; ++i) {
+			static_cast<SwitchNode&>(recursive[i].nodes.back()).switchTo(b, time);
+			static_cast<SwitchNode&>(compiled[i].nodes.back()).switchTo(b, time);
+		}
+
+		Timer timer;
+		for(size_t i=0; i<characterCount; ++i) {
+			setTime(recursive[i], time + i * 0.001f);
+			recursive[i].getFinalPose();
+		}
+		recursiveTime += timer.get().asSecond();
+
+		timer.reset();
+		for(size_t i=0; i<characterCount; ++i) {
+			setTime(compiled[i], time + i * 0.001f);
+			compiled[i].getFinalPose();
+		}
+		compiledTime += timer.get().asSecond();
+
+		for(size_t i=0; i<characterCount; ++i)
+			mismatch += poseEqual(recursive[i].getFinalPose(), compiled[i].getFinalPose()) ? 0 : 1;
+	}
+
+	CHECK_EQUAL(0u, mismatch);
+
+	std::cout << "AnimationBlendTree " << characterCount << " characters with " << tree.nodes.size() << " nodes, "
+		<< "node by node: " << recursiveTime * 1000 / frameCount << "ms, "
+		<< "compiled: " << compiledTime * 1000 / frameCount << "ms per frame" << std::endl;
+}
@@ -150,3 +150,41 @@ TEST(ProducerConsumer_CondVarTest)
 	CHECK(producer.mCount > 0);
 	CHECK(producer.mCount == consumer.mCount);
 }
+
+TEST(WaitSignal_CondVarTest)
+{
+	class Runnable : public Thread::IRunnable
+	{
+	public:
+		Runnable() : mFlag(false), mSignaled(false) {}
+		sal_override void run(Thread&)
+		{
+			ScopeLock lock(mCondVar);
+			mFlag = true;
+			mSignaled = mCondVar.waitNoLock(TimeInterval(10.0));
+		}
+		CondVar mCondVar;
+		bool mFlag, mSignaled;
+	};
+
+	{	// The timed wait returns true when signaled
+		Runnable runnable;
+		Thread thread(runnable, false);
+		while(true) {
+			ScopeLock lock(runnable.mCondVar);
+			if(runnable.mFlag) {
+				runnable.mCondVar.signalNoLock();
+				break;
+			}
+		}
+		thread.wait();
+		CHECK(runnable.mSignaled);
+	}
+
+	{	// The timeout is honored
+		CondVar condVar;
+		Timer timer;
+		CHECK(!condVar.wait(TimeInterval(0.05)));
+		CHECK(timer.get().asSecond() >= 0.04);
+	}
+}
@@ -0,0 +1,83 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/ContentHash.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+using namespace MCD;
+
+TEST(ContentHashTest)
+{
+	// Reference values of XXH64
+	CHECK(hashContent64("", 0) == 0xEF46DB3751D8E999ULL);
+	CHECK(hashContent64("a", 1) == 0xD24EC4F1A98C6E5BULL);
+	CHECK(hashContent64("abc", 3) == 0x44BC2CF5AD770999ULL);
+
+	// Every length of the tail and the 32 bytes loop
+	const std::string s(100, 'x');
+	std::vector<uint64_t> hashes;
+	for(size_t i=0; i<s.size(); ++i) {
+		hashes.push_back(hashContent64(s.c_str(), i));
+		CHECK(hashContent64(s.c_str(), i) == hashes.back());
+		CHECK(hashContent64(s.c_str(), i, 1) != hashes.back());
+	}
+	std::sort(hashes.begin(), hashes.end());
+	CHECK(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+}
+
+TEST(Index_ContentHashTest)
+{
+	ContentHashIndex index;
+	uint64_t hash = 0;
+
+	CHECK(!index.find("a.png", 10, 100, hash));
+	index.set("a.png", 123, 10, 100);
+	index.set("dir/with space.png", 0xFFFFFFFFFFFFFFFFULL, 20, 200);
+	CHECK_EQUAL(2u, index.size());
+
+	CHECK(index.find("a.png", 10, 100, hash));
+	CHECK(hash == 123);
+
+	// Modified file
+	CHECK(!index.find("a.png", 11, 100, hash));
+	CHECK(!index.find("a.png", 10, 101, hash));
+
+	{	// Save and load
+		std::stringstream ss;
+		CHECK(index.save(ss));
+
+		ContentHashIndex index2;
+		CHECK(index2.load(ss));
+		CHECK_EQUAL(2u, index2.size());
+		CHECK(index2.find("a.png", 10, 100, hash));
+		CHECK(hash == 123);
+		CHECK(index2.find("dir/with space.png", 20, 200, hash));
+		CHECK(hash == 0xFFFFFFFFFFFFFFFFULL);
+	}
+
+	{	// Invalid stream
+		std::stringstream ss("not an index");
+		ContentHashIndex index2;
+		CHECK(!index2.load(ss));
+		CHECK_EQUAL(0u, index2.size());
+	}
+
+	index.remove("a.png");
+	CHECK(!index.find("a.png", 10, 100, hash));
+	index.clear();
+	CHECK_EQUAL(0u, index.size());
+}
+
+TEST(Benchmark_ContentHashTest)
+{
+	const size_t cSize = 64 * 1024 * 1024;
+	std::vector<char> buf(cSize, 'x');
+
+	Timer timer;
+	const uint64_t hash = hashContent64(&buf[0], cSize);
+	const double t = timer.get().asSecond();
+	CHECK(hash != 0);
+
+	std::cout << "hashContent64: " << cSize / (1024 * 1024) << "MB in " << t * 1000 << "ms" << std::endl;
+}
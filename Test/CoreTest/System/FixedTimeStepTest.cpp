@@ -0,0 +1,64 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/FixedTimeStep.h"
+
+using namespace MCD;
+
+TEST(FixedTimeStepTest)
+{
+	// Use power of 2 fractions, so that the accumulation is exact
+	FixedTimeStep timeStep(1.0f / 32, 3);
+
+	// Four frames per step
+	for(size_t i=1; i<=12; ++i) {
+		const size_t steps = timeStep.advance(1.0f / 128);
+		CHECK_EQUAL(i % 4 == 0 ? 1u : 0u, steps);
+		CHECK_CLOSE(float(i % 4) / 4, timeStep.alpha(), 1e-6f);
+	}
+
+	// A long frame is limited to the budget, and the fraction is kept
+	CHECK_EQUAL(3u, timeStep.advance(1.0f + 1.0f / 64));
+	CHECK_CLOSE(0.5f, timeStep.alpha(), 1e-6f);
+	CHECK_CLOSE(1.0 - 3.0 / 32, timeStep.droppedTime(), 1e-6);
+
+	// Negative frame time is ignored
+	CHECK_EQUAL(0u, timeStep.advance(-1));
+	CHECK_CLOSE(0.5f, timeStep.alpha(), 1e-6f);
+
+	timeStep.reset();
+	CHECK_EQUAL(0.0f, timeStep.alpha());
+	CHECK_EQUAL(0.0, timeStep.droppedTime());
+
+	// Override the limit for a frame, maxSteps is unchanged
+	CHECK_EQUAL(1u, timeStep.advance(1.0f / 8, 1));
+	CHECK_EQUAL(3u, timeStep.maxSteps);
+	CHECK_CLOSE(3.0 / 32, timeStep.droppedTime(), 1e-6);
+	CHECK_EQUAL(2u, timeStep.advance(1.0f / 16));
+}
+
+TEST(Random_FixedTimeStepTest)
+{
+	FixedTimeStep timeStep(1.0f / 30, 4);
+
+	// A fixed seed linear congruential generator, such that the test is deterministic
+	unsigned seed = 1234;
+	double totalTime = 0;
+	size_t totalSteps = 0;
+
+	for(size_t i=0; i<10000; ++i) {
+		seed = seed * 1103515245u + 12345u;
+		// Frame time between 0 and 0.2 second, where the long frames exceed the budget
+		const float frameTime = float((seed >> 16) & 0x7FFF) / 0x7FFF * 0.2f;
+
+		const size_t steps = timeStep.advance(frameTime);
+		CHECK(steps <= timeStep.maxSteps);
+		CHECK(timeStep.alpha() >= 0 && timeStep.alpha() < 1);
+
+		totalTime += frameTime;
+		totalSteps += steps;
+	}
+
+	// Every bit of time is either simulated, dropped or still in the accumulator
+	const double accounted = totalSteps * timeStep.stepSize + timeStep.droppedTime() + timeStep.alpha() * timeStep.stepSize;
+	CHECK_CLOSE(totalTime, accounted, totalTime * 1e-4);
+	CHECK(timeStep.droppedTime() > 0);
+}
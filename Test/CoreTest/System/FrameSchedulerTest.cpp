@@ -0,0 +1,224 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/FrameScheduler.h"
+
+using namespace MCD;
+
+namespace {
+
+class FakeClock : public FrameScheduler::IClock
+{
+public:
+	FakeClock() : time(0) {}
+
+	sal_override double now() const { return time; }
+
+	double time;
+};	// FakeClock
+
+//! Work divided into units of fixed cost, which advance the fake clock.
+class UnitTask : public FrameScheduler::ITask
+{
+public:
+	UnitTask(FakeClock& clock, double unitCost)
+		: clock(clock), unitCost(unitCost), pending(0), done(0)
+	{}
+
+	sal_override bool run(double deadline)
+	{
+		// Always do at least one unit, like the real tasks which check the time after some work
+		do {
+			if(pending == 0)
+				return false;
+			clock.time += unitCost;
+			--pending;
+			++done;
+		} while(clock.time + unitCost <= deadline);
+
+		return pending > 0;
+	}
+
+	FakeClock& clock;
+	double unitCost;
+	size_t pending;
+	size_t done;
+};	// UnitTask
+
+//! A frame with an update before the tasks, and a render after them.
+void runFrame(FrameScheduler& scheduler, FakeClock& clock, double updateCost, double renderCost)
+{
+	scheduler.beginFrame();
+
+	scheduler.beginPhase(0);
+	clock.time += updateCost;
+	scheduler.endPhase(0);
+
+	scheduler.runTasks();
+
+	scheduler.beginPhase(1);
+	clock.time += renderCost;
+	scheduler.endPhase(1);
+
+	scheduler.endFrame();
+}
+
+}	// namespace
+
+TEST(Phase_FrameSchedulerTest)
+{
+	FakeClock clock;
+	FrameScheduler scheduler(0.02f, &clock);
+	CHECK_EQUAL(0u, scheduler.addPhase("Update"));
+	CHECK_EQUAL(1u, scheduler.addPhase("Render"));
+
+	runFrame(scheduler, clock, 0.004, 0.008);
+	CHECK_CLOSE(0.004f, scheduler.phaseStatistic(0).last, 1e-6f);
+	CHECK_CLOSE(0.004f, scheduler.phaseStatistic(0).average, 1e-6f);
+	CHECK_CLOSE(0.008f, scheduler.phaseStatistic(1).last, 1e-6f);
+	CHECK_CLOSE(0.012f, scheduler.frameStatistic().last, 1e-6f);
+
+	// The average follows the change, smoothly
+	scheduler.smoothing = 0.5f;
+	runFrame(scheduler, clock, 0.008, 0.008);
+	CHECK_CLOSE(0.008f, scheduler.phaseStatistic(0).last, 1e-6f);
+	CHECK_CLOSE(0.006f, scheduler.phaseStatistic(0).average, 1e-6f);
+	CHECK_CLOSE(0.008f, scheduler.phaseStatistic(0).max, 1e-6f);
+
+	// A phase run twice in a frame is summed
+	scheduler.beginFrame();
+	for(size_t i=0; i<2; ++i) {
+		scheduler.beginPhase(0);
+		clock.time += 0.003;
+		scheduler.endPhase(0);
+	}
+	scheduler.endFrame();
+	CHECK_CLOSE(0.006f, scheduler.phaseStatistic(0).last, 1e-6f);
+	CHECK_CLOSE(0.0f, scheduler.phaseStatistic(1).last, 1e-6f);
+
+	CHECK_EQUAL(3u, scheduler.frameStatistic().frameCount);
+	CHECK_EQUAL(0u, scheduler.frameStatistic().overBudgetCount);
+}
+
+// NOTE: The times are in multiple of 1/1024 second, so that the accumulation is exact
+TEST(Budget_FrameSchedulerTest)
+{
+	const double unit = 1.0 / 1024;
+	FakeClock clock;
+	FrameScheduler scheduler(float(32 * unit), &clock);
+	scheduler.addPhase("Update");
+	scheduler.addPhase("Render");
+
+	UnitTask task(clock, unit);
+	task.pending = 1000;
+	scheduler.addTask(task, "Commit");
+
+	// The first frame knows nothing about render, and overshoots
+	runFrame(scheduler, clock, 5 * unit, 8 * unit);
+	CHECK_EQUAL(27u, task.done);
+	CHECK_EQUAL(1u, scheduler.frameStatistic().overBudgetCount);
+
+	// Afterward the estimated render time is reserved, and the frames meet the target
+	for(size_t i=0; i<10; ++i) {
+		const size_t done = task.done;
+		runFrame(scheduler, clock, 5 * unit, 8 * unit);
+		CHECK_EQUAL(19u, task.done - done);
+	}
+	CHECK_EQUAL(1u, scheduler.frameStatistic().overBudgetCount);
+	CHECK_EQUAL(float(32 * unit), scheduler.frameStatistic().last);
+	CHECK_EQUAL(float(19 * unit), scheduler.taskStatistic(0).last);
+	CHECK_EQUAL(11u, scheduler.taskStatistic(0).pendingFrames);
+
+	// A longer target gives more to the task, spreading the work over less frames
+	scheduler.targetFrameTime = float(64 * unit);
+	{	const size_t done = task.done;
+		runFrame(scheduler, clock, 5 * unit, 8 * unit);
+		CHECK_EQUAL(51u, task.done - done);
+	}
+
+	// Nothing pending no longer counts
+	task.pending = 0;
+	runFrame(scheduler, clock, 5 * unit, 8 * unit);
+	CHECK_EQUAL(12u, scheduler.taskStatistic(0).pendingFrames);
+	CHECK_EQUAL(0.0f, scheduler.taskStatistic(0).last);
+}
+
+TEST(Priority_FrameSchedulerTest)
+{
+	const double unit = 1.0 / 1024;
+	FakeClock clock;
+	FrameScheduler scheduler(float(32 * unit), &clock);
+	scheduler.addPhase("Update");
+	scheduler.addPhase("Render");
+
+	UnitTask low(clock, unit), high(clock, unit), spare(clock, unit);
+	low.pending = high.pending = spare.pending = 1000;
+
+	// Added in the reverse order of priority
+	CHECK_EQUAL(0u, scheduler.addTask(spare, "Spare", 0, 0));
+	CHECK_EQUAL(1u, scheduler.addTask(low, "Low", 1, float(2 * unit)));
+	CHECK_EQUAL(2u, scheduler.addTask(high, "High", 2, float(2 * unit)));
+	CHECK_EQUAL(3u, scheduler.taskCount());
+
+	// Warm up the estimation of render
+	runFrame(scheduler, clock, 5 * unit, 8 * unit);
+
+	for(size_t i=0; i<10; ++i) {
+		const size_t highDone = high.done, lowDone = low.done, spareDone = spare.done;
+		runFrame(scheduler, clock, 5 * unit, 8 * unit);
+
+		// The high priority one takes all the spare time, the low one is not starved with its
+		// minimum budget, and the one without a minimum budget never runs
+		CHECK_EQUAL(19u, high.done - highDone);
+		CHECK_EQUAL(2u, low.done - lowDone);
+		CHECK_EQUAL(0u, spare.done - spareDone);
+	}
+	CHECK_EQUAL(11u, scheduler.taskStatistic(0).pendingFrames);
+
+	// In a heavy frame, the tasks still get their minimum budget
+	{	const size_t highDone = high.done, lowDone = low.done;
+		runFrame(scheduler, clock, 40 * unit, 8 * unit);
+		CHECK_EQUAL(2u, high.done - highDone);
+		CHECK_EQUAL(2u, low.done - lowDone);
+	}
+
+	// With the other work done, the spare time goes to the one without a minimum budget
+	high.pending = 0;
+	low.pending = 3;
+	{	const size_t spareDone = spare.done;
+		runFrame(scheduler, clock, 5 * unit, 8 * unit);
+		CHECK_EQUAL(0u, low.pending);
+		CHECK_EQUAL(16u, spare.done - spareDone);
+	}
+}
+
+//! Deferred work arriving in bursts is spread over frames, without pushing the frames over the target
+TEST(Burst_FrameSchedulerTest)
+{
+	FakeClock clock;
+	FrameScheduler scheduler(1.0f / 32, &clock);
+	scheduler.addPhase("Update");
+	scheduler.addPhase("Render");
+
+	UnitTask task(clock, 1.0 / 1024);
+	scheduler.addTask(task, "Commit", 0, 0);
+
+	// A fixed seed linear congruential generator, such that the test is deterministic
+	unsigned seed = 1234;
+	size_t total = 0;
+	runFrame(scheduler, clock, 1.0 / 128, 1.0 / 128);
+	scheduler.resetStatistic();
+
+	for(size_t i=0; i<200; ++i) {
+		seed = seed * 1103515245 + 12345;
+		if(i % 20 == 0) {
+			const size_t burst = 50 + (seed >> 16) % 50;
+			task.pending += burst;
+			total += burst;
+		}
+		runFrame(scheduler, clock, 1.0 / 128, 1.0 / 128);
+	}
+
+	CHECK_EQUAL(total, task.done);
+	CHECK_EQUAL(0u, scheduler.frameStatistic().overBudgetCount);
+	CHECK(scheduler.taskStatistic(0).pendingFrames > 0);
+	CHECK(scheduler.frameStatistic().max <= scheduler.targetFrameTime);
+}
@@ -1,6 +1,10 @@
 #include "Pch.h"
 #include "../../../MCD/Core/System/Log.h"
+#include "../../../MCD/Core/System/Thread.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <fstream>
 #include <memory>   // For auto_ptr
+#include <stdio.h>
 
 using namespace MCD;
 
@@ -40,3 +44,141 @@ TEST(LogTest)
 		Log::stop();
 	}
 }
+
+namespace {
+
+class LogSpamRunnable : public Thread::IRunnable
+{
+public:
+	sal_override void run(Thread&)
+	{
+		for(size_t i=0; i<count; ++i)
+			Log::format(Log::Info, "Thread %d message %d, %f", id, int(i), 1.5);
+	}
+
+	int id;
+	size_t count;
+};	// LogSpamRunnable
+
+size_t countLines(const std::string& str, const char* pattern)
+{
+	size_t count = 0;
+	for(size_t i=str.find(pattern); i != std::string::npos; i=str.find(pattern, i + 1))
+		++count;
+	return count;
+}
+
+// Returns the time used by the logging threads, until they return from Log::format()
+double spamLog(size_t threadCount, size_t messageCount)
+{
+	LogSpamRunnable runnables[4];
+	Thread threads[4];
+
+	Timer timer;
+	for(size_t i=0; i<threadCount; ++i) {
+		runnables[i].id = int(i);
+		runnables[i].count = messageCount;
+		threads[i].start(runnables[i], false);
+	}
+	for(size_t i=0; i<threadCount; ++i)
+		threads[i].wait();
+	return timer.get().asSecond();
+}
+
+}	// namespace
+
+TEST(Async_LogTest)
+{
+	{	// Messages from several threads, with time and thread id
+		std::stringstream* s(new std::stringstream);
+		Log::startAsync(s);
+
+		Log::write(Log::Warn, "Async log testing");
+		spamLog(3, 100);
+		Log::flush();
+
+		const std::string str = s->str();
+		CHECK(str.find("] Warn:  Async log testing\n") != std::string::npos);
+		CHECK_EQUAL(100u, countLines(str, "Info:  Thread 2 message"));
+		CHECK_EQUAL(301u, countLines(str, "\n"));
+
+		// Messages are in order within the same thread
+		CHECK(str.find("Thread 1 message 98,") < str.find("Thread 1 message 99,"));
+
+		Log::stop();
+	}
+
+	{	// Filtered by level
+		std::stringstream* s(new std::stringstream);
+		Log::startAsync(s);
+		Log::setLevel(Log::Error);
+		Log::write(Log::Info, "Filtered");
+		Log::format(Log::Error, "Not %s", "filtered");
+		Log::flush();
+		CHECK_EQUAL(std::string::npos, s->str().find("Filtered"));
+		CHECK(s->str().find("Error: Not filtered\n") != std::string::npos);
+		Log::setLevel(Log::Level(Log::Error | Log::Warn | Log::Info));
+		Log::stop();
+	}
+
+	{	// Long message is truncated
+		std::stringstream* s(new std::stringstream);
+		Log::startAsync(s);
+		Log::write(Log::Info, std::string(1000, 'a').c_str());
+		Log::stop(false);
+		CHECK(s->str().size() > 200u && s->str().size() < 300u);
+		delete s;
+	}
+
+	{	// A tiny queue, the messages either get written or discarded
+		std::stringstream* s(new std::stringstream);
+		Log::startAsync(s, 2, Log::Discard);
+		spamLog(2, 1000);
+		Log::flush();
+		CHECK_EQUAL(2000u, countLines(s->str(), "Info:  Thread") + Log::discardedCount());
+		Log::stop();
+	}
+
+	{	// Or the logging thread waits for the room
+		std::stringstream* s(new std::stringstream);
+		Log::startAsync(s, 2, Log::Wait);
+		spamLog(2, 1000);
+		Log::stop(false);
+		CHECK_EQUAL(2000u, countLines(s->str(), "Info:  Thread"));
+		delete s;
+	}
+
+	{	// The queues of the exited threads are reclaimed
+		std::stringstream* s(new std::stringstream);
+		Log::startAsync(s);
+		for(size_t i=0; i<50; ++i)
+			spamLog(2, 1);
+		Log::flush();
+		CHECK_EQUAL(100u, countLines(s->str(), "Info:  Thread"));
+		CHECK_EQUAL(0u, Log::queueCount());
+		Log::stop();
+	}
+}
+
+//! Time spent by 4 threads in Log::format(), writing to a file
+TEST(Benchmark_LogTest)
+{
+	const size_t threadCount = 4, messageCount = 20000;
+	const char* file = "LogBenchmark.txt";
+
+	Log::start(new std::ofstream(file));
+	const double sync = spamLog(threadCount, messageCount);
+	Log::stop();
+
+	Log::startAsync(new std::ofstream(file), 4096, Log::Wait);
+	Timer timer;
+	const double async = spamLog(threadCount, messageCount);
+	Log::flush();
+	const double asyncTotal = timer.get().asSecond();
+	Log::stop();
+
+	::remove(file);
+
+	std::cout << threadCount << " threads each logging " << messageCount << " messages, synchronous: " << sync * 1000 << "ms, "
+		<< "asynchronous: " << async * 1000 << "ms (" << asyncTotal * 1000 << "ms until written)" << std::endl;
+}
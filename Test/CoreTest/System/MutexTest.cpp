@@ -0,0 +1,287 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/Atomic.h"
+#include "../../../MCD/Core/System/CondVar.h"
+#include "../../../MCD/Core/System/Thread.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include "../../../MCD/Core/System/Utility.h"
+#include <string>
+#include <vector>
+
+using namespace MCD;
+
+TEST(Basic_MutexTest)
+{
+	const int spinCounts[] = { -1, 0, 200 };
+	for(size_t i=0; i<MCD_COUNTOF(spinCounts); ++i) {
+		Mutex mutex(spinCounts[i]);
+		CHECK(mutex.tryLock());
+		CHECK(!mutex.tryLock());
+		mutex.unlock();
+
+		mutex.lock();
+		CHECK(!mutex.tryLock());
+		mutex.unlock();
+		CHECK(mutex.tryLock());
+		mutex.unlock();
+	}
+}
+
+namespace {
+
+//! Increase a shared counter under the lock, all threads start together.
+class CounterRunnable : public Thread::IRunnable
+{
+public:
+	CounterRunnable() : mutex(nullptr), counter(nullptr), started(nullptr), threadCount(0), iteration(0) {}
+
+	sal_override void run(Thread&)
+	{
+		++(*started);
+		while(*started < threadCount)
+			mSleep(0);
+
+		for(size_t i=0; i<iteration; ++i) {
+			ScopeLock lock(*mutex);
+			++(*counter);
+		}
+	}
+
+	Mutex* mutex;
+	size_t* counter;
+	AtomicInteger* started;
+	int threadCount;
+	size_t iteration;
+};	// CounterRunnable
+
+//! Returns the number of milli-seconds used.
+double runCounter(Mutex& mutex, size_t threadCount, size_t iteration, size_t& counter)
+{
+	std::vector<CounterRunnable> runnables(threadCount);
+	std::vector<Thread*> threads(threadCount);
+	AtomicInteger started;
+
+	Timer timer;
+	for(size_t i=0; i<threadCount; ++i) {
+		runnables[i].mutex = &mutex;
+		runnables[i].counter = &counter;
+		runnables[i].started = &started;
+		runnables[i].threadCount = int(threadCount);
+		runnables[i].iteration = iteration;
+		threads[i] = new Thread(runnables[i], false);
+	}
+
+	for(size_t i=0; i<threadCount; ++i) {
+		threads[i]->wait();
+		delete threads[i];
+	}
+
+	return timer.get().asSecond() * 1000;
+}
+
+}	// namespace
+
+TEST(Contention_MutexTest)
+{
+	Mutex mutex;
+	size_t counter = 0;
+	runCounter(mutex, 8, 20000, counter);
+	CHECK_EQUAL(8u * 20000, counter);
+
+	// Sleep in the kernel right away
+	Mutex noSpin(-1);
+	counter = 0;
+	runCounter(noSpin, 8, 20000, counter);
+	CHECK_EQUAL(8u * 20000, counter);
+}
+
+namespace {
+
+struct Payload
+{
+	int a, b;
+};	// Payload
+
+class PublishRunnable : public Thread::IRunnable
+{
+public:
+	PublishRunnable() : mMismatch(0) {}
+
+	sal_override void run(Thread&)
+	{
+		Payload* p;
+		while((p = mPayload) == nullptr)
+			mSleep(0);
+		if(p->a != 1 || p->b != 2)
+			++mMismatch;
+	}
+
+	AtomicValue<Payload*> mPayload;
+	int mMismatch;
+};	// PublishRunnable
+
+}	// namespace
+
+TEST(AtomicValueTest)
+{
+#if MCD_LOCKFREE_ATOMICVALUE
+	CHECK(IsLockFreeAtomic<bool>::RET);
+	CHECK(IsLockFreeAtomic<int>::RET);
+	CHECK(IsLockFreeAtomic<float>::RET);
+	CHECK(IsLockFreeAtomic<Payload*>::RET);
+	CHECK_EQUAL(sizeof(int), sizeof(AtomicValue<int>));
+#endif
+	CHECK(!IsLockFreeAtomic<Payload>::RET);
+	CHECK(!IsLockFreeAtomic<std::string>::RET);
+
+	{	AtomicValue<int> i(1);
+		CHECK_EQUAL(1, i.get());
+		i = 2;
+		AtomicValue<int> j(i);
+		CHECK_EQUAL(2, int(j));
+	}
+
+	{	// Forced to use the Mutex
+		AtomicValue<int, int, false> i(1);
+		CHECK_EQUAL(1, i.get());
+		i = 2;
+		CHECK_EQUAL(2, int(i));
+	}
+
+	{	// The data written before set() is visible after get()
+		Payload payload = { 0, 0 };
+		PublishRunnable runnable;
+		Thread thread(runnable, false);
+		payload.a = 1;
+		payload.b = 2;
+		runnable.mPayload = &payload;
+		thread.wait();
+		CHECK_EQUAL(0, runnable.mMismatch);
+	}
+}
+
+namespace {
+
+template<class T>
+class ReadRunnable : public Thread::IRunnable
+{
+public:
+	ReadRunnable() : value(nullptr), iteration(0), sum(0) {}
+
+	sal_override void run(Thread&)
+	{
+		for(size_t i=0; i<iteration; ++i)
+			sum += value->get();
+	}
+
+	const T* value;
+	size_t iteration;
+	size_t sum;
+};	// ReadRunnable
+
+template<class T>
+double readAtomicValue(const T& value, size_t threadCount, size_t iteration)
+{
+	std::vector<ReadRunnable<T> > runnables(threadCount);
+	std::vector<Thread*> threads(threadCount);
+
+	Timer timer;
+	for(size_t i=0; i<threadCount; ++i) {
+		runnables[i].value = &value;
+		runnables[i].iteration = iteration;
+		threads[i] = new Thread(runnables[i], false);
+	}
+	for(size_t i=0; i<threadCount; ++i) {
+		threads[i]->wait();
+		delete threads[i];
+	}
+	return timer.get().asSecond() * 1000;
+}
+
+//! Consumers wait on the CondVar until the producer pushed an item.
+class ConsumerRunnable : public Thread::IRunnable
+{
+public:
+	ConsumerRunnable() : condVar(nullptr), queued(nullptr), remaining(nullptr) {}
+
+	sal_override void run(Thread&)
+	{
+		ScopeLock lock(*condVar);
+		while(true) {
+			while(*queued == 0 && *remaining > 0)
+				condVar->waitNoLock();
+			if(*remaining == 0)
+				break;
+			--(*queued);
+			--(*remaining);
+		}
+		condVar->broadcastNoLock();
+	}
+
+	CondVar* condVar;
+	size_t* queued;
+	size_t* remaining;
+};	// ConsumerRunnable
+
+double produceConsume(size_t consumerCount, size_t itemCount)
+{
+	CondVar condVar;
+	size_t queued = 0, remaining = itemCount;
+	std::vector<ConsumerRunnable> runnables(consumerCount);
+	std::vector<Thread*> threads(consumerCount);
+
+	Timer timer;
+	for(size_t i=0; i<consumerCount; ++i) {
+		runnables[i].condVar = &condVar;
+		runnables[i].queued = &queued;
+		runnables[i].remaining = &remaining;
+		threads[i] = new Thread(runnables[i], false);
+	}
+
+	for(size_t i=0; i<itemCount; ++i) {
+		ScopeLock lock(condVar);
+		++queued;
+		condVar.signalNoLock();
+	}
+
+	for(size_t i=0; i<consumerCount; ++i) {
+		threads[i]->wait();
+		delete threads[i];
+	}
+	return timer.get().asSecond() * 1000;
+}
+
+}	// namespace
+
+//! Lock contention, AtomicValue reads and CondVar notification, with 1 to 16 threads
+TEST(Benchmark_MutexTest)
+{
+	const size_t opCount = 400000;
+
+	for(size_t threadCount=1; threadCount<=16; threadCount*=2) {
+		Mutex spin, noSpin(-1);
+		size_t counter = 0;
+		const double spinMs = runCounter(spin, threadCount, opCount / threadCount, counter);
+		const double noSpinMs = runCounter(noSpin, threadCount, opCount / threadCount, counter);
+		CHECK_EQUAL(2 * (opCount / threadCount) * threadCount, counter);
+
+		AtomicValue<int> lockFree(1);
+		AtomicValue<int, int, false> locked(1);
+		const double lockFreeMs = readAtomicValue(lockFree, threadCount, opCount * 4 / threadCount);
+		const double lockedMs = readAtomicValue(locked, threadCount, opCount * 4 / threadCount);
+
+		const double condVarMs = produceConsume(threadCount, opCount / 4);
+
+		std::cout << threadCount << " threads, " << opCount << " lock/unlock with spin: " << spinMs << "ms, without spin: " << noSpinMs << "ms; "
+			<< opCount * 4 << " AtomicValue<int> reads, lock free: " << lockFreeMs << "ms, with Mutex: " << lockedMs << "ms; "
+			<< opCount / 4 << " CondVar items: " << condVarMs << "ms" << std::endl;
+	}
+
+	{	// Notifying a CondVar that nobody waits on
+		CondVar condVar;
+		ScopeLock lock(condVar);
+		Timer timer;
+		for(size_t i=0; i<opCount; ++i)
+			condVar.signalNoLock();
+		std::cout << opCount << " CondVar::signalNoLock() without waiter: " << timer.get().asSecond() * 1000 << "ms" << std::endl;
+	}
+}
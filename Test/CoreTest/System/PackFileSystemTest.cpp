@@ -0,0 +1,248 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/FileSystemCollection.h"
+#include "../../../MCD/Core/System/MemoryFileSystem.h"
+#include "../../../MCD/Core/System/PackFileSystem.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>	// For remove
+
+using namespace MCD;
+
+namespace {
+
+static const char* cPackFile = "PackFileSystemTest.pak";
+
+static std::string readAll(std::istream& is)
+{
+	std::string ret;
+	char c;
+	while(is.get(c))
+		ret += c;
+	return ret;
+}
+
+}	// namespace
+
+TEST(PackFileSystemTest)
+{
+	const std::string big(10000, 'x');	// Compress well
+
+	{	std::fstream os(cPackFile, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+		PackFileWriter writer(os);
+
+		CHECK(writer.add("a.txt", "Hello!", 6));
+		CHECK(writer.add("./folder/b.txt", "World", 5));
+		CHECK(writer.add("folder/sub/c.txt", "Hello!", 6));	// Same content as a.txt
+		CHECK(writer.add("big.txt", big.c_str(), big.size(), true));
+		CHECK(writer.add("empty.txt", nullptr, 0));
+
+		// Duplicated path
+		CHECK(!writer.add("folder/b.txt", "World", 5));
+
+		CHECK_EQUAL(5u, writer.entryCount());
+		CHECK_EQUAL(1u, writer.dedupCount());
+		CHECK_EQUAL(6u, writer.dedupBytes());
+		CHECK(writer.commit());
+		CHECK(!writer.commit());
+	}
+
+	// Non-existing pack file
+	CHECK(!PackFileSystem("__not_exist__.pak").isExists("a.txt"));
+
+	PackFileSystem fs(cPackFile);
+	CHECK_EQUAL(5u, fs.entryCount());
+
+	CHECK(fs.isExists("a.txt"));
+	CHECK(fs.isExists("./a.txt"));
+	CHECK(fs.isExists("folder/../a.txt"));
+	CHECK(fs.isExists("folder\\b.txt"));
+	CHECK(!fs.isExists("b.txt"));
+	CHECK(!fs.isExists("folder/a.txt"));
+
+	CHECK(fs.isDirectory("folder"));
+	CHECK(fs.isDirectory("folder/sub"));
+	CHECK(!fs.isDirectory("a.txt"));
+	CHECK(!fs.isDirectory("fold"));
+
+	CHECK_EQUAL(6u, fs.getSize("a.txt"));
+	CHECK_EQUAL(big.size(), fs.getSize("big.txt"));
+	CHECK_EQUAL(0u, fs.getSize("empty.txt"));
+
+	{	std::auto_ptr<std::istream> is = fs.openRead("folder/sub/c.txt");
+		CHECK(is.get() != nullptr);
+		CHECK_EQUAL(std::string("Hello!"), readAll(*is));
+	}
+
+	{	// The stream is seekable
+		std::auto_ptr<std::istream> is = fs.openRead("folder/b.txt");
+		is->seekg(0, std::ios_base::end);
+		CHECK_EQUAL(5, int(is->tellg()));
+		is->seekg(1, std::ios_base::beg);
+		CHECK_EQUAL(std::string("orld"), readAll(*is));
+	}
+
+	{	std::auto_ptr<std::istream> is = fs.openRead("big.txt");
+		CHECK(is.get() != nullptr);
+		CHECK(big == readAll(*is));
+	}
+
+	{	// The stream out lives the file system
+		std::auto_ptr<std::istream> is;
+		{	PackFileSystem tmp(cPackFile);
+			is = tmp.openRead("a.txt");
+		}
+		CHECK_EQUAL(std::string("Hello!"), readAll(*is));
+	}
+
+	CHECK(fs.openRead("b.txt").get() == nullptr);
+	CHECK(fs.openWrite("a.txt").get() == nullptr);
+
+	{	// Listing
+		void* c = fs.openFirstFileInFolder("folder");
+		CHECK_EQUAL(std::string("folder/b.txt"), fs.getNextFileInFolder(c).getString());
+		CHECK(fs.getNextFileInFolder(c).getString().empty());
+		fs.closeFirstFileInFolder(c);
+	}
+
+	CHECK_EQUAL(0, ::remove(cPackFile));
+}
+
+TEST(Dedup_PackFileSystemTest)
+{
+	const std::string big(10000, 'x');
+	std::string big2 = big;
+	big2[5000] = 'y';
+
+	{	std::fstream os(cPackFile, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+		PackFileWriter writer(os);
+		CHECK(writer.add("a.txt", big.c_str(), big.size(), true));
+		CHECK(writer.add("b.txt", big2.c_str(), big2.size(), true));
+		CHECK(writer.add("c.txt", big.c_str(), big.size(), true));	// Compared against the deflated a.txt
+		CHECK(writer.add("d.txt", big.c_str(), big.size()));
+		CHECK_EQUAL(2u, writer.dedupCount());
+		CHECK(writer.commit());
+	}
+
+	PackFileSystem fs(cPackFile);
+	const char* names[] = { "a.txt", "b.txt", "c.txt", "d.txt" };
+	for(size_t i=0; i<4; ++i) {
+		std::auto_ptr<std::istream> is = fs.openRead(names[i]);
+		CHECK(is.get() && readAll(*is) == (i == 1 ? big2 : big));
+	}
+
+	CHECK_EQUAL(0, ::remove(cPackFile));
+}
+
+//! Entries whose name lies outside the name table are ignored.
+TEST(CorruptedName_PackFileSystemTest)
+{
+	{	std::fstream os(cPackFile, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+		PackFileWriter writer(os);
+		CHECK(writer.add("folder/a.txt", "Hello!", 6));
+		CHECK(writer.commit());
+	}
+
+	{	// Patch the name offset of every used slot
+		std::fstream fs(cPackFile, std::ios::in | std::ios::out | std::ios::binary);
+		uint32_t slotCount = 0;
+		uint64_t directoryOffset = 0;
+		fs.seekg(12);
+		fs.read((char*)&slotCount, sizeof(slotCount));
+		fs.read((char*)&directoryOffset, sizeof(directoryOffset));
+
+		const size_t cEntrySize = 4 * sizeof(uint32_t) + 5 * sizeof(uint64_t);
+		for(uint32_t i=0; i<slotCount; ++i) {
+			const std::streamoff entry = std::streamoff(directoryOffset + i * cEntrySize);
+			uint32_t flags = 0;
+			fs.seekg(entry + 4);
+			fs.read((char*)&flags, sizeof(flags));
+			if(!flags)
+				continue;
+			const uint32_t nameOffset = 0xFFFFFF00;
+			fs.seekp(entry + 8);
+			fs.write((const char*)&nameOffset, sizeof(nameOffset));
+		}
+		CHECK(fs.good());
+	}
+
+	PackFileSystem fs(cPackFile);
+	CHECK_EQUAL(1u, fs.entryCount());
+	CHECK(!fs.isExists("folder/a.txt"));
+	CHECK(!fs.isDirectory("folder"));
+
+	void* c = fs.openFirstFileInFolder("folder");
+	CHECK(fs.getNextFileInFolder(c).getString().empty());
+	fs.closeFirstFileInFolder(c);
+
+	CHECK_EQUAL(0, ::remove(cPackFile));
+}
+
+TEST(Priority_PackFileSystemTest)
+{
+	{	std::fstream os(cPackFile, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+		PackFileWriter writer(os);
+		CHECK(writer.add("a.txt", "pack", 4));
+		CHECK(writer.commit());
+	}
+
+	static const char data[] = "memory";
+
+	{	// Without priority, the first added is searched first
+		FileSystemCollection fs;
+		MemoryFileSystem* memFs = new MemoryFileSystem("");
+		CHECK(memFs->add("a.txt", data, 6));
+		fs.addFileSystem(*memFs);
+		fs.addFileSystem(*new PackFileSystem(cPackFile));
+		CHECK_EQUAL(6u, fs.getSize("a.txt"));
+	}
+
+	{	// The pack file overrides the memory file system
+		FileSystemCollection fs;
+		MemoryFileSystem* memFs = new MemoryFileSystem("");
+		CHECK(memFs->add("a.txt", data, 6));
+		fs.addFileSystem(*memFs);
+		fs.addFileSystem(*new PackFileSystem(cPackFile), 1);
+		CHECK_EQUAL(4u, fs.getSize("a.txt"));
+
+		// Re-adding with a higher priority
+		fs.addFileSystem(*memFs, 2);
+		CHECK_EQUAL(6u, fs.getSize("a.txt"));
+	}
+
+	CHECK_EQUAL(0, ::remove(cPackFile));
+}
+
+TEST(Benchmark_PackFileSystemTest)
+{
+	const size_t cCount = 2000;
+
+	{	std::fstream os(cPackFile, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+		PackFileWriter writer(os);
+		for(size_t i=0; i<cCount; ++i) {
+			std::ostringstream ss;
+			ss << "folder" << (i % 10) << "/file" << i << ".txt";
+			CHECK(writer.add(ss.str(), ss.str().c_str(), ss.str().size()));
+		}
+		CHECK(writer.commit());
+	}
+
+	Timer timer;
+	PackFileSystem fs(cPackFile);
+	const double openTime = timer.get().asSecond();
+
+	timer.reset();
+	size_t found = 0;
+	for(size_t i=0; i<cCount; ++i) {
+		std::ostringstream ss;
+		ss << "folder" << (i % 10) << "/file" << i << ".txt";
+		std::auto_ptr<std::istream> is = fs.openRead(ss.str());
+		found += is.get() ? 1 : 0;
+	}
+	CHECK_EQUAL(cCount, found);
+
+	std::cout << "PackFileSystem: open " << openTime * 1000 << "ms, "
+		<< cCount << " lookups " << timer.get().asSecond() * 1000 << "ms" << std::endl;
+
+	CHECK_EQUAL(0, ::remove(cPackFile));
+}
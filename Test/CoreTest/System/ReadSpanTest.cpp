@@ -0,0 +1,221 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/FileSystemCollection.h"
+#include "../../../MCD/Core/System/MemoryMappedFile.h"
+#include "../../../MCD/Core/System/MemoryFileSystem.h"
+#include "../../../MCD/Core/System/PackFileSystem.h"
+#include "../../../MCD/Core/System/RawFileSystem.h"
+#include "../../../MCD/Core/System/ReadSpan.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>	// For remove
+#include <stdlib.h>	// For malloc
+#include <string.h>	// For memcmp
+#include <vector>
+
+#ifdef MCD_WIN
+#	include "../../../MCD/Core/System/PlatformInclude.h"
+#	include <psapi.h>
+#	pragma comment(lib, "psapi")
+#endif
+
+using namespace MCD;
+
+namespace {
+
+static const char* cRawFile = "ReadSpanTest.bin";
+static const char* cPackFile = "ReadSpanTest.pak";
+
+//! The memory of the process not backed by any file in bytes, zero if not supported.
+size_t privateMemory()
+{
+#if defined(MCD_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	if(::GetProcessMemoryInfo(::GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PagefileUsage;
+#elif defined(__linux__)
+	// Resident pages minus the file backed ones
+	size_t pages = 0, resident = 0, shared = 0;
+	if(FILE* f = ::fopen("/proc/self/statm", "r")) {
+		if(::fscanf(f, "%lu %lu %lu", &pages, &resident, &shared) != 3)
+			resident = shared = 0;
+		::fclose(f);
+	}
+	return (resident - shared) * MemoryMappedFile::pageSize();
+#endif
+	return 0;
+}
+
+}	// namespace
+
+TEST(ReadSpanTest)
+{
+	static const char data[] = "Hello world!";
+
+	{	// Span from a stream
+		std::istringstream ss(data);
+		ReadSpanPtr span = readSpanFromStream(ss);
+		CHECK_EQUAL(12u, span->size());
+		CHECK(memcmp(data, span->data(), span->size()) == 0);
+
+		// Ordinary stream has no span
+		CHECK(!getReadSpan(&ss));
+		CHECK(!getReadSpan(nullptr));
+	}
+
+	{	// Stream on a span
+		ReadSpanPtr span = new ReadSpan(data, 12);
+		std::auto_ptr<std::istream> is = createSpanStream(span);
+		CHECK(getReadSpan(is.get()) == span.get());
+
+		is->seekg(6, std::ios_base::beg);
+		std::string s;
+		*is >> s;
+		CHECK_EQUAL(std::string("world!"), s);
+
+		// The stream keeps the span alive
+		span = nullptr;
+		CHECK(getReadSpan(is.get())->data() == data);
+
+		CHECK(createSpanStream(nullptr).get() == nullptr);
+	}
+}
+
+TEST(FileSystem_ReadSpanTest)
+{
+	static const char data[] = "Hello world!";
+
+	{	// Memory file system gives the original memory
+		MemoryFileSystem fs("");
+		CHECK(fs.add("a.txt", data, 12));
+		ReadSpanPtr span = fs.openReadSpan("a.txt");
+		CHECK(span && span->data() == data);
+		CHECK(!fs.openReadSpan("b.txt"));
+
+		FileSystemCollection collection;
+		MemoryFileSystem* memFs = new MemoryFileSystem("");
+		CHECK(memFs->add("a.txt", data, 12));
+		collection.addFileSystem(*memFs);
+		span = collection.openReadSpan("a.txt");
+		CHECK(span && span->data() == data);
+	}
+
+	{	// Memory file system sharing the storage of a span
+		char* buffer = (char*)::malloc(12);
+		::memcpy(buffer, data, 12);
+		ReadSpanPtr storage = createOwnedReadSpan(buffer, 12);
+
+		ReadSpanPtr span;
+		std::auto_ptr<std::istream> is;
+		{	MemoryFileSystem fs("");
+			CHECK(fs.add("a.txt", storage));
+			CHECK(!fs.add("a.txt", storage));
+			storage = nullptr;
+			CHECK_EQUAL(12u, fs.getSize("a.txt"));
+			span = fs.openReadSpan("a.txt");
+			is = fs.openRead("a.txt");
+		}
+
+		// Both the span and the stream out live the file system
+		CHECK(span && span->data() == buffer);
+		std::string s;
+		*is >> s;
+		CHECK_EQUAL(std::string("Hello"), s);
+		CHECK(getReadSpan(is.get()) == span.get());
+	}
+
+	{	// Raw file system reads the file, or maps it if enabled
+		{	std::ofstream os(cRawFile, std::ios::out | std::ios::binary);
+			os.write(data, 12);
+		}
+
+		RawFileSystem fs("./");
+		CHECK(!fs.memoryMapping());
+		for(size_t i=0; i<2; ++i) {
+			fs.setMemoryMapping(i == 1);
+			ReadSpanPtr span = fs.openReadSpan(cRawFile);
+			CHECK(span && span->size() == 12);
+			CHECK(span && memcmp(data, span->data(), 12) == 0);
+			CHECK(!fs.openReadSpan("__not_exist__"));
+		}
+
+		// The span is gone, which unmaps the file before removing it
+		CHECK_EQUAL(0, ::remove(cRawFile));
+	}
+
+	{	// Pack file system, both stored and compressed entries
+		const std::string big(10000, 'x');
+		{	std::fstream os(cPackFile, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+			PackFileWriter writer(os);
+			CHECK(writer.add("a.txt", data, 12));
+			CHECK(writer.add("big.txt", big.c_str(), big.size(), true));
+			CHECK(writer.commit());
+		}
+
+		ReadSpanPtr a, b;
+		{	PackFileSystem fs(cPackFile);
+			a = fs.openReadSpan("a.txt");
+			b = fs.openReadSpan("big.txt");
+		}
+
+		// Spans out live the file system
+		CHECK(a && a->size() == 12 && memcmp(data, a->data(), 12) == 0);
+		CHECK(b && std::string(b->data(), b->size()) == big);
+
+		a = b = nullptr;
+		CHECK_EQUAL(0, ::remove(cPackFile));
+	}
+}
+
+TEST(Benchmark_ReadSpanTest)
+{
+	const size_t cSize = 32 * 1024 * 1024;
+
+	{	std::ofstream os(cRawFile, std::ios::out | std::ios::binary);
+		const std::string block(1024 * 1024, 'x');
+		for(size_t i=0; i<cSize / block.size(); ++i)
+			os.write(block.c_str(), block.size());
+	}
+
+	RawFileSystem fs("./");
+	fs.setMemoryMapping(true);	// Nobody modifies the file during the benchmark
+	size_t sum1 = 0, sum2 = 0;
+
+	// The private memory is sampled while the whole file is accessible, that's the peak of each method
+	const size_t baseMemory = privateMemory();
+	size_t streamMemory, spanMemory;
+
+	// Read through the stream into a buffer, as what a loader do
+	Timer timer;
+	{	std::auto_ptr<std::istream> is = fs.openRead(cRawFile);
+		std::vector<char> buf(cSize);
+		is->read(&buf[0], cSize);
+		for(size_t i=0; i<cSize; i+=4096)
+			sum1 += buf[i];
+		streamMemory = privateMemory();
+	}
+	const double streamTime = timer.get().asSecond();
+
+	// Directly on the mapped memory
+	const size_t baseMemory2 = privateMemory();
+	timer.reset();
+	{	ReadSpanPtr span = fs.openReadSpan(cRawFile);
+		for(size_t i=0; i<span->size(); i+=4096)
+			sum2 += span->data()[i];
+		spanMemory = privateMemory();
+	}
+	const double spanTime = timer.get().asSecond();
+
+	CHECK_EQUAL(sum1, sum2);
+
+	const long streamPeak = long(streamMemory - baseMemory) / 1024, spanPeak = long(spanMemory - baseMemory2) / 1024;
+	std::cout << "ReadSpan: " << cSize / (1024 * 1024) << "MB, stream " << streamTime * 1000
+		<< "ms (peak private memory +" << streamPeak << "KB), span " << spanTime * 1000
+		<< "ms (peak private memory +" << spanPeak << "KB)" << std::endl;
+
+	// The mapped pages are backed by the file, they don't count as the private memory
+	if(baseMemory > 0)
+		CHECK(spanPeak < streamPeak / 2);
+
+	CHECK_EQUAL(0, ::remove(cRawFile));
+}
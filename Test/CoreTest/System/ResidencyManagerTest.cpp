@@ -0,0 +1,239 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/MemoryFileSystem.h"
+#include "../../../MCD/Core/System/ResidencyManager.h"
+#include "../../../MCD/Core/System/Resource.h"
+#include "../../../MCD/Core/System/ResourceLoader.h"
+#include "../../../MCD/Core/System/ResourceManager.h"
+#include <sstream>
+
+using namespace MCD;
+
+namespace {
+
+class FakeLoader : public IResourceLoader
+{
+protected:
+	sal_override sal_checkreturn LoadingState load(
+		sal_maybenull std::istream* is, sal_maybenull const Path* fileId=nullptr, sal_maybenull const char* args=nullptr)
+	{
+		return is ? Loaded : Aborted;
+	}
+
+	sal_override void commit(Resource&) {}
+};	// FakeLoader
+
+//! Reports a memory size different from the file size, like a decoded texture.
+class DecodedResource : public Resource
+{
+public:
+	explicit DecodedResource(const Path& fileId) : Resource(fileId) {}
+
+	sal_override size_t memorySize() const { return 4 * 1000; }
+};	// DecodedResource
+
+class FakeFactory : public ResourceManager::IFactory
+{
+public:
+	sal_override ResourcePtr createResource(const Path& fileId, const char* args) {
+		if(fileId.getExtension() == "tile")
+			return new Resource(fileId);
+		if(fileId.getExtension() == "tex")
+			return new DecodedResource(fileId);
+		return nullptr;
+	}
+
+	sal_override IResourceLoaderPtr createLoader() {
+		return new FakeLoader;
+	}
+};	// FakeFactory
+
+static const size_t cTileCount = 64;
+static const size_t cTileSize = 1000;
+static const char cTileData[cTileSize] = { 0 };
+
+static Path tilePath(size_t i)
+{
+	std::ostringstream ss;
+	ss << "region/" << i << ".tile";
+	return ss.str();
+}
+
+static MemoryFileSystem* createTiles()
+{
+	MemoryFileSystem* fs = new MemoryFileSystem("");
+	for(size_t i=0; i<cTileCount; ++i)
+		MCD_VERIFY(fs->add(tilePath(i), cTileData, cTileSize));
+	MCD_VERIFY(fs->add("region/ground.tex", cTileData, cTileSize));
+	return fs;
+}
+
+//! No loader thread, all the loading are done inside popEvent()
+static void processLoad(ResourceManager& manager)
+{
+	manager.popEvent();
+	while(manager.popEvent()) {}
+}
+
+/*!	A camera moving one tile per frame, seeing 3 tiles at a time.
+	Returns the stall count.
+ */
+static size_t flyThrough(size_t prefetchAhead, ResidencyManager::Stats& stats)
+{
+	ResourceManager manager(*createTiles());
+	manager.addFactory(new FakeFactory);
+	ResidencyManager residency(manager, 8 * cTileSize);
+
+	const size_t cVisible = 3;
+
+	// Prepare the initial view
+	if(prefetchAhead > 0) {
+		for(size_t i=0; i<cVisible; ++i)
+			residency.prefetch(tilePath(i));
+		processLoad(manager);
+	}
+
+	for(size_t frame=0; frame + cVisible <= cTileCount; ++frame) {
+		const double time = frame / 60.0;
+
+		// Hint the tiles in front of the camera
+		std::vector<Path> ahead;
+		for(size_t i=frame + cVisible; i<frame + cVisible + prefetchAhead && i < cTileCount; ++i)
+			ahead.push_back(tilePath(i));
+		residency.prefetch(ahead, 1, time + prefetchAhead / 60.0);
+
+		{	// Render the visible tiles
+			std::vector<ResourcePtr> visible;
+			for(size_t i=frame; i<frame + cVisible; ++i)
+				visible.push_back(residency.acquire(tilePath(i)));
+		}
+
+		processLoad(manager);
+		residency.update(time);
+	}
+
+	stats = residency.stats();
+	return stats.stallCount;
+}
+
+}	// namespace
+
+TEST(ResidencyManagerTest)
+{
+	ResourceManager manager(*createTiles());
+	manager.addFactory(new FakeFactory);
+	ResidencyManager residency(manager, 2 * cTileSize);
+
+	// Prefetch
+	residency.prefetch(tilePath(0), 0, 1);
+	residency.prefetch(tilePath(0), 0, 1);	// Prefetch twice has no effect
+	CHECK(residency.isResident(tilePath(0)));
+	CHECK_EQUAL(1u, residency.stats().prefetchCount);
+
+	// Unknown resource type
+	CHECK(!residency.acquire("a.txt"));
+
+	// Deadline passed before loading
+	residency.update(2);
+	CHECK_EQUAL(1u, residency.stats().lateCount);
+
+	processLoad(manager);
+	residency.update(2);
+	CHECK_EQUAL(cTileSize, residency.stats().residentBytes);
+
+	// Acquire the prefetched resource
+	ResourcePtr r0 = residency.acquire(tilePath(0));
+	CHECK(r0 && r0->commitCount() > 0);
+	CHECK_EQUAL(1u, residency.stats().prefetchHit);
+	CHECK_EQUAL(0u, residency.stats().stallCount);
+
+	// Acquire a resource which is not loaded yet
+	CHECK(residency.acquire(tilePath(1)));
+	CHECK_EQUAL(1u, residency.stats().stallCount);
+	processLoad(manager);
+
+	// Exceed the budget, tile 0 is the least recently used but it's still referenced
+	residency.acquire(tilePath(2));
+	processLoad(manager);
+	residency.update(3);
+	CHECK(residency.isResident(tilePath(0)));
+	CHECK(!residency.isResident(tilePath(1)));
+	CHECK(residency.isResident(tilePath(2)));
+	CHECK_EQUAL(1u, residency.stats().evictionCount);
+	CHECK_EQUAL(cTileSize, residency.stats().evictedBytes);
+	CHECK_EQUAL(2 * cTileSize, residency.stats().residentBytes);
+
+	// Override the size
+	residency.setResourceSize(tilePath(2), 10);
+	CHECK_EQUAL(cTileSize + 10, residency.stats().residentBytes);
+
+	// Evict all unreferenced
+	residency.evictAll();
+	CHECK(residency.isResident(tilePath(0)));
+	CHECK(!residency.isResident(tilePath(2)));
+
+	r0 = nullptr;
+	residency.evictAll();
+	CHECK_EQUAL(0u, residency.stats().residentCount);
+	CHECK_EQUAL(0u, residency.stats().residentBytes);
+
+	residency.resetStats();
+	CHECK_EQUAL(0u, residency.stats().evictionCount);
+}
+
+TEST(Failed_ResidencyManagerTest)
+{
+	ResourceManager manager(*createTiles());
+	manager.addFactory(new FakeFactory);
+	ResidencyManager residency(manager, 2 * cTileSize);
+
+	// The file doesn't exist, the loader aborts
+	residency.prefetch("region/missing.tile", 0, 1);
+	processLoad(manager);
+	residency.update(2);
+	CHECK_EQUAL(0u, residency.stats().lateCount);
+	CHECK_EQUAL(1u, residency.stats().failCount);
+	CHECK_EQUAL(0u, residency.stats().residentBytes);
+
+	// Neither a stall nor loading it again
+	for(size_t i=0; i<3; ++i)
+		CHECK(!residency.acquire("region/missing.tile"));
+	CHECK_EQUAL(0u, residency.stats().stallCount);
+	CHECK_EQUAL(1u, residency.stats().failCount);
+	CHECK_EQUAL(0u, residency.stats().prefetchHit);
+
+	// Not charged, but evictable
+	residency.setResourceSize("region/missing.tile", cTileSize);
+	CHECK_EQUAL(0u, residency.stats().residentBytes);
+	residency.evictAll();
+	CHECK(!residency.isResident("region/missing.tile"));
+	CHECK_EQUAL(0u, residency.stats().residentCount);
+
+	// The size reported by the resource is used rather than the file size
+	ResourcePtr texture = residency.acquire("region/ground.tex");
+	processLoad(manager);
+	residency.update(3);
+	CHECK_EQUAL(texture->memorySize(), residency.stats().residentBytes);
+	CHECK_EQUAL(4 * cTileSize, residency.stats().residentBytes);
+
+	texture = nullptr;
+	residency.update(4);	// Over the budget
+	CHECK(!residency.isResident("region/ground.tex"));
+	CHECK_EQUAL(4 * cTileSize, residency.stats().evictedBytes);
+}
+
+TEST(FlyThrough_ResidencyManagerTest)
+{
+	ResidencyManager::Stats withoutPrefetch, withPrefetch;
+	const size_t stall1 = flyThrough(0, withoutPrefetch);
+	const size_t stall2 = flyThrough(3, withPrefetch);
+
+	// Every new tile stalls without prefetching
+	CHECK_EQUAL(cTileCount, stall1);
+	CHECK_EQUAL(0u, stall2);
+	CHECK(withPrefetch.prefetchHit > 0);
+	CHECK(withPrefetch.evictionCount > 0);
+	CHECK(withPrefetch.residentBytes <= 8 * cTileSize);
+
+	std::cout << "ResidencyManager fly-through: " << cTileCount << " tiles, stall without prefetch "
+		<< stall1 << ", with prefetch " << stall2 << " (" << withPrefetch.evictionCount << " evictions)" << std::endl;
+}
@@ -1,8 +1,14 @@
 #include "Pch.h"
+#include "../../../MCD/Core/System/Atomic.h"
+#include "../../../MCD/Core/System/ContentHash.h"
+#include "../../../MCD/Core/System/MemoryFileSystem.h"
 #include "../../../MCD/Core/System/RawFileSystem.h"
 #include "../../../MCD/Core/System/Resource.h"
 #include "../../../MCD/Core/System/ResourceLoader.h"
 #include "../../../MCD/Core/System/ResourceManager.h"
+#include "../../../MCD/Core/System/TaskPool.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <sstream>
 
 using namespace MCD;
 
@@ -276,4 +282,403 @@ TEST(Negative_ResourceManagerTest)
 			break;
 		}
 	}
+
+	{	// File not found, read by the I/O stage or by a task of the task pool for the content deduplication
+		const size_t ioThreadCount[] = { 1, 0 };
+		for(size_t i=0; i<sizeof(ioThreadCount)/sizeof(*ioThreadCount); ++i) {
+			std::auto_ptr<IFileSystem> fs(new RawFileSystem("./"));
+			ResourceManager manager(*fs);
+			fs.release();
+			manager.addFactory(new FakeFactory("cpp"));
+			manager.setIoThreadCount(ioThreadCount[i]);
+			manager.setContentDedup(ioThreadCount[i] == 0);
+			ResourcePtr resource = manager.load("__fileNotFound__.cpp");
+
+			IResourceLoaderPtr event;
+			Timer timer;
+			while(!(event = manager.popEvent()) && timer.get().asSecond() < 5)
+				mSleep(1);
+
+			CHECK(event);
+			if(event)
+				CHECK_EQUAL(IResourceLoader::Aborted, event->loadingState());
+		}
+	}
+}
+
+namespace {
+
+//! Simulates a slow disk, and records the order of the file being read.
+//! Reads are held while mHold is non-zero.
+class ThrottledFileSystem : public MemoryFileSystem
+{
+public:
+	ThrottledFileSystem(size_t readMs) : MemoryFileSystem(""), mReadMs(readMs), mHold(0) {}
+
+	sal_override std::auto_ptr<std::istream> openRead(const Path& path) const
+	{
+		onRead(path);
+		return MemoryFileSystem::openRead(path);
+	}
+
+	sal_override ReadSpanPtr openReadSpan(const Path& path) const
+	{
+		onRead(path);
+		return MemoryFileSystem::openReadSpan(path);
+	}
+
+	void onRead(const Path& path) const
+	{
+		++mReadStarted;
+		while(mHold != 0)
+			mSleep(1);
+		mSleep(mReadMs);
+		ScopeLock lock(mMutex);
+		mReadOrder.push_back(path.getString());
+	}
+
+	size_t mReadMs;
+	AtomicInteger mHold;
+	mutable AtomicInteger mReadStarted;
+	mutable Mutex mMutex;
+	mutable std::vector<std::string> mReadOrder;
+};	// ThrottledFileSystem
+
+//! Simulates a CPU heavy decoding.
+class SlowLoader : public FakeLoader
+{
+public:
+	SlowLoader(size_t decodeMs) : mDecodeMs(decodeMs) {}
+
+	sal_override sal_checkreturn LoadingState load(
+		sal_maybenull std::istream* is, sal_maybenull const Path* fileId=nullptr, sal_maybenull const char* args=nullptr)
+	{
+		mSleep(mDecodeMs);
+		return FakeLoader::load(is, fileId, args);
+	}
+
+	size_t mDecodeMs;
+};	// SlowLoader
+
+class SlowFactory : public FakeFactory
+{
+public:
+	SlowFactory(size_t decodeMs) : FakeFactory("txt"), mDecodeMs(decodeMs) {}
+
+	sal_override IResourceLoaderPtr createLoader() {
+		return new SlowLoader(mDecodeMs);
+	}
+
+	size_t mDecodeMs;
+};	// SlowFactory
+
+static const char cFileData[] = "data";
+
+//! Returns the number of resources successfully loaded.
+static size_t loadAll(size_t ioThreadCount, size_t fileCount, size_t readMs, size_t decodeMs, std::vector<std::string>& readOrder)
+{
+	ThrottledFileSystem* fs = new ThrottledFileSystem(readMs);
+	std::vector<std::string> names;
+	for(size_t i=0; i<fileCount; ++i) {
+		std::ostringstream ss;
+		ss << i << ".txt";
+		names.push_back(ss.str());
+		MCD_VERIFY(fs->add(names.back(), cFileData, sizeof(cFileData)));
+	}
+
+	ResourceManager manager(*fs);
+	manager.addFactory(new SlowFactory(decodeMs));
+	manager.taskPool().setThreadCount(1);
+	manager.setIoThreadCount(ioThreadCount);
+
+	// The first file keeps the reading thread busy until the others are queued
+	fs->mHold = 1;
+
+	std::vector<ResourcePtr> resources;
+	for(size_t i=0; i<fileCount; ++i) {
+		resources.push_back(manager.load(names[i], 0, int(i)));	// Later files have higher priority
+
+		if(i == 0) {
+			Timer timer;
+			while(fs->mReadStarted == 0 && timer.get().asSecond() < 5)
+				mSleep(1);
+		}
+	}
+
+	fs->mHold = 0;
+
+	size_t loaded = 0;
+	for(size_t finished=0; finished < fileCount;) {
+		if(IResourceLoaderPtr loader = manager.popEvent()) {
+			loaded += loader->loadingState() == IResourceLoader::Loaded ? 1 : 0;
+			++finished;
+		}
+		else
+			mSleep(1);
+	}
+
+	ScopeLock lock(fs->mMutex);
+	readOrder = fs->mReadOrder;
+	return loaded;
+}
+
+}	// namespace
+
+TEST(Io_ResourceManagerTest)
+{
+	std::vector<std::string> readOrder;
+
+	{	// With a single I/O thread, the first file keeps the thread busy while
+		// the others queue up, which are then read in the order of priority
+		CHECK_EQUAL(4u, loadAll(1, 4, 50, 0, readOrder));
+		CHECK_EQUAL(4u, readOrder.size());
+		if(readOrder.size() == 4) {
+			CHECK_EQUAL(std::string("0.txt"), readOrder[0]);
+			CHECK_EQUAL(std::string("3.txt"), readOrder[1]);
+			CHECK_EQUAL(std::string("2.txt"), readOrder[2]);
+			CHECK_EQUAL(std::string("1.txt"), readOrder[3]);
+		}
+	}
+
+	{	// Throttled disk: reading and decoding overlap with the I/O stage
+		const size_t cFileCount = 16;
+		const size_t cReadMs = 20;
+		const size_t cDecodeMs = 20;
+
+		Timer timer;
+		CHECK_EQUAL(cFileCount, loadAll(0, cFileCount, cReadMs, cDecodeMs, readOrder));
+		const double withoutIo = timer.get().asSecond();
+		CHECK_EQUAL(cFileCount, readOrder.size());
+
+		timer.reset();
+		CHECK_EQUAL(cFileCount, loadAll(2, cFileCount, cReadMs, cDecodeMs, readOrder));
+		const double withIo = timer.get().asSecond();
+		CHECK_EQUAL(cFileCount, readOrder.size());
+
+		std::cout << "ResourceManager throttled disk: " << cFileCount << " files, without I/O stage "
+			<< withoutIo * 1000 << "ms, with I/O stage " << withIo * 1000 << "ms" << std::endl;
+	}
+
+	{	// Without the I/O stage, the loader is not locked while the loading task reads the file
+		ThrottledFileSystem* fs = new ThrottledFileSystem(500);
+		MCD_VERIFY(fs->add("0.txt", cFileData, sizeof(cFileData)));
+
+		ResourceManager manager(*fs);
+		manager.addFactory(new SlowFactory(0));
+		manager.taskPool().setThreadCount(1);
+		manager.setIoThreadCount(0);
+
+		ResourcePtr resource = manager.load("0.txt", 0);
+		IResourceLoaderPtr loader = manager.getLoader("0.txt");
+		CHECK(loader);
+
+		Timer timer;
+		while(fs->mReadStarted == 0 && timer.get().asSecond() < 5)
+			mSleep(1);
+
+		timer.reset();
+		if(loader)
+			CHECK(loader->loadingState() != IResourceLoader::Loaded);
+		CHECK(timer.get().asSecond() < 0.25);
+
+		while(!manager.popEvent())
+			mSleep(1);
+	}
+}
+
+namespace {
+
+//! Counts the number of files decoded.
+class CountingLoader : public FakeLoader
+{
+public:
+	CountingLoader(size_t& count) : mCount(count) {}
+
+	sal_override sal_checkreturn LoadingState load(
+		sal_maybenull std::istream* is, sal_maybenull const Path* fileId=nullptr, sal_maybenull const char* args=nullptr)
+	{
+		++mCount;
+		return FakeLoader::load(is, fileId, args);
+	}
+
+	size_t& mCount;
+};	// CountingLoader
+
+class CountingFactory : public FakeFactory
+{
+public:
+	CountingFactory(size_t& count) : FakeFactory("tex"), mCount(count) {}
+
+	sal_override IResourceLoaderPtr createLoader() {
+		return new CountingLoader(mCount);
+	}
+
+	size_t& mCount;
+};	// CountingFactory
+
+static const size_t cPrefabCount = 4;
+
+/*!	The same rock and tree textures are copied into every prefab folder,
+	while the grass texture is different for each prefab.
+ */
+static MemoryFileSystem* createDuplicatedTree(std::vector<std::string>& paths)
+{
+	static const std::string rock(2000, 'r');
+	static const std::string tree(3000, 't');
+	static std::string grass[cPrefabCount];
+
+	MemoryFileSystem* fs = new MemoryFileSystem("");
+	MCD_VERIFY(fs->add("textures/rock.tex", rock.c_str(), rock.size()));
+	MCD_VERIFY(fs->add("textures/tree.tex", tree.c_str(), tree.size()));
+	paths.push_back("textures/rock.tex");
+	paths.push_back("textures/tree.tex");
+
+	for(size_t i=0; i<cPrefabCount; ++i) {
+		std::ostringstream ss;
+		ss << "prefabs/" << i << "/";
+		const std::string folder = ss.str();
+		grass[i] = std::string(1000, 'g') + folder;
+
+		MCD_VERIFY(fs->add(folder + "rock.tex", rock.c_str(), rock.size()));
+		MCD_VERIFY(fs->add(folder + "tree.tex", tree.c_str(), tree.size()));
+		MCD_VERIFY(fs->add(folder + "grass.tex", grass[i].c_str(), grass[i].size()));
+		paths.push_back(folder + "rock.tex");
+		paths.push_back(folder + "tree.tex");
+		paths.push_back(folder + "grass.tex");
+	}
+
+	return fs;
+}
+
+}	// namespace
+
+TEST(Dedup_ResourceManagerTest)
+{
+	std::vector<std::string> paths;
+	size_t decodeCount = 0;
+	std::stringstream index;
+
+	{	ResourceManager manager(*createDuplicatedTree(paths));
+		manager.addFactory(new CountingFactory(decodeCount));
+		manager.setContentDedup(true);
+		CHECK(manager.contentDedup());
+
+		std::vector<ResourcePtr> resources;
+		for(size_t i=0; i<paths.size(); ++i)
+			resources.push_back(manager.load(paths[i], 1));
+
+		// 2 shared textures plus a unique one per prefab
+		CHECK_EQUAL(2 + cPrefabCount, decodeCount);
+		CHECK(resources[0] == manager.load("prefabs/0/rock.tex", 1));
+		CHECK(resources[1] == manager.load("prefabs/3/tree.tex", 1));
+		CHECK(resources[0] != resources[1]);
+		CHECK(manager.getLoader("prefabs/0/rock.tex") == manager.getLoader("textures/rock.tex"));
+
+		const ResourceManager::DedupStats stats = manager.dedupStats();
+		CHECK_EQUAL(paths.size(), stats.hashCount);
+		CHECK_EQUAL(2 * cPrefabCount, stats.compareCount);
+		CHECK_EQUAL(2 * cPrefabCount, stats.aliasCount);
+		CHECK_EQUAL(cPrefabCount * (2000u + 3000u), stats.aliasedBytes);
+
+		std::cout << "ResourceManager dedup: " << paths.size() << " files, " << stats.aliasCount
+			<< " loads saved, " << stats.aliasedBytes << " of " << stats.hashedBytes << " bytes saved" << std::endl;
+
+		// Different args are not shared
+		ResourcePtr r = manager.load("prefabs/1/rock.tex", 1, 0, "mipmap=false");
+		CHECK(r != resources[0]);
+		CHECK_EQUAL(3 + cPrefabCount, decodeCount);
+
+		CHECK(manager.contentHashIndex().save(index));
+		CHECK_EQUAL(paths.size(), manager.contentHashIndex().size());
+	}
+
+	{	// With the persisted index, nothing needs to be hashed again
+		paths.clear();
+		decodeCount = 0;
+		ResourceManager manager(*createDuplicatedTree(paths));
+		manager.addFactory(new CountingFactory(decodeCount));
+		manager.setContentDedup(true);
+		CHECK(manager.contentHashIndex().load(index));
+
+		std::vector<ResourcePtr> resources;
+		for(size_t i=0; i<paths.size(); ++i)
+			resources.push_back(manager.load(paths[i], 1));
+
+		CHECK_EQUAL(2 + cPrefabCount, decodeCount);
+		CHECK_EQUAL(0u, manager.dedupStats().hashCount);
+		CHECK_EQUAL(2 * cPrefabCount, manager.dedupStats().compareCount);
+		CHECK_EQUAL(2 * cPrefabCount, manager.dedupStats().aliasCount);
+
+		// Once the original is gone, the copy loads by itself
+		while(manager.popEvent()) {}
+		resources.clear();
+		decodeCount = 0;
+		ResourcePtr r = manager.load("prefabs/2/rock.tex", 1);
+		CHECK(r && r->fileId() == "prefabs/2/rock.tex");
+		CHECK_EQUAL(1u, decodeCount);
+	}
+
+	{	// Disabled by default
+		paths.clear();
+		decodeCount = 0;
+		ResourceManager manager(*createDuplicatedTree(paths));
+		manager.addFactory(new CountingFactory(decodeCount));
+		CHECK(!manager.contentDedup());
+
+		std::vector<ResourcePtr> resources;
+		for(size_t i=0; i<paths.size(); ++i)
+			resources.push_back(manager.load(paths[i], 1));
+		CHECK_EQUAL(paths.size(), decodeCount);
+	}
+}
+
+TEST(DedupVerify_ResourceManagerTest)
+{
+	std::vector<std::string> paths;
+	size_t decodeCount = 0;
+	ResourceManager manager(*createDuplicatedTree(paths));
+	manager.addFactory(new CountingFactory(decodeCount));
+	manager.setContentDedup(true);
+	IFileSystem& fs = manager.fileSystem();
+
+	{	// The grass of each prefab has the same size, give one of them a colliding hash
+		ResourcePtr grass0 = manager.load("prefabs/0/grass.tex", 1);
+		uint64_t hash = 0;
+		CHECK(manager.contentHashIndex().find("prefabs/0/grass.tex", fs.getSize("prefabs/0/grass.tex"), fs.getLastWriteTime("prefabs/0/grass.tex"), hash));
+		manager.contentHashIndex().set("prefabs/1/grass.tex", hash, fs.getSize("prefabs/1/grass.tex"), fs.getLastWriteTime("prefabs/1/grass.tex"));
+
+		// The bytes differ, so it's not an alias
+		ResourcePtr grass1 = manager.load("prefabs/1/grass.tex", 1);
+		CHECK(grass1 && grass1 != grass0);
+		CHECK_EQUAL(2u, decodeCount);
+		CHECK_EQUAL(1u, manager.dedupStats().compareCount);
+		CHECK_EQUAL(0u, manager.dedupStats().aliasCount);
+	}
+
+	{	// A background load doesn't read the file in the calling thread, but in the task
+		decodeCount = 0;
+		const size_t hashCount = manager.dedupStats().hashCount;
+
+		ResourcePtr rock = manager.load("textures/rock.tex", 0);
+		CHECK_EQUAL(hashCount, manager.dedupStats().hashCount);
+		for(size_t i=0; i<100 && decodeCount < 1; ++i)
+			manager.popEvent();
+
+		ResourcePtr copy = manager.load("prefabs/0/rock.tex", 0);
+		CHECK(copy != rock);
+		CHECK_EQUAL(hashCount + 1, manager.dedupStats().hashCount);
+		for(size_t i=0; i<100 && decodeCount < 2; ++i)
+			manager.popEvent();
+
+		CHECK_EQUAL(2u, decodeCount);
+		CHECK_EQUAL(hashCount + 2, manager.dedupStats().hashCount);
+		CHECK_EQUAL(2u, manager.dedupStats().compareCount);
+
+		// Compared in the task already, the next load is an alias
+		copy = nullptr;
+		while(manager.popEvent()) {}
+		CHECK(manager.load("prefabs/0/rock.tex", 0) == rock);
+		CHECK_EQUAL(2u, decodeCount);
+		CHECK_EQUAL(1u, manager.dedupStats().aliasCount);
+	}
 }
@@ -0,0 +1,107 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/SpscQueue.h"
+#include "../../../MCD/Core/System/Thread.h"
+#include "../../../MCD/Core/System/Timer.h"
+
+using namespace MCD;
+
+TEST(SpscQueueTest)
+{
+	SpscQueue<int> queue(5);
+	CHECK_EQUAL(8u, queue.capacity());
+	CHECK(queue.isEmpty());
+
+	int val = 0;
+	CHECK(!queue.pop(val));
+
+	// Fill it up
+	for(int i=0; i<8; ++i)
+		CHECK(queue.push(i));
+	CHECK(!queue.push(8));
+	CHECK_EQUAL(8u, queue.size());
+
+	// Pop some, then push across the end of the ring buffer
+	for(int i=0; i<5; ++i) {
+		CHECK(queue.pop(val));
+		CHECK_EQUAL(i, val);
+	}
+	for(int i=8; i<13; ++i)
+		CHECK(queue.push(i));
+	CHECK(!queue.push(13));
+
+	for(int i=5; i<13; ++i) {
+		CHECK(queue.pop(val));
+		CHECK_EQUAL(i, val);
+	}
+	CHECK(!queue.pop(val));
+	CHECK(queue.isEmpty());
+}
+
+namespace {
+
+struct Item
+{
+	size_t sequence;
+	size_t payload[7];	// Make it larger than a machine word, so a torn element can be detected
+};	// Item
+
+class Consumer : public Thread::IRunnable
+{
+public:
+	Consumer(SpscQueue<Item>& queue, size_t count) : mQueue(queue), mCount(count), mError(0) {}
+
+	sal_override void run(Thread& thread)
+	{
+		(void)thread;
+		Item item;
+		for(size_t i=0; i<mCount; ) {
+			if(!mQueue.pop(item)) {
+				mSleep(0);
+				continue;
+			}
+
+			if(item.sequence != i)
+				++mError;
+			for(size_t j=0; j<7; ++j)
+				if(item.payload[j] != i * 7 + j)
+					++mError;
+			++i;
+		}
+	}
+
+	SpscQueue<Item>& mQueue;
+	size_t mCount;
+	size_t mError;
+};	// Consumer
+
+}	// namespace
+
+TEST(Threaded_SpscQueueTest)
+{
+	const size_t count = 1000000;
+	SpscQueue<Item> queue(1024);
+	Consumer consumer(queue, count);
+
+	Timer timer;
+	{	Thread thread(consumer, false);
+
+		for(size_t i=0; i<count; ) {
+			Item item;
+			item.sequence = i;
+			for(size_t j=0; j<7; ++j)
+				item.payload[j] = i * 7 + j;
+
+			if(queue.push(item))
+				++i;
+			else
+				mSleep(0);
+		}
+
+		thread.wait();
+	}
+
+	CHECK_EQUAL(0u, consumer.mError);
+	CHECK(queue.isEmpty());
+
+	std::cout << "SpscQueue: " << count << " items passed between threads in " << timer.get().asSecond() * 1000 << "ms" << std::endl;
+}
@@ -1,6 +1,10 @@
 #include "Pch.h"
 #include "../../../MCD/Core/System/StringHash.h"
+#include "../../../MCD/Core/System/Atomic.h"
+#include "../../../MCD/Core/System/Thread.h"
+#include "../../../MCD/Core/System/Timer.h"
 #include "../../../MCD/Core/System/Utility.h"
+#include <stdio.h>
 
 using namespace MCD;
 
@@ -53,6 +57,172 @@ TEST(FixStringTest)
 	CHECK_EQUAL(std::string(""), std::string(FixString(1234).c_str()));
 }
 
+TEST(Immortal_FixStringTest)
+{
+	FixString mortal("Mortal string");
+	const char* data = mortal.c_str();
+
+	// An existing string becomes immortal, the data is not moved
+	FixString s = FixString::immortal("Mortal string");
+	CHECK_EQUAL(data, s.c_str());
+	CHECK(s == mortal);
+
+	FixString i = FixString::immortal("Immortal string");
+	CHECK_EQUAL(std::string("Immortal string"), std::string(i.c_str()));
+	CHECK_EQUAL(15u, i.size());
+	CHECK(FixString("Immortal string") == i);
+
+	{	FixString copy(i);
+		copy = s;
+		copy = copy;
+		CHECK(copy == mortal);
+	}
+
+	// Still found by it's hash value after all the instances are gone
+	const uint32_t hash = i.hashValue();
+	i = FixString();
+	CHECK_EQUAL(std::string("Immortal string"), std::string(FixString(hash).c_str()));
+
+	CHECK(FixString::immortal(nullptr).empty());
+}
+
+namespace {
+
+const size_t cStressStringCount = 64;
+
+void makeStressString(char* buf, size_t i) {
+	sprintf(buf, "Stress string %d", int(i));
+}
+
+//! Creating, copying and destroying a small set of strings in many threads, to hit the revive and free race
+class FixStringStressRunnable : public Thread::IRunnable
+{
+public:
+	FixStringStressRunnable() : seed(0), iteration(0) {}
+
+	sal_override void run(Thread&)
+	{
+		FixString slots[8];
+		char buf[64];
+		for(size_t i=0; i<iteration; ++i) {
+			seed = seed * 1103515245 + 12345;
+			const size_t index = (seed >> 16) % cStressStringCount;
+			makeStressString(buf, index);
+
+			FixString& slot = slots[i % MCD_COUNTOF(slots)];
+			switch((seed >> 8) % 4) {
+			case 0: slot = buf; break;
+			case 1: slot = FixString(buf); slot = FixString(slot.hashValue()); break;
+			case 2: { FixString tmp(buf); slot = tmp; FixString copy(slot); } break;
+			case 3: if(index < 4) slot = FixString::immortal(buf); else slot = FixString(); break;
+			}
+
+			if(!slot.empty() && strcmp(slot.c_str(), buf) != 0)
+				++errorCount;
+		}
+	}
+
+	unsigned seed;
+	size_t iteration;
+	AtomicInteger errorCount;
+};	// FixStringStressRunnable
+
+}	// namespace
+
+TEST(Stress_FixStringTest)
+{
+	const size_t threadCount = 4;
+	FixStringStressRunnable runnables[threadCount];
+	Thread threads[threadCount];
+
+	for(size_t i=0; i<threadCount; ++i) {
+		runnables[i].seed = unsigned(i);
+		runnables[i].iteration = 200000;
+		threads[i].start(runnables[i], false);
+	}
+
+	for(size_t i=0; i<threadCount; ++i) {
+		threads[i].wait();
+		CHECK_EQUAL(0, runnables[i].errorCount);
+	}
+
+	// All the mortal strings are freed, a new instance gets the same content
+	char buf[64];
+	for(size_t i=0; i<cStressStringCount; ++i) {
+		makeStressString(buf, i);
+		CHECK_EQUAL(std::string(buf), std::string(FixString(buf).c_str()));
+	}
+}
+
+namespace {
+
+class FixStringBenchmarkRunnable : public Thread::IRunnable
+{
+public:
+	sal_override void run(Thread&)
+	{
+		// Interning
+		for(size_t i=0; i<iteration; ++i)
+			FixString s((*strings)[i % strings->size()].c_str());
+
+		// Copying
+		const FixString& src = immortal ? immortalString : mortalString;
+		for(size_t i=0; i<iteration; ++i)
+			FixString copy(src);
+	}
+
+	const std::vector<std::string>* strings;
+	size_t iteration;
+	bool immortal;
+	FixString mortalString, immortalString;
+};	// FixStringBenchmarkRunnable
+
+double benchmarkFixString(const std::vector<std::string>& strings, size_t threadCount, size_t totalIteration, bool immortal)
+{
+	FixStringBenchmarkRunnable runnables[4];
+	Thread threads[4];
+
+	Timer timer;
+	for(size_t i=0; i<threadCount; ++i) {
+		runnables[i].strings = &strings;
+		runnables[i].iteration = totalIteration / threadCount;
+		runnables[i].immortal = immortal;
+		runnables[i].mortalString = "Benchmark mortal string";
+		runnables[i].immortalString = FixString::immortal("Benchmark immortal string");
+		threads[i].start(runnables[i], false);
+	}
+	for(size_t i=0; i<threadCount; ++i)
+		threads[i].wait();
+
+	return timer.get().asSecond();
+}
+
+}	// namespace
+
+//! Interning then copying 2M strings, split among 1 to 4 threads
+TEST(Benchmark_FixStringTest)
+{
+	const size_t totalIteration = 2000000;
+
+	// Keep half of the strings alive, such that interning hits both the found and the new node path
+	std::vector<std::string> strings;
+	std::vector<FixString> alive;
+	char buf[64];
+	for(size_t i=0; i<10000; ++i) {
+		sprintf(buf, "Benchmark string %d", int(i));
+		strings.push_back(buf);
+		if(i % 2 == 0)
+			alive.push_back(FixString(buf));
+	}
+
+	for(size_t threadCount=1; threadCount<=4; threadCount*=2) {
+		const double mortal = benchmarkFixString(strings, threadCount, totalIteration, false);
+		const double immortal = benchmarkFixString(strings, threadCount, totalIteration, true);
+		std::cout << "FixString " << threadCount << " thread: " << totalIteration << " interning and copying in "
+			<< mortal * 1000 << "ms, with immortal copies: " << immortal * 1000 << "ms" << std::endl;
+	}
+}
+
 TEST(StringHashSetTest)
 {
 	{	StringHashSet table;
@@ -76,3 +76,41 @@ TEST(DeleteTask_TaskPoolTest)
 	mSleep(1);
 	CHECK(true);
 }
+
+TEST(ForkJoin_TaskPoolTest)
+{
+	class Task : public MCD::TaskPool::Task
+	{
+	public:
+		Task() : MCD::TaskPool::Task(0), group(nullptr), runCount(0) {}
+
+		sal_override void run(Thread&) {
+			mSleep(1);
+			++runCount;
+			group->done();
+		}
+
+		TaskGroup* group;
+		int runCount;
+	};	// Task
+
+	Task tasks[10];
+	TaskPool::Task* taskPtrs[10];
+	TaskGroup group;
+	for(size_t i=0; i<10; ++i) {
+		tasks[i].group = &group;
+		taskPtrs[i] = &tasks[i];
+	}
+
+	TaskPool taskPool;
+	taskPool.setThreadCount(2);
+	TaskPool* pools[] = { &taskPool, nullptr };
+
+	// All tasks are done when forkJoin() returns, with or without a pool
+	for(size_t i=0; i<2; ++i) {
+		group.reset(10);
+		forkJoin(pools[i], taskPtrs, 10, group);
+		for(size_t j=0; j<10; ++j)
+			CHECK_EQUAL(int(i + 1), tasks[j].runCount);
+	}
+}
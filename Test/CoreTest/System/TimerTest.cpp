@@ -1,5 +1,6 @@
 #include "Pch.h"
 #include "../../../MCD/Core/System/Timer.h"
+#include "../../../MCD/Core/System/Thread.h"
 
 using namespace MCD;
 
@@ -75,3 +76,13 @@ TEST(DeltaTimerTest)
 		CHECK(t.getDelta().asSecond() > 1.0 - 1e6);
 	}
 }
+
+TEST(Accuracy_TimerTest)
+{
+	// The timer has a sub-second resolution
+	Timer t;
+	mSleep(20);
+	const double elapsed = t.get().asSecond();
+	CHECK(elapsed >= 0.015);
+	CHECK(elapsed < 1);
+}
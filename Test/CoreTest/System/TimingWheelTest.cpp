@@ -0,0 +1,203 @@
+#include "Pch.h"
+#include "../../../MCD/Core/System/TimingWheel.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <map>
+#include <vector>
+
+using namespace MCD;
+
+namespace {
+
+void* obj(size_t i) { return reinterpret_cast<void*>(i + 1); }
+size_t idx(void* p) { return reinterpret_cast<size_t>(p) - 1; }
+
+}	// namespace
+
+TEST(Basic_TimingWheelTest)
+{
+	// NOTE: The times are in multiple of the resolution, so that there is no rounding
+	TimingWheel wheel(1.0f / 64);
+	void* o = nullptr;
+	void* userData = nullptr;
+
+	CHECK(!wheel.pop(0, o));
+
+	// Scheduled out of order
+	wheel.schedule(0.375, obj(3));
+	wheel.schedule(0.125, obj(1), obj(10));
+	TimingWheel::Handle h2 = wheel.schedule(0.25, obj(2));
+	wheel.schedule(0, obj(0));
+	CHECK_EQUAL(4u, wheel.size());
+	CHECK(wheel.isValid(h2));
+
+	// Already due
+	CHECK(wheel.pop(0, o));
+	CHECK_EQUAL(obj(0), o);
+
+	CHECK(!wheel.pop(0.0625, o));
+	CHECK(wheel.pop(0.125, o, &userData));
+	CHECK_EQUAL(obj(1), o);
+	CHECK_EQUAL(obj(10), userData);
+
+	// Cancel
+	CHECK(wheel.cancel(h2, &o));
+	CHECK_EQUAL(obj(2), o);
+	CHECK(!wheel.isValid(h2));
+	CHECK(!wheel.cancel(h2));
+
+	// The freed entry is reused, with a different handle
+	TimingWheel::Handle h4 = wheel.schedule(0.3125, obj(4));
+	CHECK(h4 != h2);
+	CHECK(!wheel.isValid(h2));
+
+	CHECK(!wheel.pop(0.25, o));
+	CHECK(wheel.pop(1, o));
+	CHECK_EQUAL(obj(4), o);
+	CHECK(!wheel.isValid(h4));
+	CHECK(wheel.pop(1, o));
+	CHECK_EQUAL(obj(3), o);
+	CHECK(!wheel.pop(1, o));
+	CHECK_EQUAL(0u, wheel.size());
+}
+
+TEST(Event_TimingWheelTest)
+{
+	TimingWheel wheel;
+	const char* eventA = "A";
+	const char* eventB = "B";
+	void* o = nullptr;
+
+	wheel.schedule(-1, obj(0), nullptr, eventA);
+	TimingWheel::Handle h1 = wheel.schedule(-1, obj(1), nullptr, eventA);
+	wheel.schedule(500, obj(2), nullptr, eventA);
+	wheel.schedule(1, obj(3), nullptr, eventB);
+
+	// Only the one with a time out
+	CHECK(wheel.pop(100, o));
+	CHECK_EQUAL(obj(3), o);
+	CHECK(!wheel.pop(100, o));
+
+	wheel.cancel(h1);
+	CHECK_EQUAL(0u, wheel.signal(eventB));
+	CHECK_EQUAL(2u, wheel.signal(eventA));
+	CHECK_EQUAL(0u, wheel.signal(eventA));
+
+	size_t mask = 0;
+	while(wheel.pop(100, o))
+		mask |= 1 << idx(o);
+	CHECK_EQUAL(0x5u, mask);
+
+	// Time out before the signal, late by at most the resolution
+	wheel.schedule(101, obj(4), nullptr, eventA);
+	CHECK(!wheel.pop(100.99, o));
+	CHECK(wheel.pop(101 + wheel.resolution(), o));
+	CHECK_EQUAL(obj(4), o);
+	CHECK_EQUAL(0u, wheel.signal(eventA));
+}
+
+//! Entries in the higher levels and the overflow list, none of them should fire early.
+TEST(Far_TimingWheelTest)
+{
+	TimingWheel wheel(1);
+	const double times[] = { 200, 300, 70000, 20000000, 5000000000.0, 9000000000.0 };
+	const size_t count = sizeof(times) / sizeof(*times);
+
+	for(size_t i=count; i--;)
+		wheel.schedule(times[i], obj(i));
+
+	void* o = nullptr;
+	for(size_t i=0; i<count; ++i) {
+		CHECK(!wheel.pop(times[i] - 1, o));
+		CHECK(wheel.pop(times[i], o));
+		CHECK_EQUAL(obj(i), o);
+	}
+	CHECK_EQUAL(0u, wheel.size());
+}
+
+//! 100k coroutines sleeping for random durations, rescheduling themselves after wakeup.
+TEST(Stress_TimingWheelTest)
+{
+	const size_t coroutineCount = 100000, frameCount = 600;
+	const double frameTime = 1.0 / 60;
+	const float resolution = 0.001f;
+
+	std::vector<double> wakeTimes(coroutineCount);
+	std::vector<TimingWheel::Handle> handles(coroutineCount);
+	unsigned seed = 1234;
+	size_t totalWakeup = 0, earlyWakeup = 0, lateWakeup = 0, cancelled = 0;
+
+	TimingWheel wheel(resolution);
+	Timer timer;
+
+	for(size_t i=0; i<coroutineCount; ++i) {
+		seed = seed * 1103515245 + 12345;
+		wakeTimes[i] = ((seed >> 8) % 3000) / 1000.0;	// Up to 3 seconds
+		handles[i] = wheel.schedule(wakeTimes[i], obj(i));
+	}
+
+	for(size_t f=1; f<=frameCount; ++f) {
+		const double now = f * frameTime;
+		void* o;
+		while(wheel.pop(now, o)) {
+			const size_t i = idx(o);
+			++totalWakeup;
+			if(now < wakeTimes[i]) ++earlyWakeup;
+			if(now > wakeTimes[i] + frameTime + resolution) ++lateWakeup;
+
+			// Mostly short sleeps, with some long ones
+			seed = seed * 1103515245 + 12345;
+			wakeTimes[i] = now + ((seed >> 8) % 16 == 0 ? ((seed >> 12) % 5000) / 1000.0 : ((seed >> 12) % 100) / 1000.0);
+			handles[i] = wheel.schedule(wakeTimes[i], o);
+		}
+
+		// Some are destroyed and recreated
+		for(size_t j=0; j<100; ++j) {
+			seed = seed * 1103515245 + 12345;
+			const size_t i = (seed >> 8) % coroutineCount;
+			if(wheel.cancel(handles[i])) ++cancelled;
+			wakeTimes[i] = now + 0.5;
+			handles[i] = wheel.schedule(wakeTimes[i], obj(i));
+		}
+	}
+	const double wheelTime = timer.get().asSecond();
+
+	CHECK_EQUAL(coroutineCount, wheel.size());
+	CHECK_EQUAL(0u, earlyWakeup);
+	CHECK_EQUAL(0u, lateWakeup);
+	CHECK(totalWakeup > coroutineCount * 10);
+	CHECK_EQUAL(frameCount * 100, cancelled);
+
+	// The same with a multimap, as VMCore did before
+	typedef std::multimap<double, size_t> Schedule;
+	Schedule schedule;
+	std::vector<Schedule::iterator> iterators(coroutineCount);
+	seed = 1234;
+	timer.reset();
+
+	for(size_t i=0; i<coroutineCount; ++i) {
+		seed = seed * 1103515245 + 12345;
+		iterators[i] = schedule.insert(std::make_pair(((seed >> 8) % 3000) / 1000.0, i));
+	}
+
+	for(size_t f=1; f<=frameCount; ++f) {
+		const double now = f * frameTime;
+		while(!schedule.empty() && schedule.begin()->first <= now) {
+			const size_t i = schedule.begin()->second;
+			schedule.erase(schedule.begin());
+			seed = seed * 1103515245 + 12345;
+			const double t = now + ((seed >> 8) % 16 == 0 ? ((seed >> 12) % 5000) / 1000.0 : ((seed >> 12) % 100) / 1000.0);
+			iterators[i] = schedule.insert(std::make_pair(t, i));
+		}
+
+		for(size_t j=0; j<100; ++j) {
+			seed = seed * 1103515245 + 12345;
+			const size_t i = (seed >> 8) % coroutineCount;
+			schedule.erase(iterators[i]);
+			iterators[i] = schedule.insert(std::make_pair(now + 0.5, i));
+		}
+	}
+	const double mapTime = timer.get().asSecond();
+
+	std::cout << "TimingWheel: " << totalWakeup << " wakeups in " << wheelTime * 1000 << "ms, "
+		<< "std::multimap: " << mapTime * 1000 << "ms" << std::endl;
+}
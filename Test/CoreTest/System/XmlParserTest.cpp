@@ -1,5 +1,8 @@
 #include "Pch.h"
 #include "../../../MCD/Core/System/XmlParser.h"
+#include "../../../MCD/Core/System/StringHash.h"
+#include "../../../MCD/Core/System/Timer.h"
+#include <stdlib.h>
 
 using namespace MCD;
 
@@ -110,3 +113,323 @@ TEST(XmlParserTest)
 	// After the parsing is finished, further call to nextEvent() should return EndDocument
 	CHECK_EQUAL(Event::EndDocument, parser.nextEvent());
 }
+
+namespace {
+
+typedef XmlParser::Event Event;
+
+/*!	Generates a random xml document, together with the events that the parser should give.
+	Each event is described as a string, for example "B model file=scene.3ds type=mesh /".
+ */
+class XmlGenerator
+{
+public:
+	explicit XmlGenerator(unsigned seed) : mSeed(seed) {}
+
+	void generate(size_t elementCount)
+	{
+		xml = "<?xml version=\"1.0\"?>";
+		events.clear();
+		events.push_back("U");
+		while(elementCount > 0)
+			element(0, elementCount);
+		events.push_back("EndDocument");
+	}
+
+	std::string xml;
+	std::vector<std::string> events;
+
+protected:
+	unsigned rand(unsigned n) {
+		mSeed = mSeed * 1103515245 + 12345;
+		return (mSeed >> 16) % n;
+	}
+
+	std::string word(size_t maxLength)
+	{
+		static const char cChars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+		std::string s;
+		const size_t length = 1 + rand(unsigned(maxLength));
+		for(size_t i=0; i<length; ++i)
+			s += cChars[rand(sizeof(cChars) - 1)];
+		return s == "script" ? "scrip" : s;
+	}
+
+	std::string space()
+	{
+		static const char cSpaces[] = " \t\n\r";
+		std::string s;
+		for(size_t i=rand(3)+1; i--;)
+			s += cSpaces[rand(4)];
+		return s;
+	}
+
+	//! Random text with escape sequences, \em decoded is what the parser should give
+	std::string text(size_t maxWords, const char* excluded, std::string& decoded)
+	{
+		static const char* cEscapes[] = { "&amp;", "&lt;", "&gt;", "&apos;", "&quot;" };
+		static const char cDecoded[] = "&<>'\"";
+
+		std::string s;
+		decoded.clear();
+		for(size_t i=rand(unsigned(maxWords))+1; i--;) {
+			const std::string w = word(20);
+			s += w;
+			decoded += w;
+			if(rand(4) == 0) {
+				const unsigned e = rand(5);
+				s += cEscapes[e];
+				decoded += cDecoded[e];
+			}
+			else if(rand(4) == 0 && !strchr(excluded, '>')) {
+				s += "> ";
+				decoded += "> ";
+			}
+			else {
+				s += " ";
+				decoded += " ";
+			}
+		}
+		return s;
+	}
+
+	void element(size_t depth, size_t& elementCount)
+	{
+		--elementCount;
+		const std::string name = word(16);
+		std::string begin = "B " + name;
+		xml += "<" + name;
+
+		for(size_t i=rand(5); i--;) {
+			const std::string attrName = word(12);
+			const char quote = rand(2) ? '"' : '\'';
+			std::string decoded;
+			const std::string value = text(3, quote == '"' ? "\">" : "'>", decoded);
+			xml += space() + attrName + "=" + quote + value + quote;
+			begin += " " + attrName + "=" + decoded;
+		}
+
+		if(rand(4) == 0) {
+			xml += rand(2) ? "/>" : space() + "/>";
+			events.push_back(begin + " /");
+			events.push_back("E " + name);
+			return;
+		}
+
+		xml += rand(3) ? ">" : space() + ">";
+		events.push_back(begin);
+
+		bool lastIsText = false;	// Two adjacent texts are just one text
+		for(size_t i=rand(depth < 6 ? 6 : 2); i-- && elementCount > 0;) {
+			const unsigned type = rand(8);
+			if(lastIsText && (type == 2 || type == 3))
+				continue;
+			lastIsText = (type == 2 || type == 3);
+
+			switch(type) {
+			case 0: {
+				const std::string comment = word(30);
+				xml += "<!-- " + comment + " -->";
+				events.push_back("C  " + comment + " ");
+			}	break;
+			case 1: {
+				std::string decoded;
+				const std::string data = text(8, "", decoded) + "<tag> if(a<b) c=d;";
+				xml += "<![CDATA[" + data + "]]>";
+				events.push_back("D " + data);
+			}	break;
+			case 2: case 3: {
+				std::string decoded;
+				xml += "x" + text(10, "", decoded);
+				events.push_back("T x" + decoded);
+			}	break;
+			default:
+				element(depth + 1, elementCount);
+				break;
+			}
+		}
+
+		xml += "</" + name + ">";
+		events.push_back("E " + name);
+	}
+
+	unsigned mSeed;
+};	// XmlGenerator
+
+std::string describe(const XmlParser::EventInfo& e)
+{
+	switch(e.type) {
+	case Event::BeginElement: {
+		std::string s = std::string("B ") + e.elementName;
+		for(size_t i=0; i<e.attributeCount; ++i)
+			s += std::string(" ") + e.attributes[i].name + "=" + e.attributes[i].value;
+		return e.isEmptyElement ? s + " /" : s;
+	}
+	case Event::EndElement: return std::string("E ") + e.elementName;
+	case Event::Text: return std::string("T ") + e.textData;
+	case Event::Comment: return std::string("C ") + e.textData;
+	case Event::CData: return std::string("D ") + e.textData;
+	case Event::Unknown: return "U";
+	case Event::EndDocument: return "EndDocument";
+	default: return "Error";
+	}
+}
+
+std::vector<std::string> parseByEvent(std::string xml)
+{
+	XmlParser parser;
+	parser.parse(const_cast<char*>(xml.c_str()));
+
+	std::vector<std::string> ret;
+	std::vector<XmlParser::Attribute> attributes;
+	for(;;) {
+		XmlParser::EventInfo e;
+		e.type = parser.nextEvent();
+		e.elementName = parser.elementName();
+		e.textData = parser.textData();
+		e.isEmptyElement = parser.isEmptyElement();
+		e.attributeCount = e.type == Event::BeginElement ? parser.attributeCount() : 0;
+		attributes.resize(e.attributeCount);
+		for(size_t i=0; i<e.attributeCount; ++i) {
+			attributes[i].name = parser.attributeName(i);
+			attributes[i].value = parser.attributeValue(i);
+		}
+		e.attributes = e.attributeCount ? &attributes[0] : nullptr;
+		ret.push_back(describe(e));
+
+		if(e.type == Event::EndDocument || e.type == Event::Error)
+			return ret;
+	}
+}
+
+std::vector<std::string> parseByBatch(std::string xml, size_t batchSize)
+{
+	XmlParser parser;
+	parser.parse(const_cast<char*>(xml.c_str()));
+
+	std::vector<std::string> ret;
+	std::vector<XmlParser::EventInfo> events(batchSize);
+	for(;;) {
+		const size_t count = parser.nextEvents(&events[0], batchSize);
+		for(size_t i=0; i<count; ++i)
+			ret.push_back(describe(events[i]));
+		if(count < batchSize || ret.back() == "EndDocument" || ret.back() == "Error")
+			return ret;
+	}
+}
+
+}	// namespace
+
+//! The parser should give the same events as the generator expected, with or without the batch api
+TEST(Conformance_XmlParserTest)
+{
+	for(unsigned seed=0; seed<50; ++seed) {
+		XmlGenerator generator(seed);
+		generator.generate(20 + seed * 4);
+
+		const std::vector<std::string> result = parseByEvent(generator.xml);
+		CHECK_EQUAL(generator.events.size(), result.size());
+		for(size_t i=0; i<result.size() && i<generator.events.size(); ++i)
+			CHECK_EQUAL(generator.events[i], result[i]);
+
+		CHECK(parseByBatch(generator.xml, 1) == result);
+		CHECK(parseByBatch(generator.xml, 7) == result);
+		CHECK(parseByBatch(generator.xml, 256) == result);
+	}
+}
+
+TEST(Batch_XmlParserTest)
+{
+	std::string xml("<a x='1' y=\"2\"><b/><c z=\"3\"></c>text</a>");
+	XmlParser parser;
+	parser.parse(const_cast<char*>(xml.c_str()));
+
+	XmlParser::EventInfo events[16];
+	CHECK_EQUAL(8u, parser.nextEvents(events, 16));
+
+	CHECK_EQUAL(Event::BeginElement, events[0].type);
+	CHECK_EQUAL(std::string("a"), events[0].elementName);
+	CHECK_EQUAL(2u, events[0].attributeCount);
+	CHECK_EQUAL(std::string("y"), events[0].attributes[1].name);
+	CHECK_EQUAL(std::string("2"), events[0].attributes[1].value);
+
+	CHECK(events[1].isEmptyElement);
+	CHECK_EQUAL(Event::EndElement, events[2].type);
+	CHECK_EQUAL(std::string("b"), events[2].elementName);
+	CHECK(!events[2].attributes);
+
+	// The attributes of the earlier events are still valid
+	CHECK_EQUAL(std::string("3"), events[3].attributes[0].value);
+	CHECK_EQUAL(std::string("1"), events[0].attributes[0].value);
+
+	CHECK_EQUAL(Event::Text, events[5].type);
+	CHECK_EQUAL(std::string("text"), events[5].textData);
+	CHECK_EQUAL(Event::EndDocument, events[7].type);
+
+	// Nothing more after the document ended
+	CHECK_EQUAL(1u, parser.nextEvents(events, 16));
+	CHECK_EQUAL(Event::EndDocument, events[0].type);
+}
+
+TEST(InternedAttribute_XmlParserTest)
+{
+	std::string xml("<model file=\"scene.3ds\" type='mesh'/><model type='skin'/>");
+	XmlParser parser;
+	parser.parse(const_cast<char*>(xml.c_str()));
+
+	const FixString file("file"), type("type"), other("other");
+
+	CHECK_EQUAL(Event::BeginElement, parser.nextEvent());
+	CHECK_EQUAL(std::string("scene.3ds"), parser.attributeValue(file));
+	CHECK_EQUAL(std::string("mesh"), parser.attributeValue(type));
+	CHECK(!parser.attributeValue(other));
+
+	CHECK_EQUAL(Event::EndElement, parser.nextEvent());
+	CHECK_EQUAL(Event::BeginElement, parser.nextEvent());
+	CHECK(!parser.attributeValue(file));
+	CHECK_EQUAL(std::string("skin"), parser.attributeValue(type));
+}
+
+//! Parsing a 4MB document event by event with the accessors, and by the batch api
+TEST(Benchmark_XmlParserTest)
+{
+	XmlGenerator generator(1234);
+	generator.generate(40000);
+	const double mb = double(generator.xml.size()) / (1024 * 1024);
+
+	std::string xml = generator.xml;
+	XmlParser parser;
+	parser.parse(const_cast<char*>(xml.c_str()));
+
+	Timer timer;
+	size_t eventCount = 0, attributeCount = 0;
+	for(Event::Enum e; (e = parser.nextEvent()) != Event::EndDocument && e != Event::Error; ++eventCount) {
+		if(e == Event::BeginElement)
+			attributeCount += parser.attributeCount() + (*parser.elementName() ? 1 : 0);
+	}
+	const double byEvent = timer.get().asSecond();
+
+	xml = generator.xml;
+	parser.parse(const_cast<char*>(xml.c_str()));
+
+	timer.reset();
+	size_t batchEventCount = 0, batchAttributeCount = 0;
+	XmlParser::EventInfo events[256];
+	for(size_t count; (count = parser.nextEvents(events, 256)) > 0; ) {
+		for(size_t i=0; i<count; ++i) {
+			if(events[i].type == Event::BeginElement)
+				batchAttributeCount += events[i].attributeCount + (*events[i].elementName ? 1 : 0);
+		}
+		batchEventCount += count;
+		if(events[count - 1].type == Event::EndDocument || events[count - 1].type == Event::Error)
+			break;
+	}
+	const double byBatch = timer.get().asSecond();
+
+	CHECK_EQUAL(generator.events.size() - 1, eventCount);
+	CHECK_EQUAL(eventCount + 1, batchEventCount);
+	CHECK_EQUAL(attributeCount, batchAttributeCount);
+
+	std::cout << "Parsing " << mb << "MB of xml with " << eventCount << " events, by nextEvent(): " << byEvent * 1000 << "ms ("
+		<< mb / byEvent << "MB/s), by nextEvents(): " << byBatch * 1000 << "ms (" << mb / byBatch << "MB/s)" << std::endl;
+}
@@ -0,0 +1,243 @@
+#include "Pch.h"
+#include "../../MCD/Render/Camera.h"
+#include "../../MCD/Render/Light.h"
+#include "../../MCD/Render/Material.h"
+#include "../../MCD/Render/Mesh.h"
+#include "../../MCD/Render/Renderer.h"
+#include "../../MCD/Render/RenderSnapshot.h"
+#include "../../MCD/Render/RenderTarget.h"
+#include "../../MCD/Core/Entity/Entity.h"
+#include "../../MCD/Core/System/Atomic.h"
+#include "../../MCD/Core/System/Timer.h"
+
+using namespace MCD;
+
+namespace {
+
+//! Burns some CPU when drawn, like a renderer building its command buffer.
+class HeavyDrawCall : public IDrawCall
+{
+public:
+	HeavyDrawCall(size_t work, AtomicInteger& drawCount)
+		: mWork(work), mDrawCount(drawCount)
+	{}
+
+	sal_override void draw(sal_in void* context, Statistic& statistic)
+	{
+		float x = 0;
+		for(size_t i=0; i<mWork; ++i)
+			x = ::sinf(x + float(i));
+		mResult = x;
+		++statistic.drawCallCount;
+		++mDrawCount;
+	}
+
+	const size_t mWork;
+	AtomicInteger& mDrawCount;
+	float mResult;
+};	// HeavyDrawCall
+
+//! Submits itself as a draw call as MeshComponent does, the draw call it clones owns its parameters.
+class HeavyMeshComponent : public MeshComponent
+{
+public:
+	HeavyMeshComponent(size_t work, AtomicInteger& drawCount)
+		: work(work), drawCount(drawCount)
+	{}
+
+	sal_override void draw(sal_in void* context, Statistic& statistic) {
+		HeavyDrawCall(work, drawCount).draw(context, statistic);
+	}
+
+	sal_override IDrawCall* cloneDrawCall() const {
+		return new HeavyDrawCall(work, drawCount);
+	}
+
+	size_t work;
+	AtomicInteger& drawCount;
+};	// HeavyMeshComponent
+
+/*!	A renderer, a camera and a render target under the root, with a material,
+	a light and some renderables under the scene Entity.
+ */
+class PipelineScene
+{
+public:
+	PipelineScene(size_t renderableCount, size_t renderWork)
+	{
+		renderer = new RendererComponent;
+		root.addFirstChild("Renderer")->addComponent(renderer);
+
+		scene = root.addLastChild("Scene");
+		material = scene->addComponent(new MaterialComponent);
+
+		Entity* e = scene->addLastChild("Light");
+		light = e->addComponent(new LightComponent);
+		light->color = ColorRGBf(1, 0.5f, 0);
+		e->localTransform.setTranslation(Vec3f(0, 5, 0));
+
+		for(size_t i=0; i<renderableCount; ++i) {
+			e = scene->addLastChild("Renderable");
+			e->localTransform.setTranslation(Vec3f(float(i), 0, -float(i)));
+			e->addComponent(new HeavyMeshComponent(renderWork, drawCount));
+		}
+
+		e = root.addLastChild("Camera");
+		camera = e->addComponent(new CameraComponent(renderer));
+		camera->frustum.create(45.f, 4.0f / 3.0f, 0.1f, 500.0f);
+		e->localTransform.setTranslation(Vec3f(0, 0, 10));
+
+		renderTarget = root.addLastChild("Render target")->addComponent(new RenderTargetComponent);
+		renderTarget->entityToRender = scene;
+		renderTarget->cameraComponent = camera;
+	}
+
+	//! A CPU heavy simulation, which moves every renderable.
+	void update(size_t work)
+	{
+		for(Entity* e = scene->firstChild(); e; e = e->nextSibling()) {
+			float x = e->localTransform.translation().x;
+			for(size_t i=0; i<work; ++i)
+				x = ::sinf(x + float(i)) * 0.5f + x;
+			e->localTransform.setTranslation(Vec3f(x, 0, 0));
+		}
+	}
+
+	AtomicInteger drawCount;
+	Entity root;
+	Entity* scene;
+	RendererComponent* renderer;
+	MaterialComponent* material;
+	LightComponent* light;
+	CameraComponent* camera;
+	RenderTargetComponent* renderTarget;
+};	// PipelineScene
+
+}	// namespace
+
+TEST(Snapshot_RenderPipelineTest)
+{
+	PipelineScene scene(10, 0);
+
+	RenderSnapshot snapshot;
+	scene.renderer->extract(scene.root, snapshot);
+
+	CHECK_EQUAL(1u, snapshot.views.size());
+	CHECK_EQUAL(10u, snapshot.itemCount());
+	CHECK_EQUAL(0u, snapshot.skippedCount);
+	CHECK_EQUAL(0, int(scene.drawCount));
+
+	const RenderSnapshot::View& view = snapshot.views[0];
+	CHECK_EQUAL(10u, view.opaque.size());
+	CHECK_CLOSE(10.0f, view.cameraTransform.translation().z, 1e-6f);
+
+	// The opaque items are sorted front to back
+	CHECK_CLOSE(0.0f, view.opaque[0].worldTransform.translation().x, 1e-6f);
+	CHECK_CLOSE(9.0f, view.opaque[9].worldTransform.translation().x, 1e-6f);
+
+	// The lights are captured
+	CHECK_EQUAL(1u, view.lights.size());
+	CHECK_CLOSE(0.5f, view.lights[0].color.g, 1e-6f);
+	CHECK_CLOSE(5.0f, view.lights[0].position.y, 1e-6f);
+
+	// The items draw a copy of the material, one copy for all of them
+	IMaterialComponent* copy = view.opaque[0].material;
+	CHECK(copy != scene.material);
+	CHECK_EQUAL(copy, view.opaque[9].material);
+
+	// Which is not affected by modifying the original
+	scene.material->opacity = 0.5f;
+	CHECK_CLOSE(1.0f, static_cast<MaterialComponent*>(copy)->opacity, 1e-6f);
+
+	// Now the material is transparent, and the items are sorted back to front
+	scene.renderer->extract(scene.root, snapshot);
+	CHECK_EQUAL(0u, snapshot.views[0].opaque.size());
+	CHECK_EQUAL(10u, snapshot.views[0].transparent.size());
+	CHECK_CLOSE(9.0f, snapshot.views[0].transparent[0].worldTransform.translation().x, 1e-6f);
+
+	// Disabled Entity are skipped
+	scene.scene->lastChild()->enabled = false;
+	scene.renderer->extract(scene.root, snapshot);
+	CHECK_EQUAL(9u, snapshot.itemCount());
+
+	// So is a disabled render target
+	scene.renderTarget->entity()->enabled = false;
+	scene.renderer->extract(scene.root, snapshot);
+	CHECK_EQUAL(0u, snapshot.views.size());
+
+	// Drawing the snapshot never touches the Entity tree
+	scene.renderTarget->entity()->enabled = true;
+	scene.renderer->extract(scene.root, snapshot);
+	scene.material->destroyThis();
+	while(Entity* e = scene.scene->firstChild())
+		e->destroyThis();
+	scene.renderer->render(snapshot);
+	CHECK_EQUAL(9, int(scene.drawCount));
+	CHECK_EQUAL(9u, snapshot.transparentStatistic.drawCallCount);
+}
+
+TEST(DestroyWhileRendering_RenderPipelineTest)
+{
+	PipelineScene scene(10, 100000);
+
+	RenderPipeline pipeline(*scene.renderer, true);
+	CHECK(pipeline.threaded());
+	pipeline.submit(scene.root);
+
+	// Destroyed during the update of the next frame, while the last one is still rendering
+	scene.material->destroyThis();
+	for(Entity* e = scene.scene->firstChild(); e; e = e->nextSibling())
+		e->localTransform.setTranslation(Vec3f(-1));
+	while(Entity* e = scene.scene->firstChild())
+		e->destroyThis();
+
+	pipeline.sync();
+	CHECK_EQUAL(10, int(scene.drawCount));
+	CHECK_EQUAL(10u, pipeline.lastSnapshot().itemCount());
+	CHECK_CLOSE(9.0f, pipeline.lastSnapshot().views[0].opaque[9].worldTransform.translation().x, 1e-6f);
+
+	// Nothing left to draw in the next frame
+	pipeline.submit(scene.root);
+	pipeline.sync();
+	CHECK_EQUAL(10, int(scene.drawCount));
+	CHECK_EQUAL(0u, pipeline.lastSnapshot().itemCount());
+}
+
+//! Serial versus pipelined rendering of a CPU heavy update and draw
+TEST(Benchmark_RenderPipelineTest)
+{
+	const size_t renderableCount = 200, updateWork = 2000, renderWork = 2000, frameCount = 100;
+
+	const bool threaded[] = { false, true };
+	double serialMs = 0;
+	for(size_t i=0; i<sizeof(threaded)/sizeof(*threaded); ++i) {
+		PipelineScene scene(renderableCount, renderWork);
+		RenderPipeline pipeline(*scene.renderer, threaded[i]);
+
+		double latency = 0;
+		TimeInterval lastFrameBegin;
+		Timer timer;
+		for(size_t frame=0; frame<frameCount; ++frame) {
+			const TimeInterval frameBegin = Timer::sinceProgramStatup();
+			scene.update(updateWork);
+
+			pipeline.sync();
+			if(frame > 0)
+				latency += (pipeline.lastRenderFinishTime() - lastFrameBegin).asSecond();
+			pipeline.submit(scene.root);
+			lastFrameBegin = frameBegin;
+		}
+		pipeline.sync();
+		latency += (pipeline.lastRenderFinishTime() - lastFrameBegin).asSecond();
+
+		const double ms = timer.get().asSecond() * 1000 / frameCount;
+		if(!pipeline.threaded())
+			serialMs = ms;
+
+		CHECK_EQUAL(int(frameCount * renderableCount), int(scene.drawCount));
+
+		std::cout << (pipeline.threaded() ? "Pipelined" : "Serial") << " rendering: "
+			<< ms << "ms per frame, " << serialMs / ms << "x, latency "
+			<< latency * 1000 / frameCount << "ms" << std::endl;
+	}
+}
@@ -0,0 +1,69 @@
+#include "Pch.h"
+#include "../../MCD/Core/System/PackFileSystem.h"
+#include "../../MCD/Core/System/RawFileSystem.h"
+#include <fstream>
+
+using namespace MCD;
+
+namespace {
+
+bool gCompress = false;
+
+//! Recursively add all files under the folder into the pack.
+bool addFolder(const RawFileSystem& fs, const Path& folder, PackFileWriter& writer)
+{
+	{	void* c = fs.openFirstFileInFolder(folder);
+		for(Path p = fs.getNextFileInFolder(c); !p.getString().empty(); p = fs.getNextFileInFolder(c)) {
+			const Path path = folder / p;
+			std::auto_ptr<std::istream> is = fs.openRead(path);
+			if(!is.get() || !writer.add(path, *is, gCompress, fs.getLastWriteTime(path))) {
+				std::cerr << "Fail to add " << path.getString() << std::endl;
+				fs.closeFirstFileInFolder(c);
+				return false;
+			}
+		}
+		fs.closeFirstFileInFolder(c);
+	}
+
+	void* c = fs.openFirstChildFolder(folder);
+	for(Path p = fs.getNextSiblingFolder(c); !p.getString().empty(); p = fs.getNextSiblingFolder(c)) {
+		if(!addFolder(fs, folder / p, writer)) {
+			fs.closeFirstChildFolder(c);
+			return false;
+		}
+	}
+	fs.closeFirstChildFolder(c);
+
+	return true;
+}
+
+}	// namespace
+
+int main(int argc, char* argv[])
+{
+	if(argc < 3) {
+		std::cout << "Usage: Packer sourceFolder output.pak [-z]" << std::endl;
+		std::cout << "  -z  Deflate compress the entries" << std::endl;
+		return 1;
+	}
+
+	gCompress = argc > 3 && std::string(argv[3]) == "-z";
+
+	RawFileSystem fs(argv[1]);
+	std::fstream os(argv[2], std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+	if(!os) {
+		std::cerr << "Fail to open " << argv[2] << " for writing" << std::endl;
+		return 1;
+	}
+
+	PackFileWriter writer(os);
+	if(!addFolder(fs, "", writer) || !writer.commit()) {
+		std::cerr << "Fail to create " << argv[2] << std::endl;
+		return 1;
+	}
+
+	std::cout << writer.entryCount() << " files packed, "
+		<< writer.dedupCount() << " duplicates (" << writer.dedupBytes() << " bytes) shared" << std::endl;
+
+	return 0;
+}
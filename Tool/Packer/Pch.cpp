@@ -0,0 +1 @@
+#include "Pch.h"
@@ -0,0 +1,3 @@
+#include "../../MCD/Core/System/Platform.h"
+#include <iostream>
+#include <string>